@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef BLOCKPIPELINE_H_
+#define BLOCKPIPELINE_H_
+#include <stdbool.h>
+#include <stdio.h>
+#include "sharedMaf.h"
+
+/* A mafBlockPipeline_t processes maf blocks on a pool of worker threads while
+ * keeping the output in input order. Blocks are handed to the pipeline with
+ * maf_blockPipeline_submit(), which takes ownership of the block. Each block
+ * is passed to the work function on some worker thread along with a FILE that
+ * writes into a private memory buffer. Once all earlier blocks have been
+ * emitted the buffer is passed, together with the block, to the emit function
+ * (or simply written to ofp if emit is NULL) on a single writer thread, after
+ * which the block is destroyed. At most a small window of blocks is held in
+ * memory at once, so submit() blocks when the workers fall behind.
+ * A work function reports an error by writing a message to its FILE and returning
+ * false. Once all earlier blocks have been emitted the message is written to
+ * stderr, and neither that block nor any later one is emitted, matching a serial
+ * run that stops at the first bad block. From then on submit() returns false,
+ * and destroy() returns false once it has drained, so the caller can exit.
+ */
+typedef struct mafBlockPipeline mafBlockPipeline_t;
+typedef bool (*mafPipelineWork_t)(mafBlock_t *mb, FILE *ofp, void *arg);
+typedef void (*mafPipelineEmit_t)(mafBlock_t *mb, const char *buf, size_t n, void *arg);
+
+mafBlockPipeline_t* maf_newBlockPipeline(unsigned numThreads, mafPipelineWork_t work,
+                                         mafPipelineEmit_t emit, void *arg, FILE *ofp);
+bool maf_blockPipeline_submit(mafBlockPipeline_t *bp, mafBlock_t *mb); // false once a block has failed
+bool maf_destroyBlockPipeline(mafBlockPipeline_t *bp); // drains and joins, false if a block failed
+#endif // BLOCKPIPELINE_H_
@@ -47,5 +47,8 @@ int minint(int a, int b);
 char* de_strtok(char **s, char t);
 unsigned countChar(char *s, const char c);
 char** extractSubStrings(char *nameList, unsigned n, const char delineator);
+unsigned de_popcount64(uint64_t w);
+uint64_t de_residueMask(const char *s, int64_t n);
+uint64_t de_identityMask(const char *s1, const char *s2, int64_t n);
 
 #endif // COMMON_H_
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef MAFINDEX_H_
+#define MAFINDEX_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "sharedMaf.h"
+
+/* A mafIndex_t is an on disk index of the alignment blocks of a maf file. It
+ * records where each block starts in the maf along with the coordinates of
+ * each of its `s' lines, and for every sequence a list of the intervals it
+ * covers sorted by start so that the blocks overlapping a region can be found
+ * without reading the maf. Blocks are numbered from 0 in file order, the
+ * header is not counted. An index is tied to the size and modification time
+ * of the maf it was built from, see maf_index_isCurrent().
+ */
+typedef struct mafIndex mafIndex_t;
+typedef struct mafIndexBlock {
+  int64_t offset; // position in the maf, as reported by maf_mafFileApi_tell()
+  uint64_t lineNumber;
+  uint64_t width; // sequence field length
+  uint64_t firstRow;
+  uint64_t numRows;
+} mafIndexBlock_t;
+typedef struct mafIndexRow {
+  uint64_t nameId;
+  uint64_t start;
+  uint64_t length;
+  uint64_t sourceLength;
+  char strand;
+} mafIndexRow_t;
+
+extern const char *kMafIndexSuffix;
+
+char* maf_index_defaultFilename(const char *mafFilename);
+void maf_buildIndex(const char *mafFilename, const char *indexFilename);
+mafIndex_t* maf_openIndex(const char *indexFilename); // NULL if indexFilename does not exist
+mafIndex_t* maf_openIndexForMaf(const char *mafFilename, const char *indexFilename); // NULL if no current index
+bool maf_isIndex(const char *filename); // true if filename begins like an index
+void maf_destroyIndex(mafIndex_t *mi);
+void maf_index_load(mafIndex_t *mi);
+bool maf_index_isCurrent(mafIndex_t *mi, const char *mafFilename);
+uint64_t maf_index_getNumBlocks(mafIndex_t *mi);
+uint64_t maf_index_getNumRows(mafIndex_t *mi);
+uint64_t maf_index_getNumNames(mafIndex_t *mi);
+const char* maf_index_getName(mafIndex_t *mi, uint64_t nameId);
+uint64_t maf_index_getSourceLength(mafIndex_t *mi, uint64_t nameId);
+int64_t maf_index_findName(mafIndex_t *mi, const char *name); // nameId, or -1
+void maf_index_getBlock(mafIndex_t *mi, uint64_t i, mafIndexBlock_t *block);
+void maf_index_getRows(mafIndex_t *mi, mafIndexBlock_t *block, mafIndexRow_t *rows);
+void maf_index_queryBlocks(mafIndex_t *mi, const char *name, uint64_t start, uint64_t stop,
+                           uint64_t **blocks, uint64_t *numBlocks, uint64_t *maxBlocks);
+uint64_t maf_index_uniqueBlocks(uint64_t *blocks, uint64_t n);
+mafBlock_t* maf_index_readBlock(mafIndex_t *mi, mafFileApi_t *mfa, uint64_t i);
+char* maf_index_preadBlock(mafIndex_t *mi, int fd, uint64_t i, uint64_t *length,
+                           uint64_t *lineNumber);
+#endif // MAFINDEX_H_
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef NAMEMATCHER_H_
+#define NAMEMATCHER_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A mafNameMatcher_t is a list of sequence name patterns compiled into a trie
+ * so that a sequence name can be checked against every pattern on the list in
+ * time proportional to the length of the name rather than the length of the
+ * list. A pattern ending in `*' matches any name that begins with the rest of
+ * the pattern. Other patterns match exactly or, if the matcher was built with
+ * prefix set, as prefixes (i.e. `hg19' matches `hg19.chr1'). Patterns are
+ * identified by their index in the list used to build the matcher.
+ */
+typedef struct mafNameMatcher mafNameMatcher_t;
+
+mafNameMatcher_t* maf_newNameMatcher(char **patterns, unsigned n, bool prefix);
+void maf_destroyNameMatcher(mafNameMatcher_t *nm);
+unsigned maf_nameMatcher_getNumPatterns(const mafNameMatcher_t *nm);
+int32_t maf_nameMatcher_match(const mafNameMatcher_t *nm, const char *name); // lowest matching index, or -1
+bool maf_nameMatcher_mark(const mafNameMatcher_t *nm, const char *name, bool *seen, unsigned *numSeen);
+bool maf_nameMatcher_isWild(const char *pattern);
+bool maf_nameMatcher_matchOne(const char *pattern, const char *name);
+#endif // NAMEMATCHER_H_
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SEQUENCESIZES_H_
+#define SEQUENCESIZES_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A mafSequenceSizes_t is a dictionary of sequence names and source lengths,
+ * the information tools otherwise learn by reading every `s' line of a maf
+ * before they start their real work. It is read from a .chrom.sizes style file
+ * (a name and a length on each line, separated by white space) or a samtools
+ * .fai (the columns after the length are ignored), or taken from the name table
+ * of a maf index, which records each name with its source length as the index
+ * is built. Lines that are blank or begin with `#' are skipped. Sequences are
+ * numbered in the order they appear in the file.
+ */
+typedef struct mafSequenceSizes mafSequenceSizes_t;
+
+mafSequenceSizes_t* maf_readSequenceSizes(const char *filename);
+void maf_destroySequenceSizes(mafSequenceSizes_t *ss);
+uint64_t maf_sequenceSizes_getNumSequences(const mafSequenceSizes_t *ss);
+const char* maf_sequenceSizes_getName(const mafSequenceSizes_t *ss, uint64_t i);
+uint64_t maf_sequenceSizes_getLength(const mafSequenceSizes_t *ss, uint64_t i);
+#endif // SEQUENCESIZES_H_
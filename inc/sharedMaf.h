@@ -26,6 +26,7 @@
 #define SHAREDMAF_H_
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 typedef struct mafFileApi mafFileApi_t;
 typedef struct mafBlock mafBlock_t;
@@ -54,6 +55,8 @@ mafBlock_t* maf_readBlockBody(mafFileApi_t *mfa);
 void maf_writeAll(mafFileApi_t *mfa, mafBlock_t *mb);
 void maf_writeBlock(mafFileApi_t *mfa, mafBlock_t *mb);
 uint64_t maf_mafFileApi_getLineNumber(mafFileApi_t *mfa);
+void maf_mafFileApi_tell(mafFileApi_t *mfa, int64_t *offset, uint64_t *lineNumber);
+void maf_mafFileApi_seek(mafFileApi_t *mfa, int64_t offset, uint64_t lineNumber);
 // getters
 char* maf_mafFileApi_getFilename(mafFileApi_t *mfa);
 uint64_t maf_mafFileApi_getLineNumber(mafFileApi_t *mfa);
@@ -128,4 +131,6 @@ char *copyChromosomeName(const char *s); // hg18.chr1 -> chr1
 // print
 void maf_mafBlock_printList(mafBlock_t *m);
 void maf_mafBlock_print(mafBlock_t *m);
+void maf_mafBlock_printToFile(mafBlock_t *m, FILE *ofp);
+void maf_mafBlock_printVerbatimToFile(mafBlock_t *m, FILE *ofp); // lines as read, no reformatting
 #endif // SHAREDMAF_H_
@@ -25,6 +25,9 @@
 #ifndef TEST_COMMON_H_
 #define TEST_COMMON_H_
 #include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include "CuTest.h"
 #include "common.h"
 
@@ -39,9 +42,55 @@ static void test_de_malloc(CuTest *testCase) {
     free(t);
 }
 
+static void test_columnMasks(CuTest *testCase) {
+    // compare against the column by column tests for every length, including the bytes that
+    // differ only in case and those with the high bit set.
+    const char alphabet[] = "ACGTNacgtn-.*@`{zZ\x80\xe1\xc1";
+    char s1[65], s2[65];
+    srand(1);
+    for (int trial = 0; trial < 2000; ++trial) {
+        for (int k = 0; k < 64; ++k) {
+            s1[k] = alphabet[rand() % (sizeof(alphabet) - 1)];
+            s2[k] = (rand() % 2) ? s1[k] : alphabet[rand() % (sizeof(alphabet) - 1)];
+            if (rand() % 4 == 0) {
+                s2[k] = isupper((unsigned char) s1[k]) ? tolower(s1[k]) : toupper(s1[k]);
+            }
+        }
+        s1[64] = s2[64] = '\0';
+        int64_t n = trial % 65;
+        uint64_t residues = 0, identities = 0;
+        for (int64_t k = 0; k < n; ++k) {
+            residues |= (uint64_t) (s1[k] != '-') << k;
+            identities |= (uint64_t) (toupper((unsigned char) s1[k]) != 'N' &&
+                                      toupper((unsigned char) s1[k]) == toupper((unsigned char) s2[k])) << k;
+        }
+        CuAssertTrue(testCase, residues == de_residueMask(s1, n));
+        CuAssertTrue(testCase, identities == de_identityMask(s1, s2, n));
+    }
+}
+static void test_de_popcount64(CuTest *testCase) {
+    CuAssertTrue(testCase, de_popcount64(0) == 0);
+    CuAssertTrue(testCase, de_popcount64(~0ULL) == 64);
+    CuAssertTrue(testCase, de_popcount64(1ULL << 63) == 1);
+    srand(2);
+    for (int trial = 0; trial < 1000; ++trial) {
+        uint64_t w = 0;
+        unsigned count = 0;
+        for (int k = 0; k < 64; ++k) {
+            if (rand() % (trial % 5 + 2) == 0) {
+                w |= 1ULL << k;
+                ++count;
+            }
+        }
+        CuAssertTrue(testCase, de_popcount64(w) == count);
+    }
+}
+
 CuSuite* common_TestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, test_de_malloc);
+    SUITE_ADD_TEST(suite, test_columnMasks);
+    SUITE_ADD_TEST(suite, test_de_popcount64);
     return suite;
 }
 
@@ -29,14 +29,26 @@
 #include "test.sharedMaf.h"
 
 CuSuite* mafShared_TestSuite(void);
+CuSuite* blockPipeline_TestSuite(void);
+CuSuite* nameMatcher_TestSuite(void);
+CuSuite* mafIndex_TestSuite(void);
+CuSuite* sequenceSizes_TestSuite(void);
 
 int include_RunAllTests(void) {
   CuString *output = CuStringNew();
   CuSuite *suite = CuSuiteNew();
   CuSuite *common_s = common_TestSuite();
   CuSuite *maf_s = mafShared_TestSuite();
+  CuSuite *pipeline_s = blockPipeline_TestSuite();
+  CuSuite *matcher_s = nameMatcher_TestSuite();
+  CuSuite *index_s = mafIndex_TestSuite();
+  CuSuite *sizes_s = sequenceSizes_TestSuite();
   CuSuiteAddSuite(suite, common_s);
   CuSuiteAddSuite(suite, maf_s);
+  CuSuiteAddSuite(suite, pipeline_s);
+  CuSuiteAddSuite(suite, matcher_s);
+  CuSuiteAddSuite(suite, index_s);
+  CuSuiteAddSuite(suite, sizes_s);
   CuSuiteRun(suite);
   CuSuiteSummary(suite, output);
   CuSuiteDetails(suite, output);
@@ -45,6 +57,10 @@ int include_RunAllTests(void) {
   int status = (suite->failCount > 0);
   free(common_s);
   free(maf_s);
+  free(pipeline_s);
+  free(matcher_s);
+  free(index_s);
+  free(sizes_s);
   CuSuiteDelete(suite);
   return status;
 }
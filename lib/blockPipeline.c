@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200809L // open_memstream()
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+#include "sharedMaf.h"
+#include "blockPipeline.h"
+
+typedef enum slotState {
+  kSlotEmpty, kSlotQueued, kSlotDone
+} slotState_t;
+typedef struct pipelineSlot {
+  // a pipelineSlot holds one block from submission until it has been emitted
+  mafBlock_t *mb;
+  char *buf; // output of the work function
+  size_t len;
+  bool ok; // what the work function returned
+  slotState_t state;
+} pipelineSlot_t;
+struct mafBlockPipeline {
+  mafPipelineWork_t work;
+  mafPipelineEmit_t emit;
+  void *arg;
+  FILE *ofp;
+  unsigned numThreads;
+  pthread_t *workers;
+  pthread_t writer;
+  pipelineSlot_t *slots;
+  uint64_t window; // number of slots
+  uint64_t submitted; // number of blocks submitted
+  uint64_t claimed; // number of blocks claimed by workers
+  uint64_t emitted; // number of blocks emitted, always <= claimed <= submitted
+  bool finished; // no more blocks will be submitted
+  bool failed; // a block has failed, nothing from it onwards is emitted
+  pthread_mutex_t lock;
+  pthread_cond_t workAvailable;
+  pthread_cond_t slotDone;
+  pthread_cond_t slotFree;
+};
+static void pipeline_fail(const char *what, int status) {
+  fprintf(stderr, "Error, %s failed in block pipeline (%d)\n", what, status);
+  exit(EXIT_FAILURE);
+}
+static void* pipeline_worker(void *data) {
+  mafBlockPipeline_t *bp = (mafBlockPipeline_t *) data;
+  pthread_mutex_lock(&(bp->lock));
+  while (true) {
+    while (bp->claimed == bp->submitted && !bp->finished) {
+      pthread_cond_wait(&(bp->workAvailable), &(bp->lock));
+    }
+    if (bp->claimed == bp->submitted) {
+      break;
+    }
+    pipelineSlot_t *slot = &(bp->slots[bp->claimed % bp->window]);
+    ++(bp->claimed);
+    pthread_mutex_unlock(&(bp->lock));
+    FILE *f = open_memstream(&(slot->buf), &(slot->len));
+    if (f == NULL) {
+      pipeline_fail("open_memstream()", 0);
+    }
+    slot->ok = bp->work(slot->mb, f, bp->arg);
+    fclose(f);
+    pthread_mutex_lock(&(bp->lock));
+    slot->state = kSlotDone;
+    pthread_cond_signal(&(bp->slotDone));
+  }
+  pthread_mutex_unlock(&(bp->lock));
+  return NULL;
+}
+static void* pipeline_writer(void *data) {
+  // emit blocks strictly in the order they were submitted
+  mafBlockPipeline_t *bp = (mafBlockPipeline_t *) data;
+  pthread_mutex_lock(&(bp->lock));
+  while (true) {
+    pipelineSlot_t *slot = &(bp->slots[bp->emitted % bp->window]);
+    while (!(bp->emitted < bp->submitted && slot->state == kSlotDone) &&
+           !(bp->finished && bp->emitted == bp->submitted)) {
+      pthread_cond_wait(&(bp->slotDone), &(bp->lock));
+    }
+    if (bp->emitted == bp->submitted) {
+      break;
+    }
+    if (!slot->ok && !bp->failed) {
+      bp->failed = true;
+      fwrite(slot->buf, sizeof(char), slot->len, stderr);
+    }
+    bool failed = bp->failed; // the failed block and every later one are dropped
+    pthread_mutex_unlock(&(bp->lock));
+    if (!failed) {
+      if (bp->emit != NULL) {
+        bp->emit(slot->mb, slot->buf, slot->len, bp->arg);
+      } else if (slot->len > 0) {
+        fwrite(slot->buf, sizeof(char), slot->len, bp->ofp);
+      }
+    }
+    free(slot->buf);
+    slot->buf = NULL;
+    slot->len = 0;
+    maf_destroyMafBlockList(slot->mb);
+    slot->mb = NULL;
+    pthread_mutex_lock(&(bp->lock));
+    slot->state = kSlotEmpty;
+    ++(bp->emitted);
+    pthread_cond_signal(&(bp->slotFree));
+  }
+  pthread_mutex_unlock(&(bp->lock));
+  return NULL;
+}
+mafBlockPipeline_t* maf_newBlockPipeline(unsigned numThreads, mafPipelineWork_t work,
+                                         mafPipelineEmit_t emit, void *arg, FILE *ofp) {
+  assert(work != NULL);
+  mafBlockPipeline_t *bp = (mafBlockPipeline_t *) de_malloc(sizeof(*bp));
+  bp->work = work;
+  bp->emit = emit;
+  bp->arg = arg;
+  bp->ofp = ofp;
+  bp->numThreads = (numThreads == 0) ? 1 : numThreads;
+  bp->window = 4 * bp->numThreads;
+  bp->slots = (pipelineSlot_t *) de_malloc(sizeof(*(bp->slots)) * bp->window);
+  for (uint64_t i = 0; i < bp->window; ++i) {
+    bp->slots[i].mb = NULL;
+    bp->slots[i].buf = NULL;
+    bp->slots[i].len = 0;
+    bp->slots[i].ok = true;
+    bp->slots[i].state = kSlotEmpty;
+  }
+  bp->submitted = 0;
+  bp->claimed = 0;
+  bp->emitted = 0;
+  bp->finished = false;
+  bp->failed = false;
+  pthread_mutex_init(&(bp->lock), NULL);
+  pthread_cond_init(&(bp->workAvailable), NULL);
+  pthread_cond_init(&(bp->slotDone), NULL);
+  pthread_cond_init(&(bp->slotFree), NULL);
+  bp->workers = (pthread_t *) de_malloc(sizeof(*(bp->workers)) * bp->numThreads);
+  int status;
+  for (unsigned i = 0; i < bp->numThreads; ++i) {
+    if ((status = pthread_create(&(bp->workers[i]), NULL, pipeline_worker, bp)) != 0) {
+      pipeline_fail("pthread_create()", status);
+    }
+  }
+  if ((status = pthread_create(&(bp->writer), NULL, pipeline_writer, bp)) != 0) {
+    pipeline_fail("pthread_create()", status);
+  }
+  return bp;
+}
+bool maf_blockPipeline_submit(mafBlockPipeline_t *bp, mafBlock_t *mb) {
+  pthread_mutex_lock(&(bp->lock));
+  while (bp->submitted - bp->emitted >= bp->window) {
+    pthread_cond_wait(&(bp->slotFree), &(bp->lock));
+  }
+  if (bp->failed) {
+    // nothing more will be emitted, so the block is not queued
+    pthread_mutex_unlock(&(bp->lock));
+    maf_destroyMafBlockList(mb);
+    return false;
+  }
+  pipelineSlot_t *slot = &(bp->slots[bp->submitted % bp->window]);
+  slot->mb = mb;
+  slot->state = kSlotQueued;
+  ++(bp->submitted);
+  pthread_cond_signal(&(bp->workAvailable));
+  pthread_mutex_unlock(&(bp->lock));
+  return true;
+}
+bool maf_destroyBlockPipeline(mafBlockPipeline_t *bp) {
+  if (bp == NULL) {
+    return true;
+  }
+  pthread_mutex_lock(&(bp->lock));
+  bp->finished = true;
+  pthread_cond_broadcast(&(bp->workAvailable));
+  pthread_cond_broadcast(&(bp->slotDone));
+  pthread_mutex_unlock(&(bp->lock));
+  for (unsigned i = 0; i < bp->numThreads; ++i) {
+    pthread_join(bp->workers[i], NULL);
+  }
+  pthread_join(bp->writer, NULL);
+  bool ok = !bp->failed;
+  pthread_mutex_destroy(&(bp->lock));
+  pthread_cond_destroy(&(bp->workAvailable));
+  pthread_cond_destroy(&(bp->slotDone));
+  pthread_cond_destroy(&(bp->slotFree));
+  free(bp->workers);
+  free(bp->slots);
+  free(bp);
+  return ok;
+}
@@ -264,3 +264,74 @@ char** extractSubStrings(char *nameList, unsigned n, const char delineator) {
     copy = NULL;
     return mat;
 }
+
+// Column masks. The first n (<= 64) columns of one or two alignment rows are turned into a
+// bitmask, bit k standing for column k, eight columns at a time within a uint64_t.
+static const uint64_t kLowSevenBits = 0x7f7f7f7f7f7f7f7fULL;
+static const uint64_t kHighBits = 0x8080808080808080ULL;
+static const uint64_t kOnes = 0x0101010101010101ULL;
+static uint64_t loadColumns(const char *s) {
+    // the eight columns from s, column k in byte k.
+    uint64_t w;
+    memcpy(&w, s, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+static uint64_t nonZeroBytes(uint64_t w) {
+    // the high bit of each byte of w that is not zero.
+    return (((w & kLowSevenBits) + kLowSevenBits) | w) & kHighBits;
+}
+static unsigned gatherHighBits(uint64_t w) {
+    // the high bits of the bytes of w as an 8 bit mask, byte k to bit k.
+    return (((w >> 7) & kOnes) * 0x0102040810204080ULL) >> 56;
+}
+static uint64_t upperColumns(uint64_t w) {
+    // toupper() on each byte, a-z only, as in the C locale.
+    uint64_t low = w & kLowSevenBits;
+    uint64_t lowerCase = ((low + kOnes * (0x80 - 'a')) & ~(low + kOnes * (0x80 - 'z' - 1)) & ~w) & kHighBits;
+    return w - (lowerCase >> 2);
+}
+unsigned de_popcount64(uint64_t w) {
+    // the number of set bits in w.
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned) __builtin_popcountll(w);
+#else
+    w -= (w >> 1) & 0x5555555555555555ULL;
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (unsigned) ((w * kOnes) >> 56);
+#endif
+}
+uint64_t de_residueMask(const char *s, int64_t n) {
+    // bit k is set if s[k] is not a gap, for k < n <= 64.
+    assert(n >= 0 && n <= 64);
+    uint64_t mask = 0;
+    int64_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        mask |= (uint64_t) gatherHighBits(nonZeroBytes(loadColumns(s + k) ^ (kOnes * '-'))) << k;
+    }
+    for (; k < n; ++k) {
+        mask |= (uint64_t) (s[k] != '-') << k;
+    }
+    return mask;
+}
+uint64_t de_identityMask(const char *s1, const char *s2, int64_t n) {
+    // bit k is set if s1[k] and s2[k] are the same base, ignoring case, and that base is not N,
+    // for k < n <= 64. Gaps are not excluded, see de_residueMask().
+    assert(n >= 0 && n <= 64);
+    uint64_t mask = 0;
+    int64_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        uint64_t w1 = upperColumns(loadColumns(s1 + k));
+        uint64_t w2 = upperColumns(loadColumns(s2 + k));
+        uint64_t same = ~nonZeroBytes(w1 ^ w2) & kHighBits;
+        mask |= (uint64_t) gatherHighBits(same & nonZeroBytes(w1 ^ (kOnes * 'N'))) << k;
+    }
+    for (; k < n; ++k) {
+        int c1 = toupper((unsigned char) s1[k]);
+        mask |= (uint64_t) (c1 != 'N' && c1 == toupper((unsigned char) s2[k])) << k;
+    }
+    return mask;
+}
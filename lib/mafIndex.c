@@ -0,0 +1,674 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#define _POSIX_C_SOURCE 200809L // fseeko(), ftello(), pread()
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafIndex.h"
+
+/* Layout of an index file. Every field is a uint64_t in native byte order.
+ *   header:    magic, byte order mark, maf size, maf mtime, numBlocks, numRows,
+ *              numNames, blocksOffset, namesOffset, intervalsOffset
+ *   rows:      numRows x {nameId, start, length, sourceLength, strand}
+ *   blocks:    numBlocks x {offset, lineNumber, width, firstRow, numRows}
+ *   names:     numNames x {nameLength, name (not terminated, padded to a multiple
+ *              of 8 bytes), sourceLength, firstInterval, numIntervals}
+ *   intervals: for each name, sorted by lo, {lo, hi, maxHi, block}. [lo, hi] is
+ *              the positive strand extent of a row, inclusive, and maxHi is the
+ *              largest hi of this and all preceding intervals of the name.
+ */
+const char *kMafIndexSuffix = ".mafidx";
+static const uint64_t kMafIndexMagic = 0x313058444946414dULL; // "MAFIDX01" on little endian machines
+static const uint64_t kMafIndexByteOrder = 0x0102030405060708ULL;
+static const uint64_t kMafIndexHeaderSize = 10 * sizeof(uint64_t);
+static const uint64_t kMafIndexQueryChunk = 256; // intervals read at a time when walking back
+
+typedef struct indexName {
+  char *name;
+  uint64_t sourceLength;
+  uint64_t firstInterval;
+  uint64_t numIntervals;
+} indexName_t;
+typedef struct indexInterval {
+  uint64_t nameId;
+  uint64_t lo;
+  uint64_t hi;
+  uint64_t block;
+} indexInterval_t;
+typedef struct nameTable {
+  // names seen while building an index, ids are assigned in order of first appearance
+  indexName_t *names;
+  uint64_t numNames;
+  uint64_t maxNames;
+  int64_t *slots; // open addressing hash of name -> id, -1 if empty
+  uint64_t numSlots;
+} nameTable_t;
+struct mafIndex {
+  FILE *ifp;
+  char *filename;
+  uint64_t mafSize;
+  int64_t mafMtime;
+  uint64_t numBlocks;
+  uint64_t numRows;
+  uint64_t numNames;
+  uint64_t blocksOffset;
+  uint64_t namesOffset;
+  uint64_t intervalsOffset;
+  indexName_t *names;
+  indexName_t **sorted; // names sorted for lookup
+  char *data; // the whole index file once maf_index_load() is called, else NULL
+  uint64_t dataSize;
+  uint64_t dataPos;
+};
+
+static void* index_realloc(void *p, size_t n) {
+  void *q = realloc(p, n);
+  if (q == NULL) {
+    fprintf(stderr, "Error, realloc failed in mafIndex\n");
+    exit(EXIT_FAILURE);
+  }
+  return q;
+}
+static void index_write(const void *p, size_t size, size_t n, FILE *ofp, const char *filename) {
+  if (fwrite(p, size, n, ofp) != n) {
+    fprintf(stderr, "Error, unable to write index %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+}
+static void index_read(void *p, size_t size, size_t n, mafIndex_t *mi) {
+  if (mi->data != NULL) {
+    if (mi->dataPos + size * n > mi->dataSize) {
+      fprintf(stderr, "Error, index %s is truncated, rebuild it.\n", mi->filename);
+      exit(EXIT_FAILURE);
+    }
+    memcpy(p, mi->data + mi->dataPos, size * n);
+    mi->dataPos += size * n;
+    return;
+  }
+  if (fread(p, size, n, mi->ifp) != n) {
+    fprintf(stderr, "Error, index %s is truncated, rebuild it.\n", mi->filename);
+    exit(EXIT_FAILURE);
+  }
+}
+static void index_seek(mafIndex_t *mi, uint64_t offset) {
+  if (mi->data != NULL) {
+    mi->dataPos = offset;
+    return;
+  }
+  if (fseeko(mi->ifp, (off_t) offset, SEEK_SET) != 0) {
+    fprintf(stderr, "Error, unable to seek to byte %" PRIu64 " of index %s\n", offset, mi->filename);
+    exit(EXIT_FAILURE);
+  }
+}
+static uint64_t hashName(const char *s) {
+  uint64_t h = 5381;
+  while (*s != '\0') {
+    h = h * 33 + (unsigned char) *s++;
+  }
+  return h;
+}
+static void nameTable_insertSlot(nameTable_t *nt, uint64_t id) {
+  uint64_t i = hashName(nt->names[id].name) & (nt->numSlots - 1);
+  while (nt->slots[i] != -1) {
+    i = (i + 1) & (nt->numSlots - 1);
+  }
+  nt->slots[i] = (int64_t) id;
+}
+static uint64_t nameTable_intern(nameTable_t *nt, const char *name, uint64_t sourceLength) {
+  // return the id of name, adding it to the table if this is its first appearance.
+  uint64_t i = hashName(name) & (nt->numSlots - 1);
+  while (nt->slots[i] != -1) {
+    if (strcmp(nt->names[nt->slots[i]].name, name) == 0) {
+      return (uint64_t) nt->slots[i];
+    }
+    i = (i + 1) & (nt->numSlots - 1);
+  }
+  if (nt->numNames == nt->maxNames) {
+    nt->maxNames *= 2;
+    nt->names = (indexName_t *) index_realloc(nt->names, sizeof(*(nt->names)) * nt->maxNames);
+  }
+  uint64_t id = nt->numNames++;
+  nt->names[id].name = de_strdup(name);
+  nt->names[id].sourceLength = sourceLength;
+  nt->names[id].firstInterval = 0;
+  nt->names[id].numIntervals = 0;
+  if (2 * nt->numNames > nt->numSlots) {
+    // keep the table at most half full
+    free(nt->slots);
+    nt->numSlots *= 2;
+    nt->slots = (int64_t *) de_malloc(sizeof(*(nt->slots)) * nt->numSlots);
+    memset(nt->slots, -1, sizeof(*(nt->slots)) * nt->numSlots);
+    for (uint64_t j = 0; j < nt->numNames; ++j) {
+      nameTable_insertSlot(nt, j);
+    }
+  } else {
+    nt->slots[i] = (int64_t) id;
+  }
+  return id;
+}
+static void rowExtent(uint64_t start, uint64_t length, uint64_t sourceLength, char strand,
+                      uint64_t *lo, uint64_t *hi) {
+  // the positive strand coordinates covered by a row, inclusive. An empty row
+  // is given the positions on either side of it.
+  uint64_t a, b;
+  if (strand == '-') {
+    a = sourceLength - (start + length);
+    b = sourceLength - 1 - start;
+  } else {
+    a = start;
+    b = start + length - 1;
+  }
+  if (length == 0) {
+    *lo = (a > 0) ? a - 1 : 0;
+    *hi = a;
+  } else {
+    *lo = (a < b) ? a : b;
+    *hi = (a < b) ? b : a;
+  }
+}
+static int cmpInterval(const void *a, const void *b) {
+  const indexInterval_t *x = (const indexInterval_t *) a;
+  const indexInterval_t *y = (const indexInterval_t *) b;
+  if (x->nameId != y->nameId) {
+    return (x->nameId < y->nameId) ? -1 : 1;
+  }
+  if (x->lo != y->lo) {
+    return (x->lo < y->lo) ? -1 : 1;
+  }
+  if (x->block != y->block) {
+    return (x->block < y->block) ? -1 : 1;
+  }
+  return 0;
+}
+static int cmpNamePtr(const void *a, const void *b) {
+  return strcmp((*(indexName_t * const *) a)->name, (*(indexName_t * const *) b)->name);
+}
+static int cmpUint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+  return (x < y) ? -1 : (x > y);
+}
+char* maf_index_defaultFilename(const char *mafFilename) {
+  char *s = (char *) de_malloc(strlen(mafFilename) + strlen(kMafIndexSuffix) + 1);
+  sprintf(s, "%s%s", mafFilename, kMafIndexSuffix);
+  return s;
+}
+void maf_buildIndex(const char *mafFilename, const char *indexFilename) {
+  // read through the maf once and write its index. The index is written to a
+  // temporary file which is renamed into place once complete.
+  struct stat st;
+  if (stat(mafFilename, &st) != 0) {
+    fprintf(stderr, "Error, unable to stat maf %s\n", mafFilename);
+    exit(EXIT_FAILURE);
+  }
+  char *tmpFilename = (char *) de_malloc(strlen(indexFilename) + 5);
+  sprintf(tmpFilename, "%s.tmp", indexFilename);
+  FILE *ofp = de_fopen(tmpFilename, "wb");
+  uint64_t header[10] = {kMafIndexMagic, kMafIndexByteOrder, (uint64_t) st.st_size,
+                         (uint64_t) (int64_t) st.st_mtime, 0, 0, 0, 0, 0, 0};
+  index_write(header, sizeof(uint64_t), 10, ofp, tmpFilename);
+  nameTable_t nt;
+  nt.numNames = 0;
+  nt.maxNames = 64;
+  nt.names = (indexName_t *) de_malloc(sizeof(*(nt.names)) * nt.maxNames);
+  nt.numSlots = 128;
+  nt.slots = (int64_t *) de_malloc(sizeof(*(nt.slots)) * nt.numSlots);
+  memset(nt.slots, -1, sizeof(*(nt.slots)) * nt.numSlots);
+  uint64_t numBlocks = 0, maxBlocks = 1024, numRows = 0, maxIntervals = 1024;
+  mafIndexBlock_t *blocks = (mafIndexBlock_t *) de_malloc(sizeof(*blocks) * maxBlocks);
+  indexInterval_t *intervals = (indexInterval_t *) de_malloc(sizeof(*intervals) * maxIntervals);
+  mafFileApi_t *mfa = maf_newMfa(mafFilename, "r");
+  mafBlock_t *mb = maf_readBlock(mfa); // header
+  maf_destroyMafBlockList(mb);
+  while (1) {
+    int64_t offset;
+    uint64_t lineNumber;
+    maf_mafFileApi_tell(mfa, &offset, &lineNumber);
+    if ((mb = maf_readBlock(mfa)) == NULL) {
+      break;
+    }
+    if (numBlocks == maxBlocks) {
+      maxBlocks *= 2;
+      blocks = (mafIndexBlock_t *) index_realloc(blocks, sizeof(*blocks) * maxBlocks);
+    }
+    mafIndexBlock_t *b = &(blocks[numBlocks]);
+    b->offset = offset;
+    b->lineNumber = lineNumber;
+    b->width = maf_mafBlock_getSequenceFieldLength(mb);
+    b->firstRow = numRows;
+    b->numRows = 0;
+    for (mafLine_t *ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+      if (maf_mafLine_getType(ml) != 's') {
+        continue;
+      }
+      uint64_t row[5];
+      row[0] = nameTable_intern(&nt, maf_mafLine_getSpecies(ml), maf_mafLine_getSourceLength(ml));
+      row[1] = maf_mafLine_getStart(ml);
+      row[2] = maf_mafLine_getLength(ml);
+      row[3] = maf_mafLine_getSourceLength(ml);
+      row[4] = (uint64_t) maf_mafLine_getStrand(ml);
+      index_write(row, sizeof(uint64_t), 5, ofp, tmpFilename);
+      if (numRows == maxIntervals) {
+        maxIntervals *= 2;
+        intervals = (indexInterval_t *) index_realloc(intervals, sizeof(*intervals) * maxIntervals);
+      }
+      indexInterval_t *in = &(intervals[numRows]);
+      in->nameId = row[0];
+      in->block = numBlocks;
+      rowExtent(row[1], row[2], row[3], (char) row[4], &(in->lo), &(in->hi));
+      ++(b->numRows);
+      ++numRows;
+    }
+    ++numBlocks;
+    maf_destroyMafBlockList(mb);
+  }
+  maf_destroyMfa(mfa);
+  // blocks
+  uint64_t blocksOffset = kMafIndexHeaderSize + numRows * 5 * sizeof(uint64_t);
+  for (uint64_t i = 0; i < numBlocks; ++i) {
+    uint64_t rec[5] = {(uint64_t) blocks[i].offset, blocks[i].lineNumber, blocks[i].width,
+                       blocks[i].firstRow, blocks[i].numRows};
+    index_write(rec, sizeof(uint64_t), 5, ofp, tmpFilename);
+  }
+  // names
+  qsort(intervals, numRows, sizeof(*intervals), cmpInterval);
+  for (uint64_t i = 0; i < numRows; ++i) {
+    indexName_t *n = &(nt.names[intervals[i].nameId]);
+    if (n->numIntervals == 0) {
+      n->firstInterval = i;
+    }
+    ++(n->numIntervals);
+  }
+  uint64_t namesOffset = blocksOffset + numBlocks * 5 * sizeof(uint64_t);
+  uint64_t intervalsOffset = namesOffset;
+  const char pad[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (uint64_t i = 0; i < nt.numNames; ++i) {
+    uint64_t len = strlen(nt.names[i].name);
+    uint64_t padded = (len + 7) / 8 * 8;
+    index_write(&len, sizeof(uint64_t), 1, ofp, tmpFilename);
+    index_write(nt.names[i].name, 1, len, ofp, tmpFilename);
+    index_write(pad, 1, padded - len, ofp, tmpFilename);
+    uint64_t rec[3] = {nt.names[i].sourceLength, nt.names[i].firstInterval, nt.names[i].numIntervals};
+    index_write(rec, sizeof(uint64_t), 3, ofp, tmpFilename);
+    intervalsOffset += (4 * sizeof(uint64_t)) + padded;
+  }
+  // intervals
+  uint64_t maxHi = 0;
+  for (uint64_t i = 0; i < numRows; ++i) {
+    if (i == 0 || intervals[i].nameId != intervals[i - 1].nameId || intervals[i].hi > maxHi) {
+      maxHi = intervals[i].hi;
+    }
+    uint64_t rec[4] = {intervals[i].lo, intervals[i].hi, maxHi, intervals[i].block};
+    index_write(rec, sizeof(uint64_t), 4, ofp, tmpFilename);
+  }
+  header[4] = numBlocks;
+  header[5] = numRows;
+  header[6] = nt.numNames;
+  header[7] = blocksOffset;
+  header[8] = namesOffset;
+  header[9] = intervalsOffset;
+  if (fseeko(ofp, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "Error, unable to seek in index %s\n", tmpFilename);
+    exit(EXIT_FAILURE);
+  }
+  index_write(header, sizeof(uint64_t), 10, ofp, tmpFilename);
+  if (fclose(ofp) != 0) {
+    fprintf(stderr, "Error, unable to write index %s\n", tmpFilename);
+    exit(EXIT_FAILURE);
+  }
+  if (rename(tmpFilename, indexFilename) != 0) {
+    fprintf(stderr, "Error, unable to move %s to %s\n", tmpFilename, indexFilename);
+    exit(EXIT_FAILURE);
+  }
+  for (uint64_t i = 0; i < nt.numNames; ++i) {
+    free(nt.names[i].name);
+  }
+  free(nt.names);
+  free(nt.slots);
+  free(blocks);
+  free(intervals);
+  free(tmpFilename);
+}
+mafIndex_t* maf_openIndex(const char *indexFilename) {
+  // open an index and load its name table. Returns NULL if there is no such file.
+  FILE *ifp = fopen(indexFilename, "rb");
+  if (ifp == NULL) {
+    if (errno == ENOENT) {
+      return NULL;
+    }
+    fprintf(stderr, "Error, unable to open index %s\n", indexFilename);
+    exit(EXIT_FAILURE);
+  }
+  mafIndex_t *mi = (mafIndex_t *) de_malloc(sizeof(*mi));
+  mi->ifp = ifp;
+  mi->filename = de_strdup(indexFilename);
+  mi->data = NULL;
+  mi->dataSize = 0;
+  mi->dataPos = 0;
+  uint64_t header[10];
+  index_read(header, sizeof(uint64_t), 10, mi);
+  if (header[0] != kMafIndexMagic) {
+    fprintf(stderr, "Error, %s is not a maf index.\n", indexFilename);
+    exit(EXIT_FAILURE);
+  }
+  if (header[1] != kMafIndexByteOrder) {
+    fprintf(stderr, "Error, index %s was built on a machine with a different byte order, "
+            "rebuild it.\n", indexFilename);
+    exit(EXIT_FAILURE);
+  }
+  mi->mafSize = header[2];
+  mi->mafMtime = (int64_t) header[3];
+  mi->numBlocks = header[4];
+  mi->numRows = header[5];
+  mi->numNames = header[6];
+  mi->blocksOffset = header[7];
+  mi->namesOffset = header[8];
+  mi->intervalsOffset = header[9];
+  index_seek(mi, mi->namesOffset);
+  mi->names = (indexName_t *) de_malloc(sizeof(*(mi->names)) * (mi->numNames + 1));
+  mi->sorted = (indexName_t **) de_malloc(sizeof(*(mi->sorted)) * (mi->numNames + 1));
+  for (uint64_t i = 0; i < mi->numNames; ++i) {
+    uint64_t len, rec[3];
+    index_read(&len, sizeof(uint64_t), 1, mi);
+    uint64_t padded = (len + 7) / 8 * 8;
+    mi->names[i].name = (char *) de_malloc(padded + 1);
+    index_read(mi->names[i].name, 1, padded, mi);
+    mi->names[i].name[len] = '\0';
+    index_read(rec, sizeof(uint64_t), 3, mi);
+    mi->names[i].sourceLength = rec[0];
+    mi->names[i].firstInterval = rec[1];
+    mi->names[i].numIntervals = rec[2];
+    mi->sorted[i] = &(mi->names[i]);
+  }
+  qsort(mi->sorted, mi->numNames, sizeof(*(mi->sorted)), cmpNamePtr);
+  return mi;
+}
+bool maf_isIndex(const char *filename) {
+  FILE *ifp = fopen(filename, "rb");
+  if (ifp == NULL) {
+    return false;
+  }
+  uint64_t magic = 0;
+  bool isIndex = (fread(&magic, sizeof(magic), 1, ifp) == 1) && (magic == kMafIndexMagic);
+  fclose(ifp);
+  return isIndex;
+}
+void maf_destroyIndex(mafIndex_t *mi) {
+  if (mi == NULL) {
+    return;
+  }
+  for (uint64_t i = 0; i < mi->numNames; ++i) {
+    free(mi->names[i].name);
+  }
+  free(mi->names);
+  free(mi->sorted);
+  free(mi->data);
+  fclose(mi->ifp);
+  free(mi->filename);
+  free(mi);
+}
+void maf_index_load(mafIndex_t *mi) {
+  // read the whole index into memory so that lookups no longer touch the file. Meant
+  // for long running processes that make many queries.
+  if (mi->data != NULL) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fileno(mi->ifp), &st) != 0) {
+    fprintf(stderr, "Error, unable to stat index %s\n", mi->filename);
+    exit(EXIT_FAILURE);
+  }
+  uint64_t n = (uint64_t) st.st_size;
+  char *data = (char *) de_malloc(n + 1);
+  index_seek(mi, 0);
+  index_read(data, 1, n, mi);
+  mi->data = data;
+  mi->dataSize = n;
+  mi->dataPos = 0;
+}
+bool maf_index_isCurrent(mafIndex_t *mi, const char *mafFilename) {
+  // true if the maf has the size and modification time it had when the index was built
+  struct stat st;
+  if (stat(mafFilename, &st) != 0) {
+    return false;
+  }
+  return ((uint64_t) st.st_size == mi->mafSize) && ((int64_t) st.st_mtime == mi->mafMtime);
+}
+mafIndex_t* maf_openIndexForMaf(const char *mafFilename, const char *indexFilename) {
+  // open the index for the maf, either indexFilename or, if that is NULL, the default
+  // index next to the maf if there is one. An indexFilename that does not exist is an
+  // error. Returns NULL if there is no default index or if the index is out of date.
+  char *filename = (indexFilename != NULL) ? de_strdup(indexFilename) : maf_index_defaultFilename(mafFilename);
+  mafIndex_t *mi = maf_openIndex(filename);
+  if (mi == NULL) {
+    if (indexFilename != NULL) {
+      fprintf(stderr, "Error, index %s does not exist.\n", filename);
+      exit(EXIT_FAILURE);
+    }
+    de_verbose("no index %s\n", filename);
+  } else if (!maf_index_isCurrent(mi, mafFilename)) {
+    fprintf(stderr, "Warning, index %s is out of date with %s and will not be used, "
+            "rebuild it with mafExtractor --buildIndex.\n", filename, mafFilename);
+    maf_destroyIndex(mi);
+    mi = NULL;
+  } else {
+    de_verbose("using index %s\n", filename);
+  }
+  free(filename);
+  return mi;
+}
+uint64_t maf_index_getNumBlocks(mafIndex_t *mi) {
+  return mi->numBlocks;
+}
+uint64_t maf_index_getNumRows(mafIndex_t *mi) {
+  return mi->numRows;
+}
+uint64_t maf_index_getNumNames(mafIndex_t *mi) {
+  return mi->numNames;
+}
+const char* maf_index_getName(mafIndex_t *mi, uint64_t nameId) {
+  return mi->names[nameId].name;
+}
+uint64_t maf_index_getSourceLength(mafIndex_t *mi, uint64_t nameId) {
+  return mi->names[nameId].sourceLength;
+}
+int64_t maf_index_findName(mafIndex_t *mi, const char *name) {
+  indexName_t key;
+  indexName_t *keyPtr = &key;
+  key.name = (char *) name;
+  indexName_t **found = (indexName_t **) bsearch(&keyPtr, mi->sorted, mi->numNames,
+                                                 sizeof(*(mi->sorted)), cmpNamePtr);
+  if (found == NULL) {
+    return -1;
+  }
+  return (int64_t) (*found - mi->names);
+}
+void maf_index_getBlock(mafIndex_t *mi, uint64_t i, mafIndexBlock_t *block) {
+  if (i >= mi->numBlocks) {
+    fprintf(stderr, "Error, block %" PRIu64 " is out of range for index %s\n", i, mi->filename);
+    exit(EXIT_FAILURE);
+  }
+  uint64_t rec[5];
+  index_seek(mi, mi->blocksOffset + i * sizeof(rec));
+  index_read(rec, sizeof(uint64_t), 5, mi);
+  block->offset = (int64_t) rec[0];
+  block->lineNumber = rec[1];
+  block->width = rec[2];
+  block->firstRow = rec[3];
+  block->numRows = rec[4];
+}
+void maf_index_getRows(mafIndex_t *mi, mafIndexBlock_t *block, mafIndexRow_t *rows) {
+  // fill rows, which must have room for block->numRows entries
+  uint64_t rec[5];
+  index_seek(mi, kMafIndexHeaderSize + block->firstRow * sizeof(rec));
+  for (uint64_t i = 0; i < block->numRows; ++i) {
+    index_read(rec, sizeof(uint64_t), 5, mi);
+    rows[i].nameId = rec[0];
+    rows[i].start = rec[1];
+    rows[i].length = rec[2];
+    rows[i].sourceLength = rec[3];
+    rows[i].strand = (char) rec[4];
+  }
+}
+void maf_index_queryBlocks(mafIndex_t *mi, const char *name, uint64_t start, uint64_t stop,
+                           uint64_t **blocks, uint64_t *numBlocks, uint64_t *maxBlocks) {
+  // append to *blocks the number of every block that has a row on name overlapping
+  // [start, stop], inclusive and in positive strand coordinates. A block is appended
+  // once per overlapping row, see maf_index_uniqueBlocks(). *blocks may start out
+  // NULL with *maxBlocks 0.
+  int64_t id = maf_index_findName(mi, name);
+  if (id < 0) {
+    return;
+  }
+  indexName_t *n = &(mi->names[id]);
+  const uint64_t recSize = 4 * sizeof(uint64_t);
+  uint64_t base = mi->intervalsOffset + n->firstInterval * recSize;
+  // find the first interval that starts after stop
+  uint64_t lo = 0, hi = n->numIntervals;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    uint64_t v;
+    index_seek(mi, base + mid * recSize);
+    index_read(&v, sizeof(uint64_t), 1, mi);
+    if (v <= stop) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  // walk left until no earlier interval can reach start
+  uint64_t *buffer = (uint64_t *) de_malloc(recSize * kMafIndexQueryChunk);
+  uint64_t i = lo;
+  bool done = false;
+  while (i > 0 && !done) {
+    uint64_t m = (i < kMafIndexQueryChunk) ? i : kMafIndexQueryChunk;
+    index_seek(mi, base + (i - m) * recSize);
+    index_read(buffer, sizeof(uint64_t), 4 * m, mi);
+    for (uint64_t k = m; k > 0; --k) {
+      uint64_t *rec = &(buffer[4 * (k - 1)]);
+      if (rec[2] < start) {
+        done = true;
+        break;
+      }
+      if (rec[1] >= start) {
+        if (*numBlocks == *maxBlocks) {
+          *maxBlocks = (*maxBlocks == 0) ? 64 : 2 * (*maxBlocks);
+          *blocks = (uint64_t *) index_realloc(*blocks, sizeof(**blocks) * (*maxBlocks));
+        }
+        (*blocks)[(*numBlocks)++] = rec[3];
+      }
+    }
+    i -= m;
+  }
+  free(buffer);
+}
+uint64_t maf_index_uniqueBlocks(uint64_t *blocks, uint64_t n) {
+  // sort a list of block numbers into file order and remove repeats, returns the new length
+  if (n == 0) {
+    return 0;
+  }
+  qsort(blocks, n, sizeof(*blocks), cmpUint64);
+  uint64_t j = 0;
+  for (uint64_t i = 1; i < n; ++i) {
+    if (blocks[i] != blocks[j]) {
+      blocks[++j] = blocks[i];
+    }
+  }
+  return j + 1;
+}
+mafBlock_t* maf_index_readBlock(mafIndex_t *mi, mafFileApi_t *mfa, uint64_t i) {
+  // read block i of the maf open in mfa
+  mafIndexBlock_t b;
+  maf_index_getBlock(mi, i, &b);
+  maf_mafFileApi_seek(mfa, b.offset, b.lineNumber);
+  mafBlock_t *mb = maf_readBlock(mfa);
+  if (mb == NULL) {
+    fprintf(stderr, "Error, index %s does not match maf %s, rebuild it.\n", mi->filename,
+            maf_mafFileApi_getFilename(mfa));
+    exit(EXIT_FAILURE);
+  }
+  return mb;
+}
+char* maf_index_preadBlock(mafIndex_t *mi, int fd, uint64_t i, uint64_t *length,
+                           uint64_t *lineNumber) {
+  // read the text of block i from the maf open on fd with a single pread(), without
+  // moving the file offset of fd. The text runs from the `a' line up to the line that
+  // ends the block and is NUL terminated. *length is set to its length and
+  // *lineNumber to the line number of the `a' line. The caller owns the result.
+  mafIndexBlock_t b;
+  maf_index_getBlock(mi, i, &b);
+  uint64_t end = mi->mafSize;
+  if (i + 1 < mi->numBlocks) {
+    mafIndexBlock_t next;
+    maf_index_getBlock(mi, i + 1, &next);
+    end = (uint64_t) next.offset;
+  }
+  uint64_t n = end - (uint64_t) b.offset;
+  char *s = (char *) de_malloc(n + 1);
+  uint64_t got = 0;
+  while (got < n) {
+    ssize_t r = pread(fd, s + got, n - got, (off_t) (b.offset + got));
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      break;
+    }
+    got += (uint64_t) r;
+  }
+  // the span between two block offsets may hold blank and comment lines before the
+  // block and blank lines after it
+  uint64_t k = 0, first = n, line = b.lineNumber + 1;
+  while (k < n) {
+    char *eol = (got == n) ? (char *) memchr(s + k, '\n', n - k) : NULL;
+    uint64_t next = (eol == NULL) ? n : (uint64_t) (eol - s) + 1;
+    if (first == n) {
+      if (s[k] == 'a') {
+        first = k;
+      } else {
+        ++line;
+      }
+    } else if (s[k] == '\n' || s[k] == '\r') {
+      break;
+    }
+    k = next;
+  }
+  if (got != n || first == n) {
+    fprintf(stderr, "Error, index %s does not match its maf, rebuild it.\n", mi->filename);
+    exit(EXIT_FAILURE);
+  }
+  memmove(s, s + first, k - first);
+  s[k - first] = '\0';
+  *length = k - first;
+  *lineNumber = line;
+  return s;
+}
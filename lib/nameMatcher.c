@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "nameMatcher.h"
+
+typedef struct nameMatcherNode {
+  // a single node of the trie, children are kept as a sibling list.
+  char c;
+  int32_t child; // index of first child, -1 if none
+  int32_t sibling; // index of next sibling, -1 if none
+  int32_t exact; // first pattern that ends at this node and matches exactly, -1 if none
+  int32_t prefix; // first pattern that ends at this node and matches as a prefix, -1 if none
+} nameMatcherNode_t;
+struct mafNameMatcher {
+  nameMatcherNode_t *nodes;
+  uint32_t numNodes;
+  uint32_t maxNodes;
+  unsigned numPatterns;
+  int32_t *duplicates; // duplicates[i] is the next pattern identical to pattern i, -1 if none
+};
+
+static void nameMatcher_insert(mafNameMatcher_t *nm, const char *pattern, int32_t index, bool prefix);
+static void nameMatcher_markChain(const mafNameMatcher_t *nm, int32_t index, bool *seen, unsigned *numSeen);
+
+mafNameMatcher_t* maf_newNameMatcher(char **patterns, unsigned n, bool prefix) {
+  // build a matcher out of the list of patterns. If prefix is true then every
+  // pattern matches as a prefix, otherwise only patterns ending in `*' do.
+  mafNameMatcher_t *nm = (mafNameMatcher_t *) de_malloc(sizeof(*nm));
+  nm->maxNodes = 64;
+  nm->nodes = (nameMatcherNode_t *) de_malloc(sizeof(*(nm->nodes)) * nm->maxNodes);
+  nm->nodes[0].c = '\0';
+  nm->nodes[0].child = -1;
+  nm->nodes[0].sibling = -1;
+  nm->nodes[0].exact = -1;
+  nm->nodes[0].prefix = -1;
+  nm->numNodes = 1;
+  nm->numPatterns = n;
+  nm->duplicates = (int32_t *) de_malloc(sizeof(int32_t) * (n + 1));
+  for (unsigned i = 0; i < n; ++i) {
+    nm->duplicates[i] = -1;
+    nameMatcher_insert(nm, patterns[i], (int32_t) i, prefix);
+  }
+  return nm;
+}
+void maf_destroyNameMatcher(mafNameMatcher_t *nm) {
+  if (nm == NULL) {
+    return;
+  }
+  free(nm->nodes);
+  free(nm->duplicates);
+  free(nm);
+}
+unsigned maf_nameMatcher_getNumPatterns(const mafNameMatcher_t *nm) {
+  return nm->numPatterns;
+}
+static void nameMatcher_insert(mafNameMatcher_t *nm, const char *pattern, int32_t index, bool prefix) {
+  size_t len = strlen(pattern);
+  if (maf_nameMatcher_isWild(pattern)) {
+    prefix = true;
+    --len;
+  }
+  int32_t node = 0;
+  for (size_t i = 0; i < len; ++i) {
+    int32_t child = nm->nodes[node].child;
+    while (child != -1 && nm->nodes[child].c != pattern[i]) {
+      child = nm->nodes[child].sibling;
+    }
+    if (child == -1) {
+      if (nm->numNodes == nm->maxNodes) {
+        nm->maxNodes *= 2;
+        nm->nodes = (nameMatcherNode_t *) realloc(nm->nodes, sizeof(*(nm->nodes)) * nm->maxNodes);
+        if (nm->nodes == NULL) {
+          fprintf(stderr, "Error, realloc failed in nameMatcher_insert()\n");
+          exit(EXIT_FAILURE);
+        }
+      }
+      child = nm->numNodes++;
+      nm->nodes[child].c = pattern[i];
+      nm->nodes[child].child = -1;
+      nm->nodes[child].exact = -1;
+      nm->nodes[child].prefix = -1;
+      nm->nodes[child].sibling = nm->nodes[node].child;
+      nm->nodes[node].child = child;
+    }
+    node = child;
+  }
+  int32_t *terminal = prefix ? &(nm->nodes[node].prefix) : &(nm->nodes[node].exact);
+  if (*terminal == -1) {
+    *terminal = index;
+    return;
+  }
+  // identical patterns share a terminal, later ones hang off the first
+  int32_t last = *terminal;
+  while (nm->duplicates[last] != -1) {
+    last = nm->duplicates[last];
+  }
+  nm->duplicates[last] = index;
+}
+int32_t maf_nameMatcher_match(const mafNameMatcher_t *nm, const char *name) {
+  // return the index of the first pattern on the list that matches name, or
+  // -1 if there is none.
+  int32_t best = -1;
+  int32_t node = 0;
+  for (const char *c = name; ; ++c) {
+    int32_t term = nm->nodes[node].prefix;
+    if (term != -1 && (best == -1 || term < best)) {
+      best = term;
+    }
+    if (*c == '\0') {
+      term = nm->nodes[node].exact;
+      if (term != -1 && (best == -1 || term < best)) {
+        best = term;
+      }
+      break;
+    }
+    node = nm->nodes[node].child;
+    while (node != -1 && nm->nodes[node].c != *c) {
+      node = nm->nodes[node].sibling;
+    }
+    if (node == -1) {
+      break;
+    }
+  }
+  return best;
+}
+static void nameMatcher_markChain(const mafNameMatcher_t *nm, int32_t index, bool *seen, unsigned *numSeen) {
+  for (; index != -1; index = nm->duplicates[index]) {
+    if (!seen[index]) {
+      seen[index] = true;
+      ++(*numSeen);
+    }
+  }
+}
+bool maf_nameMatcher_mark(const mafNameMatcher_t *nm, const char *name, bool *seen, unsigned *numSeen) {
+  // walk name down the trie and report whether any pattern matched. If seen
+  // is not NULL, every matching pattern that is not already marked in seen is
+  // marked and numSeen is incremented.
+  bool matched = false;
+  int32_t node = 0;
+  for (const char *c = name; ; ++c) {
+    int32_t term = nm->nodes[node].prefix;
+    if (*c == '\0' && nm->nodes[node].exact != -1) {
+      if (seen == NULL) {
+        return true;
+      }
+      matched = true;
+      nameMatcher_markChain(nm, nm->nodes[node].exact, seen, numSeen);
+    }
+    if (term != -1) {
+      if (seen == NULL) {
+        return true;
+      }
+      matched = true;
+      nameMatcher_markChain(nm, term, seen, numSeen);
+    }
+    if (*c == '\0') {
+      break;
+    }
+    node = nm->nodes[node].child;
+    while (node != -1 && nm->nodes[node].c != *c) {
+      node = nm->nodes[node].sibling;
+    }
+    if (node == -1) {
+      break;
+    }
+  }
+  return matched;
+}
+bool maf_nameMatcher_isWild(const char *pattern) {
+  // return true if pattern ends in `*', false otherwise
+  size_t len = strlen(pattern);
+  return (len > 0 && pattern[len - 1] == '*');
+}
+bool maf_nameMatcher_matchOne(const char *pattern, const char *name) {
+  // check a single pattern against name without building a matcher. The
+  // pattern is exact unless it ends in `*'.
+  if (maf_nameMatcher_isWild(pattern)) {
+    return strncmp(name, pattern, strlen(pattern) - 1) == 0;
+  }
+  return strcmp(name, pattern) == 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "mafIndex.h"
+#include "sequenceSizes.h"
+
+typedef struct sequenceSize {
+  char *name;
+  uint64_t length;
+} sequenceSize_t;
+struct mafSequenceSizes {
+  sequenceSize_t *sequences;
+  uint64_t numSequences;
+  uint64_t maxSequences;
+};
+
+static void sequenceSizes_append(mafSequenceSizes_t *ss, const char *name, uint64_t length) {
+  if (ss->numSequences == ss->maxSequences) {
+    ss->maxSequences *= 2;
+    ss->sequences = (sequenceSize_t *) realloc(ss->sequences, sizeof(*(ss->sequences)) * ss->maxSequences);
+    if (ss->sequences == NULL) {
+      fprintf(stderr, "Error, realloc failed in sequenceSizes\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  ss->sequences[ss->numSequences].name = de_strdup(name);
+  ss->sequences[ss->numSequences].length = length;
+  ++(ss->numSequences);
+}
+static void readSizesFromIndex(mafSequenceSizes_t *ss, const char *filename) {
+  mafIndex_t *mi = maf_openIndex(filename);
+  for (uint64_t i = 0; i < maf_index_getNumNames(mi); ++i) {
+    sequenceSizes_append(ss, maf_index_getName(mi, i), maf_index_getSourceLength(mi, i));
+  }
+  maf_destroyIndex(mi);
+}
+static void readSizesFromText(mafSequenceSizes_t *ss, const char *filename) {
+  // each line is a name and a length separated by white space, anything after the
+  // length (the offset and line widths of a .fai) is ignored.
+  FILE *ifp = de_fopen(filename, "r");
+  int64_t n = 256;
+  char *line = (char *) de_malloc(n);
+  uint64_t lineNumber = 0;
+  while (1) {
+    int64_t status = de_getline(&line, &n, ifp);
+    ++lineNumber;
+    char *p = line;
+    while (isspace((unsigned char) *p)) {
+      ++p;
+    }
+    if (*p != '\0' && *p != '#') {
+      char *name = p;
+      while (*p != '\0' && !isspace((unsigned char) *p)) {
+        ++p;
+      }
+      char *end = NULL;
+      uint64_t length = 0;
+      if (*p != '\0') {
+        *p++ = '\0';
+        while (isspace((unsigned char) *p)) {
+          ++p;
+        }
+        // strtoull() would take "-5" as a huge length, so only digits are allowed
+        if (isdigit((unsigned char) *p)) {
+          errno = 0;
+          length = strtoull(p, &end, 10);
+        }
+      }
+      if (end == NULL || end == p || errno != 0 || !(*end == '\0' || isspace((unsigned char) *end))) {
+        fprintf(stderr, "Error, line %" PRIu64 " of %s is not of the form `name length'.\n",
+                lineNumber, filename);
+        exit(EXIT_FAILURE);
+      }
+      sequenceSizes_append(ss, name, length);
+    }
+    if (status == -1) {
+      break;
+    }
+  }
+  free(line);
+  fclose(ifp);
+}
+static int cmpSequencePtr(const void *a, const void *b) {
+  return strcmp((*(sequenceSize_t * const *) a)->name, (*(sequenceSize_t * const *) b)->name);
+}
+static void checkForConflicts(mafSequenceSizes_t *ss, const char *filename) {
+  // a name may be listed more than once, but only ever with the same length
+  sequenceSize_t **sorted = (sequenceSize_t **) de_malloc(sizeof(*sorted) * (ss->numSequences + 1));
+  for (uint64_t i = 0; i < ss->numSequences; ++i) {
+    sorted[i] = &(ss->sequences[i]);
+  }
+  qsort(sorted, ss->numSequences, sizeof(*sorted), cmpSequencePtr);
+  for (uint64_t i = 1; i < ss->numSequences; ++i) {
+    if (strcmp(sorted[i - 1]->name, sorted[i]->name) == 0 && sorted[i - 1]->length != sorted[i]->length) {
+      fprintf(stderr, "Error, %s lists sequence %s with lengths %" PRIu64 " and %" PRIu64 "\n",
+              filename, sorted[i]->name, sorted[i - 1]->length, sorted[i]->length);
+      exit(EXIT_FAILURE);
+    }
+  }
+  free(sorted);
+}
+mafSequenceSizes_t* maf_readSequenceSizes(const char *filename) {
+  mafSequenceSizes_t *ss = (mafSequenceSizes_t *) de_malloc(sizeof(*ss));
+  ss->numSequences = 0;
+  ss->maxSequences = 64;
+  ss->sequences = (sequenceSize_t *) de_malloc(sizeof(*(ss->sequences)) * ss->maxSequences);
+  if (maf_isIndex(filename)) {
+    readSizesFromIndex(ss, filename);
+  } else {
+    readSizesFromText(ss, filename);
+  }
+  checkForConflicts(ss, filename);
+  return ss;
+}
+void maf_destroySequenceSizes(mafSequenceSizes_t *ss) {
+  if (ss == NULL) {
+    return;
+  }
+  for (uint64_t i = 0; i < ss->numSequences; ++i) {
+    free(ss->sequences[i].name);
+  }
+  free(ss->sequences);
+  free(ss);
+}
+uint64_t maf_sequenceSizes_getNumSequences(const mafSequenceSizes_t *ss) {
+  return ss->numSequences;
+}
+const char* maf_sequenceSizes_getName(const mafSequenceSizes_t *ss, uint64_t i) {
+  return ss->sequences[i].name;
+}
+uint64_t maf_sequenceSizes_getLength(const mafSequenceSizes_t *ss, uint64_t i) {
+  return ss->sequences[i].length;
+}
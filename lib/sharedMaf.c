@@ -22,6 +22,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#define _POSIX_C_SOURCE 200809L // fseeko(), ftello(), strtok_r()
 #include <assert.h>
 #include <ctype.h>
 #include <inttypes.h>
@@ -45,6 +46,7 @@ struct mafFileApi {
   char *lastLine; /* a temporary cache in case the header fails to have a blank
                    * line before the first alignment block.
                    */
+  int64_t lastLineOffset; // byte offset of lastLine in the file
 };
 struct mafLine {
   // a mafLine struct is a single line of a mafBlock
@@ -257,8 +259,8 @@ mafLine_t* maf_newMafLineFromString(const char *s, uint64_t lineNumber) {
     cline = NULL;
     return ml;
   }
-  char *tkn = NULL;
-  tkn = strtok(cline, " \t");
+  char *tkn = NULL, *saveptr = NULL; // strtok_r() so that lines may be parsed on several threads
+  tkn = strtok_r(cline, " \t", &saveptr);
   if (tkn == NULL) {
     free(cline);
     cline = NULL;
@@ -266,7 +268,7 @@ mafLine_t* maf_newMafLineFromString(const char *s, uint64_t lineNumber) {
     sprintf(error, "Unable to separate line on tabs and spaces at line definition field:\n%s", s);
     maf_failBadFormat(lineNumber, error);
   }
-  tkn = strtok(NULL, " \t"); // name field
+  tkn = strtok_r(NULL, " \t", &saveptr); // name field
   if (tkn == NULL) {
     free(cline);
     cline = NULL;
@@ -275,21 +277,21 @@ mafLine_t* maf_newMafLineFromString(const char *s, uint64_t lineNumber) {
   char *species = (char *) de_malloc(strlen(tkn) + 1);
   strcpy(species, tkn);
   ml->species = species;
-  tkn = strtok(NULL, " \t"); // start position
+  tkn = strtok_r(NULL, " \t", &saveptr); // start position
   if (tkn == NULL) {
     free(cline);
     cline = NULL;
     maf_failBadFormat(lineNumber, "Unable to separate line on tabs and spaces at start position field.");
   }
   ml->start = strtoul(tkn, NULL, 10);
-  tkn = strtok(NULL, " \t"); // length position
+  tkn = strtok_r(NULL, " \t", &saveptr); // length position
   if (tkn == NULL){
     free(cline);
     cline = NULL;
     maf_failBadFormat(lineNumber, "Unable to separate line on tabs and spaces at length position field.");
   }
   ml->length = strtoul(tkn, NULL, 10);
-  tkn = strtok(NULL, " \t"); // strand
+  tkn = strtok_r(NULL, " \t", &saveptr); // strand
   if (tkn == NULL) {
     free(cline);
     cline = NULL;
@@ -301,14 +303,14 @@ mafLine_t* maf_newMafLineFromString(const char *s, uint64_t lineNumber) {
     maf_failBadFormat(lineNumber, error);
   }
   ml->strand = tkn[0];
-  tkn = strtok(NULL, " \t"); // source length position
+  tkn = strtok_r(NULL, " \t", &saveptr); // source length position
   if (tkn == NULL) {
     free(cline);
     cline = NULL;
     maf_failBadFormat(lineNumber, "Unable to separate line on tabs and spaces at source length field.");
   }
   ml->sourceLength = strtoul(tkn, NULL, 10);
-  tkn = strtok(NULL, " \t"); // sequence field
+  tkn = strtok_r(NULL, " \t", &saveptr); // sequence field
   if (tkn == NULL) {
     free(cline);
     cline = NULL;
@@ -379,6 +381,7 @@ mafFileApi_t* maf_newMfa(const char *filename, char const *mode) {
   mafFileApi_t *mfa = (mafFileApi_t *) de_malloc(sizeof(*mfa));
   mfa->lineNumber = 0;
   mfa->lastLine = NULL;
+  mfa->lastLineOffset = 0;
   mfa->mfp = de_fopen(filename, mode);
   mfa->filename = de_strdup(filename);
   return mfa;
@@ -440,6 +443,29 @@ char* maf_mafFileApi_getFilename(mafFileApi_t *mfa) {
 uint64_t maf_mafFileApi_getLineNumber(mafFileApi_t *mfa) {
   return mfa->lineNumber;
 }
+void maf_mafFileApi_tell(mafFileApi_t *mfa, int64_t *offset, uint64_t *lineNumber) {
+  // report the position the next call to maf_readBlock() will read the body from,
+  // such that maf_mafFileApi_seek() can later return to it.
+  if (mfa->lastLine != NULL) {
+    *offset = mfa->lastLineOffset;
+    *lineNumber = mfa->lineNumber - 1;
+  } else {
+    *offset = (int64_t) ftello(mfa->mfp);
+    *lineNumber = mfa->lineNumber;
+  }
+}
+void maf_mafFileApi_seek(mafFileApi_t *mfa, int64_t offset, uint64_t lineNumber) {
+  // move to a position previously reported by maf_mafFileApi_tell(). lineNumber
+  // must be past the header.
+  assert(lineNumber > 0);
+  if (fseeko(mfa->mfp, (off_t) offset, SEEK_SET) != 0) {
+    fprintf(stderr, "Error, unable to seek to byte %" PRIi64 " of %s\n", offset, mfa->filename);
+    exit(EXIT_FAILURE);
+  }
+  free(mfa->lastLine);
+  mfa->lastLine = NULL;
+  mfa->lineNumber = lineNumber;
+}
 mafLine_t* maf_mafBlock_getHeadLine(mafBlock_t *mb) {
   return mb->headLine;
 }
@@ -801,6 +827,7 @@ mafBlock_t* maf_readBlockHeader(mafFileApi_t *mfa) {
   int64_t n = kMaxStringLength;
   char *line = (char*) de_malloc(n);
   mafBlock_t *header = maf_newMafBlock();
+  int64_t lineOffset = (int64_t) ftello(mfa->mfp);
   int status = de_getline(&line, &n, mfa->mfp);
   bool validHeader = false;
   ++(mfa->lineNumber);
@@ -816,6 +843,7 @@ mafBlock_t* maf_readBlockHeader(mafFileApi_t *mfa) {
     ml->lineNumber = mfa->lineNumber;
     header->headLine = ml;
     header->tailLine = ml;
+    lineOffset = (int64_t) ftello(mfa->mfp);
     status = de_getline(&line, &n, mfa->mfp);
     ++(mfa->lineNumber);
     header->lineNumber = mfa->lineNumber;
@@ -838,6 +866,7 @@ mafBlock_t* maf_readBlockHeader(mafFileApi_t *mfa) {
       header->headLine->next = ml;
       header->tailLine = ml;
     }
+    lineOffset = (int64_t) ftello(mfa->mfp);
     status = de_getline(&line, &n, mfa->mfp);
     ++(mfa->lineNumber);
     header->lineNumber = mfa->lineNumber;
@@ -860,6 +889,7 @@ mafBlock_t* maf_readBlockHeader(mafFileApi_t *mfa) {
     thisMl->next = ml;
     thisMl = ml;
     header->tailLine = thisMl;
+    lineOffset = (int64_t) ftello(mfa->mfp);
     status = de_getline(&line, &n, mfa->mfp);
     ++(mfa->lineNumber);
     header->lineNumber = mfa->lineNumber;
@@ -871,6 +901,7 @@ mafBlock_t* maf_readBlockHeader(mafFileApi_t *mfa) {
     char *copy = (char *) de_malloc(n + 1); // freed in destroy lines
     strcpy(copy, line);
     mfa->lastLine = copy;
+    mfa->lastLineOffset = lineOffset;
   }
   free(line);
   line = NULL;
@@ -1001,8 +1032,27 @@ void maf_mafBlock_printList(mafBlock_t *m) {
 }
 void maf_mafBlock_print(mafBlock_t *m) {
   // pretty print a mafBlock.
+  maf_mafBlock_printToFile(m, stdout);
+}
+void maf_mafBlock_printVerbatimToFile(mafBlock_t *m, FILE *ofp) {
+  // print a mafBlock to an open file using each line's text as it was read,
+  // i.e. without recomputing the fields. Edits made through the setters
+  // (start, strand, sequence, ...) are not reflected, use printToFile for those.
+  if (m == NULL) {
+    return;
+  }
+  mafLine_t *ml = maf_mafBlock_getHeadLine(m);
+  while (ml != NULL) {
+    fputs(maf_mafLine_getLine(ml), ofp);
+    fputc('\n', ofp);
+    ml = maf_mafLine_getNext(ml);
+  }
+  fprintf(ofp, "\n");
+}
+void maf_mafBlock_printToFile(mafBlock_t *m, FILE *ofp) {
+  // pretty print a mafBlock to an open file.
   if (m == NULL) {
-    printf("..block NULL\n");
+    fprintf(ofp, "..block NULL\n");
     return;
   }
   mafLine_t* ml = maf_mafBlock_getHeadLine(m);
@@ -1053,14 +1103,14 @@ void maf_mafBlock_print(mafBlock_t *m) {
       break;
     }
     if (maf_mafLine_getType(ml) != 's') {
-      printf("%s\n", line);
+      fprintf(ofp, "%s\n", line);
     } else {
-      printf(fmtLine, maf_mafLine_getSpecies(ml), maf_mafLine_getStart(ml), maf_mafLine_getLength(ml),
-             maf_mafLine_getStrand(ml), maf_mafLine_getSourceLength(ml), maf_mafLine_getSequence(ml));
+      fprintf(ofp, fmtLine, maf_mafLine_getSpecies(ml), maf_mafLine_getStart(ml), maf_mafLine_getLength(ml),
+              maf_mafLine_getStrand(ml), maf_mafLine_getSourceLength(ml), maf_mafLine_getSequence(ml));
     }
     ml = maf_mafLine_getNext(ml);
   }
-  printf("\n");
+  fprintf(ofp, "\n");
 }
 static int intmax(int a, int b) {
   if (a > b) {
@@ -1123,14 +1173,20 @@ void maf_mafBlock_flipStrand(mafBlock_t *mb) {
   }
 }
 void reverseComplementSequence(char *s, size_t n) {
-  // accepts upper and lower case, full iupac
-  int c, i, j;
-  for (i = 0, j = n - 1; i < j; ++i, j--) {
+  // accepts upper and lower case, full iupac. swaps and complements in one pass.
+  char c;
+  size_t i, j;
+  if (n == 0) {
+    return;
+  }
+  for (i = 0, j = n - 1; i < j; ++i, --j) {
     c = s[i];
-    s[i] = s[j];
-    s[j] = c;
+    s[i] = complementChar(s[j]);
+    s[j] = complementChar(c);
+  }
+  if (i == j) {
+    s[i] = complementChar(s[i]);
   }
-  complementSequence(s, n);
 }
 void complementSequence(char *s, size_t n) {
   // accepts upper and lower case, full iupac
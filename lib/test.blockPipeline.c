@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "CuTest.h"
+#include "common.h"
+#include "sharedMaf.h"
+#include "blockPipeline.h"
+
+CuSuite* blockPipeline_TestSuite(void);
+
+static bool reportLineNumber(mafBlock_t *mb, FILE *ofp, void *arg) {
+  (void) arg;
+  // uneven amounts of work so that blocks finish out of order
+  volatile uint64_t x = 0;
+  for (uint64_t i = 0; i < (maf_mafBlock_getLineNumber(mb) % 7) * 10000; ++i) {
+    x += i;
+  }
+  fprintf(ofp, "%" PRIu64 "\n", maf_mafBlock_getLineNumber(mb));
+  return true;
+}
+static bool failOnLineNumber(mafBlock_t *mb, FILE *ofp, void *arg) {
+  // fail on the block with line number *arg, writing no message
+  if (maf_mafBlock_getLineNumber(mb) == *(uint64_t *) arg) {
+    return false;
+  }
+  return reportLineNumber(mb, ofp, NULL);
+}
+static void checkEmitOrder(mafBlock_t *mb, const char *buf, size_t n, void *arg) {
+  uint64_t *next = (uint64_t *) arg;
+  uint64_t value = strtoull(buf, NULL, 10);
+  assert(n > 0);
+  if (value == *next && maf_mafBlock_getLineNumber(mb) == *next) {
+    ++(*next);
+  }
+}
+static void test_blockPipeline_order_0(CuTest *testCase) {
+  // output written to ofp must come out in submission order
+  FILE *f = tmpfile();
+  CuAssertTrue(testCase, f != NULL);
+  mafBlockPipeline_t *bp = maf_newBlockPipeline(4, reportLineNumber, NULL, NULL, f);
+  for (uint64_t i = 0; i < 1000; ++i) {
+    mafBlock_t *mb = maf_newMafBlock();
+    maf_mafBlock_setLineNumber(mb, i);
+    maf_blockPipeline_submit(bp, mb);
+  }
+  maf_destroyBlockPipeline(bp);
+  rewind(f);
+  uint64_t value, i = 0;
+  while (fscanf(f, "%" SCNu64, &value) == 1) {
+    CuAssertTrue(testCase, value == i);
+    ++i;
+  }
+  CuAssertTrue(testCase, i == 1000);
+  fclose(f);
+}
+static void test_blockPipeline_emit_0(CuTest *testCase) {
+  // the emit function must see every block, in order, with its buffer
+  uint64_t next = 0;
+  mafBlockPipeline_t *bp = maf_newBlockPipeline(3, reportLineNumber, checkEmitOrder, &next, NULL);
+  for (uint64_t i = 0; i < 500; ++i) {
+    mafBlock_t *mb = maf_newMafBlock();
+    maf_mafBlock_setLineNumber(mb, i);
+    maf_blockPipeline_submit(bp, mb);
+  }
+  maf_destroyBlockPipeline(bp);
+  CuAssertTrue(testCase, next == 500);
+}
+static void test_blockPipeline_empty_0(CuTest *testCase) {
+  // a pipeline that never receives a block must shut down cleanly
+  mafBlockPipeline_t *bp = maf_newBlockPipeline(2, reportLineNumber, NULL, NULL, stdout);
+  CuAssertTrue(testCase, maf_destroyBlockPipeline(bp));
+}
+static void test_blockPipeline_fail_0(CuTest *testCase) {
+  // a failed block stops the output right before it, as a serial run would
+  FILE *f = tmpfile();
+  CuAssertTrue(testCase, f != NULL);
+  uint64_t failAt = 300;
+  mafBlockPipeline_t *bp = maf_newBlockPipeline(4, failOnLineNumber, NULL, &failAt, f);
+  uint64_t submitted = 0;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    mafBlock_t *mb = maf_newMafBlock();
+    maf_mafBlock_setLineNumber(mb, i);
+    if (!maf_blockPipeline_submit(bp, mb)) {
+      break;
+    }
+    ++submitted;
+  }
+  CuAssertTrue(testCase, !maf_destroyBlockPipeline(bp));
+  // submission stops within a window of the failed block
+  CuAssertTrue(testCase, submitted > failAt && submitted < 1000);
+  rewind(f);
+  uint64_t value, i = 0;
+  while (fscanf(f, "%" SCNu64, &value) == 1) {
+    CuAssertTrue(testCase, value == i);
+    ++i;
+  }
+  CuAssertTrue(testCase, i == failAt);
+  fclose(f);
+}
+CuSuite* blockPipeline_TestSuite(void) {
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, test_blockPipeline_order_0);
+  SUITE_ADD_TEST(suite, test_blockPipeline_emit_0);
+  SUITE_ADD_TEST(suite, test_blockPipeline_empty_0);
+  SUITE_ADD_TEST(suite, test_blockPipeline_fail_0);
+  return suite;
+}
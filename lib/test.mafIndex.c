@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "CuTest.h"
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafIndex.h"
+#include "test.sharedMaf.h"
+
+CuSuite* mafIndex_TestSuite(void);
+
+static const char *g_indexTestMaf =
+  "##maf version=1\n"
+  "a score=0\n"
+  "s hg19.chr1 10 5 + 100 ACGTA\n"
+  "s mm9.chr2   0 5 - 50 ACGTA\n"
+  "\n"
+  "a score=1\n"
+  "s hg19.chr1 40 4 + 100 AC-GT\n"
+  "s rn4.chr7  20 3 + 60 A--GT\n"
+  "\n"
+  "\n"
+  "a score=2\n"
+  "s mm9.chr2  10 5 + 50 ACGTA\n"
+  "s hg19.chr1 60 5 - 100 ACGTA\n"
+  "\n";
+
+static uint64_t queryBlocks(mafIndex_t *mi, const char *name, uint64_t start, uint64_t stop,
+                            uint64_t *result) {
+  uint64_t *blocks = NULL, n = 0, max = 0;
+  maf_index_queryBlocks(mi, name, start, stop, &blocks, &n, &max);
+  n = maf_index_uniqueBlocks(blocks, n);
+  for (uint64_t i = 0; i < n; ++i) {
+    result[i] = blocks[i];
+  }
+  free(blocks);
+  return n;
+}
+static void test_mafIndex_build_0(CuTest *testCase) {
+  createTmpFolder();
+  writeStringToTmpFile((char *) g_indexTestMaf);
+  maf_buildIndex("test_tmp/test.maf", "test_tmp/test.maf.mafidx");
+  mafIndex_t *mi = maf_openIndex("test_tmp/test.maf.mafidx");
+  CuAssertTrue(testCase, mi != NULL);
+  CuAssertTrue(testCase, maf_index_isCurrent(mi, "test_tmp/test.maf"));
+  CuAssertTrue(testCase, maf_index_getNumBlocks(mi) == 3);
+  CuAssertTrue(testCase, maf_index_getNumRows(mi) == 6);
+  CuAssertTrue(testCase, maf_index_getNumNames(mi) == 3);
+  int64_t id = maf_index_findName(mi, "rn4.chr7");
+  CuAssertTrue(testCase, id >= 0);
+  CuAssertStrEquals(testCase, "rn4.chr7", maf_index_getName(mi, id));
+  CuAssertTrue(testCase, maf_index_getSourceLength(mi, id) == 60);
+  CuAssertTrue(testCase, maf_index_findName(mi, "rn4") == -1);
+  mafIndexBlock_t b;
+  mafIndexRow_t rows[2];
+  maf_index_getBlock(mi, 2, &b);
+  CuAssertTrue(testCase, b.numRows == 2);
+  CuAssertTrue(testCase, b.width == 5);
+  maf_index_getRows(mi, &b, rows);
+  CuAssertStrEquals(testCase, "hg19.chr1", maf_index_getName(mi, rows[1].nameId));
+  CuAssertTrue(testCase, rows[1].start == 60);
+  CuAssertTrue(testCase, rows[1].strand == '-');
+  maf_destroyIndex(mi);
+  CuAssertTrue(testCase, maf_openIndex("test_tmp/missing.mafidx") == NULL);
+  unlink("test_tmp/test.maf.mafidx");
+  unlink("test_tmp/test.maf");
+  rmdir("test_tmp");
+}
+static void test_mafIndex_query_0(CuTest *testCase) {
+  // hg19.chr1 covers 10..14 (block 0), 40..43 (block 1) and, on the negative
+  // strand, 100 - 65 = 35..39 (block 2)
+  uint64_t result[3];
+  createTmpFolder();
+  writeStringToTmpFile((char *) g_indexTestMaf);
+  maf_buildIndex("test_tmp/test.maf", "test_tmp/test.maf.mafidx");
+  mafIndex_t *mi = maf_openIndex("test_tmp/test.maf.mafidx");
+  CuAssertTrue(testCase, queryBlocks(mi, "hg19.chr1", 0, 9, result) == 0);
+  CuAssertTrue(testCase, queryBlocks(mi, "hg19.chr1", 0, 10, result) == 1);
+  CuAssertTrue(testCase, result[0] == 0);
+  CuAssertTrue(testCase, queryBlocks(mi, "hg19.chr1", 14, 35, result) == 2);
+  CuAssertTrue(testCase, result[0] == 0 && result[1] == 2);
+  CuAssertTrue(testCase, queryBlocks(mi, "hg19.chr1", 0, 99, result) == 3);
+  CuAssertTrue(testCase, result[0] == 0 && result[1] == 1 && result[2] == 2);
+  CuAssertTrue(testCase, queryBlocks(mi, "hg19.chr1", 44, 99, result) == 0);
+  // mm9.chr2 covers 45..49 (block 0) and 10..14 (block 2)
+  CuAssertTrue(testCase, queryBlocks(mi, "mm9.chr2", 12, 47, result) == 2);
+  CuAssertTrue(testCase, queryBlocks(mi, "mm9.chr2", 0, 9, result) == 0);
+  CuAssertTrue(testCase, queryBlocks(mi, "mm9", 0, 100, result) == 0);
+  maf_destroyIndex(mi);
+  unlink("test_tmp/test.maf.mafidx");
+  unlink("test_tmp/test.maf");
+  rmdir("test_tmp");
+}
+static void test_mafIndex_readBlock_0(CuTest *testCase) {
+  // blocks read through the index are the same as those read in order
+  createTmpFolder();
+  writeStringToTmpFile((char *) g_indexTestMaf);
+  maf_buildIndex("test_tmp/test.maf", "test_tmp/test.maf.mafidx");
+  mafIndex_t *mi = maf_openIndex("test_tmp/test.maf.mafidx");
+  mafFileApi_t *mfa = maf_newMfa("test_tmp/test.maf", "r");
+  mafFileApi_t *seek = maf_newMfa("test_tmp/test.maf", "r");
+  mafBlock_t *header = maf_readBlock(mfa);
+  maf_destroyMafBlockList(header);
+  for (uint64_t i = 2; i < 3; --i) {
+    // backwards to be sure the seek is doing the work
+    mafBlock_t *mb = maf_index_readBlock(mi, seek, i);
+    CuAssertTrue(testCase, maf_mafBlock_getNumberOfSequences(mb) == 2);
+    mafIndexBlock_t b;
+    maf_index_getBlock(mi, i, &b);
+    CuAssertTrue(testCase, b.width == maf_mafBlock_getSequenceFieldLength(mb));
+    maf_destroyMafBlockList(mb);
+  }
+  for (uint64_t i = 0; i < 3; ++i) {
+    mafBlock_t *ma = maf_readBlock(mfa);
+    mafBlock_t *mb = maf_index_readBlock(mi, seek, i);
+    CuAssertTrue(testCase, maf_mafBlock_getNumberOfLines(ma) == maf_mafBlock_getNumberOfLines(mb));
+    mafLine_t *la = maf_mafBlock_getHeadLine(ma), *lb = maf_mafBlock_getHeadLine(mb);
+    while (la != NULL && lb != NULL) {
+      CuAssertStrEquals(testCase, maf_mafLine_getLine(la), maf_mafLine_getLine(lb));
+      la = maf_mafLine_getNext(la);
+      lb = maf_mafLine_getNext(lb);
+    }
+    maf_destroyMafBlockList(ma);
+    maf_destroyMafBlockList(mb);
+  }
+  maf_destroyMfa(mfa);
+  maf_destroyMfa(seek);
+  maf_destroyIndex(mi);
+  // a changed maf no longer matches its index
+  writeStringToTmpFile("##maf version=1\n\n");
+  mi = maf_openIndex("test_tmp/test.maf.mafidx");
+  CuAssertTrue(testCase, !maf_index_isCurrent(mi, "test_tmp/test.maf"));
+  maf_destroyIndex(mi);
+  unlink("test_tmp/test.maf.mafidx");
+  unlink("test_tmp/test.maf");
+  rmdir("test_tmp");
+}
+static void test_mafIndex_preadBlock_0(CuTest *testCase) {
+  // a loaded index answers as one read from disk does, and each block comes back
+  // as its own text, without the blank lines around it
+  const char *expected[3] = {"a score=0\n"
+                             "s hg19.chr1 10 5 + 100 ACGTA\n"
+                             "s mm9.chr2   0 5 - 50 ACGTA\n",
+                             "a score=1\n"
+                             "s hg19.chr1 40 4 + 100 AC-GT\n"
+                             "s rn4.chr7  20 3 + 60 A--GT\n",
+                             "a score=2\n"
+                             "s mm9.chr2  10 5 + 50 ACGTA\n"
+                             "s hg19.chr1 60 5 - 100 ACGTA\n"};
+  const uint64_t expectedLine[3] = {2, 6, 11};
+  uint64_t result[3];
+  createTmpFolder();
+  writeStringToTmpFile((char *) g_indexTestMaf);
+  maf_buildIndex("test_tmp/test.maf", "test_tmp/test.maf.mafidx");
+  mafIndex_t *mi = maf_openIndex("test_tmp/test.maf.mafidx");
+  maf_index_load(mi);
+  CuAssertTrue(testCase, maf_index_getNumBlocks(mi) == 3);
+  CuAssertTrue(testCase, queryBlocks(mi, "hg19.chr1", 14, 35, result) == 2);
+  CuAssertTrue(testCase, result[0] == 0 && result[1] == 2);
+  CuAssertTrue(testCase, queryBlocks(mi, "mm9.chr2", 0, 9, result) == 0);
+  int fd = open("test_tmp/test.maf", O_RDONLY);
+  CuAssertTrue(testCase, fd >= 0);
+  for (uint64_t i = 2; i < 3; --i) {
+    uint64_t n, lineNumber;
+    char *s = maf_index_preadBlock(mi, fd, i, &n, &lineNumber);
+    CuAssertStrEquals(testCase, expected[i], s);
+    CuAssertTrue(testCase, n == strlen(expected[i]));
+    CuAssertTrue(testCase, lineNumber == expectedLine[i]);
+    free(s);
+  }
+  close(fd);
+  maf_destroyIndex(mi);
+  unlink("test_tmp/test.maf.mafidx");
+  unlink("test_tmp/test.maf");
+  rmdir("test_tmp");
+}
+CuSuite* mafIndex_TestSuite(void) {
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, test_mafIndex_build_0);
+  SUITE_ADD_TEST(suite, test_mafIndex_query_0);
+  SUITE_ADD_TEST(suite, test_mafIndex_readBlock_0);
+  SUITE_ADD_TEST(suite, test_mafIndex_preadBlock_0);
+  return suite;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CuTest.h"
+#include "common.h"
+#include "nameMatcher.h"
+
+CuSuite* nameMatcher_TestSuite(void);
+
+static void test_nameMatcher_exact_0(CuTest *testCase) {
+  char *patterns[] = {"hg19.chr1", "mm9.chr2", "hg19"};
+  mafNameMatcher_t *nm = maf_newNameMatcher(patterns, 3, false);
+  CuAssertTrue(testCase, maf_nameMatcher_getNumPatterns(nm) == 3);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr1") == 0);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "mm9.chr2") == 1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19") == 2);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr10") == -1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr") == -1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "mm9") == -1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "") == -1);
+  maf_destroyNameMatcher(nm);
+}
+static void test_nameMatcher_prefix_0(CuTest *testCase) {
+  // with prefix set the first pattern on the list that is a prefix wins
+  char *patterns[] = {"hg19.chr1", "mm9", "hg19", "hg"};
+  mafNameMatcher_t *nm = maf_newNameMatcher(patterns, 4, true);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr1") == 0);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr10") == 0);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr2") == 2);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg18.chr2") == 3);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "mm9.chr2") == 1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "mm10.chr2") == -1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "h") == -1);
+  maf_destroyNameMatcher(nm);
+}
+static void test_nameMatcher_wild_0(CuTest *testCase) {
+  char *patterns[] = {"hg19.chr19", "hg19*", "mm9.chr*", "rn4"};
+  mafNameMatcher_t *nm = maf_newNameMatcher(patterns, 4, false);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr19") == 0);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19.chr1") == 1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "hg19") == 1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "mm9.chr7") == 2);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "mm9") == -1);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "rn4.chr1") == -1);
+  maf_destroyNameMatcher(nm);
+  char *all[] = {"*"};
+  nm = maf_newNameMatcher(all, 1, false);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "anything") == 0);
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "") == 0);
+  maf_destroyNameMatcher(nm);
+}
+static void test_nameMatcher_mark_0(CuTest *testCase) {
+  // every matching pattern is marked, duplicates included
+  char *patterns[] = {"hg19", "hg19.chr1", "mm9", "hg19", "hg*"};
+  bool seen[5];
+  unsigned numSeen = 0;
+  memset(seen, 0, sizeof(seen));
+  mafNameMatcher_t *nm = maf_newNameMatcher(patterns, 5, true);
+  CuAssertTrue(testCase, maf_nameMatcher_mark(nm, "hg19.chr1", NULL, NULL));
+  CuAssertTrue(testCase, !maf_nameMatcher_mark(nm, "rn4.chr1", NULL, NULL));
+  CuAssertTrue(testCase, maf_nameMatcher_mark(nm, "hg19.chr1", seen, &numSeen));
+  CuAssertTrue(testCase, numSeen == 4);
+  CuAssertTrue(testCase, seen[0] && seen[1] && !seen[2] && seen[3] && seen[4]);
+  CuAssertTrue(testCase, maf_nameMatcher_mark(nm, "hg19.chr2", seen, &numSeen));
+  CuAssertTrue(testCase, numSeen == 4);
+  CuAssertTrue(testCase, !maf_nameMatcher_mark(nm, "rn4.chr1", seen, &numSeen));
+  CuAssertTrue(testCase, maf_nameMatcher_mark(nm, "mm9.chr2", seen, &numSeen));
+  CuAssertTrue(testCase, numSeen == 5);
+  maf_destroyNameMatcher(nm);
+}
+static void test_nameMatcher_many_0(CuTest *testCase) {
+  // a long list still reports the index of the matching pattern
+  char **patterns = (char **) de_malloc(sizeof(char *) * 600);
+  char name[64];
+  for (unsigned i = 0; i < 600; ++i) {
+    sprintf(name, "species%u.chr%u", i, i % 23);
+    patterns[i] = de_strdup(name);
+  }
+  mafNameMatcher_t *nm = maf_newNameMatcher(patterns, 600, false);
+  for (unsigned i = 0; i < 600; ++i) {
+    CuAssertTrue(testCase, maf_nameMatcher_match(nm, patterns[i]) == (int32_t) i);
+  }
+  CuAssertTrue(testCase, maf_nameMatcher_match(nm, "species600.chr2") == -1);
+  maf_destroyNameMatcher(nm);
+  for (unsigned i = 0; i < 600; ++i) {
+    free(patterns[i]);
+  }
+  free(patterns);
+}
+static void test_nameMatcher_matchOne_0(CuTest *testCase) {
+  CuAssertTrue(testCase, maf_nameMatcher_isWild("hg19*"));
+  CuAssertTrue(testCase, !maf_nameMatcher_isWild("hg1*9"));
+  CuAssertTrue(testCase, !maf_nameMatcher_isWild(""));
+  CuAssertTrue(testCase, maf_nameMatcher_matchOne("hg19.chr19", "hg19.chr19"));
+  CuAssertTrue(testCase, maf_nameMatcher_matchOne("hg19*", "hg19.chr19"));
+  CuAssertTrue(testCase, maf_nameMatcher_matchOne("*", "hg19.chr19"));
+  CuAssertTrue(testCase, !maf_nameMatcher_matchOne("hg19", "hg19.chr19"));
+  CuAssertTrue(testCase, !maf_nameMatcher_matchOne("mm9*", "hg19.chr19"));
+}
+CuSuite* nameMatcher_TestSuite(void) {
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, test_nameMatcher_exact_0);
+  SUITE_ADD_TEST(suite, test_nameMatcher_prefix_0);
+  SUITE_ADD_TEST(suite, test_nameMatcher_wild_0);
+  SUITE_ADD_TEST(suite, test_nameMatcher_mark_0);
+  SUITE_ADD_TEST(suite, test_nameMatcher_many_0);
+  SUITE_ADD_TEST(suite, test_nameMatcher_matchOne_0);
+  return suite;
+}
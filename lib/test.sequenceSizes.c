@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2012 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "CuTest.h"
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafIndex.h"
+#include "sequenceSizes.h"
+#include "test.sharedMaf.h"
+
+CuSuite* sequenceSizes_TestSuite(void);
+
+static void writeSizes(const char *filename, const char *s) {
+  FILE *f = de_fopen(filename, "w");
+  fprintf(f, "%s", s);
+  fclose(f);
+}
+static void test_sequenceSizes_chromSizes_0(CuTest *testCase) {
+  createTmpFolder();
+  writeSizes("test_tmp/test.chrom.sizes", "hg19.chr1\t249250621\n"
+             "# a comment\n"
+             "\n"
+             "mm9.chr2 181748087\n"
+             "hg19.chr1\t249250621\n"
+             "rn4.chr7\t145728004"); // no trailing newline
+  mafSequenceSizes_t *ss = maf_readSequenceSizes("test_tmp/test.chrom.sizes");
+  CuAssertTrue(testCase, maf_sequenceSizes_getNumSequences(ss) == 4);
+  CuAssertStrEquals(testCase, "hg19.chr1", maf_sequenceSizes_getName(ss, 0));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 0) == 249250621);
+  CuAssertStrEquals(testCase, "mm9.chr2", maf_sequenceSizes_getName(ss, 1));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 1) == 181748087);
+  CuAssertStrEquals(testCase, "rn4.chr7", maf_sequenceSizes_getName(ss, 3));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 3) == 145728004);
+  maf_destroySequenceSizes(ss);
+  unlink("test_tmp/test.chrom.sizes");
+  rmdir("test_tmp");
+}
+static void test_sequenceSizes_fai_0(CuTest *testCase) {
+  // only the first two columns of a .fai are used
+  createTmpFolder();
+  writeSizes("test_tmp/test.fa.fai", "chr1\t1000\t6\t60\t61\n"
+             "chr2\t250\t1030\t60\t61\n");
+  mafSequenceSizes_t *ss = maf_readSequenceSizes("test_tmp/test.fa.fai");
+  CuAssertTrue(testCase, maf_sequenceSizes_getNumSequences(ss) == 2);
+  CuAssertStrEquals(testCase, "chr2", maf_sequenceSizes_getName(ss, 1));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 1) == 250);
+  maf_destroySequenceSizes(ss);
+  unlink("test_tmp/test.fa.fai");
+  rmdir("test_tmp");
+}
+static void test_sequenceSizes_index_0(CuTest *testCase) {
+  // an index carries the names and source lengths of its maf in order of appearance
+  createTmpFolder();
+  writeStringToTmpFile((char *) "##maf version=1\n"
+                       "a score=0\n"
+                       "s hg19.chr1 10 5 + 100 ACGTA\n"
+                       "s mm9.chr2   0 5 - 50 ACGTA\n"
+                       "\n"
+                       "a score=1\n"
+                       "s rn4.chr7  20 3 + 60 A--GT\n"
+                       "s hg19.chr1 40 4 + 100 AC-GT\n"
+                       "\n");
+  maf_buildIndex("test_tmp/test.maf", "test_tmp/test.maf.mafidx");
+  CuAssertTrue(testCase, maf_isIndex("test_tmp/test.maf.mafidx"));
+  CuAssertTrue(testCase, !maf_isIndex("test_tmp/test.maf"));
+  mafSequenceSizes_t *ss = maf_readSequenceSizes("test_tmp/test.maf.mafidx");
+  CuAssertTrue(testCase, maf_sequenceSizes_getNumSequences(ss) == 3);
+  CuAssertStrEquals(testCase, "hg19.chr1", maf_sequenceSizes_getName(ss, 0));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 0) == 100);
+  CuAssertStrEquals(testCase, "mm9.chr2", maf_sequenceSizes_getName(ss, 1));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 1) == 50);
+  CuAssertStrEquals(testCase, "rn4.chr7", maf_sequenceSizes_getName(ss, 2));
+  CuAssertTrue(testCase, maf_sequenceSizes_getLength(ss, 2) == 60);
+  maf_destroySequenceSizes(ss);
+  unlink("test_tmp/test.maf.mafidx");
+  unlink("test_tmp/test.maf");
+  rmdir("test_tmp");
+}
+CuSuite* sequenceSizes_TestSuite(void) {
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, test_sequenceSizes_chromSizes_0);
+  SUITE_ADD_TEST(suite, test_sequenceSizes_fai_0);
+  SUITE_ADD_TEST(suite, test_sequenceSizes_index_0);
+  return suite;
+}
@@ -600,6 +600,25 @@ static void test_flipBlockStrand_1(CuTest *testCase) {
   maf_destroyMafBlockList(exp);
   maf_destroyMafBlockList(orig);
 }
+static void test_printVerbatimToFile_0(CuTest *testCase) {
+  // verbatim printing keeps the original spacing, pretty printing does not
+  const char *input = ("a score=6636.0\n"
+                       "s hg18.chr7 27707221 13 + 158545518 gcagct--gaaaaca\n"
+                       "# comment   line\n"
+                       "s baboon  249182 13 -   4622798 gc--agctgaaaaca\n"
+                       "\n");
+  mafBlock_t *mb = maf_newMafBlockFromString(input, 3);
+  FILE *f = tmpfile();
+  CuAssertTrue(testCase, f != NULL);
+  maf_mafBlock_printVerbatimToFile(mb, f);
+  rewind(f);
+  char buffer[256];
+  size_t n = fread(buffer, sizeof(char), sizeof(buffer) - 1, f);
+  buffer[n] = '\0';
+  CuAssertTrue(testCase, strcmp(buffer, input) == 0);
+  fclose(f);
+  maf_destroyMafBlockList(mb);
+}
 static void performTest_copyName(CuTest *testCase, char t,
                                  const char *a,
                                  const char *b) {
@@ -666,6 +685,7 @@ CuSuite* mafShared_TestSuite(void) {
   SUITE_ADD_TEST(suite, test_newMafBlockFromString_0);
   SUITE_ADD_TEST(suite, test_flipBlockStrand_0);
   SUITE_ADD_TEST(suite, test_flipBlockStrand_1);
+  SUITE_ADD_TEST(suite, test_printVerbatimToFile_0);
   SUITE_ADD_TEST(suite, test_copySpeciesName_0);
   SUITE_ADD_TEST(suite, test_copyChromosomeName_0);
   SUITE_ADD_TEST(suite, test_getSequenceMatrix_0);
@@ -29,6 +29,7 @@
 #include <string.h>
 #include "sonLib.h"
 #include "common.h"
+#include "sequenceSizes.h"
 #include "comparatorAPI.h"
 #include "comparatorRandom.h"
 
@@ -81,6 +82,8 @@ Options* options_construct(void) {
     o->wiggleRegionStop = 0;
     o->numPairsString = NULL;
     o->legitSequences = NULL;
+    o->sizesFile1 = NULL;
+    o->sizesFile2 = NULL;
     o->numberOfSamples = 1000000; // by default do a million samples per file pair.
     o->randomSeed = (time(NULL) << 16) | (getpid() & 65535); // Likely to be unique
     o->near = 0;
@@ -146,6 +149,8 @@ void options_destruct(Options *o) {
     free(o->bedFiles);
     free(o->wigglePairs);
     free(o->legitSequences);
+    free(o->sizesFile1);
+    free(o->sizesFile2);
     free(o->numPairsString);
     free(o);
     o = NULL;
@@ -1536,6 +1541,29 @@ void populateNames(const char *filename, stSet *set, stHash *sequenceLengthHash)
     // clean up
     maf_destroyMfa(mfa);
 }
+void populateNamesFromSizes(const char *filename, stSet *set, stHash *sequenceLengthHash) {
+    /*
+     * as populateNames(), but the names and lengths come from a .chrom.sizes, .fai or maf
+     * index file so that the maf need not be read.
+     */
+    mafSequenceSizes_t *ss = maf_readSequenceSizes(filename);
+    for (uint64_t i = 0; i < maf_sequenceSizes_getNumSequences(ss); ++i) {
+        const char *name = maf_sequenceSizes_getName(ss, i);
+        uint64_t length = maf_sequenceSizes_getLength(ss, i);
+        if (stHash_search(sequenceLengthHash, (void *) name) == NULL) {
+            stHash_insert(sequenceLengthHash, stString_copy(name), buildInt64(length));
+        } else if (*(int64_t*)stHash_search(sequenceLengthHash, (void *) name) != (int64_t) length) {
+            fprintf(stderr, "Inconsistency detected. Previous source length for sequence %s was %" PRIu64
+                    " but %s gives %" PRIu64 "\n", name, *(uint64_t*)stHash_search(sequenceLengthHash, (void *) name),
+                    filename, length);
+            exit(EXIT_FAILURE);
+        }
+        if (stSet_search(set, (void *) name) == NULL) {
+            stSet_insert(set, stString_copy(name));
+        }
+    }
+    maf_destroySequenceSizes(ss);
+}
 void writeXMLHeader(FILE *fileHandle){
     fprintf(fileHandle, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\" ?>\n");
     return;
@@ -1607,8 +1635,16 @@ void buildSeqNamesSet(Options *options, stSet *seqNamesSet, stHash *sequenceLeng
         // read the input maf files and construct the set and hash from them
         stSet *seqNamesSet1 = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, free);
         stSet *seqNamesSet2 = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, free);
-        populateNames(options->mafFile1, seqNamesSet1, sequenceLengthHash);
-        populateNames(options->mafFile2, seqNamesSet2, sequenceLengthHash);
+        if (options->sizesFile1 != NULL) {
+            populateNamesFromSizes(options->sizesFile1, seqNamesSet1, sequenceLengthHash);
+        } else {
+            populateNames(options->mafFile1, seqNamesSet1, sequenceLengthHash);
+        }
+        if (options->sizesFile2 != NULL) {
+            populateNamesFromSizes(options->sizesFile2, seqNamesSet2, sequenceLengthHash);
+        } else {
+            populateNames(options->mafFile2, seqNamesSet2, sequenceLengthHash);
+        }
         stSet *seqNamesSetTmp = stSet_getIntersection(seqNamesSet1, seqNamesSet2);
         stSetIterator *sit = stSet_getIterator(seqNamesSetTmp);
         char *key = NULL;
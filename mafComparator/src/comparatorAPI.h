@@ -52,6 +52,8 @@ typedef struct _options {
     uint64_t wiggleRegionStart;
     uint64_t wiggleRegionStop;
     char *legitSequences; // the intersection of sequence names between inputs
+    char *sizesFile1; // sequence names and lengths of mafFile1, instead of reading it
+    char *sizesFile2;
     char *numPairsString;
     uint64_t numberOfSamples;
     uint64_t randomSeed;
@@ -107,6 +109,7 @@ extern bool g_isVerboseFailures;
 Options* options_construct(void);
 void options_destruct(Options* o);
 void populateNames(const char *mAFFile, stSet *set, stHash *seqLengthHash);
+void populateNamesFromSizes(const char *sizesFile, stSet *set, stHash *seqLengthHash);
 stSortedSet* compareMAFs_AB(const char *mAFFileA, const char *mAFFileB, uint64_t *numberOfPairsInFile,
                             stSet *legitimateSequences, stHash *intervalsHash, stHash *wigHash, bool isAtoB,
                             Options *options, stHash *sequenceLengthHash);
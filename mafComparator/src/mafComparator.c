@@ -287,6 +287,10 @@ void usage(void) {
                  "are verified by mafComparator is it runs and discrepncies will cause errors. If this "
                  "option is invoked it can result in a speedup of about 15%. Example: --legitSequences "
                  "apple.chr1:100,apple.chr2:102,pineapple.chr1:2010 ...");
+    usageMessage('\0', "sizes1", "A .chrom.sizes, .fai or maf index file listing the name and source length "
+                 "of every sequence in maf1. When given, the names and lengths are taken from this file "
+                 "rather than from a read of maf1. Ignored if --legitSequences is used.");
+    usageMessage('\0', "sizes2", "As --sizes1, for maf2.");
 
     usageMessage('\0', "logLevel", "Set the log level. [off, critical, info, debug] "
                  "in ascending order.");
@@ -315,6 +319,8 @@ int parseOptions(int argc, char **argv, Options* options) {
         {"wiggleRegionStop", required_argument, 0, 0},
         {"numberOfPairs", required_argument, 0, 0},
         {"legitSequences", required_argument, 0, 0},
+        {"sizes1", required_argument, 0, 0},
+        {"sizes2", required_argument, 0, 0},
         {"printFailed", no_argument, 0, 'p'},
         {"version", no_argument, 0, 'v'},
         {"help", no_argument, 0, 'h'},
@@ -344,6 +350,14 @@ int parseOptions(int argc, char **argv, Options* options) {
                 options->legitSequences = stString_copy(optarg);
                 break;
             }
+            if (strcmp("sizes1", longOptions[longIndex].name) == 0) {
+                options->sizesFile1 = stString_copy(optarg);
+                break;
+            }
+            if (strcmp("sizes2", longOptions[longIndex].name) == 0) {
+                options->sizesFile2 = stString_copy(optarg);
+                break;
+            }
             if (strcmp("samples", longOptions[longIndex].name) == 0) {
                 i = sscanf(optarg, "%" PRIu64, &(options->numberOfSamples));
                 assert(i == 1);
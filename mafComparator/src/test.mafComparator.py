@@ -762,6 +762,77 @@ class LegitSequencesTest(unittest.TestCase):
             self.assertTrue(passed)
         mtt.removeDir(tmpDir)
 
+def writeSizes(filename, maf):
+    """ write a .chrom.sizes file listing the source length of every sequence in maf
+    """
+    sizes = {}
+    for line in maf.split('\n'):
+        data = line.split()
+        if len(data) == 7 and data[0] == 's':
+            sizes[data[1]] = data[5]
+    f = open(filename, 'w')
+    for name in sorted(sizes):
+        f.write('%s\t%s\n' % (name, sizes[name]))
+    f.close()
+
+class SizesTest(unittest.TestCase):
+    def test_sizes(self):
+        """ --sizes1 and --sizes2 should produce the same output as reading the names from the mafs
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('sizes'))
+        for maf1, maf2, totalTrue, totalFalse in knownValues:
+            testMaf1 = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'maf1.maf')), 
+                                    maf1, g_headers)
+            testMaf2 = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'maf2.maf')), 
+                                    maf2, g_headers)
+            writeSizes(os.path.join(tmpDir, 'maf1.sizes'), maf1)
+            writeSizes(os.path.join(tmpDir, 'maf2.sizes'), maf2)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmds = []
+            for out, extra in [('read.xml', []),
+                               ('sizes.xml', ['--sizes1', os.path.join(tmpDir, 'maf1.sizes'),
+                                              '--sizes2', os.path.join(tmpDir, 'maf2.sizes')])]:
+                cmds.append([os.path.abspath(os.path.join(parent, 'test', 'mafComparator')),
+                             '--maf1', os.path.abspath(os.path.join(tmpDir, 'maf1.maf')),
+                             '--maf2', os.path.abspath(os.path.join(tmpDir, 'maf2.maf')),
+                             '--out', os.path.abspath(os.path.join(tmpDir, out)),
+                             '--samples=1000', '--logLevel=critical', '--seed=1',
+                             ] + extra)
+            mtt.recordCommands(cmds, tmpDir)
+            mtt.runCommandsS(cmds, tmpDir)
+            self.assertEqual(open(os.path.join(tmpDir, 'read.xml')).read(),
+                             open(os.path.join(tmpDir, 'sizes.xml')).read())
+        mtt.removeDir(tmpDir)
+    def test_sizesNegative(self):
+        """ --sizes1 should fail on a negative sequence length
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('sizesNegative'))
+        maf1, maf2, totalTrue, totalFalse = knownValues[0]
+        testMaf1 = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'maf1.maf')), 
+                                maf1, g_headers)
+        testMaf2 = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'maf2.maf')), 
+                                maf2, g_headers)
+        f = open(os.path.join(tmpDir, 'maf1.sizes'), 'w')
+        f.write('A\t-5\n')
+        f.close()
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafComparator')),
+               '--maf1', os.path.abspath(os.path.join(tmpDir, 'maf1.maf')),
+               '--maf2', os.path.abspath(os.path.join(tmpDir, 'maf2.maf')),
+               '--out', os.path.abspath(os.path.join(tmpDir, 'output.xml')),
+               '--samples=1000', '--logLevel=critical',
+               '--sizes1', os.path.join(tmpDir, 'maf1.sizes'),
+               ]
+        mtt.recordCommands([cmd], tmpDir)
+        p = subprocess.Popen(cmd, cwd=tmpDir, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        out, err = p.communicate()
+        self.assertNotEqual(p.returncode, 0)
+        # rejected when the sizes file is read, not later for disagreeing with the maf
+        self.assertTrue('line 1 of %s is not of the form' % os.path.join(tmpDir, 'maf1.sizes') in err)
+        mtt.removeDir(tmpDir)
+
 class NumberOfPairsTest(unittest.TestCase):
     def test_numberOfPairs(self):
         """ --numberOfPairs options should produce expected and known output for given inputs
@@ -38,10 +38,15 @@
 #include "sonLib.h"
 
 static char *mafFileName = NULL;
+static char *sizesFileName = NULL;
+static char *bedGraphFileName = NULL, *wiggleFileName = NULL;
+static int64_t windowLength = 1000;
 static stSet *speciesOrChromosomeNames = NULL;
-static bool nCoverage = 0, identity = 0, ignoreSpecies = 0;
+static bool nCoverage = 0, identity = 0, ignoreSpecies = 0, singlePass = 0;
+static int64_t numThreads = 1;
 
 const char *g_version = "version 0.1 May 2013";
+const unsigned kTrackBufferSize = 1 << 20;
 uint64_t getRegionSize(char *seq1, stHash *intervalsHash);
 
 void version(void) {
@@ -65,6 +70,16 @@ void usage(void) {
     usageMessage('i', "identity", "report coverage of identical bases.");
     usageMessage('l', "logLevel", "Set logging level, either 'CRITICAL'/'INFO'/'DEBUG'.");
     usageMessage('a', "ignoreSpecies", "Do all chromosomes-against-all-chromosomes coverage.");
+    usageMessage('1', "singlePass", "Read the maf once for all species rather than once per species. "
+            "The coverages of every species are then held in memory at the same time.");
+    usageMessage('t', "threads", "number of threads, the work is shared between them by reference sequence. default 1.");
+    usageMessage('z', "sizes", "path to a .chrom.sizes, .fai or maf index file giving the name and length of every sequence "
+            "in the maf. Saves the read of the maf that otherwise finds them.");
+    usageMessage('b', "bedGraph", "also write, to this file, a bedGraph track of the coverage of the species/chr by each other species.");
+    usageMessage('w', "wiggle", "as --bedGraph but write a fixedStep wiggle track. A last window "
+            "cut short by the end of a sequence is written under its own fixedStep line.");
+    usageMessage('W', "window", "window length for the --bedGraph and --wiggle tracks, each window holds the proportion of its "
+            "bases that are covered. 1 gives per base runs in bedGraph. default 1000.");
     exit(EXIT_FAILURE);
 }
 
@@ -74,9 +89,11 @@ static void parseOptions(int argc, char **argv) {
     while (1) {
         static struct option longOptions[] = { { "help", no_argument, 0, 'h' }, { "maf", required_argument, 0, 'm' }, { "speciesOrChr",
                 required_argument, 0, 's' }, { "nCoverage", no_argument, 0, 'n' }, { "identity", no_argument, 0, 'i' }, { "logLevel",
-                required_argument, 0, 'l' }, { "ignoreSpecies", no_argument, 0, 'a' }, { 0, 0, 0, 0 } };
+                required_argument, 0, 'l' }, { "ignoreSpecies", no_argument, 0, 'a' }, { "singlePass", no_argument, 0, '1' }, { "threads", required_argument, 0, 't' },
+                { "sizes", required_argument, 0, 'z' }, { "bedGraph", required_argument, 0, 'b' }, { "wiggle", required_argument, 0, 'w' },
+                { "window", required_argument, 0, 'W' }, { 0, 0, 0, 0 } };
         int longIndex = 0;
-        c = getopt_long(argc, argv, "m:s:hnl:a", longOptions, &longIndex);
+        c = getopt_long(argc, argv, "m:s:hnil:a1t:z:b:w:W:", longOptions, &longIndex);
         if (c == -1)
             break;
         switch (c) {
@@ -86,6 +103,22 @@ static void parseOptions(int argc, char **argv) {
             case 'm':
                 mafFileName = stString_copy(optarg);
                 break;
+            case 'z':
+                sizesFileName = stString_copy(optarg);
+                break;
+            case 'b':
+                bedGraphFileName = stString_copy(optarg);
+                break;
+            case 'w':
+                wiggleFileName = stString_copy(optarg);
+                break;
+            case 'W':
+                windowLength = strtoll(optarg, NULL, 10);
+                if (windowLength < 1) {
+                    fprintf(stderr, "Error, --window %" PRId64 " must be positive.\n", windowLength);
+                    usage();
+                }
+                break;
             case 'n':
                 nCoverage = 1;
                 break;
@@ -101,6 +134,16 @@ static void parseOptions(int argc, char **argv) {
             case 'a':
                 ignoreSpecies = 1;
                 break;
+            case '1':
+                singlePass = 1;
+                break;
+            case 't':
+                numThreads = strtoll(optarg, NULL, 10);
+                if (numThreads < 1) {
+                    fprintf(stderr, "Error, --threads %" PRId64 " must be positive.\n", numThreads);
+                    usage();
+                }
+                break;
             default:
                 abort();
         }
@@ -117,10 +160,30 @@ static void parseOptions(int argc, char **argv) {
     }
 }
 
+static FILE *openTrackFile(const char *filename) {
+    if (filename == NULL) {
+        return NULL;
+    }
+    FILE *fp = de_fopen(filename, "w");
+    //Tracks are written a line per window so give them a large buffer.
+    setvbuf(fp, NULL, _IOFBF, kTrackBufferSize);
+    return fp;
+}
+
+static void reportTracks(NGenomeCoverage *nGC, FILE *bedGraphFile, FILE *wiggleFile) {
+    if (bedGraphFile != NULL) {
+        nGenomeCoverage_reportTracks(nGC, bedGraphFile, 0, windowLength);
+    }
+    if (wiggleFile != NULL) {
+        nGenomeCoverage_reportTracks(nGC, wiggleFile, 1, windowLength);
+    }
+}
+
 int main(int argc, char **argv) {
     parseOptions(argc, argv);
     //Work out the structure of the chromosomes of the query sequence
-    stHash *sequenceNamesToSequenceSizes = getMapOfSequenceNamesToSizesFromMaf(mafFileName);
+    stHash *sequenceNamesToSequenceSizes = (sizesFileName != NULL) ? getMapOfSequenceNamesToSizesFromFile(sizesFileName)
+            : getMapOfSequenceNamesToSizesFromMaf(mafFileName);
     stHashIterator *sequenceNameIt = stHash_getIterator(sequenceNamesToSequenceSizes);
     char *sequenceName;
     while ((sequenceName = stHash_getNext(sequenceNameIt)) != NULL) {
@@ -152,18 +215,35 @@ int main(int argc, char **argv) {
             stSet_destruct(speciesNames);
         }
     }
+    FILE *bedGraphFile = openTrackFile(bedGraphFileName);
+    FILE *wiggleFile = openTrackFile(wiggleFileName);
     //Print header
     nGenomeCoverage_reportHeader(stdout, nCoverage);
     //For each of the chosen species calculate species
     stSetIterator *speciesOrChrNamesIt = stSet_getIterator(speciesOrChromosomeNames);
     char *speciesOrChrName;
-    while ((speciesOrChrName = stSet_getNext(speciesOrChrNamesIt)) != NULL) {
+    if (singlePass) {
+        //Build every species' coverage structure, then fill them all from one read of the maf
+        stList *nGCs = stList_construct3(0, (void(*)(void *)) nGenomeCoverage_destruct);
+        while ((speciesOrChrName = stSet_getNext(speciesOrChrNamesIt)) != NULL) {
+            stList_append(nGCs, nGenomeCoverage_construct(sequenceNamesToSequenceSizes, speciesOrChrName, ignoreSpecies));
+        }
+        st_logInfo("Computing the coverages for all %" PRId64 " species/chrs in one pass\n", stList_length(nGCs));
+        nGenomeCoverage_populateAll(nGCs, mafFileName, identity, numThreads);
+        for (int64_t i = 0; i < stList_length(nGCs); i++) {
+            nGenomeCoverage_report(stList_get(nGCs, i), stdout, nCoverage);
+            reportTracks(stList_get(nGCs, i), bedGraphFile, wiggleFile);
+        }
+        stList_destruct(nGCs);
+    }
+    while (!singlePass && (speciesOrChrName = stSet_getNext(speciesOrChrNamesIt)) != NULL) {
         st_logInfo("Computing the coverages for species/chr: %s\n", speciesOrChrName);
         //Build the coverage data structure
         NGenomeCoverage *nGC = nGenomeCoverage_construct(sequenceNamesToSequenceSizes, speciesOrChrName, ignoreSpecies);
-        nGenomeCoverage_populate(nGC, mafFileName, identity);
+        nGenomeCoverage_populate(nGC, mafFileName, identity, numThreads);
         //Report
         nGenomeCoverage_report(nGC, stdout, nCoverage);
+        reportTracks(nGC, bedGraphFile, wiggleFile);
         //cleanup loop
         nGenomeCoverage_destruct(nGC);
     }
@@ -173,6 +253,15 @@ int main(int argc, char **argv) {
     stHash_destruct(sequenceNamesToSequenceSizes);
     stSet_destruct(speciesOrChromosomeNames);
     free(mafFileName);
+    free(sizesFileName);
+    if (bedGraphFile != NULL) {
+        fclose(bedGraphFile);
+    }
+    if (wiggleFile != NULL) {
+        fclose(wiggleFile);
+    }
+    free(bedGraphFileName);
+    free(wiggleFileName);
     // while(1);
     return EXIT_SUCCESS;
 }
@@ -33,8 +33,11 @@
 #include <string.h>
 #include <limits.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "nameMatcher.h"
+#include "sequenceSizes.h"
 #include "mafCoverageAPI.h"
 #include "bioioC.h" // benLine()
 #include "sonLib.h"
@@ -45,9 +48,7 @@
 
 bool is_wild(const char *s) {
     // return true if char array ends in *, false otherwise
-    if (s[strlen(s) - 1] == '*')
-        return true;
-    return false;
+    return maf_nameMatcher_isWild(s);
 }
 bool searchMatched(mafLine_t *ml, const char *seq) {
     // report false if search did not match, true if it did
@@ -56,17 +57,7 @@ bool searchMatched(mafLine_t *ml, const char *seq) {
     return searchMatched_(maf_mafLine_getSpecies(ml), seq);
 }
 bool searchMatched_(const char *target, const char *seq) {
-    if (is_wild(seq)) {
-        // only compare up to the wildcard character
-        if (!(strncmp(target, seq, strlen(seq) - 1) == 0)) {
-            return false;
-        }
-    } else {
-        if (!(strcmp(target, seq) == 0)) {
-            return false;
-        }
-    }
-    return true;
+    return maf_nameMatcher_matchOne(seq, target);
 }
 
 /*
@@ -99,6 +90,19 @@ stHash *getMapOfSequenceNamesToSizesFromMaf(char *mafFileName) {
     return sequenceNamesToSequenceSizes;
 }
 
+stHash *getMapOfSequenceNamesToSizesFromFile(char *sizesFileName) {
+    stHash *sequenceNamesToSequenceSizes = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, (void(*)(void *)) stIntTuple_destruct);
+    mafSequenceSizes_t *sequenceSizes = maf_readSequenceSizes(sizesFileName);
+    for (uint64_t i = 0; i < maf_sequenceSizes_getNumSequences(sequenceSizes); i++) {
+        const char *sequenceName = maf_sequenceSizes_getName(sequenceSizes, i);
+        if (stHash_search(sequenceNamesToSequenceSizes, (void *) sequenceName) == NULL) {
+            stHash_insert(sequenceNamesToSequenceSizes, stString_copy(sequenceName), stIntTuple_construct1(maf_sequenceSizes_getLength(sequenceSizes, i)));
+        }
+    }
+    maf_destroySequenceSizes(sequenceSizes);
+    return sequenceNamesToSequenceSizes;
+}
+
 static char *copySpeciesName2(const char *sequenceName, bool ignoreSpeciesNames) {
     return ignoreSpeciesNames ? stString_copy(sequenceName) : copySpeciesName(sequenceName);
 }
@@ -142,25 +146,137 @@ int64_t getTotalLengthOfSequences(stHash *sequenceNamesToSequenceSizes) {
     return length;
 }
 
+/*
+ * The coverage array of a sequence, a saturating count per base kept in fixed size chunks. A chunk is only
+ * allocated once one of its positions is covered, so memory follows the aligned part of the sequence rather
+ * than its length.
+ */
+
+#define COVERAGE_CHUNK_BITS 16
+static const int64_t kCoverageChunkLength = ((int64_t) 1) << COVERAGE_CHUNK_BITS;
+
+struct _coverageArray {
+    int64_t length;
+    int64_t numberOfChunks;
+    char **chunks; //NULL for chunks with no coverage.
+    int64_t *histogram; //Number of positions with each count, 0 to SCHAR_MAX, see coverageArray_getHistogram.
+    bool histogramIsCurrent; //False once a count has changed since the histogram was made.
+};
+
+CoverageArray *coverageArray_construct(int64_t length) {
+    CoverageArray *cA = st_malloc(sizeof(CoverageArray));
+    cA->length = length;
+    cA->numberOfChunks = (length + kCoverageChunkLength - 1) / kCoverageChunkLength;
+    cA->chunks = st_calloc(cA->numberOfChunks, sizeof(char *));
+    cA->histogram = st_calloc(SCHAR_MAX + 1, sizeof(int64_t));
+    cA->histogram[0] = length;
+    cA->histogramIsCurrent = 1;
+    return cA;
+}
+
+void coverageArray_destruct(CoverageArray *cA) {
+    for (int64_t i = 0; i < cA->numberOfChunks; i++) {
+        free(cA->chunks[i]);
+    }
+    free(cA->chunks);
+    free(cA->histogram);
+    free(cA);
+}
+
+int64_t coverageArray_getLength(CoverageArray *cA) {
+    return cA->length;
+}
+
+char coverageArray_get(CoverageArray *cA, int64_t position) {
+    assert(position >= 0 && position < cA->length);
+    char *chunk = cA->chunks[position >> COVERAGE_CHUNK_BITS];
+    return chunk == NULL ? 0 : chunk[position & (kCoverageChunkLength - 1)];
+}
+
+static int64_t coverageArray_getChunkLength(CoverageArray *cA, int64_t chunk) {
+    int64_t chunkStart = chunk * kCoverageChunkLength;
+    return cA->length - chunkStart < kCoverageChunkLength ? cA->length - chunkStart : kCoverageChunkLength;
+}
+
+const int64_t *coverageArray_getHistogram(CoverageArray *cA) {
+    if (cA->histogramIsCurrent) {
+        return cA->histogram;
+    }
+    for (int64_t i = 0; i <= SCHAR_MAX; i++) {
+        cA->histogram[i] = 0;
+    }
+    //Four interleaved sub-histograms, so that runs of equal counts do not serialise on one counter.
+    uint32_t counts[4][SCHAR_MAX + 1];
+    for (int64_t c = 0; c < cA->numberOfChunks; c++) {
+        int64_t chunkLength = coverageArray_getChunkLength(cA, c);
+        const unsigned char *chunk = (const unsigned char *) cA->chunks[c];
+        if (chunk == NULL) {
+            cA->histogram[0] += chunkLength;
+            continue;
+        }
+        memset(counts, 0, sizeof(counts));
+        int64_t i = 0;
+        for (; i + 4 <= chunkLength; i += 4) {
+            counts[0][chunk[i]]++;
+            counts[1][chunk[i + 1]]++;
+            counts[2][chunk[i + 2]]++;
+            counts[3][chunk[i + 3]]++;
+        }
+        for (; i < chunkLength; i++) {
+            counts[0][chunk[i]]++;
+        }
+        for (int64_t j = 0; j <= SCHAR_MAX; j++) {
+            cA->histogram[j] += (int64_t) counts[0][j] + counts[1][j] + counts[2][j] + counts[3][j];
+        }
+    }
+    cA->histogramIsCurrent = 1;
+    return cA->histogram;
+}
+
+int64_t coverageArray_countCovered(CoverageArray *cA, int64_t start, int64_t end) {
+    assert(start >= 0 && start <= end && end <= cA->length);
+    int64_t covered = 0;
+    while (start < end) {
+        int64_t c = start >> COVERAGE_CHUNK_BITS;
+        int64_t chunkEnd = (c + 1) * kCoverageChunkLength < end ? (c + 1) * kCoverageChunkLength : end;
+        const char *chunk = cA->chunks[c];
+        if (chunk != NULL) {
+            for (int64_t i = start & (kCoverageChunkLength - 1), j = chunkEnd - c * kCoverageChunkLength; i < j; i++) {
+                covered += chunk[i] != 0;
+            }
+        }
+        start = chunkEnd;
+    }
+    return covered;
+}
+
+int64_t coverageArray_getNumberOfAllocatedChunks(CoverageArray *cA) {
+    int64_t n = 0;
+    for (int64_t i = 0; i < cA->numberOfChunks; i++) {
+        n += cA->chunks[i] != NULL;
+    }
+    return n;
+}
+
 /*
  * The Pairwise Coverage structure.
  */
 
 struct _pairwiseCoverage {
-    stHash *sequenceCoverages; //A hash of sequence names to char arrays describing the coverage of each base of the given species.
+    stHash *sequenceCoverages; //A hash of sequence names to coverage arrays describing the coverage of each base of the given species.
     const stHash *sequenceNamesToSequenceSizeForGivenSpecies; //A hash of sequence names to their lengths, memory not owned by the object.
 };
 
 PairwiseCoverage *pairwiseCoverage_construct(const stHash *sequenceNamesToSequenceSizeForGivenSpecies) {
     PairwiseCoverage *pC = st_malloc(sizeof(PairwiseCoverage));
-    pC->sequenceCoverages = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, free);
+    pC->sequenceCoverages = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, (void(*)(void *)) coverageArray_destruct);
     pC->sequenceNamesToSequenceSizeForGivenSpecies = sequenceNamesToSequenceSizeForGivenSpecies;
     //Now build the sequence coverage arrays.
     stHashIterator *it = stHash_getIterator((stHash *)pC->sequenceNamesToSequenceSizeForGivenSpecies);
     char *sequenceName;
     while ((sequenceName = stHash_getNext(it)) != NULL) {
         stHash_insert(pC->sequenceCoverages, stString_copy(sequenceName),
-                st_calloc(stIntTuple_get(stHash_search((stHash *)pC->sequenceNamesToSequenceSizeForGivenSpecies, sequenceName), 0), sizeof(char)));
+                coverageArray_construct(stIntTuple_get(stHash_search((stHash *)pC->sequenceNamesToSequenceSizeForGivenSpecies, sequenceName), 0)));
     }
     stHash_destructIterator(it);
     return pC;
@@ -171,16 +287,22 @@ void pairwiseCoverage_destruct(PairwiseCoverage *pC) {
     free(pC);
 }
 
-char *pairwiseCoverage_getCoverageArrayForSequence(PairwiseCoverage *pC, char *sequenceName) {
-    char *sequenceCoverageArray = stHash_search(pC->sequenceCoverages, sequenceName);
+CoverageArray *pairwiseCoverage_getCoverageArrayForSequence(PairwiseCoverage *pC, char *sequenceName) {
+    CoverageArray *sequenceCoverageArray = stHash_search(pC->sequenceCoverages, sequenceName);
     assert(sequenceCoverageArray != NULL);
     return sequenceCoverageArray;
 }
 
-bool pairwiseCoverageArray_increase(char *sequenceCoverageArray, int64_t position) {
-    assert(position >= 0);
-    if ((int64_t) sequenceCoverageArray[position] < SCHAR_MAX) {
-        sequenceCoverageArray[position]++;
+bool pairwiseCoverageArray_increase(CoverageArray *sequenceCoverageArray, int64_t position) {
+    assert(position >= 0 && position < sequenceCoverageArray->length);
+    char **chunk = &sequenceCoverageArray->chunks[position >> COVERAGE_CHUNK_BITS];
+    if (*chunk == NULL) {
+        *chunk = st_calloc(coverageArray_getChunkLength(sequenceCoverageArray, position >> COVERAGE_CHUNK_BITS), sizeof(char));
+    }
+    char *count = &(*chunk)[position & (kCoverageChunkLength - 1)];
+    if ((int64_t) *count < SCHAR_MAX) {
+        (*count)++;
+        sequenceCoverageArray->histogramIsCurrent = 0;
         return 1;
     }
     return 0;
@@ -191,15 +313,16 @@ double *pairwiseCoverage_calculateNCoverages(PairwiseCoverage *pC) {
     double *nCoverages = st_calloc(SCHAR_MAX + 1, sizeof(double));
     char *sequenceName;
     while ((sequenceName = stHash_getNext(it)) != NULL) {
-        int64_t chromosomeLength = stIntTuple_get(stHash_search((stHash *)pC->sequenceNamesToSequenceSizeForGivenSpecies, sequenceName), 0);
-        char *chromosomeCoverage = stHash_search(pC->sequenceCoverages, sequenceName);
-        for (int64_t i = 0; i < chromosomeLength; i++) {
-            for (int64_t j = chromosomeCoverage[i]; j >= 0; j--) {
-                nCoverages[j]++;
-            }
+        const int64_t *histogram = coverageArray_getHistogram(stHash_search(pC->sequenceCoverages, sequenceName));
+        for (int64_t j = 0; j <= SCHAR_MAX; j++) {
+            nCoverages[j] += histogram[j];
         }
     }
     stHash_destructIterator(it);
+    //The n-coverage counts the positions with a count of n or more.
+    for (int64_t j = SCHAR_MAX - 1; j >= 0; j--) {
+        nCoverages[j] += nCoverages[j + 1];
+    }
     int64_t genomeLength = getTotalLengthOfSequences((stHash *)pC->sequenceNamesToSequenceSizeForGivenSpecies);
     for (int64_t i = 0; i <= SCHAR_MAX; i++) {
         nCoverages[i] /= genomeLength;
@@ -207,6 +330,49 @@ double *pairwiseCoverage_calculateNCoverages(PairwiseCoverage *pC) {
     return nCoverages;
 }
 
+static int compareSequenceNames(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+void pairwiseCoverage_writeTrack(PairwiseCoverage *pC, FILE *out, const char *trackName, bool wiggle, int64_t windowLength) {
+    assert(windowLength > 0);
+    fprintf(out, "track type=%s name=\"%s\"\n", wiggle ? "wiggle_0" : "bedGraph", trackName);
+    //Sequences in name order so that the track does not depend on the order of the hash.
+    stList *sequenceNames = stHash_getKeys(pC->sequenceCoverages);
+    stList_sort(sequenceNames, compareSequenceNames);
+    for (int64_t i = 0; i < stList_length(sequenceNames); i++) {
+        char *sequenceName = stList_get(sequenceNames, i);
+        CoverageArray *cA = stHash_search(pC->sequenceCoverages, sequenceName);
+        int64_t length = coverageArray_getLength(cA);
+        //bedGraph merges neighbouring windows with the same value into one run.
+        int64_t runStart = 0;
+        double runValue = 0.0;
+        for (int64_t start = 0; start < length; start += windowLength) {
+            int64_t end = start + windowLength < length ? start + windowLength : length;
+            double value = (double) coverageArray_countCovered(cA, start, end) / (end - start);
+            if (wiggle) {
+                //A window cut short by the end of the sequence gets its own header, so that its
+                //span does not run past the end of the chromosome.
+                if (start == 0 || end - start < windowLength) {
+                    fprintf(out, "fixedStep chrom=%s start=%" PRId64 " step=%" PRId64 " span=%" PRId64 "\n",
+                            sequenceName, start + 1, end - start, end - start);
+                }
+                fprintf(out, "%g\n", value);
+            } else if (start == 0) {
+                runValue = value;
+            } else if (value != runValue) {
+                fprintf(out, "%s\t%" PRId64 "\t%" PRId64 "\t%g\n", sequenceName, runStart, start, runValue);
+                runStart = start;
+                runValue = value;
+            }
+        }
+        if (!wiggle && length > 0) {
+            fprintf(out, "%s\t%" PRId64 "\t%" PRId64 "\t%g\n", sequenceName, runStart, length, runValue);
+        }
+    }
+    stList_destruct(sequenceNames);
+}
+
 double pairwiseCoverage_calculateCoverage(PairwiseCoverage *pC) {
     double *nCoverages = pairwiseCoverage_calculateNCoverages(pC);
     double coverage = nCoverages[1];
@@ -223,6 +389,7 @@ struct _nGenomeCoverage {
     char *speciesOrChrName;
     stHash *pairwiseCoverages;
     stHash *sequenceNamesToSequenceSizeForGivenSpeciesOrChr;
+    stHash *sequenceNamesToPartitions; //Sequence names to the worker thread that fills their coverage, NULL if not threaded.
     bool ignoreSpeciesNames;
 };
 
@@ -240,6 +407,7 @@ NGenomeCoverage *nGenomeCoverage_construct(stHash *sequenceNamesToSequenceSizes,
     while ((speciesName2 = stSet_getNext(it)) != NULL) {
         stHash_insert(nGC->pairwiseCoverages, stString_copy(speciesName2), pairwiseCoverage_construct(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr));
     }
+    nGC->sequenceNamesToPartitions = NULL;
     nGC->ignoreSpeciesNames = ignoreSpeciesNames;
     //Cleanup
     stSet_destructIterator(it);
@@ -248,87 +416,333 @@ NGenomeCoverage *nGenomeCoverage_construct(stHash *sequenceNamesToSequenceSizes,
     return nGC;
 }
 
-void nGenomeCoverage_populate(NGenomeCoverage *nGC, char *mafFileName, bool requireIdentityForMatch) {
-    mafFileApi_t *mfa = maf_newMfa(mafFileName, "r");
-    mafBlock_t *thisBlock = NULL;
-    while ((thisBlock = maf_readBlock(mfa)) != NULL) {
-        mafLine_t *ml = maf_mafBlock_getHeadLine(thisBlock);
-        //Get any lines for out target species
-        stList *querySpeciesLines = stList_construct();
-        stList *targetSpeciesLines = stList_construct();
-        stList *targetSpeciesPairwiseCoverages = stList_construct();
-        while (ml != NULL) {
-            if (maf_mafLine_getType(ml) == 's') {
-                char *lineSpeciesName = copySpeciesName2(maf_mafLine_getSpecies(ml), nGC->ignoreSpeciesNames);
-                if (stString_eq(nGC->speciesOrChrName, lineSpeciesName) || stString_eq(nGC->speciesOrChrName, maf_mafLine_getSpecies(ml))) {
+static int64_t getPartition(NGenomeCoverage *nGC, char *sequenceName) {
+    return stIntTuple_get(stHash_search(nGC->sequenceNamesToPartitions, sequenceName), 0);
+}
+
+/*
+ * Adds the alignments of the block, but only to the query sequences in the given partition, or to all query
+ * sequences if partition is negative. Every update to a query sequence's coverage arrays is made while
+ * processing one of its own lines, so threads working on distinct partitions never write the same array.
+ */
+static void populateFromBlockPartition(NGenomeCoverage *nGC, mafBlock_t *thisBlock, bool requireIdentityForMatch,
+        int64_t partition) {
+    mafLine_t *ml = maf_mafBlock_getHeadLine(thisBlock);
+    //Get any lines for out target species
+    stList *querySpeciesLines = stList_construct();
+    stList *targetSpeciesLines = stList_construct();
+    stList *targetSpeciesPairwiseCoverages = stList_construct();
+    while (ml != NULL) {
+        if (maf_mafLine_getType(ml) == 's') {
+            char *lineSpeciesName = copySpeciesName2(maf_mafLine_getSpecies(ml), nGC->ignoreSpeciesNames);
+            PairwiseCoverage *pC = stHash_search(nGC->pairwiseCoverages, lineSpeciesName);
+            if (pC == NULL) {
+                //Only possible when the sequence sizes were not read from the maf itself
+                st_errAbort("Sequence %s on line %" PRIu64 " of the maf is not among the given sequence sizes\n",
+                        maf_mafLine_getSpecies(ml), maf_mafLine_getLineNumber(ml));
+            }
+            if (stString_eq(nGC->speciesOrChrName, lineSpeciesName) || stString_eq(nGC->speciesOrChrName, maf_mafLine_getSpecies(ml))) {
+                stIntTuple *querySequenceSize = stHash_search(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr, maf_mafLine_getSpecies(ml));
+                if (querySequenceSize == NULL || stIntTuple_get(querySequenceSize, 0) != (int64_t) maf_mafLine_getSourceLength(ml)) {
+                    st_errAbort("Sequence %s on line %" PRIu64 " of the maf is missing from, or has a different length in, the given sequence sizes\n",
+                            maf_mafLine_getSpecies(ml), maf_mafLine_getLineNumber(ml));
+                }
+                if (partition < 0 || getPartition(nGC, maf_mafLine_getSpecies(ml)) == partition) {
                     stList_append(querySpeciesLines, ml);
                 }
-                stList_append(targetSpeciesLines, ml);
-                stList_append(targetSpeciesPairwiseCoverages, stHash_search(nGC->pairwiseCoverages, lineSpeciesName));
-                free(lineSpeciesName);
             }
-            ml = maf_mafLine_getNext(ml);
+            stList_append(targetSpeciesLines, ml);
+            stList_append(targetSpeciesPairwiseCoverages, pC);
+            free(lineSpeciesName);
         }
-        for (int64_t i = 0; i < stList_length(querySpeciesLines); i++) {
-            mafLine_t *qML = stList_get(querySpeciesLines, i);
-            char *querySequenceFragment = maf_mafLine_getSequence(qML);
-            char *querySequenceName = maf_mafLine_getSpecies(qML);
-            //Asserts on coordinates
-            int64_t querySequenceLength = stIntTuple_get(stHash_search(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr, querySequenceName), 0);
-            (void)querySequenceLength;
-            assert(querySequenceLength == maf_mafLine_getSourceLength(qML));
-            if(maf_mafLine_getLength(qML) > 0) { //This if is because mafs produced by hal2maf sometimes break these assumptions for all gap lines.
-                assert(maf_mafLine_getPositiveCoord(qML) >= 0);
-                assert(maf_mafLine_getPositiveCoord(qML) <= querySequenceLength);
-                if(maf_mafLine_getStrand(qML) == '+') {
-                    assert(maf_mafLine_getPositiveCoord(qML) + maf_mafLine_getLength(qML) <= maf_mafLine_getSourceLength(qML));
-                }
-                else {
-                    assert(maf_mafLine_getStrand(qML) == '-');
-                    assert((int64_t)(maf_mafLine_getPositiveCoord(qML) - maf_mafLine_getLength(qML)) >= -1);
-                }
+        ml = maf_mafLine_getNext(ml);
+    }
+    for (int64_t i = 0; i < stList_length(querySpeciesLines); i++) {
+        mafLine_t *qML = stList_get(querySpeciesLines, i);
+        char *querySequenceFragment = maf_mafLine_getSequence(qML);
+        char *querySequenceName = maf_mafLine_getSpecies(qML);
+        //Asserts on coordinates
+        int64_t querySequenceLength = stIntTuple_get(stHash_search(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr, querySequenceName), 0);
+        (void)querySequenceLength;
+        assert(querySequenceLength == maf_mafLine_getSourceLength(qML));
+        if(maf_mafLine_getLength(qML) > 0) { //This if is because mafs produced by hal2maf sometimes break these assumptions for all gap lines.
+            assert(maf_mafLine_getPositiveCoord(qML) >= 0);
+            assert(maf_mafLine_getPositiveCoord(qML) <= querySequenceLength);
+            if(maf_mafLine_getStrand(qML) == '+') {
+                assert(maf_mafLine_getPositiveCoord(qML) + maf_mafLine_getLength(qML) <= maf_mafLine_getSourceLength(qML));
             }
-            assert(strlen(querySequenceFragment) == maf_mafLine_getSequenceFieldLength(qML));
-            for (int64_t j = 0; j < stList_length(targetSpeciesLines); j++) {
-                mafLine_t *tML = stList_get(targetSpeciesLines, j);
-                if(qML != tML) { //To allow self alignments we must ignore identity alignments
-                    PairwiseCoverage *pC = stList_get(targetSpeciesPairwiseCoverages, j);
-                    assert(pC != NULL);
-                    char *coverageArray = pairwiseCoverage_getCoverageArrayForSequence(pC, querySequenceName);
-                    assert(coverageArray != NULL);
-                    char *targetSequenceFragment = maf_mafLine_getSequence(tML);
-                    int64_t position = maf_mafLine_getPositiveCoord(qML);
-                    assert(maf_mafLine_getSequenceFieldLength(qML) == maf_mafLine_getSequenceFieldLength(tML));
-                    assert(strlen(targetSequenceFragment) == maf_mafLine_getSequenceFieldLength(tML));
-                    bool saturated = 1;
-                    for (int64_t k = 0; k < maf_mafLine_getSequenceFieldLength(qML); k++) {
-                        assert(querySequenceFragment[k] != '\0');
-                        assert(querySequenceFragment[k] != ' ');
-                        assert(querySequenceFragment[k] != '\n');
-                        if (querySequenceFragment[k] != '-') {
-                            assert(position >= 0);
-                            assert(position < querySequenceLength);
-                            if(targetSequenceFragment[k] == '-' ||
-                               (requireIdentityForMatch &&
-                                       (toupper(querySequenceFragment[k]) == 'N' ||
-                                        toupper(querySequenceFragment[k]) != toupper(targetSequenceFragment[k]))) ||
-                               pairwiseCoverageArray_increase(coverageArray, position)) {
-                                saturated = 0;
-                            }
-                            position += maf_mafLine_getStrand(qML) == '+' ? 1 : -1;
-                        }
+            else {
+                assert(maf_mafLine_getStrand(qML) == '-');
+                assert((int64_t)(maf_mafLine_getPositiveCoord(qML) - maf_mafLine_getLength(qML)) >= -1);
+            }
+        }
+        assert(strlen(querySequenceFragment) == maf_mafLine_getSequenceFieldLength(qML));
+        for (int64_t j = 0; j < stList_length(targetSpeciesLines); j++) {
+            mafLine_t *tML = stList_get(targetSpeciesLines, j);
+            if(qML != tML) { //To allow self alignments we must ignore identity alignments
+                PairwiseCoverage *pC = stList_get(targetSpeciesPairwiseCoverages, j);
+                assert(pC != NULL);
+                CoverageArray *coverageArray = pairwiseCoverage_getCoverageArrayForSequence(pC, querySequenceName);
+                assert(coverageArray != NULL);
+                char *targetSequenceFragment = maf_mafLine_getSequence(tML);
+                int64_t position = maf_mafLine_getPositiveCoord(qML);
+                int64_t step = maf_mafLine_getStrand(qML) == '+' ? 1 : -1;
+                assert(maf_mafLine_getSequenceFieldLength(qML) == maf_mafLine_getSequenceFieldLength(tML));
+                assert(strlen(targetSequenceFragment) == maf_mafLine_getSequenceFieldLength(tML));
+                bool saturated = 1;
+                //Take the columns 64 at a time, as masks of the query bases and of those query bases that are covered
+                for (int64_t k = 0; k < maf_mafLine_getSequenceFieldLength(qML); k += 64) {
+                    int64_t n = maf_mafLine_getSequenceFieldLength(qML) - k < 64 ? maf_mafLine_getSequenceFieldLength(qML) - k : 64;
+                    uint64_t queryBases = de_residueMask(querySequenceFragment + k, n);
+                    uint64_t covered = queryBases & de_residueMask(targetSequenceFragment + k, n);
+                    if (requireIdentityForMatch) {
+                        covered &= de_identityMask(querySequenceFragment + k, targetSequenceFragment + k, n);
                     }
-                    if(saturated) {
-                        break;
+                    if (covered != queryBases) {
+                        saturated = 0;
+                    }
+                    for (uint64_t m = covered; m != 0; m &= m - 1) {
+                        //The position of a column is found from the number of query bases before it
+                        uint64_t before = queryBases & ((m & -m) - 1);
+                        int64_t coveredPosition = position + step * de_popcount64(before);
+                        assert(coveredPosition >= 0);
+                        assert(coveredPosition < querySequenceLength);
+                        if (pairwiseCoverageArray_increase(coverageArray, coveredPosition)) {
+                            saturated = 0;
+                        }
                     }
+                    position += step * de_popcount64(queryBases);
                 }
+                if(saturated) {
+                    break;
+                }
+            }
+        }
+    }
+    //Cleanup
+    stList_destruct(querySpeciesLines);
+    stList_destruct(targetSpeciesLines);
+    stList_destruct(targetSpeciesPairwiseCoverages);
+}
+
+void nGenomeCoverage_populateFromBlock(NGenomeCoverage *nGC, mafBlock_t *thisBlock, bool requireIdentityForMatch) {
+    populateFromBlockPartition(nGC, thisBlock, requireIdentityForMatch, -1);
+}
+
+void nGenomeCoverage_populate(NGenomeCoverage *nGC, char *mafFileName, bool requireIdentityForMatch, int64_t numThreads) {
+    stList *nGCs = stList_construct();
+    stList_append(nGCs, nGC);
+    nGenomeCoverage_populateAll(nGCs, mafFileName, requireIdentityForMatch, numThreads);
+    stList_destruct(nGCs);
+}
+
+/*
+ * Threaded population. The query sequences of all the structures are shared out between the threads, balanced by
+ * length. The main thread reads the maf in batches of blocks and every thread works through each batch, adding
+ * only the alignments of the query sequences it owns. Each query sequence therefore sees its blocks in file order,
+ * as it would with one thread, and the coverages do not depend on the number of threads.
+ */
+
+static const int64_t kPopulateBatchSize = 256;
+
+typedef struct _populateShared {
+    stList *nGCs;
+    bool requireIdentityForMatch;
+    int64_t numThreads;
+    mafBlock_t **blocks; //The current batch.
+    int64_t numBlocks;
+    uint64_t generation; //Incremented each time a batch is handed out, and once more when there are no more.
+    int64_t numFinished; //Number of threads done with the current batch.
+    bool finished;
+    pthread_mutex_t lock;
+    pthread_cond_t batchReady;
+    pthread_cond_t batchDone;
+} PopulateShared;
+
+typedef struct _populateWorker {
+    PopulateShared *shared;
+    int64_t partition;
+} PopulateWorker;
+
+typedef struct _partitionSequence {
+    NGenomeCoverage *nGC;
+    char *sequenceName;
+    int64_t length;
+} PartitionSequence;
+
+static int partitionSequence_cmp(const void *a, const void *b) {
+    //Longest first, then by name so the assignment does not depend on hash order.
+    const PartitionSequence *pa = a, *pb = b;
+    if (pa->length != pb->length) {
+        return pa->length > pb->length ? -1 : 1;
+    }
+    return strcmp(pa->sequenceName, pb->sequenceName);
+}
+
+static void assignPartitions(stList *nGCs, int64_t numThreads) {
+    int64_t numSequences = 0;
+    for (int64_t i = 0; i < stList_length(nGCs); i++) {
+        NGenomeCoverage *nGC = stList_get(nGCs, i);
+        numSequences += stHash_size(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr);
+    }
+    PartitionSequence *sequences = st_malloc(sizeof(PartitionSequence) * (numSequences + 1));
+    int64_t j = 0;
+    for (int64_t i = 0; i < stList_length(nGCs); i++) {
+        NGenomeCoverage *nGC = stList_get(nGCs, i);
+        stHashIterator *it = stHash_getIterator(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr);
+        char *sequenceName;
+        while ((sequenceName = stHash_getNext(it)) != NULL) {
+            sequences[j].nGC = nGC;
+            sequences[j].sequenceName = sequenceName;
+            sequences[j++].length = stIntTuple_get(stHash_search(nGC->sequenceNamesToSequenceSizeForGivenSpeciesOrChr, sequenceName), 0);
+        }
+        stHash_destructIterator(it);
+        if (nGC->sequenceNamesToPartitions != NULL) {
+            stHash_destruct(nGC->sequenceNamesToPartitions);
+        }
+        nGC->sequenceNamesToPartitions = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, (void(*)(void *)) stIntTuple_destruct);
+    }
+    qsort(sequences, numSequences, sizeof(PartitionSequence), partitionSequence_cmp);
+    //Each sequence goes to the least loaded thread.
+    int64_t *loads = st_calloc(numThreads, sizeof(int64_t));
+    for (j = 0; j < numSequences; j++) {
+        int64_t partition = 0;
+        for (int64_t k = 1; k < numThreads; k++) {
+            if (loads[k] < loads[partition]) {
+                partition = k;
             }
         }
-        //Cleanup
+        loads[partition] += sequences[j].length;
+        stHash_insert(sequences[j].nGC->sequenceNamesToPartitions, sequences[j].sequenceName, stIntTuple_construct1(partition));
+    }
+    free(loads);
+    free(sequences);
+}
+
+static void *populateWorker(void *arg) {
+    PopulateWorker *worker = arg;
+    PopulateShared *shared = worker->shared;
+    uint64_t generation = 0;
+    while (1) {
+        pthread_mutex_lock(&shared->lock);
+        while (shared->generation == generation) {
+            pthread_cond_wait(&shared->batchReady, &shared->lock);
+        }
+        generation = shared->generation;
+        if (shared->finished) {
+            pthread_mutex_unlock(&shared->lock);
+            break;
+        }
+        mafBlock_t **blocks = shared->blocks;
+        int64_t numBlocks = shared->numBlocks;
+        pthread_mutex_unlock(&shared->lock);
+        for (int64_t i = 0; i < numBlocks; i++) {
+            for (int64_t j = 0; j < stList_length(shared->nGCs); j++) {
+                populateFromBlockPartition(stList_get(shared->nGCs, j), blocks[i], shared->requireIdentityForMatch, worker->partition);
+            }
+        }
+        pthread_mutex_lock(&shared->lock);
+        if (++shared->numFinished == shared->numThreads) {
+            pthread_cond_signal(&shared->batchDone);
+        }
+        pthread_mutex_unlock(&shared->lock);
+    }
+    return NULL;
+}
+
+static int64_t readBatch(mafFileApi_t *mfa, mafBlock_t **blocks) {
+    int64_t numBlocks = 0;
+    while (numBlocks < kPopulateBatchSize && (blocks[numBlocks] = maf_readBlock(mfa)) != NULL) {
+        numBlocks++;
+    }
+    return numBlocks;
+}
+
+static void populateAllThreaded(stList *nGCs, char *mafFileName, bool requireIdentityForMatch, int64_t numThreads) {
+    assignPartitions(nGCs, numThreads);
+    PopulateShared shared;
+    shared.nGCs = nGCs;
+    shared.requireIdentityForMatch = requireIdentityForMatch;
+    shared.numThreads = numThreads;
+    shared.blocks = NULL;
+    shared.numBlocks = 0;
+    shared.generation = 0;
+    shared.numFinished = 0;
+    shared.finished = false;
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.batchReady, NULL);
+    pthread_cond_init(&shared.batchDone, NULL);
+    pthread_t *threads = st_malloc(sizeof(pthread_t) * numThreads);
+    PopulateWorker *workers = st_malloc(sizeof(PopulateWorker) * numThreads);
+    for (int64_t i = 0; i < numThreads; i++) {
+        workers[i].shared = &shared;
+        workers[i].partition = i;
+        if (pthread_create(&threads[i], NULL, populateWorker, &workers[i]) != 0) {
+            st_errAbort("Error, unable to create thread %" PRId64 "\n", i);
+        }
+    }
+    mafBlock_t **batch = st_malloc(sizeof(mafBlock_t *) * kPopulateBatchSize);
+    mafBlock_t **nextBatch = st_malloc(sizeof(mafBlock_t *) * kPopulateBatchSize);
+    mafFileApi_t *mfa = maf_newMfa(mafFileName, "r");
+    int64_t numBlocks = readBatch(mfa, batch);
+    while (numBlocks > 0) {
+        pthread_mutex_lock(&shared.lock);
+        shared.blocks = batch;
+        shared.numBlocks = numBlocks;
+        shared.numFinished = 0;
+        shared.generation++;
+        pthread_cond_broadcast(&shared.batchReady);
+        pthread_mutex_unlock(&shared.lock);
+        //Read the next batch while the threads work on this one.
+        int64_t numNextBlocks = readBatch(mfa, nextBatch);
+        pthread_mutex_lock(&shared.lock);
+        while (shared.numFinished < numThreads) {
+            pthread_cond_wait(&shared.batchDone, &shared.lock);
+        }
+        pthread_mutex_unlock(&shared.lock);
+        for (int64_t i = 0; i < numBlocks; i++) {
+            maf_destroyMafBlockList(batch[i]);
+        }
+        mafBlock_t **swap = batch;
+        batch = nextBatch;
+        nextBatch = swap;
+        numBlocks = numNextBlocks;
+    }
+    pthread_mutex_lock(&shared.lock);
+    shared.finished = true;
+    shared.generation++;
+    pthread_cond_broadcast(&shared.batchReady);
+    pthread_mutex_unlock(&shared.lock);
+    for (int64_t i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    maf_destroyMfa(mfa);
+    pthread_mutex_destroy(&shared.lock);
+    pthread_cond_destroy(&shared.batchReady);
+    pthread_cond_destroy(&shared.batchDone);
+    free(batch);
+    free(nextBatch);
+    free(threads);
+    free(workers);
+    for (int64_t i = 0; i < stList_length(nGCs); i++) {
+        NGenomeCoverage *nGC = stList_get(nGCs, i);
+        stHash_destruct(nGC->sequenceNamesToPartitions);
+        nGC->sequenceNamesToPartitions = NULL;
+    }
+}
+
+void nGenomeCoverage_populateAll(stList *nGCs, char *mafFileName, bool requireIdentityForMatch, int64_t numThreads) {
+    if (numThreads > 1) {
+        populateAllThreaded(nGCs, mafFileName, requireIdentityForMatch, numThreads);
+        return;
+    }
+    mafFileApi_t *mfa = maf_newMfa(mafFileName, "r");
+    mafBlock_t *thisBlock = NULL;
+    while ((thisBlock = maf_readBlock(mfa)) != NULL) {
+        for (int64_t i = 0; i < stList_length(nGCs); i++) {
+            nGenomeCoverage_populateFromBlock(stList_get(nGCs, i), thisBlock, requireIdentityForMatch);
+        }
         maf_destroyMafBlockList(thisBlock);
-        stList_destruct(querySpeciesLines);
-        stList_destruct(targetSpeciesLines);
-        stList_destruct(targetSpeciesPairwiseCoverages);
     }
     maf_destroyMfa(mfa);
 }
@@ -369,3 +783,15 @@ void nGenomeCoverage_report(NGenomeCoverage *nGC, FILE *out, bool includeNCovera
     }
     stHash_destructIterator(it);
 }
+
+void nGenomeCoverage_reportTracks(NGenomeCoverage *nGC, FILE *out, bool wiggle, int64_t windowLength) {
+    stList *speciesNames = stHash_getKeys(nGC->pairwiseCoverages);
+    stList_sort(speciesNames, compareSequenceNames);
+    for (int64_t i = 0; i < stList_length(speciesNames); i++) {
+        char *speciesName = stList_get(speciesNames, i);
+        char *trackName = stString_print("%s_%s", nGC->speciesOrChrName, speciesName);
+        pairwiseCoverage_writeTrack(stHash_search(nGC->pairwiseCoverages, speciesName), out, trackName, wiggle, windowLength);
+        free(trackName);
+    }
+    stList_destruct(speciesNames);
+}
@@ -43,6 +43,12 @@ bool searchMatched_(const char *target, const char *seq);
  */
 stHash *getMapOfSequenceNamesToSizesFromMaf(char *mafFileName);
 
+/*
+ * As getMapOfSequenceNamesToSizesFromMaf, but the names and sizes are read from a .chrom.sizes or .fai file, or from a
+ * maf index, so the maf itself is not read. Every sequence in the maf must then be listed in the file.
+ */
+stHash *getMapOfSequenceNamesToSizesFromFile(char *sizesFileName);
+
 /*
  * Each sequence name is comprised of two fields separated by a period. The first is the species field, the second is the
  * chromosome field. This function returns the set of distinct species names from the set of sequence names. If ignoreSpeciesNames
@@ -60,6 +66,40 @@ stHash *getMapOfSequenceNamesToSequenceSizesForGivenSpeciesOrChr(stHash *sequenc
  */
 int64_t getTotalLengthOfSequences(stHash *sequenceSizes);
 
+/*
+ * The coverage array of a sequence, a count per base saturating at SCHAR_MAX. Storage is allocated in chunks as
+ * positions are first covered.
+ */
+
+typedef struct _coverageArray CoverageArray;
+
+CoverageArray *coverageArray_construct(int64_t length);
+
+void coverageArray_destruct(CoverageArray *cA);
+
+int64_t coverageArray_getLength(CoverageArray *cA);
+
+/*
+ * Returns the coverage count of the position.
+ */
+char coverageArray_get(CoverageArray *cA, int64_t position);
+
+/*
+ * Returns the number of positions with each count, indexed 0 to SCHAR_MAX. The histogram is kept with the array
+ * and only recomputed, in one pass over the allocated chunks, after counts have changed. Owned by the array.
+ */
+const int64_t *coverageArray_getHistogram(CoverageArray *cA);
+
+/*
+ * Returns the number of positions in [start, end) with a non-zero count.
+ */
+int64_t coverageArray_countCovered(CoverageArray *cA, int64_t start, int64_t end);
+
+/*
+ * Returns the number of chunks that have storage, for checking memory use.
+ */
+int64_t coverageArray_getNumberOfAllocatedChunks(CoverageArray *cA);
+
 /*
  * The pairwise coverage object.
  */
@@ -81,15 +121,22 @@ double pairwiseCoverage_calculateCoverage(PairwiseCoverage *pC);
  */
 double *pairwiseCoverage_calculateNCoverages(PairwiseCoverage *pC);
 
+/*
+ * Writes the coverage as a bedGraph or, if wiggle is true, a fixedStep wiggle track named trackName. Each sequence is
+ * cut into windows of windowLength bases and a window's value is the proportion of its bases with coverage. In bedGraph
+ * neighbouring windows of equal value are merged, so a windowLength of 1 gives runs of covered and uncovered bases.
+ */
+void pairwiseCoverage_writeTrack(PairwiseCoverage *pC, FILE *out, const char *trackName, bool wiggle, int64_t windowLength);
+
 /*
  * Increases the coverage count of a given sequence position.
  */
-char *pairwiseCoverage_getCoverageArrayForSequence(PairwiseCoverage *pC, char *sequenceName);
+CoverageArray *pairwiseCoverage_getCoverageArrayForSequence(PairwiseCoverage *pC, char *sequenceName);
 
 /*
  * Returns non-zero if successful, if maximum coverage achieved (so can't be increased) returns 0.
  */
-bool pairwiseCoverageArray_increase(char *sequenceCoverageArray, int64_t position);
+bool pairwiseCoverageArray_increase(CoverageArray *sequenceCoverageArray, int64_t position);
 
 /*
  * An all-against-a-given-species object.
@@ -102,9 +149,21 @@ void nGenomeCoverage_destruct(NGenomeCoverage *nGC);
 NGenomeCoverage *nGenomeCoverage_construct(stHash *sequenceSizes, char *speciesName, bool ignoreSpeciesNames);
 
 /*
- * Iterate through a maf file and populate the species coverages.
+ * Iterate through a maf file and populate the species coverages. With numThreads > 1 the work is shared between
+ * threads by query sequence, the result is the same for any number of threads.
  */
-void nGenomeCoverage_populate(NGenomeCoverage *nGC, char *mafFileName, bool requireIdentityForMatch);
+void nGenomeCoverage_populate(NGenomeCoverage *nGC, char *mafFileName, bool requireIdentityForMatch, int64_t numThreads);
+
+/*
+ * Adds the alignments of a single maf block to the species coverages.
+ */
+void nGenomeCoverage_populateFromBlock(NGenomeCoverage *nGC, mafBlock_t *block, bool requireIdentityForMatch);
+
+/*
+ * Iterate through a maf file once and populate the species coverages of every structure in the list, the
+ * result is the same as calling nGenomeCoverage_populate on each.
+ */
+void nGenomeCoverage_populateAll(stList *nGCs, char *mafFileName, bool requireIdentityForMatch, int64_t numThreads);
 
 /*
  * Reports stats in tab delimited format.
@@ -112,4 +171,9 @@ void nGenomeCoverage_populate(NGenomeCoverage *nGC, char *mafFileName, bool requ
 void nGenomeCoverage_reportHeader(FILE *out, bool includeNCoverage);
 void nGenomeCoverage_report(NGenomeCoverage *nGC, FILE *out, bool includeNCoverage);
 
+/*
+ * Writes a coverage track, see pairwiseCoverage_writeTrack, for each other species, named referenceSpecies_otherSpecies.
+ */
+void nGenomeCoverage_reportTracks(NGenomeCoverage *nGC, FILE *out, bool wiggle, int64_t windowLength);
+
 #endif // _MAF_COVERAGE_API_H_
@@ -194,6 +194,108 @@ class CoverageTest(unittest.TestCase):
                                         solutionDict))
     mtt.removeDir(tmpDir)
 
+  def testCoverageSinglePass(self):
+    """ mafCoverage --singlePass should report the same coverages for every species as one pass per species.
+    """
+    mtt.makeTempDirParent()
+    tmpDir = os.path.abspath(mtt.makeTempDir('testCoverageSinglePass'))
+    parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    for target, mafSeq, solutionDict in g_knownGood:
+      testMaf = mtt.testFile(os.path.join(os.path.abspath(tmpDir), 'test.maf'),
+                             mafSeq, g_headers)
+      cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafCoverage'))]
+      cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf'))]
+      outpipes = [os.path.join(tmpDir, 'output.txt'), os.path.join(tmpDir, 'outputSinglePass.txt')]
+      cmds = [cmd, cmd + ['--singlePass']]
+      mtt.recordCommands(cmds, tmpDir, outPipes=outpipes)
+      mtt.runCommandsS(cmds, tmpDir, outPipes=outpipes)
+      self.assertEqual(open(outpipes[0]).read(), open(outpipes[1]).read())
+      f = open(os.path.join(tmpDir, 'outputTarget.txt'), 'w')
+      for line in open(outpipes[1]):
+        if line.startswith(target + '\t'):
+          f.write(line)
+      f.close()
+      self.assertTrue(coverageIsCorrect(os.path.join(tmpDir, 'outputTarget.txt'),
+                                        solutionDict))
+    mtt.removeDir(tmpDir)
+
+  def testCoverageThreads(self):
+    """ mafCoverage --threads should report the same coverages as a single thread.
+    """
+    mtt.makeTempDirParent()
+    tmpDir = os.path.abspath(mtt.makeTempDir('testCoverageThreads'))
+    parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    for target, mafSeq, solutionDict in g_knownGood:
+      testMaf = mtt.testFile(os.path.join(os.path.abspath(tmpDir), 'test.maf'),
+                             mafSeq, g_headers)
+      cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafCoverage'))]
+      cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--nCoverage']
+      outpipes = [os.path.join(tmpDir, 'output.txt'), os.path.join(tmpDir, 'outputThreads.txt'),
+                  os.path.join(tmpDir, 'outputThreadsSinglePass.txt')]
+      cmds = [cmd, cmd + ['--threads', '3'], cmd + ['--threads', '3', '--singlePass']]
+      mtt.recordCommands(cmds, tmpDir, outPipes=outpipes)
+      mtt.runCommandsS(cmds, tmpDir, outPipes=outpipes)
+      self.assertEqual(open(outpipes[0]).read(), open(outpipes[1]).read())
+      self.assertEqual(open(outpipes[0]).read(), open(outpipes[2]).read())
+    mtt.removeDir(tmpDir)
+
+  def testCoverageSizes(self):
+    """ mafCoverage --sizes should report the same coverages as when the sizes come from the maf.
+    """
+    mtt.makeTempDirParent()
+    tmpDir = os.path.abspath(mtt.makeTempDir('testCoverageSizes'))
+    parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    for target, mafSeq, solutionDict in g_knownGood:
+      testMaf = mtt.testFile(os.path.join(os.path.abspath(tmpDir), 'test.maf'),
+                             mafSeq, g_headers)
+      sizes = {}
+      for line in mafSeq.split('\n'):
+        data = line.split()
+        if len(data) == 7 and data[0] == 's':
+          sizes[data[1]] = data[5]
+      f = open(os.path.join(tmpDir, 'test.chrom.sizes'), 'w')
+      for name in sizes:
+        f.write('%s\t%s\n' % (name, sizes[name]))
+      f.close()
+      cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafCoverage'))]
+      cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--nCoverage']
+      outpipes = [os.path.join(tmpDir, 'output.txt'), os.path.join(tmpDir, 'outputSizes.txt')]
+      cmds = [cmd, cmd + ['--sizes', os.path.join(tmpDir, 'test.chrom.sizes')]]
+      mtt.recordCommands(cmds, tmpDir, outPipes=outpipes)
+      mtt.runCommandsS(cmds, tmpDir, outPipes=outpipes)
+      self.assertEqual(sorted(open(outpipes[0]).readlines()), sorted(open(outpipes[1]).readlines()))
+    mtt.removeDir(tmpDir)
+
+  def testCoverageBedGraph(self):
+    """ mafCoverage --bedGraph with a window of 1 should cover the same proportion of the target as the table reports.
+    """
+    mtt.makeTempDirParent()
+    tmpDir = os.path.abspath(mtt.makeTempDir('testCoverageBedGraph'))
+    parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    for target, mafSeq, solutionDict in g_knownGood:
+      testMaf = mtt.testFile(os.path.join(os.path.abspath(tmpDir), 'test.maf'),
+                             mafSeq, g_headers)
+      cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafCoverage'))]
+      cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--speciesOrChr', target,
+              '--bedGraph', os.path.join(tmpDir, 'output.bedGraph'), '--window', '1']
+      outpipes = [os.path.join(tmpDir, 'output.txt')]
+      mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+      mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+      covered = {}
+      length = {}
+      for line in open(os.path.join(tmpDir, 'output.bedGraph')):
+        data = line.split()
+        if data[0] == 'track':
+          species = data[2][len('name="%s_' % target):-1]
+          covered[species] = 0.0
+          length[species] = 0
+          continue
+        covered[species] += (int(data[2]) - int(data[1])) * float(data[3])
+        length[species] += int(data[2]) - int(data[1])
+      for species in solutionDict:
+        self.assertTrue(AlmostEqual(solutionDict[species], covered[species] / length[species]))
+    mtt.removeDir(tmpDir)
+
   def testMemory0(self):
     """ If valgrind is installed on the system, check for memory related errors (0).
     """
@@ -115,7 +115,7 @@ static void test_pairwiseCoverage(CuTest *testCase) {
     free(nCoverages);
 
     //Add some coverage
-    char *coverageArray = pairwiseCoverage_getCoverageArrayForSequence(pC, "spider.man");
+    CoverageArray *coverageArray = pairwiseCoverage_getCoverageArrayForSequence(pC, "spider.man");
     CuAssertTrue(testCase, coverageArray != NULL);
     pairwiseCoverageArray_increase(coverageArray, 0);
     coverageArray = pairwiseCoverage_getCoverageArrayForSequence(pC, "penfold");
@@ -140,6 +140,92 @@ static void test_pairwiseCoverage(CuTest *testCase) {
     teardown();
 }
 
+static void test_coverageArray(CuTest *testCase) {
+    //Storage is only allocated for the chunks that are covered
+    int64_t length = 3 * 65536 + 5;
+    CoverageArray *cA = coverageArray_construct(length);
+    CuAssertIntEquals(testCase, length, coverageArray_getLength(cA));
+    CuAssertIntEquals(testCase, 0, coverageArray_getNumberOfAllocatedChunks(cA));
+    CuAssertIntEquals(testCase, 0, coverageArray_get(cA, 70000));
+    CuAssertTrue(testCase, pairwiseCoverageArray_increase(cA, 70000));
+    CuAssertTrue(testCase, pairwiseCoverageArray_increase(cA, 70000));
+    CuAssertIntEquals(testCase, 2, coverageArray_get(cA, 70000));
+    CuAssertIntEquals(testCase, 0, coverageArray_get(cA, 70001));
+    CuAssertIntEquals(testCase, 1, coverageArray_getNumberOfAllocatedChunks(cA));
+    CuAssertTrue(testCase, pairwiseCoverageArray_increase(cA, length - 1));
+    CuAssertIntEquals(testCase, 1, coverageArray_get(cA, length - 1));
+    CuAssertIntEquals(testCase, 2, coverageArray_getNumberOfAllocatedChunks(cA));
+    //Counts saturate
+    for (int64_t i = 0; i < SCHAR_MAX; i++) {
+        CuAssertTrue(testCase, pairwiseCoverageArray_increase(cA, 0));
+    }
+    CuAssertTrue(testCase, !pairwiseCoverageArray_increase(cA, 0));
+    CuAssertIntEquals(testCase, SCHAR_MAX, coverageArray_get(cA, 0));
+    CuAssertIntEquals(testCase, 3, coverageArray_getNumberOfAllocatedChunks(cA));
+    //The histogram counts positions by coverage, and follows later increases
+    const int64_t *histogram = coverageArray_getHistogram(cA);
+    CuAssertIntEquals(testCase, length - 3, histogram[0]);
+    CuAssertIntEquals(testCase, 1, histogram[1]);
+    CuAssertIntEquals(testCase, 1, histogram[2]);
+    CuAssertIntEquals(testCase, 1, histogram[SCHAR_MAX]);
+    pairwiseCoverageArray_increase(cA, 70001);
+    histogram = coverageArray_getHistogram(cA);
+    CuAssertIntEquals(testCase, length - 4, histogram[0]);
+    CuAssertIntEquals(testCase, 2, histogram[1]);
+    //Covered positions are counted across chunks, skipping the unallocated one
+    CuAssertIntEquals(testCase, 4, coverageArray_countCovered(cA, 0, length));
+    CuAssertIntEquals(testCase, 2, coverageArray_countCovered(cA, 1, 70002));
+    CuAssertIntEquals(testCase, 1, coverageArray_countCovered(cA, 70001, length - 1));
+    CuAssertIntEquals(testCase, 0, coverageArray_countCovered(cA, 70002, length - 1));
+    CuAssertIntEquals(testCase, 0, coverageArray_countCovered(cA, 5, 5));
+    coverageArray_destruct(cA);
+}
+
+static char *writeTrack(CuTest *testCase, PairwiseCoverage *pC, bool wiggle, int64_t windowLength) {
+    FILE *fp = tmpfile();
+    pairwiseCoverage_writeTrack(pC, fp, "track", wiggle, windowLength);
+    int64_t length = ftell(fp);
+    rewind(fp);
+    char *track = st_malloc(length + 1);
+    CuAssertTrue(testCase, fread(track, 1, length, fp) == (size_t) length);
+    track[length] = '\0';
+    fclose(fp);
+    return track;
+}
+
+static void test_pairwiseCoverage_writeTrack(CuTest *testCase) {
+    setup();
+    PairwiseCoverage *pC = pairwiseCoverage_construct(sequenceNamesToSequenceSizes);
+    pairwiseCoverageArray_increase(pairwiseCoverage_getCoverageArrayForSequence(pC, "spider.man"), 0);
+    CoverageArray *coverageArray = pairwiseCoverage_getCoverageArrayForSequence(pC, "penfold");
+    pairwiseCoverageArray_increase(coverageArray, 2);
+    pairwiseCoverageArray_increase(coverageArray, 3);
+    pairwiseCoverageArray_increase(coverageArray, 3);
+    //Per base runs, sequences in name order
+    char *track = writeTrack(testCase, pC, 0, 1);
+    CuAssertStrEquals(testCase, "track type=bedGraph name=\"track\"\n"
+            "bat.fink\t0\t7\t0\n"
+            "bat.man\t0\t50\t0\n"
+            "danger.mouse\t0\t12\t0\n"
+            "penfold\t0\t2\t0\n"
+            "penfold\t2\t4\t1\n"
+            "penfold\t4\t12\t0\n"
+            "spider.man\t0\t1\t1\n", track);
+    free(track);
+    //Windows, the last of which is cut short by the end of the sequence
+    track = writeTrack(testCase, pC, 0, 5);
+    CuAssertTrue(testCase, strstr(track, "penfold\t0\t5\t0.4\npenfold\t5\t12\t0\n") != NULL);
+    free(track);
+    track = writeTrack(testCase, pC, 1, 5);
+    CuAssertTrue(testCase, strstr(track, "track type=wiggle_0 name=\"track\"\n") == track);
+    CuAssertTrue(testCase, strstr(track, "fixedStep chrom=penfold start=1 step=5 span=5\n0.4\n0\n"
+                                  "fixedStep chrom=penfold start=11 step=2 span=2\n0\n") != NULL);
+    CuAssertTrue(testCase, strstr(track, "fixedStep chrom=spider.man start=1 step=1 span=1\n1\n") != NULL);
+    free(track);
+    pairwiseCoverage_destruct(pC);
+    teardown();
+}
+
 static void test_nGenomeCoverage(CuTest *testCase) {
     setup();
     //Just build a single nGenomeCoverage and check the report functions work as expected.
@@ -160,6 +246,8 @@ CuSuite* coverage_TestSuite(void) {
     SUITE_ADD_TEST(suite, test_getMapOfSequenceNamesToSequenceSizesForGivenSpecies);
     SUITE_ADD_TEST(suite, test_getTotalLengthOfSequences);
     SUITE_ADD_TEST(suite, test_pairwiseCoverage);
+    SUITE_ADD_TEST(suite, test_pairwiseCoverage_writeTrack);
+    SUITE_ADD_TEST(suite, test_coverageArray);
     SUITE_ADD_TEST(suite, test_nGenomeCoverage);
     return suite;
 }
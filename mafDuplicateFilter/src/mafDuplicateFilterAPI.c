@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2014 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafDuplicateFilterAPI.h"
+
+double g_maskScores[32][256];
+char g_maskResidues[32];
+static const unsigned kNumResidues = 5;
+// buildConsensus() profile row of each character: {A, C, G, T, N} in either case,
+// then the gap. Anything else, including the terminating '\0', is kBadResidue.
+static uint8_t g_residueRows[256];
+static const uint8_t kGapResidue = 5;
+static const uint8_t kBadResidue = 6;
+static const unsigned kProfileWidth = 6;
+
+scoredMafLine_t* newScoredMafLine(void) {
+    scoredMafLine_t *m = (scoredMafLine_t *) de_malloc(sizeof(*m));
+    m->mafLine = NULL;
+    m->next = NULL;
+    m->score = 0.0;
+    return m;
+}
+duplicate_t* newDuplicate(void) {
+    duplicate_t *d = (duplicate_t *) de_malloc(sizeof(*d));
+    d->species = NULL;
+    d->headScoredMaf = NULL;
+    d->tailScoredMaf = NULL;
+    d->reported = false;
+    d->next = NULL;
+    d->numSequences = 1;
+    return d;
+}
+void printHeader(void) {
+    printf("##maf version=1\n\n");
+}
+unsigned longestLine(mafBlock_t *mb) {
+    // walk the mafline linked list and return the longest m->line value
+    mafLine_t *m = maf_mafBlock_getHeadLine(mb);
+    unsigned max = 0;
+    while (m != NULL) {
+        if (max < strlen(maf_mafLine_getLine(m)))
+            max = strlen(maf_mafLine_getLine(m));
+        m = maf_mafLine_getNext(m);
+    }
+    return max;
+}
+unsigned numberOfSequencesScoredMafLineList(scoredMafLine_t *m) {
+    // count the number of actual sequence lines in a mafLine_t list
+    unsigned s = 0;
+    while (m != NULL) {
+        if (maf_mafLine_getType(m->mafLine) == 's')
+            ++s;
+        m = m->next;
+    }
+    return s;
+}
+void printResidues(unsigned *r) {
+    // debug function
+    for (int i = 0; i < 5; ++i)
+        printf("%d:%d, ", i, r[i]);
+    printf("\n");
+}
+unsigned maxRes(unsigned residues[]) {
+    // walk the residues array and return the largest value
+    unsigned m = 0;
+    for (int i = 0; i < 5; ++i) {
+        if (m < residues[i])
+            m = residues[i];
+    }
+    return m;
+}
+char consensusResidue(unsigned residues[]) {
+    // given an unsigned array of counts of the 4 bases in the order A, C, G, T, N
+    // return as a char the IUPAC for the consensus residue.
+    unsigned m = maxRes(residues);
+    bool maxA = false, maxC = false, maxG = false, maxT = false, maxN = false, allGap = false;
+    if (residues[0] == m)
+        maxA = true;
+    if (residues[1] == m)
+        maxC = true;
+    if (residues[2] == m)
+        maxG = true;
+    if (residues[3] == m)
+        maxT = true;
+    if (residues[4] == m)
+        maxN = true;
+    if (residues[5] == m)
+        allGap = true;
+    if ((maxA && maxC && maxG && maxT) || (maxN))
+        return 'N';
+    if (maxA && maxC && maxG)
+        return 'V';
+    if (maxA && maxC && maxT)
+        return 'H';
+    if (maxA && maxG && maxT)
+        return 'D';
+    if (maxC && maxG && maxT)
+        return 'B';
+    if (maxA && maxC)
+        return 'M';
+    if (maxA && maxG)
+        return 'R';
+    if (maxA && maxT)
+        return 'W';
+    if (maxC && maxG)
+        return 'S';
+    if (maxC && maxT)
+        return 'Y';
+    if (maxG && maxT)
+        return 'K';
+    if (maxA)
+        return 'A';
+    if (maxC)
+        return 'C';
+    if (maxG)
+        return 'G';
+    if (maxT)
+        return 'T';
+    if (allGap)
+        return '-';
+    return '?';
+}
+void initScores(void) {
+    // fill in the consensus and scoring lookup tables from consensusResidue() and bitScore().
+    // a column's mask has a bit set for each of {A, C, G, T, N} that ties for the
+    // highest count. An all-gap column has every count tied at zero, so its mask is 31,
+    // whose residue is 'N' and scores zero against everything.
+    static const char residueChars[] = "ACGTN";
+    unsigned residues[6];
+    for (unsigned c = 0; c < 256; ++c) {
+        g_residueRows[c] = kBadResidue;
+    }
+    for (unsigned k = 0; k < kNumResidues; ++k) {
+        g_residueRows[(unsigned char) residueChars[k]] = k;
+        g_residueRows[(unsigned char) tolower(residueChars[k])] = k;
+    }
+    g_residueRows['-'] = kGapResidue;
+    for (unsigned mask = 0; mask < 32; ++mask) {
+        for (unsigned k = 0; k < kNumResidues; ++k) {
+            residues[k] = (mask >> k) & 1;
+        }
+        residues[5] = 0;
+        g_maskResidues[mask] = consensusResidue(residues);
+        for (unsigned c = 0; c < 256; ++c) {
+            g_maskScores[mask][c] = bitScore(g_maskResidues[mask], (char) c);
+        }
+    }
+}
+void reportBadResidue(char **sequences, unsigned numSeqs, uint64_t n, unsigned lineno, FILE *efp) {
+    // find the first unanticipated character, column by column, and report it to efp.
+    for (uint64_t i = 0; i < n; ++i) {
+        for (unsigned j = 1; j < numSeqs; ++j) {
+            if (strchr("ACGTNacgtn-", sequences[j][i]) == NULL || sequences[j][i] == '\0') {
+                fprintf(efp, "Error, unanticipated character within sequence (%u,%" PRIu64 ") "
+                        "contained in block near line number %u: %c\n",
+                        j, i, lineno, sequences[j][i]);
+                return;
+            }
+        }
+    }
+}
+bool buildConsensus(uint8_t *consensus, char **sequences, unsigned numSeqs, uint64_t n, unsigned lineno,
+                    FILE *efp) {
+    // given an array `consensus' of length n and a string array containing all of
+    // the sequences of a block, build the consensus of the block and store it in the
+    // provided array as one column mask per column (see initScores).
+    // Returns false, having reported the first bad residue to efp, if the block holds
+    // anything other than {A, C, G, T, N} and gaps.
+    // Each row is read once, in place, and tallied into a profile that holds the
+    // counts of one column next to each other. A short row ends in '\0', which is
+    // a bad residue, so rows are never read past their end.
+    uint32_t *profile = (uint32_t *) de_malloc(sizeof(uint32_t) * kProfileWidth * (n + 1));
+    memset(profile, 0, sizeof(uint32_t) * kProfileWidth * (n + 1));
+    for (unsigned j = 1; j < numSeqs; ++j) {
+        // rows
+        const unsigned char *seq = (const unsigned char *) sequences[j];
+        uint32_t *counts = profile;
+        for (uint64_t i = 0; i < n; ++i, counts += kProfileWidth) {
+            // columns
+            uint8_t k = g_residueRows[seq[i]];
+            if (k == kBadResidue) {
+                reportBadResidue(sequences, numSeqs, n, lineno, efp);
+                free(profile);
+                return false;
+            }
+            ++counts[k];
+        }
+    }
+    const uint32_t *counts = profile;
+    for (uint64_t i = 0; i < n; ++i, counts += kProfileWidth) {
+        uint32_t m = 0;
+        uint8_t mask = 0;
+        for (unsigned k = 0; k < kNumResidues; ++k) {
+            if (m < counts[k]) {
+                m = counts[k];
+            }
+        }
+        for (unsigned k = 0; k < kNumResidues; ++k) {
+            mask |= (uint8_t) ((counts[k] == m) << k);
+        }
+        consensus[i] = mask;
+    }
+    free(profile);
+    return true;
+}
+bool checkForDupes(char **species, int index, mafLine_t *m) {
+    // walk through the species string array and check to see if m->species is contained
+    // anywhere within.
+    for (int i = 0; i < index; ++i) {
+        if (!strcmp(species[i], maf_mafLine_getSpecies(m))) {
+            return true;
+        }
+    }
+    return false;
+}
+void reportBlock(mafBlock_t *b, FILE *ofp) {
+    // print out a maf block in the form of the mafline linked list
+    // We *MUST* use this function instead of the convience function maf_mafBlock_print()
+    // because we have screwed with the structure field "species" and removed the chromosome
+    // information. Using _print() will omitt the chromosome information in the printed block.
+    mafLine_t *ml = maf_mafBlock_getHeadLine(b);
+    while (ml != NULL) {
+        fprintf(ofp, "%s\n", maf_mafLine_getLine(ml));
+        ml = maf_mafLine_getNext(ml);
+    }
+    fprintf(ofp, "\n");
+}
+void reportBlockWithDuplicates(mafBlock_t *mb, speciesTable_t *table, FILE *ofp) {
+    // report the block represented by mb. If a given line
+    // is a member of the duplicate linked list, report only the top scoring duplicate
+    // which will be the one stored at the head of the mafline linkeded list (dup->headScoredMaf).
+    mafLine_t *m = maf_mafBlock_getHeadLine(mb);
+    duplicate_t *d = NULL;
+    while (m != NULL) {
+        bool isDup = false;
+        if (maf_mafLine_getSpecies(m) != NULL) {
+            d = findDuplicate(table, maf_mafLine_getSpecies(m));
+            if (d != NULL && d->numSequences > 1) {
+                isDup = true;
+                if (!strcmp(maf_mafLine_getLine(m), maf_mafLine_getLine(d->headScoredMaf->mafLine))
+                    && !d->reported) {
+                    fprintf(ofp, "%s\n", maf_mafLine_getLine(d->headScoredMaf->mafLine));
+                    d->reported = true;
+                }
+            }
+        }
+        if (!isDup)
+            fprintf(ofp, "%s\n", maf_mafLine_getLine(m));
+        m = maf_mafLine_getNext(m);
+    }
+    fprintf(ofp, "\n");
+}
+void reportDuplicates(duplicate_t *dup) {
+    // debugging function
+    printf("Duplicates: ");
+    while (dup->species != NULL) {
+        if (dup->numSequences < 2) {
+            dup = dup->next;
+            continue;
+        }
+        scoredMafLine_t *m = dup->headScoredMaf;
+        printf("    %s\n", dup->species);
+        while (m != NULL) {
+            printf("        %.2f %s\n", m->score, maf_mafLine_getSequence(m->mafLine));
+            m = m->next;
+        }
+        dup = dup->next;
+    }
+}
+speciesTable_t* newSpeciesTable(uint64_t n) {
+    // a table with room for n species
+    speciesTable_t *table = (speciesTable_t *) de_malloc(sizeof(*table));
+    table->size = 16;
+    while (table->size < 2 * n) {
+        table->size <<= 1;
+    }
+    table->slots = (duplicate_t **) de_malloc(sizeof(duplicate_t *) * table->size);
+    for (uint64_t i = 0; i < table->size; ++i) {
+        table->slots[i] = NULL;
+    }
+    return table;
+}
+void destroySpeciesTable(speciesTable_t *table) {
+    // the duplicates themselves are freed by destroyDuplicates()
+    if (table == NULL) {
+        return;
+    }
+    free(table->slots);
+    free(table);
+}
+duplicate_t** speciesTable_slot(speciesTable_t *table, const char *species) {
+    // return the slot holding the duplicate of `species', or the empty slot where it belongs.
+    uint64_t h = 14695981039346656037ULL; // FNV-1a
+    for (const char *c = species; *c != '\0'; ++c) {
+        h ^= (unsigned char) *c;
+        h *= 1099511628211ULL;
+    }
+    uint64_t mask = table->size - 1;
+    uint64_t i = h & mask;
+    while (table->slots[i] != NULL && strcmp(table->slots[i]->species, species) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &(table->slots[i]);
+}
+duplicate_t* findDuplicate(speciesTable_t *table, const char *species) {
+    // return the pointer to the duplicate of `species' if found, NULL if not found.
+    return *speciesTable_slot(table, species);
+}
+double bitScore(char a, char b) {
+    // a is the truth, b is the prediction
+    a = toupper(a);
+    b = toupper(b);
+    if ((a == 'N') || (b == 'N'))
+        return 0.0;
+    double f = 0.41503749927884381854626105605; // -log2(3/4)
+    switch (a) {
+    case 'A':
+    case 'C':
+    case 'G':
+    case 'T':
+        return a == b ? 2.0 : 0.0;
+    case 'W':
+        return (b == 'A' || b == 'T') ? 1.0 : 0.0;
+    case 'S':
+        return (b == 'C' || b == 'G') ? 1.0 : 0.0;
+    case 'M':
+        return (b == 'A' || b == 'C') ? 1.0 : 0.0;
+    case 'K':
+        return (b == 'G' || b == 'T') ? 1.0 : 0.0;
+    case 'R':
+        return (b == 'A' || b == 'G') ? 1.0 : 0.0;
+    case 'Y':
+        return (b == 'C' || b == 'T') ? 1.0 : 0.0;
+    case 'B':
+        return (b != 'A') ? f : 0.0;
+    case 'D':
+        return (b != 'C') ? f : 0.0;
+    case 'H':
+        return (b != 'G') ? f : 0.0;
+    case 'V':
+        return (b != 'T') ? f : 0.0;
+    default:
+        fprintf(stderr, "Unanticipated condition when calling bitScore(%c, %c)\n", a, b);
+        exit(EXIT_FAILURE);
+    }
+}
+double scoreSequence(const uint8_t *consensus, uint64_t n, const char *seq) {
+    // walk the sequence `seq' and calculate and return its bitScore versus the consensus
+    // column masks `consensus', of length n.
+    double s = 0.0;
+    for (uint64_t i = 0; i < n; ++i)
+        s += g_maskScores[consensus[i]][(unsigned char) seq[i]];
+    return s;
+}
+void populateMafLineArray(scoredMafLine_t *head, scoredMafLine_t **array) {
+    // given a mafLine linked list, create an array of the same. this array will be used
+    // later to sort the mafline pointers based on their ->score value.
+    unsigned i = 0;
+    scoredMafLine_t *m = head;
+    while (m != NULL) {
+        array[i++] = m;
+        m = m->next;
+    }
+}
+void findBestDupes(duplicate_t *head, const uint8_t *consensus, uint64_t n) {
+    // For each duplicate list, go through its mafline list and find the best line and move it
+    // to the head of the list.
+    duplicate_t *d = head;
+    scoredMafLine_t *sml = NULL;
+    while (d != NULL) {
+        if (d->numSequences < 2) {
+            // if there's only one sequence, who cares
+            d = d->next;
+            continue;
+        }
+        // score all the maf lines
+        sml = d->headScoredMaf;
+        while (sml != NULL) {
+            sml->score = scoreSequence(consensus, n, maf_mafLine_getSequence(sml->mafLine));
+            sml = sml->next;
+        }
+        // sort on scores
+        scoredMafLine_t **mafLineArray = (scoredMafLine_t**) de_malloc(sizeof(*mafLineArray) * d->numSequences);
+        populateMafLineArray(d->headScoredMaf, mafLineArray);
+        qsort(mafLineArray, d->numSequences, sizeof(scoredMafLine_t *), cmp_by_score);
+        // move the top score to the head of the list
+        d->headScoredMaf = mafLineArray[0];
+        sml = d->headScoredMaf;
+        for (unsigned i = 1; i < d->numSequences; ++i) {
+            // rebuild the linked list
+            sml->next = mafLineArray[i];
+            sml = sml->next;
+        }
+        sml->next = NULL;
+        d = d->next;
+        free(mafLineArray);
+    }
+}
+int cmp_by_score(const void *a, const void *b) {
+    // mafBlock_t * const *ia = a;
+    // mafBlock_t * const *ib = b;
+    scoredMafLine_t **ia = (scoredMafLine_t **) a;
+    scoredMafLine_t **ib = (scoredMafLine_t **) b;
+    // reverse sort
+    return ((*ib)->score - (*ia)->score);
+}
+void correctSpeciesNames(mafBlock_t *block) {
+    // the sharedMaf.h block reading function takes the entire name field,
+    // but we only want the name field up until the first '.' is observed.
+    // NOTE!! This means that we cannot use the convience function maf_mafBlock_print()
+    // to print out the block at the end as the ->species field is going to be "wrong"
+    // though the ->line field will still be correct.
+    mafLine_t *m = maf_mafBlock_getHeadLine(block);
+    unsigned len = 0;
+    while(m != NULL) {
+        if (maf_mafLine_getType(m) != 's') {
+            m = maf_mafLine_getNext(m);
+            continue;
+        }
+        len = strlen(maf_mafLine_getSpecies(m));
+        for (unsigned i = 0; i < len; ++i) {
+            if (maf_mafLine_getSpecies(m)[i] == '.') {
+                maf_mafLine_getSpecies(m)[i] = '\0';
+                break;
+            }
+        }
+        m = maf_mafLine_getNext(m);
+    }
+}
+bool checkBlock(mafBlock_t *block, FILE *ofp, FILE *efp) {
+    // read through each line of a mafBlock and filter duplicates.
+    // Report the top scoring duplication only. Returns false, with nothing written
+    // to ofp and the error written to efp, if the block cannot be scored.
+    mafLine_t *ml = maf_mafBlock_getHeadLine(block);
+    unsigned n = maf_mafLine_getNumberOfSequences(ml);
+    char **sequences = (char **) de_malloc(sizeof(char *) * n); // not copies, the lines' own sequences
+    int index = 0;
+    bool containsDuplicates = false;
+    duplicate_t *d = NULL, *dupSpeciesHead = NULL;
+    speciesTable_t *table = newSpeciesTable(n);
+    while (ml != NULL) {
+        if (maf_mafLine_getType(ml) != 's') {
+            // skip non-sequence lines
+            ml = maf_mafLine_getNext(ml);
+            continue;
+        }
+        sequences[index] = maf_mafLine_getSequence(ml);
+        duplicate_t **slot = speciesTable_slot(table, maf_mafLine_getSpecies(ml));
+        duplicate_t *thisDup = *slot;
+        if (thisDup == NULL) {
+            // first instance of species, add to list
+            if (dupSpeciesHead == NULL) {
+                dupSpeciesHead = newDuplicate();
+                d = dupSpeciesHead;
+            } else {
+                d->next = newDuplicate();
+                d = d->next;
+            }
+            d->species = maf_mafLine_getSpecies(ml);
+            *slot = d;
+            // create the mafline linked list
+            d->headScoredMaf = newScoredMafLine();
+            d->headScoredMaf->mafLine = ml;
+            d->tailScoredMaf = d->headScoredMaf;
+        } else {
+            // this sequence is a duplicate, extend the duplicate list.
+            containsDuplicates = true;
+            ++(thisDup->numSequences);
+            scoredMafLine_t *sml = thisDup->tailScoredMaf;
+            sml->next = newScoredMafLine();
+            sml = sml->next;
+            sml->mafLine = ml;
+            thisDup->tailScoredMaf = sml;
+        }
+        ++index;
+        ml = maf_mafLine_getNext(ml);
+    }
+    if (!containsDuplicates) {
+        reportBlock(block, ofp);
+        free(sequences);
+        destroySpeciesTable(table);
+        destroyDuplicates(dupSpeciesHead);
+        return true;
+    }
+    // this block contains duplicates
+    uint64_t numColumns = strlen(sequences[0]);
+    uint8_t *consensus = (uint8_t *) de_malloc(numColumns + 1);
+    bool ok = buildConsensus(consensus, sequences, n, numColumns,
+                             maf_mafLine_getLineNumber(maf_mafBlock_getHeadLine(block)), // for error reporting
+                             efp);
+    if (ok) {
+        findBestDupes(dupSpeciesHead, consensus, numColumns);
+        reportBlockWithDuplicates(block, table, ofp);
+    }
+    // clean up
+    free(sequences);
+    destroySpeciesTable(table);
+    destroyDuplicates(dupSpeciesHead);
+    free(consensus);
+    return ok;
+}
+void destroyDuplicates(duplicate_t *d) {
+    // free all memory associated with a duplicate linked list
+    duplicate_t *tmp = NULL;
+    while (d != NULL) {
+        tmp = d;
+        d = d->next;
+        destroyScoredMafLineList(tmp->headScoredMaf);
+        free(tmp);
+    }
+}
+void destroyScoredMafLineList(scoredMafLine_t *sml) {
+    scoredMafLine_t *tmp = NULL;
+    while (sml != NULL) {
+        tmp = sml;
+        sml = sml->next;
+        // note that sml->mafLine is NOT freed here
+        free(tmp);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _MAF_DUPLICATE_FILTER_API_H_
+#define _MAF_DUPLICATE_FILTER_API_H_
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "common.h"
+#include "sharedMaf.h"
+
+typedef struct scoredMafLine {
+    // augmented data structure
+    double score;
+    mafLine_t *mafLine;
+    struct scoredMafLine *next;
+} scoredMafLine_t;
+typedef struct duplicate {
+    // a duplicate is a species that shows up twice in a block
+    char *species; // not owned, the species of the first line
+    scoredMafLine_t *headScoredMaf; // linked list of scoredMafLine_t containing the duplicated lines
+    scoredMafLine_t *tailScoredMaf; // last element in ll
+    bool reported; // whether or not this duplicate has been reported yet
+    struct duplicate *next;
+    uint64_t numSequences; // number of elements in the headScoredMaf ll
+} duplicate_t;
+typedef struct speciesTable {
+    // open addressing hash table of the duplicate_t of each species in a block
+    duplicate_t **slots;
+    uint64_t size; // a power of two, at least twice the number of species
+} speciesTable_t;
+
+// bitScore() of each consensus residue against each character, indexed by the
+// consensus column mask (see initScores) and then by the character.
+extern double g_maskScores[32][256];
+// consensusResidue() of each column mask. bit order: {A, C, G, T, N}
+extern char g_maskResidues[32];
+
+scoredMafLine_t* newScoredMafLine(void);
+duplicate_t* newDuplicate(void);
+void printHeader(void);
+unsigned longestLine(mafBlock_t *mb);
+unsigned numberOfSequencesScoredMafLineList(scoredMafLine_t *m);
+void printResidues(unsigned *r);
+unsigned maxRes(unsigned residues[]);
+char consensusResidue(unsigned residues[]);
+void initScores(void);
+void reportBadResidue(char **sequences, unsigned numSeqs, uint64_t n, unsigned lineno, FILE *efp);
+bool buildConsensus(uint8_t *consensus, char **sequences, unsigned numSeqs, uint64_t n, unsigned lineno,
+                    FILE *efp);
+bool checkForDupes(char **species, int index, mafLine_t *m);
+void reportBlock(mafBlock_t *b, FILE *ofp);
+void reportBlockWithDuplicates(mafBlock_t *mb, speciesTable_t *table, FILE *ofp);
+void reportDuplicates(duplicate_t *dup);
+speciesTable_t* newSpeciesTable(uint64_t n);
+void destroySpeciesTable(speciesTable_t *table);
+duplicate_t** speciesTable_slot(speciesTable_t *table, const char *species);
+duplicate_t* findDuplicate(speciesTable_t *table, const char *species);
+double bitScore(char a, char b);
+double scoreSequence(const uint8_t *consensus, uint64_t n, const char *seq);
+void populateMafLineArray(scoredMafLine_t *head, scoredMafLine_t **array);
+void findBestDupes(duplicate_t *head, const uint8_t *consensus, uint64_t n);
+int cmp_by_score(const void *a, const void *b);
+void correctSpeciesNames(mafBlock_t *block);
+bool checkBlock(mafBlock_t *block, FILE *ofp, FILE *efp);
+void destroyDuplicates(duplicate_t *d);
+void destroyScoredMafLineList(scoredMafLine_t *sml);
+
+#endif // _MAF_DUPLICATE_FILTER_API_H_
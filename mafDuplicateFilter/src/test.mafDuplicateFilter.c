@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2014 by
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's
+ * lab (BME Dept. UCSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CuTest.h"
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafDuplicateFilterAPI.h"
+#include "test.mafDuplicateFilter.h"
+
+static void naiveConsensus(char *residues, char **sequences, unsigned numSeqs, uint64_t n) {
+    // the consensus as it was computed before column masks, one column at a time,
+    // with consensusResidue() on the counts of that column.
+    for (uint64_t i = 0; i < n; ++i) {
+        unsigned counts[6] = {0, 0, 0, 0, 0, 0};
+        for (unsigned j = 1; j < numSeqs; ++j) {
+            switch (toupper(sequences[j][i])) {
+            case 'A': ++counts[0]; break;
+            case 'C': ++counts[1]; break;
+            case 'G': ++counts[2]; break;
+            case 'T': ++counts[3]; break;
+            case 'N': ++counts[4]; break;
+            default: break;
+            }
+        }
+        residues[i] = consensusResidue(counts);
+    }
+}
+static void test_buildConsensus_0(CuTest *testCase) {
+    // mixed case rows count as the same residue, the first row is not counted
+    initScores();
+    char *sequences[] = {"TTTTTT",
+                         "ACgtAa",
+                         "acGTCa",
+                         "AcGt-g"};
+    uint8_t consensus[6];
+    CuAssertTrue(testCase, buildConsensus(consensus, sequences, 4, 6, 0, stderr));
+    const char *expected = "ACGTMA";
+    for (unsigned i = 0; i < 6; ++i) {
+        CuAssertTrue(testCase, g_maskResidues[consensus[i]] == expected[i]);
+    }
+    CuAssertTrue(testCase, consensus[0] == 1);
+    CuAssertTrue(testCase, consensus[4] == 3);
+}
+static void test_buildConsensus_1(CuTest *testCase) {
+    // N columns, all-gap columns and ties with N
+    initScores();
+    char *sequences[] = {"ACGTA",
+                         "AN-an",
+                         "nN-cA",
+                         "AN-c-"};
+    uint8_t consensus[5];
+    CuAssertTrue(testCase, buildConsensus(consensus, sequences, 4, 5, 0, stderr));
+    CuAssertTrue(testCase, consensus[0] == 1);
+    CuAssertTrue(testCase, g_maskResidues[consensus[1]] == 'N');
+    CuAssertTrue(testCase, consensus[1] == 16);
+    // an all-gap column ties every residue at zero
+    CuAssertTrue(testCase, consensus[2] == 31);
+    CuAssertTrue(testCase, g_maskResidues[consensus[2]] == 'N');
+    CuAssertTrue(testCase, consensus[3] == 2);
+    CuAssertTrue(testCase, consensus[4] == 17);
+}
+static void test_buildConsensus_2(CuTest *testCase) {
+    // random blocks give the same consensus as the column by column count
+    initScores();
+    static const char alphabet[] = "ACGTNacgtn-";
+    unsigned numSeqs = 7;
+    uint64_t n = 300;
+    char **sequences = (char **) de_malloc(sizeof(char *) * numSeqs);
+    uint8_t *consensus = (uint8_t *) de_malloc(n);
+    char *expected = (char *) de_malloc(n);
+    srand(1);
+    for (unsigned t = 0; t < 20; ++t) {
+        for (unsigned j = 0; j < numSeqs; ++j) {
+            if (t == 0) {
+                sequences[j] = (char *) de_malloc(n + 1);
+            }
+            for (uint64_t i = 0; i < n; ++i) {
+                // a skewed alphabet so that ties and gap runs both happen
+                sequences[j][i] = alphabet[(rand() % 3 == 0) ? 10 : rand() % 10];
+            }
+            sequences[j][n] = '\0';
+        }
+        CuAssertTrue(testCase, buildConsensus(consensus, sequences, numSeqs, n, 0, stderr));
+        naiveConsensus(expected, sequences, numSeqs, n);
+        for (uint64_t i = 0; i < n; ++i) {
+            CuAssertTrue(testCase, g_maskResidues[consensus[i]] == expected[i]);
+        }
+    }
+    for (unsigned j = 0; j < numSeqs; ++j) {
+        free(sequences[j]);
+    }
+    free(sequences);
+    free(consensus);
+    free(expected);
+}
+static void test_buildConsensus_3(CuTest *testCase) {
+    // a bad residue, or a short row, is reported rather than ending the program
+    initScores();
+    char *bad[] = {"ACGT",
+                   "ACGT",
+                   "ACxT"};
+    char *shortRow[] = {"ACGT",
+                        "ACGT",
+                        "AC"};
+    uint8_t consensus[4];
+    char line[256];
+    FILE *f = tmpfile();
+    CuAssertTrue(testCase, f != NULL);
+    CuAssertTrue(testCase, !buildConsensus(consensus, bad, 3, 4, 7, f));
+    CuAssertTrue(testCase, !buildConsensus(consensus, shortRow, 3, 4, 9, f));
+    rewind(f);
+    CuAssertTrue(testCase, fgets(line, sizeof(line), f) != NULL);
+    CuAssertStrEquals(testCase, "Error, unanticipated character within sequence (2,2) "
+                      "contained in block near line number 7: x\n", line);
+    CuAssertTrue(testCase, fgets(line, sizeof(line), f) != NULL);
+    CuAssertTrue(testCase, strstr(line, "(2,2) contained in block near line number 9") != NULL);
+    fclose(f);
+}
+static void test_scoreSequence_0(CuTest *testCase) {
+    initScores();
+    // masks for A, C, M (A or C) and an all-gap column
+    uint8_t consensus[] = {1, 2, 3, 31};
+    CuAssertDblEquals(testCase, 5.0, scoreSequence(consensus, 4, "ACAA"), 1e-9);
+    CuAssertDblEquals(testCase, 5.0, scoreSequence(consensus, 4, "acaa"), 1e-9);
+    CuAssertDblEquals(testCase, 2.0, scoreSequence(consensus, 4, "A-NA"), 1e-9);
+    CuAssertDblEquals(testCase, 1.0, scoreSequence(consensus, 4, "NNCN"), 1e-9);
+    CuAssertDblEquals(testCase, 0.0, scoreSequence(consensus, 4, "----"), 1e-9);
+    for (unsigned mask = 0; mask < 32; ++mask) {
+        // the table agrees with bitScore() for every character a block may hold
+        const char *c = "ACGTNacgtn-";
+        for (unsigned i = 0; i < strlen(c); ++i) {
+            CuAssertDblEquals(testCase, bitScore(g_maskResidues[mask], c[i]),
+                              g_maskScores[mask][(unsigned char) c[i]], 1e-12);
+        }
+    }
+}
+CuSuite* duplicateFilter_TestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, test_buildConsensus_0);
+    SUITE_ADD_TEST(suite, test_buildConsensus_1);
+    SUITE_ADD_TEST(suite, test_buildConsensus_2);
+    SUITE_ADD_TEST(suite, test_buildConsensus_3);
+    SUITE_ADD_TEST(suite, test_scoreSequence_0);
+    return suite;
+}
@@ -24,6 +24,7 @@
 ##################################################
 import os
 import random
+import subprocess
 import sys
 import unittest
 sys.path.append(os.path.abspath(os.path.join(os.path.dirname(sys.argv[0]), '../../lib/')))
@@ -254,6 +255,63 @@ class DuplicationFilterTest(unittest.TestCase):
             mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
             self.assertTrue(mafIsFiltered(os.path.join(tmpDir, 'filtered.maf'), expectedOutput))
             mtt.removeDir(tmpDir)
+    def testFilterThreads(self):
+        """ mafDuplicateFilter should filter identically when using worker threads.
+        """
+        mtt.makeTempDirParent()
+        for i in xrange(0, 10):
+            shuffledBlocks = []
+            expectedOutput = []
+            tmpDir = os.path.abspath(mtt.makeTempDir('filterThreads'))
+            order = [1] * len(g_duplicateBlocks) + [0] * len(g_nonDuplicateBlocks)
+            random.shuffle(order)
+            random.shuffle(g_duplicateBlocks)
+            random.shuffle(g_nonDuplicateBlocks)
+            j, k = 0, 0
+            for dupBlock in order:
+                if dupBlock:
+                    shuffledBlocks.append(g_duplicateBlocks[j][0])
+                    expectedOutput.append(g_duplicateBlocks[j][1])
+                    j += 1
+                else:
+                    shuffledBlocks.append(g_nonDuplicateBlocks[k])
+                    expectedOutput.append(g_nonDuplicateBlocks[k])
+                    k += 1
+            testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                   ''.join(shuffledBlocks), g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafDuplicateFilter')),
+                   '--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--threads', '3']
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'filtered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            self.assertTrue(mafIsFiltered(os.path.join(tmpDir, 'filtered.maf'), expectedOutput))
+            mtt.removeDir(tmpDir)
+    def testBadResidueThreads(self):
+        """ mafDuplicateFilter should stop at a block with a bad residue, printing the same with worker threads.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('badResidueThreads'))
+        # the last sequence line of a block with duplicates gets an unanticipated character
+        lines = g_duplicateBlocks[0][0].split('\n')
+        last = max(i for i, l in enumerate(lines) if l.startswith('s'))
+        lines[last] = lines[last][:-1] + 'x'
+        blocks = [b[0] for b in g_duplicateBlocks] * 20 + ['\n'.join(lines)] + g_nonDuplicateBlocks * 20
+        testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                               ''.join(blocks), g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        results = []
+        for threads in ['1', '3', '8']:
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafDuplicateFilter')),
+                   '--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--threads', threads]
+            p = subprocess.Popen(cmd, cwd=tmpDir, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            out, err = p.communicate()
+            self.assertNotEqual(p.returncode, 0)
+            self.assertTrue('unanticipated character' in err)
+            results.append((out, err))
+        for r in results[1:]:
+            self.assertEqual(results[0], r)
+        mtt.removeDir(tmpDir)
     def testNonFilter(self):
         """ mafDuplicateFilter should not filter out any sequences from blocks when there are no duplicates.
         """
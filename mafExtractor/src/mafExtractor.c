@@ -30,6 +30,7 @@
 #include <string.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "mafIndex.h"
 #include "mafExtractor.h"
 #include "mafExtractorAPI.h"
 #include "buildVersion.h"
@@ -55,11 +56,22 @@ void usage(void) {
     usageMessage('\0', "start", "start of region, inclusive, 0 based.");
     usageMessage('\0', "stop", "end of region, inclusive, 0 based.");
     usageMessage('\0', "soft", "include entire block even if it has gaps or over-hangs. default=false.");
+    usageMessage('\0', "regions", "path to a bed file of regions to extract in a single pass, used "
+                 "instead of --seq --start --stop. Each reported block has region=[name] appended to "
+                 "its alignment line, where name is the bed name field or seq_start_end.");
+    usageMessage('\0', "regionPrefix", "with --regions, write each region to its own file, "
+                 "[prefix][name].maf, instead of standard out. Region names must be unique.");
+    usageMessage('\0', "buildIndex", "write a block index for --maf to [maf].mafidx (or to --index) "
+                 "and exit. Later runs on the same maf read only the blocks that overlap the "
+                 "requested region(s).");
+    usageMessage('\0', "index", "path to the block index of --maf. default=[maf].mafidx, which is "
+                 "used if it exists and is up to date.");
     usageMessage('v', "verbose", "turns on verbose output.");
     exit(EXIT_FAILURE);
 }
 void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t *start, 
-                  uint64_t *stop, bool *isSoft) {
+                  uint64_t *stop, bool *isSoft, char **regions, char **regionPrefix,
+                  char **indexFilename, bool *buildIndex) {
     extern int g_debug_flag;
     extern int g_verbose_flag;
     int c;
@@ -76,6 +88,10 @@ void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t
             {"start", required_argument, 0, 0},
             {"stop", required_argument, 0, 0},
             {"soft", no_argument, 0, 0},
+            {"regions", required_argument, 0, 0},
+            {"regionPrefix", required_argument, 0, 0},
+            {"index", required_argument, 0, 0},
+            {"buildIndex", no_argument, 0, 0},
             {0, 0, 0, 0}
         };
         int longIndex = 0;
@@ -103,6 +119,17 @@ void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t
                 setStop = true;
             } else if (strcmp("soft", longOptions[longIndex].name) == 0) {
                 *isSoft = true;
+            } else if (strcmp("regions", longOptions[longIndex].name) == 0) {
+                free(*regions);
+                *regions = de_strdup(optarg);
+            } else if (strcmp("regionPrefix", longOptions[longIndex].name) == 0) {
+                free(*regionPrefix);
+                *regionPrefix = de_strdup(optarg);
+            } else if (strcmp("index", longOptions[longIndex].name) == 0) {
+                free(*indexFilename);
+                *indexFilename = de_strdup(optarg);
+            } else if (strcmp("buildIndex", longOptions[longIndex].name) == 0) {
+                *buildIndex = true;
             } else if (strcmp("version", longOptions[longIndex].name) == 0) {
                 version();
                 exit(EXIT_SUCCESS);
@@ -130,6 +157,24 @@ void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t
             abort();
         }
     }
+    if (*buildIndex) {
+        if (!setMName || setSName || setStart || setStop || *regions != NULL) {
+            fprintf(stderr, "Error, specify --maf --buildIndex on its own\n");
+            usage();
+        }
+        return;
+    }
+    if (*regions != NULL) {
+        if (!setMName || setSName || setStart || setStop) {
+            fprintf(stderr, "Error, specify --maf --regions, or --maf --seq --start --stop\n");
+            usage();
+        }
+        return;
+    }
+    if (*regionPrefix != NULL) {
+        fprintf(stderr, "Error, --regionPrefix requires --regions\n");
+        usage();
+    }
     if (!(setMName && setSName && setStart && setStop)) {
         fprintf(stderr, "Error, specify --maf --seq --start --stop\n");
         usage();
@@ -158,11 +203,41 @@ int main(int argc, char **argv) {
     char filename[kMaxStringLength];
     uint64_t start, stop;
     bool isSoft = false;
-    parseOptions(argc, argv, filename, seq, &start, &stop, &isSoft);
+    char *regions = NULL, *regionPrefix = NULL, *indexFilename = NULL;
+    bool buildIndex = false;
+    parseOptions(argc, argv, filename, seq, &start, &stop, &isSoft, &regions, &regionPrefix,
+                 &indexFilename, &buildIndex);
+    if (buildIndex) {
+        char *path = (indexFilename != NULL) ? de_strdup(indexFilename) : maf_index_defaultFilename(filename);
+        maf_buildIndex(filename, path);
+        free(path);
+        free(indexFilename);
+        return EXIT_SUCCESS;
+    }
+    mafIndex_t *mi = maf_openIndexForMaf(filename, indexFilename);
     mafFileApi_t *mfa = maf_newMfa(filename, "r");
 
-    processBody(mfa, seq, start, stop, isSoft);
+    if (regions != NULL) {
+        mafRegionSet_t *rs = readRegionSet(regions);
+        if (regionPrefix != NULL) {
+            regionSet_setPrefix(rs, regionPrefix);
+        }
+        if (mi != NULL) {
+            processBodyRegionsIndexed(mfa, mi, rs, isSoft);
+        } else {
+            processBodyRegions(mfa, rs, isSoft);
+        }
+        destroyRegionSet(rs);
+    } else if (mi != NULL) {
+        processBodyIndexed(mfa, mi, seq, start, stop, isSoft);
+    } else {
+        processBody(mfa, seq, start, stop, isSoft);
+    }
     maf_destroyMfa(mfa);
+    maf_destroyIndex(mi);
+    free(indexFilename);
+    free(regions);
+    free(regionPrefix);
     
     return EXIT_SUCCESS;
 }
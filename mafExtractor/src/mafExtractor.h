@@ -33,6 +33,7 @@
 void version(void);
 void usage(void);
 void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t *start, 
-                  uint64_t *stop, bool *isSoft);
+                  uint64_t *stop, bool *isSoft, char **regions, char **regionPrefix,
+                  char **indexFilename, bool *buildIndex);
 
 #endif // _BLOCK_EXTRACTOR_H_
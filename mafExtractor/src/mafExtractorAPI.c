@@ -32,8 +32,11 @@
 #include <string.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "mafIndex.h"
 #include "mafExtractorAPI.h"
 
+const unsigned kMaxOpenRegionFiles = 64;
+
 bool checkRegion(uint64_t targetStart, uint64_t targetStop, uint64_t lineStart,
                  uint64_t length, uint64_t sourceLength, char strand) {
     // check to see if pos is in this block
@@ -71,146 +74,169 @@ bool searchMatched(mafLine_t *ml, const char *seq, uint64_t start, uint64_t stop
 void printHeader(void) {
     printf("##maf version=1\n\n");
 }
-void printTargetColumns(bool *targetColumns, uint64_t n) {
-    for (uint64_t i = 0; i < n; ++i) {
-        if (targetColumns[i])
-            printf("*");
-        else
-            printf(".");
-        // if (!((i + 1) % 5))
-        //     printf(" ");
-    }
-    printf("\n");
-}
-uint64_t getTargetColumns(bool **targetColumns, uint64_t *len, mafBlock_t *b, const char *seqName,
-                          uint64_t start, uint64_t stop) {
-    // given a block and a target, create an array of bools where true means the target
-    // is present in that column and false means it is absent
-    /* printf("getTargetColumns(len=%"PRIu64", seqName=%s, start=%"PRIu64", stop=%"PRIu64")\n",
-     *len, seqName, start, stop); */
-    mafLine_t *ml = maf_mafBlock_getHeadLine(b);
-    uint64_t sum = 0;
-    while(maf_mafLine_getType(ml) != 's') {
-        ml = maf_mafLine_getNext(ml);
+static int cmpColumnRun(const void *a, const void *b) {
+    const mafColumnRun_t *x = (const mafColumnRun_t *) a;
+    const mafColumnRun_t *y = (const mafColumnRun_t *) b;
+    if (x->l != y->l) {
+        return (x->l < y->l) ? -1 : 1;
     }
-    char *seq = NULL;
-    *len = maf_mafBlock_getSequenceFieldLength(b);
-    // printf("target columns len: %" PRIu64 "\n", *len);
-    if (*len == 0) {
-        *targetColumns = NULL;
+    return (x->r < y->r) ? -1 : (x->r > y->r);
+}
+uint64_t getTargetRuns(mafColumnRun_t **runs, uint64_t *numRuns, mafBlock_t *b, const char *seqName,
+                       uint64_t start, uint64_t stop) {
+    // given a block and a target, create a list of the maximal runs of columns in which
+    // the target is present, in column order. Returns the number of target columns.
+    uint64_t len = maf_mafBlock_getSequenceFieldLength(b);
+    uint64_t n = 0, maxRuns = 16, sum = 0;
+    unsigned matched = 0;
+    *runs = NULL;
+    *numRuns = 0;
+    if (len == 0) {
         return sum;
     }
-    *targetColumns = (bool*) de_malloc(sizeof(bool*) * (*len));
-    memset(*targetColumns, false, sizeof(bool*) * (*len));
-    // printf("target columns len: %" PRIu64 "\n", *len);
-    int it = 0;
-    uint64_t pos = 0;
-    while (ml != NULL) {
-        if (maf_mafLine_getType(ml) != 's') {
-            ml = maf_mafLine_getNext(ml);
-            continue;
-        }
-        if (maf_mafLine_getSpecies(ml) == NULL) {
-            ml = maf_mafLine_getNext(ml);
+    mafColumnRun_t *rr = (mafColumnRun_t*) de_malloc(sizeof(*rr) * maxRuns);
+    for (mafLine_t *ml = maf_mafBlock_getHeadLine(b); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+        if (maf_mafLine_getType(ml) != 's' || maf_mafLine_getSpecies(ml) == NULL) {
             continue;
         }
-        // make sure name is the same
         if (strcmp(maf_mafLine_getSpecies(ml), seqName) != 0) {
-            // printf("does not match: [%s] vs [%s]\n", maf_mafLine_getSpecies(ml), seqName);
-            ml = maf_mafLine_getNext(ml);
             continue;
         }
-        // printf("match: %s\n", maf_mafLine_getSpecies(ml));
-        // establish sign of iterator
-        if (maf_mafLine_getStrand(ml) == '+') {
-            it = 1;
-        } else {
-            it = -1;
-        }
-        seq = maf_mafLine_getSequence(ml);
-        pos = maf_mafLine_getPositiveCoord(ml);
-        for (uint64_t i = 0; i < (*len); ++i) {
-            if (seq[i] != '-') {
-                // if not gap, check to see if in target region
-                if ((start <= pos) && (pos <= stop)) {
-                    if ((*targetColumns)[i] == 0) {
-                        ++sum;
-                        (*targetColumns)[i] = 1;
+        ++matched;
+        // positions run up the positive strand for + lines and down it for - lines, so
+        // once a position falls past the target on that side there is nothing left to find
+        int it = (maf_mafLine_getStrand(ml) == '+') ? 1 : -1;
+        char *seq = maf_mafLine_getSequence(ml);
+        uint64_t pos = maf_mafLine_getPositiveCoord(ml);
+        uint64_t rowFirst = n;
+        for (uint64_t i = 0; i < len; ++i) {
+            if (seq[i] == '-') {
+                continue;
+            }
+            if ((start <= pos) && (pos <= stop)) {
+                if (n > rowFirst && rr[n - 1].r + 1 == i) {
+                    rr[n - 1].r = i;
+                } else {
+                    if (n == maxRuns) {
+                        maxRuns *= 2;
+                        rr = (mafColumnRun_t*) realloc(rr, sizeof(*rr) * maxRuns);
+                        if (rr == NULL) {
+                            fprintf(stderr, "Error, realloc failed in getTargetRuns()\n");
+                            exit(EXIT_FAILURE);
+                        }
                     }
+                    rr[n].l = i;
+                    rr[n].r = i;
+                    ++n;
                 }
-                pos += it;
+            } else if ((it > 0) ? (pos > stop) : (pos < start)) {
+                break;
             }
+            pos += it;
         }
-        ml = maf_mafLine_getNext(ml);
     }
-    return sum;
-}
-uint64_t sumBool(bool *array, uint64_t n) {
-    uint64_t a = 0;
-    for (uint64_t i = 0; i < n; ++i) {
-        if (array[i]) {
-            // printf("1");
-            ++a;
-        } else {
-            // printf("0");
+    if (matched > 1 && n > 1) {
+        // the same sequence appears more than once, merge the runs of each appearance
+        qsort(rr, n, sizeof(*rr), cmpColumnRun);
+        uint64_t j = 0;
+        for (uint64_t i = 1; i < n; ++i) {
+            if (rr[i].l <= rr[j].r + 1) {
+                if (rr[i].r > rr[j].r) {
+                    rr[j].r = rr[i].r;
+                }
+            } else {
+                rr[++j] = rr[i];
+            }
         }
-        /* if ((i + 1) % 5 == 0) { */
-        /*     printf(" "); */
-        /* } */
+        n = j + 1;
     }
-    // printf("\n");
-    return a;
-}
-int64_t **createOffsets(uint64_t n) {
-    // create a matrix to store relative offsets for walking through a maf block
-    int64_t **offs = (int64_t**) de_malloc(sizeof(int64_t*) * n);
     for (uint64_t i = 0; i < n; ++i) {
-        offs[i] = (int64_t*) de_malloc(sizeof(int64_t) * 2); // 0: index 1: offset
-        offs[i][0] = 0;
-        offs[i][1] = -1;
+        sum += rr[i].r - rr[i].l + 1;
+    }
+    if (n == 0) {
+        free(rr);
+        rr = NULL;
     }
-    return offs;
+    *runs = rr;
+    *numRuns = n;
+    return sum;
 }
-void destroyOffsets(int64_t **offs, uint64_t n) {
-    for (uint64_t i = 0; i < n; ++i) {
-        free(offs[i]);
-        offs[i] = NULL;
+mafRowCursor_t *newRowCursors(mafBlock_t *b) {
+    // one cursor per sequence line of the block, each at the first column.
+    uint64_t n = maf_mafBlock_getNumberOfSequences(b);
+    mafRowCursor_t *cursors = (mafRowCursor_t*) de_malloc(sizeof(mafRowCursor_t) * (n ? n : 1));
+    memset(cursors, 0, sizeof(mafRowCursor_t) * (n ? n : 1));
+    return cursors;
+}
+void advanceRowCursors(mafBlock_t *b, mafRowCursor_t *cursors, uint64_t l, uint64_t r, uint64_t *offsets) {
+    // moves the cursor of each sequence line to the end of the run [l, r], recording for the i-th
+    // line the number of non-gap characters left of l in offsets[2 * i] and the number up to
+    // and including r in offsets[2 * i + 1]. Runs must be given left to right, so that taken
+    // together each line is walked once.
+    mafRowCursor_t *c = cursors;
+    uint64_t *o = offsets;
+    for (mafLine_t *ml = maf_mafBlock_getHeadLine(b); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+        if (maf_mafLine_getType(ml) != 's') {
+            continue;
+        }
+        const char *seq = maf_mafLine_getSequence(ml);
+        assert(c->column <= l);
+        for (; c->column < l; ++c->column) {
+            c->count += (seq[c->column] != '-');
+        }
+        *o++ = c->count;
+        for (; c->column <= r; ++c->column) {
+            c->count += (seq[c->column] != '-');
+        }
+        *o++ = c->count;
+        ++c;
     }
-    free(offs);
-    offs = NULL;
 }
 mafBlock_t *processBlockForSplice(mafBlock_t *b, uint64_t blockNumber, const char *seq,
                                   uint64_t start, uint64_t stop, bool store) {
+    return processBlockForSpliceToFile(b, blockNumber, seq, start, stop, store, NULL, stdout);
+}
+void printBlockWithTag(mafBlock_t *mb, bool owned, const char *tag, FILE *ofp) {
+    // print mb to ofp, with tag appended to the alignment line if tag is not NULL.
+    // blocks that are not owned are copied rather than altered.
+    if (tag == NULL) {
+        maf_mafBlock_printToFile(mb, ofp);
+        return;
+    }
+    if (owned) {
+        maf_mafBlock_appendToAlignmentBlock(mb, (char*) tag);
+        maf_mafBlock_printToFile(mb, ofp);
+        return;
+    }
+    mafBlock_t *copy = maf_copyMafBlock(mb);
+    maf_mafBlock_appendToAlignmentBlock(copy, (char*) tag);
+    maf_mafBlock_printToFile(copy, ofp);
+    maf_destroyMafBlockList(copy);
+}
+mafBlock_t *processBlockForSpliceToFile(mafBlock_t *b, uint64_t blockNumber, const char *seq,
+                                        uint64_t start, uint64_t stop, bool store,
+                                        const char *tag, FILE *ofp) {
     // walks mafBlock_t b, returns a mafBlock_t (using the linked list feature) of all spliced out bits.
     // if store is true, will return a mafBlock_t linked list of all sub-blocks. If store is false,
-    // will report each sub-block (maf_mafBlock_print()) as it comes in and immediatly destroy that block.
+    // will report each sub-block to ofp as it comes in and immediatly destroy that block. If tag
+    // is not NULL it is appended to the alignment line of each reported sub-block.
     /*
     printf("\n\nprocessBlockForSplice(block=%"PRIu64", seq=%s, start=%"PRIu64", stop=%"PRIu64")\n",
            blockNumber, seq, start, stop);
     maf_mafBlock_print(b);
     */
-    bool *targetColumns = NULL;
-    uint64_t len = 0;
+    mafColumnRun_t *runs = NULL;
+    uint64_t numRuns = 0;
     mafBlock_t *head = NULL, *mb = NULL;
-    getTargetColumns(&targetColumns, &len, b, seq, start, stop);
-    // printTargetColumns(targetColumns, len);
-    int64_t **offsets = createOffsets(maf_mafBlock_getNumberOfSequences(b));
-    uint64_t l = 0, r = 0, ri = 0;
+    getTargetRuns(&runs, &numRuns, b, seq, start, stop);
+    mafRowCursor_t *cursors = newRowCursors(b);
+    uint64_t numSequences = maf_mafBlock_getNumberOfSequences(b);
+    uint64_t *offsets = (uint64_t*) de_malloc(sizeof(uint64_t) * 2 * (numSequences ? numSequences : 1));
     uint64_t spliceNumber = 0;
     char *id = (char*) de_malloc(kMaxStringLength);
-    while (l < len) {
-        if (!targetColumns[l]) {
-            // find the left most element
-            ++l;
-            r = l;
-            continue;
-        }
-        while (targetColumns[r] && r < len) {
-            // find the end of the right
-            ++r;
-        }
-        // set ri equal to the index of the last element
-        ri = r - 1;
+    for (uint64_t k = 0; k < numRuns; ++k) {
+        uint64_t l = runs[k].l, ri = runs[k].r;
+        advanceRowCursors(b, cursors, l, ri, offsets);
         if (store) {
             // used in unit tests
             if (head == NULL) {
@@ -233,32 +259,26 @@ mafBlock_t *processBlockForSplice(mafBlock_t *b, uint64_t blockNumber, const cha
                 sprintf(id, " splice_id=%" PRIu64 "_%" PRIu64, blockNumber, spliceNumber);
                 maf_mafBlock_appendToAlignmentBlock(mb, id);
             }
-            maf_mafBlock_print(mb);
+            printBlockWithTag(mb, mb != b, tag, ofp);
             if (mb != b) {
                 maf_destroyMafBlockList(mb);
             }
             ++spliceNumber;
         }
-        l = r;
-        if (l == len - 1) {
-            break;
-        }
     }
     // clean up
     free(id);
-    free(targetColumns);
-    destroyOffsets(offsets, maf_mafBlock_getNumberOfSequences(b));
+    free(runs);
+    free(cursors);
+    free(offsets);
     return head;
 }
-void printOffsetArray(int64_t **offsetArray, uint64_t n) {
-    for (uint64_t i = 0; i < n; ++i) {
-        printf("(%" PRIi64 ", %" PRIi64 "), ", offsetArray[i][0], offsetArray[i][1]);
-    }
-}
-mafBlock_t *spliceBlock(mafBlock_t *b, uint64_t l, uint64_t r, int64_t **offsetArray) {
+mafBlock_t *spliceBlock(mafBlock_t *b, uint64_t l, uint64_t r, const uint64_t *offsets) {
     // b is the input maf block
     // l is the left index in the sequence field, the start of inclusion
     // r is the right index in the sequence field, the stop of inclusion
+    // offsets[2 * i] is the number of non-gap characters of the i-th sequence line
+    // left of l, offsets[2 * i + 1] the number up to and including r
     if ((l == 0) && (r == maf_mafBlock_getSequenceFieldLength(b) - 1)) {
         return b;
     }
@@ -267,10 +287,7 @@ mafBlock_t *spliceBlock(mafBlock_t *b, uint64_t l, uint64_t r, int64_t **offsetA
     mafLine_t *ml1 = NULL, *ml2 = NULL;
     ml1 = maf_mafBlock_getHeadLine(b);
     uint64_t lineNumber = maf_mafLine_getLineNumber(ml1);
-    uint64_t numberOfSequences = maf_mafBlock_getNumberOfSequences(b);
-    for (uint64_t i = 0; i < numberOfSequences; ++i) {
-        assert(offsetArray[i][0] <= (int64_t)l);
-    }
+    assert(l <= r);
     assert(r < maf_mafBlock_getSequenceFieldLength(b));
     ml1 = maf_mafLine_getNext(ml1);
     maf_mafBlock_setHeadLine(mb, maf_newMafLineFromString("a score=0 mafExtractor_splicedBlock=true", lineNumber));
@@ -281,7 +298,7 @@ mafBlock_t *spliceBlock(mafBlock_t *b, uint64_t l, uint64_t r, int64_t **offsetA
     char *seq = NULL;
     bool prevLineUsed = true; // used when a mafline is dropped because it's length becomes 0
     bool emptyBlock = true;
-    uint64_t si = 0; // sequence index, for addressing into offsetArray
+    uint64_t si = 0; // sequence index, for addressing into offsets
     while (ml1 != NULL) {
         // loop through all maf lines in a block
         if (prevLineUsed) {
@@ -312,43 +329,8 @@ mafBlock_t *spliceBlock(mafBlock_t *b, uint64_t l, uint64_t r, int64_t **offsetA
         if (maf_mafBlock_getSequenceFieldLength(mb) == 0) {
             maf_mafBlock_setSequenceFieldLength(mb, len);
         }
-        // printf(" [%2"PRIi64", %2"PRIi64"] pre: %s\n", offsetArray[si][0], offsetArray[si][1], maf_mafLine_getSpecies(ml1));
-        // find first non-gap position OR the left edge, update offset
-        while (seq[offsetArray[si][0]] == '-' &&
-               offsetArray[si][0] <= (int64_t)l) {
-            ++offsetArray[si][0];
-            if (seq[offsetArray[si][0]] != '-' && offsetArray[si][1] >= 0) {
-                // if we've advanced to a non-gap char and the local offset
-                // is not 0 (i.e. these aren't simply leading gaps), then
-                // advance the offset
-                ++offsetArray[si][1]; // advance offset
-            }
-        }
-        // printf(" [%2"PRIi64", %2"PRIi64"] post-initial gap / left edge discovery: %s \n", offsetArray[si][0], offsetArray[si][1], maf_mafLine_getSpecies(ml1));
-        // we normally ignore the initial value because it's already been set. however if -1 it must be set
-        if (seq[offsetArray[si][0]] != '-' && offsetArray[si][1] == -1) {
-            offsetArray[si][1] = 0;
-        }
-        // offsets
-        for (int64_t i = offsetArray[si][0] + 1; i <= (int64_t)l; ++i) {
-            // figure out the non-gap offset for the splice-in point, `l'
-            offsetArray[si][0] = i; // local pos
-            if (seq[i] != '-') {
-                if (offsetArray[si][1] == -1) {
-                    offsetArray[si][1] = 0;
-                }
-                ++offsetArray[si][1]; // advance offset
-            }
-        }
-        // printf(" [%2"PRIi64", %2"PRIi64"] post-gaps: %s \n", offsetArray[si][0], offsetArray[si][1], maf_mafLine_getSpecies(ml1));
-        bool allGaps = true;
-        for (uint64_t i = l; i <= r; ++i) {
-            if (seq[i] != '-') {
-                allGaps = false;
-                break;
-            }
-        }
-        if (allGaps) {
+        uint64_t before = offsets[2 * si], through = offsets[2 * si + 1];
+        if (before == through) {
             // this sequence is all gaps in this region, exclude it
             ml1 = maf_mafLine_getNext(ml1);
             prevLineUsed = false;
@@ -359,37 +341,9 @@ mafBlock_t *spliceBlock(mafBlock_t *b, uint64_t l, uint64_t r, int64_t **offsetA
             ++si;
             continue;
         }
-        // Walk up beyond the `l' point if the left edge falls on a gap character
-        while (seq[offsetArray[si][0]] == '-' && offsetArray[si][0] < (int64_t) r) {
-            ++offsetArray[si][0];
-            if (seq[offsetArray[si][0]] != '-') { //  && offsetArray[si][1] >= 0) {
-                ++offsetArray[si][1];
-            }
-        }
-        // printf(" [%2"PRIi64", %2"PRIi64"] walk past left: %s\n", offsetArray[si][0], offsetArray[si][1], maf_mafLine_getSpecies(ml1));
-        // ensure local offset is set properly
-        int64_t seqCoords = offsetArray[si][1];
-        if (offsetArray[si][1] == -1) {
-            seqCoords = 0;
-            if (seq[offsetArray[si][0]] != '-') {
-                offsetArray[si][1] = 0;
-            }
-        }
-        // printf(" [%2"PRIi64", %2"PRIi64"] seqCoords:%"PRIi64" set properly: %s\n", offsetArray[si][0], offsetArray[si][1], seqCoords, maf_mafLine_getSpecies(ml1));
-        maf_mafLine_setStart(ml2, maf_mafLine_getStart(ml1) + seqCoords);
-        // update offsetArray:
-        for (uint64_t i = offsetArray[si][0] + 1; i <= r; ++i) {
-            offsetArray[si][0] = i;
-            if (seq[i] != '-') {
-                if (offsetArray[si][1] == -1) {
-                    offsetArray[si][1] = 0;
-                }
-                ++offsetArray[si][1];
-            }
-        }
-        // printf(" [%2"PRIi64", %2"PRIi64"] post update: %s\n", offsetArray[si][0], offsetArray[si][1], maf_mafLine_getSpecies(ml1));
+        maf_mafLine_setStart(ml2, maf_mafLine_getStart(ml1) + before);
         maf_mafLine_setSequence(ml2, de_strndup(seq + l, 1 + r - l));
-        maf_mafLine_setLength(ml2, countNonGaps(maf_mafLine_getSequence(ml2)));
+        maf_mafLine_setLength(ml2, through - before);
         maf_mafBlock_setSequenceFieldLength(mb, maf_mafLine_getSequenceFieldLength(ml2));
         maf_mafLine_setStrand(ml2, maf_mafLine_getStrand(ml1));
         maf_mafLine_setSourceLength(ml2, maf_mafLine_getSourceLength(ml1));
@@ -453,3 +407,354 @@ void processBody(mafFileApi_t *mfa, char *seq, uint64_t start, uint64_t stop, bo
         printHeader();
     }
 }
+static int cmpRegion(const void *a, const void *b) {
+    const mafRegion_t *ra = (const mafRegion_t *) a, *rb = (const mafRegion_t *) b;
+    int c = strcmp(ra->seq, rb->seq);
+    if (c != 0) {
+        return c;
+    }
+    if (ra->start != rb->start) {
+        return (ra->start < rb->start) ? -1 : 1;
+    }
+    return (ra->stop < rb->stop) ? -1 : (ra->stop > rb->stop);
+}
+static int cmpUint64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x < y) ? -1 : (x > y);
+}
+static int cmpString(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+mafRegionSet_t* readRegionSet(const char *filename) {
+    // read a bed file (seq, start, end and an optional name; end is exclusive) into a
+    // region set. Blank, comment, track and browser lines are skipped.
+    FILE *ifp = de_fopen(filename, "r");
+    uint64_t n = 0, max = 1024;
+    mafRegion_t *regions = (mafRegion_t*) de_malloc(sizeof(*regions) * max);
+    int64_t nBytes = kMaxStringLength;
+    char *line = (char*) de_malloc(nBytes + 1);
+    uint64_t lineno = 0;
+    while (!feof(ifp)) {
+        de_getline(&line, &nBytes, ifp);
+        ++lineno;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            ++p;
+        }
+        if (*p == '\0' || *p == '#' ||
+            strncmp(p, "track", 5) == 0 || strncmp(p, "browser", 7) == 0) {
+            continue;
+        }
+        char seq[kMaxSeqName], name[kMaxSeqName];
+        uint64_t bedStart, bedEnd;
+        name[0] = '\0';
+        int fields = sscanf(p, "%511s %" SCNu64 " %" SCNu64 " %511s", seq, &bedStart, &bedEnd, name);
+        if (fields < 3 || bedEnd <= bedStart) {
+            fprintf(stderr, "Error, unable to parse bed line %" PRIu64 " of %s: %s\n", lineno, filename, line);
+            exit(EXIT_FAILURE);
+        }
+        if (n == max) {
+            max *= 2;
+            regions = (mafRegion_t*) realloc(regions, sizeof(*regions) * max);
+            if (regions == NULL) {
+                fprintf(stderr, "Error, realloc failed in readRegionSet()\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        regions[n].seq = de_strdup(seq);
+        regions[n].start = bedStart;
+        regions[n].stop = bedEnd - 1;
+        if (fields == 4) {
+            regions[n].name = de_strdup(name);
+        } else {
+            char tmp[kMaxStringLength];
+            snprintf(tmp, kMaxStringLength, "%s_%" PRIu64 "_%" PRIu64, seq, bedStart, bedEnd);
+            regions[n].name = de_strdup(tmp);
+        }
+        ++n;
+    }
+    free(line);
+    fclose(ifp);
+    mafRegionSet_t *rs = newRegionSet(regions, n);
+    free(regions);
+    return rs;
+}
+mafRegionSet_t* newRegionSet(mafRegion_t *regions, uint64_t n) {
+    // build a region set out of an array of n regions. The seq and name fields of the
+    // regions are taken over by the set, the array itself is not.
+    mafRegionSet_t *rs = (mafRegionSet_t*) de_malloc(sizeof(*rs));
+    rs->numRegions = n;
+    rs->regions = (mafRegion_t*) de_malloc(sizeof(*(rs->regions)) * (n + 1));
+    if (n > 0) {
+        memcpy(rs->regions, regions, sizeof(*regions) * n);
+        qsort(rs->regions, n, sizeof(*(rs->regions)), cmpRegion);
+    }
+    rs->maxStop = (uint64_t*) de_malloc(sizeof(uint64_t) * (n + 1));
+    rs->seqs = (char**) de_malloc(sizeof(char*) * (n + 1));
+    rs->seqFirst = (uint64_t*) de_malloc(sizeof(uint64_t) * (n + 1));
+    rs->numSeqs = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        rs->regions[i].ofp = NULL;
+        rs->regions[i].created = false;
+        rs->regions[i].lruPrev = NULL;
+        rs->regions[i].lruNext = NULL;
+        if (i == 0 || strcmp(rs->regions[i].seq, rs->regions[i - 1].seq) != 0) {
+            rs->seqs[rs->numSeqs] = rs->regions[i].seq;
+            rs->seqFirst[rs->numSeqs++] = i;
+            rs->maxStop[i] = rs->regions[i].stop;
+        } else {
+            rs->maxStop[i] = (rs->maxStop[i - 1] < rs->regions[i].stop) ? rs->regions[i].stop : rs->maxStop[i - 1];
+        }
+    }
+    rs->seqFirst[rs->numSeqs] = n;
+    rs->hits = (uint64_t*) de_malloc(sizeof(uint64_t) * (n + 1));
+    rs->numHits = 0;
+    rs->isHit = (bool*) de_malloc(sizeof(bool) * (n + 1));
+    memset(rs->isHit, 0, sizeof(bool) * (n + 1));
+    rs->prefix = NULL;
+    rs->lruHead = NULL;
+    rs->lruTail = NULL;
+    rs->numOpen = 0;
+    return rs;
+}
+void destroyRegionSet(mafRegionSet_t *rs) {
+    if (rs == NULL) {
+        return;
+    }
+    regionSet_closeFiles(rs);
+    for (uint64_t i = 0; i < rs->numRegions; ++i) {
+        free(rs->regions[i].seq);
+        free(rs->regions[i].name);
+    }
+    free(rs->regions);
+    free(rs->maxStop);
+    free(rs->seqs);
+    free(rs->seqFirst);
+    free(rs->hits);
+    free(rs->isHit);
+    free(rs->prefix);
+    free(rs);
+}
+void regionSet_setPrefix(mafRegionSet_t *rs, const char *prefix) {
+    // write each region to its own file, <prefix><name>.maf. Region names must be unique.
+    char **names = (char**) de_malloc(sizeof(char*) * (rs->numRegions + 1));
+    for (uint64_t i = 0; i < rs->numRegions; ++i) {
+        names[i] = rs->regions[i].name;
+    }
+    qsort(names, rs->numRegions, sizeof(char*), cmpString);
+    for (uint64_t i = 1; i < rs->numRegions; ++i) {
+        if (strcmp(names[i], names[i - 1]) == 0) {
+            fprintf(stderr, "Error, region name `%s' appears more than once, region names must be "
+                    "unique when writing one file per region.\n", names[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(names);
+    rs->prefix = de_strdup(prefix);
+}
+void regionSet_collectOverlaps(mafRegionSet_t *rs, const char *seq, uint64_t absStart, uint64_t absEnd) {
+    // add every region on seq that overlaps [absStart, absEnd] to the hit list
+    char **found = (char**) bsearch(&seq, rs->seqs, rs->numSeqs, sizeof(char*), cmpString);
+    if (found == NULL) {
+        return;
+    }
+    uint64_t j = found - rs->seqs;
+    uint64_t lo = rs->seqFirst[j], hi = rs->seqFirst[j + 1];
+    // first region that starts after absEnd
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (rs->regions[mid].start <= absEnd) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    // walk left until no earlier region can reach absStart
+    for (uint64_t i = lo; i > rs->seqFirst[j] && rs->maxStop[i - 1] >= absStart; --i) {
+        if (rs->regions[i - 1].stop >= absStart && !rs->isHit[i - 1]) {
+            rs->isHit[i - 1] = true;
+            rs->hits[rs->numHits++] = i - 1;
+        }
+    }
+}
+void regionSet_clearHits(mafRegionSet_t *rs) {
+    for (uint64_t i = 0; i < rs->numHits; ++i) {
+        rs->isHit[rs->hits[i]] = false;
+    }
+    rs->numHits = 0;
+}
+static void regionSet_lruRemove(mafRegionSet_t *rs, mafRegion_t *r) {
+    if (r->lruPrev != NULL) {
+        r->lruPrev->lruNext = r->lruNext;
+    } else {
+        rs->lruHead = r->lruNext;
+    }
+    if (r->lruNext != NULL) {
+        r->lruNext->lruPrev = r->lruPrev;
+    } else {
+        rs->lruTail = r->lruPrev;
+    }
+    r->lruPrev = NULL;
+    r->lruNext = NULL;
+}
+static void regionSet_lruPushFront(mafRegionSet_t *rs, mafRegion_t *r) {
+    r->lruPrev = NULL;
+    r->lruNext = rs->lruHead;
+    if (rs->lruHead != NULL) {
+        rs->lruHead->lruPrev = r;
+    }
+    rs->lruHead = r;
+    if (rs->lruTail == NULL) {
+        rs->lruTail = r;
+    }
+}
+FILE* regionSet_getFile(mafRegionSet_t *rs, uint64_t i) {
+    // return the open output file for region i. Only a limited number of files are held
+    // open at once, when that limit is reached the least recently used one is closed, to
+    // be reopened for append.
+    mafRegion_t *r = &(rs->regions[i]);
+    if (r->ofp != NULL) {
+        if (rs->lruHead != r) {
+            regionSet_lruRemove(rs, r);
+            regionSet_lruPushFront(rs, r);
+        }
+        return r->ofp;
+    }
+    if (rs->numOpen >= kMaxOpenRegionFiles) {
+        mafRegion_t *victim = rs->lruTail;
+        regionSet_lruRemove(rs, victim);
+        fclose(victim->ofp);
+        victim->ofp = NULL;
+        --(rs->numOpen);
+    }
+    char *path = (char*) de_malloc(strlen(rs->prefix) + strlen(r->name) + 5);
+    sprintf(path, "%s%s.maf", rs->prefix, r->name);
+    r->ofp = de_fopen(path, r->created ? "a" : "w");
+    free(path);
+    if (!r->created) {
+        fprintf(r->ofp, "##maf version=1\n\n");
+        r->created = true;
+    }
+    ++(rs->numOpen);
+    regionSet_lruPushFront(rs, r);
+    return r->ofp;
+}
+void regionSet_closeFiles(mafRegionSet_t *rs) {
+    while (rs->lruHead != NULL) {
+        mafRegion_t *r = rs->lruHead;
+        regionSet_lruRemove(rs, r);
+        fclose(r->ofp);
+        r->ofp = NULL;
+    }
+    rs->numOpen = 0;
+}
+void checkBlockRegions(mafBlock_t *b, uint64_t blockNumber, mafRegionSet_t *rs,
+                       bool *printedHeader, bool isSoft) {
+    // find every region that overlaps a sequence in the block and report the block
+    // (or the spliced out part of it) once for each of them.
+    mafLine_t *ml = maf_mafBlock_getHeadLine(b);
+    while (ml != NULL) {
+        if (maf_mafLine_getType(ml) == 's' && maf_mafLine_getLength(ml) > 0) {
+            uint64_t absStart, absEnd;
+            if (maf_mafLine_getStrand(ml) == '-') {
+                absStart = maf_mafLine_getSourceLength(ml) - (maf_mafLine_getStart(ml) + maf_mafLine_getLength(ml));
+                absEnd = maf_mafLine_getSourceLength(ml) - 1 - maf_mafLine_getStart(ml);
+            } else {
+                absStart = maf_mafLine_getStart(ml);
+                absEnd = maf_mafLine_getStart(ml) + maf_mafLine_getLength(ml) - 1;
+            }
+            regionSet_collectOverlaps(rs, maf_mafLine_getSpecies(ml), absStart, absEnd);
+        }
+        ml = maf_mafLine_getNext(ml);
+    }
+    if (rs->numHits == 0) {
+        return;
+    }
+    qsort(rs->hits, rs->numHits, sizeof(uint64_t), cmpUint64);
+    char *tag = NULL;
+    for (uint64_t k = 0; k < rs->numHits; ++k) {
+        mafRegion_t *r = &(rs->regions[rs->hits[k]]);
+        FILE *ofp = stdout;
+        if (rs->prefix != NULL) {
+            ofp = regionSet_getFile(rs, rs->hits[k]);
+        } else {
+            if (!*printedHeader) {
+                printHeader();
+                *printedHeader = true;
+            }
+            tag = (char*) de_malloc(strlen(r->name) + 9);
+            sprintf(tag, " region=%s", r->name);
+        }
+        if (isSoft) {
+            printBlockWithTag(b, false, tag, ofp);
+        } else {
+            mafBlock_t *dummy = NULL;
+            dummy = processBlockForSpliceToFile(b, blockNumber, r->seq, r->start, r->stop, false, tag, ofp);
+            assert(dummy == NULL);
+        }
+        free(tag);
+        tag = NULL;
+    }
+    regionSet_clearHits(rs);
+}
+static void finishRegions(mafRegionSet_t *rs, bool printedHeader) {
+    if (rs->prefix != NULL) {
+        // make sure every region gets a (possibly empty) valid maf
+        regionSet_closeFiles(rs);
+        for (uint64_t i = 0; i < rs->numRegions; ++i) {
+            if (!rs->regions[i].created) {
+                regionSet_getFile(rs, i);
+            }
+        }
+        regionSet_closeFiles(rs);
+    } else if (!printedHeader) {
+        printHeader();
+    }
+}
+void processBodyRegions(mafFileApi_t *mfa, mafRegionSet_t *rs, bool isSoft) {
+    // extract every region in rs in a single pass over the maf
+    mafBlock_t *thisBlock = NULL;
+    bool printedHeader = false;
+    uint64_t blockNumber = 0;
+    while ((thisBlock = maf_readBlock(mfa)) != NULL) {
+        checkBlockRegions(thisBlock, blockNumber, rs, &printedHeader, isSoft);
+        maf_destroyMafBlockList(thisBlock);
+        ++blockNumber;
+    }
+    finishRegions(rs, printedHeader);
+}
+void processBodyIndexed(mafFileApi_t *mfa, mafIndex_t *mi, char *seq, uint64_t start,
+                        uint64_t stop, bool isSoft) {
+    // as processBody() but only read the blocks the index says overlap the region.
+    // Block numbers are the same as processBody() uses, the header being block 0.
+    uint64_t *blocks = NULL, numBlocks = 0, maxBlocks = 0;
+    bool printedHeader = false;
+    maf_index_queryBlocks(mi, seq, start, stop, &blocks, &numBlocks, &maxBlocks);
+    numBlocks = maf_index_uniqueBlocks(blocks, numBlocks);
+    for (uint64_t i = 0; i < numBlocks; ++i) {
+        mafBlock_t *thisBlock = maf_index_readBlock(mi, mfa, blocks[i]);
+        checkBlock(thisBlock, blocks[i] + 1, seq, start, stop, &printedHeader, isSoft);
+        maf_destroyMafBlockList(thisBlock);
+    }
+    free(blocks);
+    if (!printedHeader) {
+        printHeader();
+    }
+}
+void processBodyRegionsIndexed(mafFileApi_t *mfa, mafIndex_t *mi, mafRegionSet_t *rs, bool isSoft) {
+    // as processBodyRegions() but only read the blocks that overlap at least one region
+    uint64_t *blocks = NULL, numBlocks = 0, maxBlocks = 0;
+    bool printedHeader = false;
+    for (uint64_t i = 0; i < rs->numRegions; ++i) {
+        maf_index_queryBlocks(mi, rs->regions[i].seq, rs->regions[i].start, rs->regions[i].stop,
+                              &blocks, &numBlocks, &maxBlocks);
+    }
+    numBlocks = maf_index_uniqueBlocks(blocks, numBlocks);
+    for (uint64_t i = 0; i < numBlocks; ++i) {
+        mafBlock_t *thisBlock = maf_index_readBlock(mi, mfa, blocks[i]);
+        checkBlockRegions(thisBlock, blocks[i] + 1, rs, &printedHeader, isSoft);
+        maf_destroyMafBlockList(thisBlock);
+    }
+    free(blocks);
+    finishRegions(rs, printedHeader);
+}
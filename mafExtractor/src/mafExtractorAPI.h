@@ -28,25 +28,83 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include <stdio.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "mafIndex.h"
+
+typedef struct mafColumnRun {
+    // a maximal run of adjacent alignment columns, inclusive
+    uint64_t l;
+    uint64_t r;
+} mafColumnRun_t;
+typedef struct mafRowCursor {
+    // how far along one sequence line of a block a walk has got
+    uint64_t column; // the next column to count
+    uint64_t count; // number of non-gap characters left of column
+} mafRowCursor_t;
+typedef struct mafRegion {
+    // a single target region, as read from a bed file
+    char *seq;
+    uint64_t start; // inclusive, 0 based
+    uint64_t stop; // inclusive, 0 based
+    char *name; // bed name field, or seq_start_end if the bed has no name column
+    FILE *ofp; // per-region output file, NULL when closed
+    bool created; // whether the per-region output file has been written to yet
+    struct mafRegion *lruPrev; // neighbours on the lru list, while ofp is open
+    struct mafRegion *lruNext;
+} mafRegion_t;
+typedef struct mafRegionSet {
+    // a set of regions sorted by sequence name and then start position so that all
+    // of the regions overlapping a maf line can be found with a pair of binary searches.
+    mafRegion_t *regions;
+    uint64_t numRegions;
+    uint64_t *maxStop; // maxStop[i] is the largest stop of regions[seqFirst[j] .. i], i in seq j
+    char **seqs; // distinct sequence names, sorted
+    uint64_t *seqFirst; // regions of seqs[j] are regions[seqFirst[j] .. seqFirst[j + 1] - 1]
+    uint64_t numSeqs;
+    uint64_t *hits; // indices of the regions overlapping the current block
+    uint64_t numHits;
+    bool *isHit;
+    char *prefix; // if not NULL each region is written to <prefix><name>.maf
+    mafRegion_t *lruHead; // most recently used region with an open output file
+    mafRegion_t *lruTail; // least recently used region with an open output file
+    unsigned numOpen;
+} mafRegionSet_t;
+
+extern const unsigned kMaxOpenRegionFiles;
 
 bool checkRegion(uint64_t targetStart, uint64_t targetStop, uint64_t lineStart,
                  uint64_t length, uint64_t sourceLength, char strand);
 bool searchMatched(mafLine_t *ml, const char *seq, uint64_t start, uint64_t stop);
 void printHeader(void);
-uint64_t getTargetColumns(bool **targetColumns, uint64_t *n, mafBlock_t *b, const char *seq,
-                          uint64_t start, uint64_t stop);
-void printTargetColumns(bool *targetColumns, uint64_t n);
-int64_t **createOffsets(uint64_t n);
-void destroyOffsets(int64_t **offs, uint64_t n);
+uint64_t getTargetRuns(mafColumnRun_t **runs, uint64_t *numRuns, mafBlock_t *b, const char *seq,
+                       uint64_t start, uint64_t stop);
+mafRowCursor_t *newRowCursors(mafBlock_t *b);
+void advanceRowCursors(mafBlock_t *b, mafRowCursor_t *cursors, uint64_t l, uint64_t r, uint64_t *offsets);
 mafBlock_t *processBlockForSplice(mafBlock_t *b, uint64_t blockNumber, const char *seq,
                                   uint64_t start, uint64_t stop, bool store);
-mafBlock_t *spliceBlock(mafBlock_t *mb, uint64_t l, uint64_t r, int64_t **offsetArray);
+mafBlock_t *processBlockForSpliceToFile(mafBlock_t *b, uint64_t blockNumber, const char *seq,
+                                        uint64_t start, uint64_t stop, bool store,
+                                        const char *tag, FILE *ofp);
+void printBlockWithTag(mafBlock_t *mb, bool owned, const char *tag, FILE *ofp);
+mafBlock_t *spliceBlock(mafBlock_t *mb, uint64_t l, uint64_t r, const uint64_t *offsets);
 void checkBlock(mafBlock_t *b, uint64_t blockNumber, const char *seq, uint64_t start,
                 uint64_t stop, bool *printedHeader, bool isSoft);
 void processBody(mafFileApi_t *mfa, char *seq, uint64_t start, uint64_t stop, bool isSoft);
-uint64_t sumBool(bool *array, uint64_t n);
-void printOffsetArray(int64_t **offsetArray, uint64_t n);
+mafRegionSet_t* readRegionSet(const char *filename);
+mafRegionSet_t* newRegionSet(mafRegion_t *regions, uint64_t n);
+void destroyRegionSet(mafRegionSet_t *rs);
+void regionSet_setPrefix(mafRegionSet_t *rs, const char *prefix);
+void regionSet_collectOverlaps(mafRegionSet_t *rs, const char *seq, uint64_t absStart, uint64_t absEnd);
+void regionSet_clearHits(mafRegionSet_t *rs);
+FILE* regionSet_getFile(mafRegionSet_t *rs, uint64_t i);
+void regionSet_closeFiles(mafRegionSet_t *rs);
+void checkBlockRegions(mafBlock_t *b, uint64_t blockNumber, mafRegionSet_t *rs,
+                       bool *printedHeader, bool isSoft);
+void processBodyRegions(mafFileApi_t *mfa, mafRegionSet_t *rs, bool isSoft);
+void processBodyIndexed(mafFileApi_t *mfa, mafIndex_t *mi, char *seq, uint64_t start,
+                        uint64_t stop, bool isSoft);
+void processBodyRegionsIndexed(mafFileApi_t *mfa, mafIndex_t *mi, mafRegionSet_t *rs, bool isSoft);
 
 #endif // _BLOCK_EXTRACTOR_API_H_
@@ -237,14 +237,31 @@ static bool mafBlockListsAreEqual(mafBlock_t *head1, mafBlock_t *head2) {
 }
 static void targetColumnTest(CuTest *testCase, const char *mafString, uint64_t start,
                              uint64_t stop, uint64_t expectedLen, bool expected[]) {
+    // the runs are expanded back out to one bool per column to compare with expected
     mafBlock_t *ib = maf_newMafBlockFromString(mafString, 3);
-    bool *targetColumns = NULL;
-    uint64_t len = 0;
-    getTargetColumns(&targetColumns, &len, ib, "theTarget.chr0", start, stop);
+    mafColumnRun_t *runs = NULL;
+    uint64_t numRuns = 0, n = 0;
+    uint64_t sum = getTargetRuns(&runs, &numRuns, ib, "theTarget.chr0", start, stop);
+    uint64_t len = maf_mafBlock_getSequenceFieldLength(ib);
     CuAssertTrue(testCase, len == expectedLen);
+    bool *targetColumns = (bool*) de_malloc(sizeof(bool) * len);
+    memset(targetColumns, false, sizeof(bool) * len);
+    for (uint64_t k = 0; k < numRuns; ++k) {
+        // runs are in order, maximal and inside the block
+        CuAssertTrue(testCase, runs[k].l <= runs[k].r && runs[k].r < len);
+        if (k > 0) {
+            CuAssertTrue(testCase, runs[k - 1].r + 1 < runs[k].l);
+        }
+        for (uint64_t i = runs[k].l; i <= runs[k].r; ++i) {
+            targetColumns[i] = true;
+            ++n;
+        }
+    }
+    CuAssertTrue(testCase, sum == n);
     CuAssertTrue(testCase, boolArraysAreEqual(targetColumns, expected, len));
     maf_destroyMafBlockList(ib);
     free(targetColumns);
+    free(runs);
 }
 static void test_getTargetColumn_0(CuTest *testCase) {
     // test 0
@@ -299,13 +316,18 @@ static void test_getTargetColumn_0(CuTest *testCase) {
                      158545507, 158545517, 13, test5);
 }
 static void spliceTest(CuTest *testCase, const char *input, const char *expected, uint64_t l,
-                       uint64_t r, int64_t **offs) {
+                       uint64_t r, const uint64_t *expectedOffsets) {
+    // if expectedOffsets is not NULL it holds the pair of non-gap counts (left of l,
+    // up to and including r) expected for each sequence line
     mafBlock_t *ib = maf_newMafBlockFromString(input, 3);
     mafBlock_t *eb = maf_newMafBlockFromString(expected, 3);
-    bool cleanOffs = false;
-    if (offs == NULL) {
-        cleanOffs = true;
-        offs = createOffsets(maf_mafBlock_getNumberOfSequences(ib));
+    mafRowCursor_t *cursors = newRowCursors(ib);
+    uint64_t *offs = (uint64_t*) de_malloc(sizeof(uint64_t) * 2 * maf_mafBlock_getNumberOfSequences(ib));
+    advanceRowCursors(ib, cursors, l, r, offs);
+    if (expectedOffsets != NULL) {
+        for (uint64_t i = 0; i < 2 * maf_mafBlock_getNumberOfSequences(ib); ++i) {
+            CuAssertTrue(testCase, offs[i] == expectedOffsets[i]);
+        }
     }
     mafBlock_t *ob = spliceBlock(ib, l, r, offs);
     CuAssertTrue(testCase, mafBlocksAreEqual(eb, ob));
@@ -313,24 +335,18 @@ static void spliceTest(CuTest *testCase, const char *input, const char *expected
         CuAssertTrue(testCase, ib == ob);
     }
     // clean up
-    if (cleanOffs) {
-        destroyOffsets(offs, maf_mafBlock_getNumberOfSequences(ib));
-    }
+    free(cursors);
+    free(offs);
     if (ib != ob)
         maf_destroyMafBlockList(ob);
     maf_destroyMafBlockList(ib);
     maf_destroyMafBlockList(eb);
 }
 static void test_splice_0(CuTest *testCase) {
-    int64_t **offs = NULL;
     // int testcount = 0;
     // test 0
     // printf("test %d\n", testcount++);
-    offs = createOffsets(3);
-    /* for (uint64_t i = 0; i < 3; ++i) { */
-    /*     printf("offs[%"PRIu64"][0] = %"PRIu64"\n", i, offs[i][0]); */
-    /*     printf("offs[%"PRIu64"][1] = %"PRIu64"\n", i, offs[i][1]); */
-    /* } */
+    uint64_t offs0[] = {2, 13, 2, 10, 2, 10};
     spliceTest(testCase,
                "a score=0\n"
                "s theTarget.chr0 0 13 + 158545518 gcagctgaaaaca\n"
@@ -340,19 +356,7 @@ static void test_splice_0(CuTest *testCase) {
                "s theTarget.chr0 2 11 + 158545518 agctgaaaaca\n"
                "s name.chr1      2  8 +       100 GT---ATGCCG\n"
                "s name2.chr1     2  8 +       100 GT---ATGCCG\n",
-               2, 12, offs);
-    /* printf("##########\n"); */
-    /* for (uint64_t i = 0; i < 3; ++i) { */
-    /*     printf("offs[%"PRIu64"][0] = %"PRIu64"\n", i, offs[i][0]); */
-    /*     printf("offs[%"PRIu64"][1] = %"PRIu64"\n", i, offs[i][1]); */
-    /* } */
-    CuAssertTrue(testCase, offs[0][0] == 12); // seq field coord
-    CuAssertTrue(testCase, offs[0][1] == 12); // non-gap offset
-    for (uint64_t i = 1; i < 3; ++i) {
-        CuAssertTrue(testCase, offs[i][0] == 12);
-        CuAssertTrue(testCase, offs[i][1] == 9);
-    }
-    destroyOffsets(offs, 3);
+               2, 12, offs0);
     // test 1
     // printf("test %d\n", testcount++);
     spliceTest(testCase,
@@ -426,7 +430,7 @@ static void test_splice_0(CuTest *testCase) {
                0, 3, NULL);
     // test 7
     // printf("test %d\n", testcount++);
-    offs = createOffsets(3);
+    uint64_t offs7[] = {4, 13, 4, 15, 4, 15};
     spliceTest(testCase,
                "a score=0\n"
                "s theTarget.chr0 0 13 + 158545518 gcag--ctgaaaaca\n"
@@ -436,14 +440,7 @@ static void test_splice_0(CuTest *testCase) {
                "s theTarget.chr0 4  9 + 158545518 --ctgaaaaca\n"
                "s name.chr1      4 11 +       100 ATATTATGCCG\n"
                "s name2.chr1     4 11 +       100 ATATAATGCCG\n",
-               4, 14, offs);
-    CuAssertTrue(testCase, offs[0][0] == 14); // seq field coord
-    CuAssertTrue(testCase, offs[0][1] == 12); // non-gap offset
-    for (uint64_t i = 1; i < 3; ++i) {
-        CuAssertTrue(testCase, offs[i][0] == 14);
-        CuAssertTrue(testCase, offs[i][1] == 14);
-    }
-    destroyOffsets(offs, 3);
+               4, 14, offs7);
     // test 8
     // printf("test %d\n", testcount++);
     spliceTest(testCase,
@@ -458,7 +455,8 @@ static void test_splice_0(CuTest *testCase) {
                5, 10, NULL);
     // test 9
     // printf("test %d\n", testcount++);
-    offs = createOffsets(3);
+    // the whole block is passed back directly rather than spliced
+    uint64_t offs9[] = {0, 13, 0, 13, 0, 13};
     spliceTest(testCase,
                "a score=0\n"
                "s theTarget.chr0 0 13 + 158545518 gcagctgaaaaca\n"
@@ -468,16 +466,7 @@ static void test_splice_0(CuTest *testCase) {
                "s theTarget.chr0 0 13 + 158545518 gcagctgaaaaca\n"
                "s name.chr1      0 13 +       100 ATGTATTATGCCG\n"
                "s name2.chr1     0 13 +       100 ATGTATAATGCCG\n",
-               0, 12, offs);
-    for (uint64_t i = 0; i < 3; ++i) {
-        // SPECIAL CASE!
-        // since the block is passed back directly, since no splice is performed,
-        // there is no update made to the offset array. This makes sense because
-        // the array will not be used again.
-        CuAssertTrue(testCase, offs[i][0] == 0);
-        CuAssertTrue(testCase, offs[i][1] == -1);
-    }
-    destroyOffsets(offs, 3);
+               0, 12, offs9);
 
 }
 struct blockRecord {
@@ -558,6 +547,63 @@ static void processSpliceTest(CuTest *testCase, const char *seq, uint64_t start,
     }
     maf_destroyMafBlockList(eb);
 }
+static void test_processSplice_1(CuTest *testCase) {
+    // a block whose target alternates base and gap splices into one sub-block per target base.
+    // each row's start and length in every sub-block must match a count made from scratch.
+    const uint64_t numRuns = 5000, len = 2 * numRuns;
+    const char *names[] = {"theTarget.chr0", "name.chr1", "name2.chr1", "name3.chr1"};
+    char *rows[4];
+    uint64_t rowLengths[4] = {0, 0, 0, 0};
+    for (int j = 0; j < 4; ++j) {
+        rows[j] = (char*) de_malloc(len + 1);
+        for (uint64_t i = 0; i < len; ++i) {
+            if (j == 0) {
+                rows[j][i] = (i % 2) ? '-' : 'A';
+            } else {
+                rows[j][i] = (i % (j + 2) == 0) ? '-' : 'C';
+            }
+            rowLengths[j] += (rows[j][i] != '-');
+        }
+        rows[j][len] = '\0';
+    }
+    char *input = (char*) de_malloc(4 * (len + 100) + 100);
+    char *p = input + sprintf(input, "a score=0\n");
+    for (int j = 0; j < 4; ++j) {
+        p += sprintf(p, "s %s 0 %" PRIu64 " + 1000000 %s\n", names[j], rowLengths[j], rows[j]);
+    }
+    mafBlock_t *ib = maf_newMafBlockFromString(input, 3);
+    mafBlock_t *obhead = processBlockForSplice(ib, 0, names[0], 0, 1000000, true);
+    uint64_t k = 0;
+    for (mafBlock_t *ob = obhead; ob != NULL; ob = maf_mafBlock_getNext(ob), ++k) {
+        uint64_t column = 2 * k;
+        mafLine_t *ml = maf_mafLine_getNext(maf_mafBlock_getHeadLine(ob));
+        uint64_t numSequences = 0;
+        for (int j = 0; j < 4; ++j) {
+            if (rows[j][column] == '-') {
+                continue; // all gap rows are dropped
+            }
+            ++numSequences;
+            uint64_t before = 0;
+            for (uint64_t i = 0; i < column; ++i) {
+                before += (rows[j][i] != '-');
+            }
+            CuAssertTrue(testCase, ml != NULL);
+            CuAssertStrEquals(testCase, names[j], maf_mafLine_getSpecies(ml));
+            CuAssertTrue(testCase, maf_mafLine_getStart(ml) == before);
+            CuAssertTrue(testCase, maf_mafLine_getLength(ml) == 1);
+            ml = maf_mafLine_getNext(ml);
+        }
+        CuAssertTrue(testCase, maf_mafBlock_getNumberOfSequences(ob) == numSequences);
+    }
+    CuAssertTrue(testCase, k == numRuns);
+    // clean up
+    maf_destroyMafBlockList(obhead);
+    maf_destroyMafBlockList(ib);
+    free(input);
+    for (int j = 0; j < 4; ++j) {
+        free(rows[j]);
+    }
+}
 static void test_processSplice_0(CuTest *testCase) {
     // int testcount = 0;
     // test 0
@@ -989,14 +1035,101 @@ static void test_processSplice_0(CuTest *testCase) {
                       );
 
 }
+static void test_regionSet_0(CuTest *testCase) {
+    // overlap queries must find every region that overlaps a span, and only those
+    uint64_t n = 6;
+    mafRegion_t *regions = (mafRegion_t*) de_malloc(sizeof(*regions) * n);
+    const char *seqs[] = {"hg19.chr1", "hg19.chr1", "hg19.chr1", "hg19.chr2", "mm9.chr1", "hg19.chr1"};
+    uint64_t starts[] = {100, 10, 50, 10, 0, 40};
+    uint64_t stops[] = {200, 500, 60, 20, 1000, 45};
+    for (uint64_t i = 0; i < n; ++i) {
+        regions[i].seq = de_strdup(seqs[i]);
+        regions[i].start = starts[i];
+        regions[i].stop = stops[i];
+        regions[i].name = de_strdup("r");
+    }
+    mafRegionSet_t *rs = newRegionSet(regions, n);
+    free(regions);
+    CuAssertTrue(testCase, rs->numSeqs == 3);
+    // sorted: hg19.chr1 [10,500] [40,45] [50,60] [100,200], hg19.chr2 [10,20], mm9.chr1 [0,1000]
+    regionSet_collectOverlaps(rs, "hg19.chr1", 46, 49);
+    CuAssertTrue(testCase, rs->numHits == 1);
+    CuAssertTrue(testCase, rs->regions[rs->hits[0]].start == 10);
+    regionSet_collectOverlaps(rs, "hg19.chr1", 46, 49); // already collected, not added twice
+    CuAssertTrue(testCase, rs->numHits == 1);
+    regionSet_clearHits(rs);
+    regionSet_collectOverlaps(rs, "hg19.chr1", 45, 100);
+    CuAssertTrue(testCase, rs->numHits == 4);
+    regionSet_clearHits(rs);
+    regionSet_collectOverlaps(rs, "hg19.chr1", 501, 600);
+    CuAssertTrue(testCase, rs->numHits == 0);
+    regionSet_collectOverlaps(rs, "hg19.chr1", 0, 9);
+    CuAssertTrue(testCase, rs->numHits == 0);
+    regionSet_collectOverlaps(rs, "hg19.chr3", 0, 1000);
+    CuAssertTrue(testCase, rs->numHits == 0);
+    regionSet_collectOverlaps(rs, "hg19.chr2", 20, 20);
+    regionSet_collectOverlaps(rs, "mm9.chr1", 1000, 2000);
+    CuAssertTrue(testCase, rs->numHits == 2);
+    regionSet_clearHits(rs);
+    destroyRegionSet(rs);
+}
+static void test_regionSet_1(CuTest *testCase) {
+    // with more regions than files that may be open, only the least recently used file is closed
+    uint64_t n = kMaxOpenRegionFiles + 2;
+    mafRegion_t *regions = (mafRegion_t*) de_malloc(sizeof(*regions) * n);
+    for (uint64_t i = 0; i < n; ++i) {
+        regions[i].seq = de_strdup("hg19.chr1");
+        regions[i].start = 10 * i;
+        regions[i].stop = 10 * i + 5;
+        regions[i].name = (char*) de_malloc(32);
+        sprintf(regions[i].name, "r%03" PRIu64, i);
+    }
+    mafRegionSet_t *rs = newRegionSet(regions, n);
+    free(regions);
+    regionSet_setPrefix(rs, "test/lru.");
+    for (uint64_t i = 0; i < kMaxOpenRegionFiles; ++i) {
+        CuAssertTrue(testCase, regionSet_getFile(rs, i) != NULL);
+    }
+    CuAssertTrue(testCase, rs->numOpen == kMaxOpenRegionFiles);
+    regionSet_getFile(rs, 0); // 0 is now the most recently used, 1 the least
+    regionSet_getFile(rs, kMaxOpenRegionFiles);
+    CuAssertTrue(testCase, rs->numOpen == kMaxOpenRegionFiles);
+    CuAssertTrue(testCase, rs->regions[0].ofp != NULL);
+    CuAssertTrue(testCase, rs->regions[1].ofp == NULL);
+    for (uint64_t i = 2; i <= kMaxOpenRegionFiles; ++i) {
+        CuAssertTrue(testCase, rs->regions[i].ofp != NULL);
+    }
+    regionSet_getFile(rs, kMaxOpenRegionFiles + 1);
+    CuAssertTrue(testCase, rs->regions[2].ofp == NULL);
+    CuAssertTrue(testCase, rs->regions[0].ofp != NULL);
+    // a reopened file is appended to rather than recreated
+    fprintf(regionSet_getFile(rs, 1), "x\n");
+    regionSet_closeFiles(rs);
+    CuAssertTrue(testCase, rs->numOpen == 0 && rs->lruHead == NULL && rs->lruTail == NULL);
+    FILE *ifp = de_fopen("test/lru.r001.maf", "r");
+    char line[32];
+    CuAssertTrue(testCase, fgets(line, sizeof(line), ifp) != NULL);
+    CuAssertStrEquals(testCase, "##maf version=1\n", line);
+    fclose(ifp);
+    for (uint64_t i = 0; i < n; ++i) {
+        char path[64];
+        sprintf(path, "test/lru.r%03" PRIu64 ".maf", i);
+        remove(path);
+    }
+    destroyRegionSet(rs);
+}
 CuSuite* extractor_TestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     (void) printBoolArray;
     (void) test_getTargetColumn_0;
     (void) test_splice_0;
     (void) test_processSplice_0;
+    (void) test_regionSet_0;
     SUITE_ADD_TEST(suite, test_getTargetColumn_0);
     SUITE_ADD_TEST(suite, test_splice_0);
     SUITE_ADD_TEST(suite, test_processSplice_0);
+    SUITE_ADD_TEST(suite, test_processSplice_1);
+    SUITE_ADD_TEST(suite, test_regionSet_0);
+    SUITE_ADD_TEST(suite, test_regionSet_1);
     return suite;
 }
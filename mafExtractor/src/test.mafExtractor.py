@@ -709,6 +709,207 @@ MafLine('simHuman.chrJ', 6786941, 60, '-', 88398963, '--------------------------
             self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
             mtt.removeDir(tmpDir)
 
+def writeRegionsBed(regions, tmpDir):
+    bed = os.path.abspath(os.path.join(tmpDir, 'regions.bed'))
+    f = open(bed, 'w')
+    f.write('track name=regions\n')
+    for r in regions:
+        if r[3] is None:
+            f.write('%s\t%d\t%d\n' % r[:3])
+        else:
+            f.write('%s\t%d\t%d\t%s\n' % r)
+    f.close()
+    return bed
+
+class RegionsTest(unittest.TestCase):
+    # bed lines, names are given to some regions and not others
+    regions = [(g_targetSeq, g_targetRange[0], g_targetRange[1] + 1, 'target'),
+               ('name2.chr1', 52, 56, 'name2'),
+               ('name', 3, 12, None),
+               ('panTro1.chr6', 28869787, 28869790, None),
+               ('notInTheMaf.chr1', 0, 100, 'absent'),
+               ]
+    def regionName(self, r):
+        if r[3] is None:
+            return '%s_%d_%d' % r[:3]
+        return r[3]
+    def writeRegions(self, tmpDir):
+        return writeRegionsBed(self.regions, tmpDir)
+    def testRegionFiles(self):
+        """ mafExtractor --regions --regionPrefix should write the same output for each region as a single --seq --start --stop run.
+        """
+        mtt.makeTempDirParent()
+        for soft in [[], ['--soft']]:
+            tmpDir = os.path.abspath(mtt.makeTempDir('regionFiles'))
+            blocks = g_overlappingBlocks + g_nonOverlappingBlocks
+            random.shuffle(blocks)
+            testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                   ''.join(blocks), g_headers)
+            bed = self.writeRegions(tmpDir)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmds = []
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafExtractor'))]
+            cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                    '--regions', bed, '--regionPrefix', os.path.join(tmpDir, 'region.')] + soft
+            cmds.append(cmd)
+            outpipes = [None]
+            for r in self.regions:
+                cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafExtractor'))]
+                cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                        '--seq', r[0], '--start', '%d' % r[1], '--stop', '%d' % (r[2] - 1)] + soft
+                cmds.append(cmd)
+                outpipes.append(os.path.abspath(os.path.join(tmpDir, 'single.%s.maf' % self.regionName(r))))
+            mtt.recordCommands(cmds, tmpDir, outPipes=outpipes)
+            mtt.runCommandsS(cmds, tmpDir, outPipes=outpipes)
+            for r in self.regions:
+                name = self.regionName(r)
+                observed = open(os.path.join(tmpDir, 'region.%s.maf' % name)).read()
+                expected = open(os.path.join(tmpDir, 'single.%s.maf' % name)).read()
+                if observed != expected:
+                    print '\n[%s]' % name
+                    print 'dang, observed:'
+                    print observed
+                    print '!= expected:'
+                    print expected
+                self.assertEqual(observed, expected)
+            mtt.removeDir(tmpDir)
+    def testRegionTags(self):
+        """ mafExtractor --regions should tag every reported block with the name of its region.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('regionTags'))
+        blocks = g_overlappingBlocks + g_nonOverlappingBlocks
+        random.shuffle(blocks)
+        testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                               ''.join(blocks), g_headers)
+        bed = self.writeRegions(tmpDir)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafExtractor'))]
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--regions', bed, '--soft']
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'extracted.maf'))]
+        mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+        counts = {}
+        for line in open(os.path.join(tmpDir, 'extracted.maf')):
+            if line.startswith('a'):
+                self.assertTrue(' region=' in line)
+                name = line.split(' region=')[1].strip()
+                counts[name] = counts.get(name, 0) + 1
+        self.assertEqual(counts['target'], len(g_overlappingBlocks))
+        self.assertTrue('absent' not in counts)
+        mtt.removeDir(tmpDir)
+    def testMemory3(self):
+        """ If valgrind is installed on the system, check for memory related errors (3).
+        """
+        valgrind = mtt.which('valgrind')
+        if valgrind is None:
+            return
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('memory_3'))
+        blocks = g_overlappingBlocks + g_nonOverlappingBlocks
+        random.shuffle(blocks)
+        testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                               ''.join(blocks), g_headers)
+        bed = self.writeRegions(tmpDir)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        cmd = mtt.genericValgrind(tmpDir)
+        cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafExtractor')))
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--regions', bed]
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'extracted.maf'))]
+        mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+        self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
+        mtt.removeDir(tmpDir)
+
+class IndexTest(unittest.TestCase):
+    def runExtractions(self, tmpDir, mafName, soft, tag):
+        # run a --seq extraction and a --regions extraction on mafName, return the outputs
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        bed = writeRegionsBed(RegionsTest.regions, tmpDir)
+        cmds = []
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafExtractor'))]
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, mafName)), '--seq', g_targetSeq,
+                '--start', '%d' % g_targetRange[0], '--stop', '%d' % g_targetRange[1]] + soft
+        cmds.append(cmd)
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafExtractor'))]
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, mafName)), '--regions', bed] + soft
+        cmds.append(cmd)
+        outpipes = [os.path.abspath(os.path.join(tmpDir, '%s.seq.maf' % tag)),
+                    os.path.abspath(os.path.join(tmpDir, '%s.regions.maf' % tag))]
+        mtt.recordCommands(cmds, tmpDir, outPipes=outpipes)
+        mtt.runCommandsS(cmds, tmpDir, outPipes=outpipes)
+        return [open(f).read() for f in outpipes]
+    def buildIndex(self, tmpDir, mafName):
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafExtractor'))]
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, mafName)), '--buildIndex']
+        mtt.recordCommands([cmd], tmpDir)
+        mtt.runCommandsS([cmd], tmpDir)
+    def testIndexedExtraction(self):
+        """ mafExtractor should produce the same output whether or not the maf has an index.
+        """
+        mtt.makeTempDirParent()
+        for soft in [[], ['--soft']]:
+            tmpDir = os.path.abspath(mtt.makeTempDir('indexedExtraction'))
+            blocks = g_overlappingBlocks + g_nonOverlappingBlocks
+            random.shuffle(blocks)
+            for name in ['indexed.maf', 'plain.maf']:
+                mtt.testFile(os.path.abspath(os.path.join(tmpDir, name)), ''.join(blocks), g_headers)
+            self.buildIndex(tmpDir, 'indexed.maf')
+            self.assertTrue(os.path.exists(os.path.join(tmpDir, 'indexed.maf.mafidx')))
+            observed = self.runExtractions(tmpDir, 'indexed.maf', soft, 'indexed')
+            expected = self.runExtractions(tmpDir, 'plain.maf', soft, 'plain')
+            self.assertEqual(observed, expected)
+            if soft:
+                self.assertTrue(mafIsExtracted(os.path.join(tmpDir, 'indexed.seq.maf')))
+            mtt.removeDir(tmpDir)
+    def testStaleIndex(self):
+        """ mafExtractor should ignore an index that was built for an earlier version of the maf.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('staleIndex'))
+        blocks = g_overlappingBlocks + g_nonOverlappingBlocks
+        random.shuffle(blocks)
+        mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                     ''.join(g_nonOverlappingBlocks), g_headers)
+        self.buildIndex(tmpDir, 'test.maf')
+        for name in ['test.maf', 'plain.maf']:
+            mtt.testFile(os.path.abspath(os.path.join(tmpDir, name)), ''.join(blocks), g_headers)
+        observed = self.runExtractions(tmpDir, 'test.maf', ['--soft'], 'stale')
+        expected = self.runExtractions(tmpDir, 'plain.maf', ['--soft'], 'plain')
+        self.assertEqual(observed, expected)
+        self.assertTrue(mafIsExtracted(os.path.join(tmpDir, 'stale.seq.maf')))
+        mtt.removeDir(tmpDir)
+    def testMemory4(self):
+        """ If valgrind is installed on the system, check for memory related errors (4).
+        """
+        valgrind = mtt.which('valgrind')
+        if valgrind is None:
+            return
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('memory_4'))
+        blocks = g_overlappingBlocks + g_nonOverlappingBlocks
+        random.shuffle(blocks)
+        testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                               ''.join(blocks), g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        cmd = mtt.genericValgrind(tmpDir)
+        cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafExtractor')))
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')), '--buildIndex']
+        mtt.recordCommands([cmd], tmpDir)
+        mtt.runCommandsS([cmd], tmpDir)
+        self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
+        cmd = mtt.genericValgrind(tmpDir)
+        cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafExtractor')))
+        cmd += ['--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                '--seq', g_targetSeq, '--start', '%d' % g_targetRange[0],
+                '--stop', '%d' % g_targetRange[1]]
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'extracted.maf'))]
+        mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+        self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
+        mtt.removeDir(tmpDir)
+
 class CuTestMemory(unittest.TestCase):
     def test_CuTestMemory(self):
         """ If valgrind is installed on the system, check for memory related errors in CuTests.
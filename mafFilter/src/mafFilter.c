@@ -23,6 +23,7 @@
  * THE SOFTWARE.
  */
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h> // file existence via ENOENT
 #include <getopt.h>
 #include <inttypes.h>
@@ -36,23 +37,138 @@
 #include <unistd.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "blockPipeline.h"
+#include "nameMatcher.h"
 #include "buildVersion.h"
 
 const char *g_version = "version 0.1 September 2012";
+const unsigned kSplitBufferSize = 1 << 18;
+const size_t kMaxSplitKeyLength = 200;
+
+typedef enum filterField {
+    kFieldDegree, kFieldWidth, kFieldScore, kFieldLength, kFieldGapFraction, kFieldCount
+} filterField_t;
+typedef enum filterCmp {
+    kCmpLT, kCmpLE, kCmpGT, kCmpGE, kCmpEQ, kCmpNE
+} filterCmp_t;
+typedef enum filterOp {
+    kOpCompare, kOpAny, kOpAll, kOpOnly, kOpAnd, kOpOr, kOpNot
+} filterOp_t;
+typedef struct filterInstruction {
+    filterOp_t op;
+    filterField_t field; // kOpCompare only
+    filterCmp_t cmp; // kOpCompare only
+    double value; // kOpCompare only
+    unsigned set; // index into the program's species sets, kOpAny, kOpAll, kOpOnly, kFieldCount
+} filterInstruction_t;
+typedef struct filterProgram {
+    // a --expr expression compiled into postfix order. Evaluated once per block
+    // with a small boolean stack.
+    filterInstruction_t *code;
+    unsigned numCode;
+    unsigned maxCode;
+    mafNameMatcher_t **sets;
+    unsigned numSets;
+    unsigned maxSets;
+    unsigned maxDepth; // maximum stack depth needed to evaluate the program
+    bool needsGaps; // gap counting is only performed if gapFraction is used
+} filterProgram_t;
+typedef enum splitMode {
+    kSplitNone, kSplitChrom, kSplitDegree, kSplitSpecies, kSplitChunk
+} splitMode_t;
+typedef struct splitOptions {
+    splitMode_t mode;
+    char *prefix; // output path prefix, files are named prefix + key + .maf
+    char *reference; // --splitRef, the sequence used to route in chrom mode
+    char *degreeBins; // --splitDegreeBins, raw comma separated list
+    uint64_t chunkSize; // number of reported blocks per file in chunk mode
+    unsigned maxOpen; // maximum number of simultaneously open output files
+} splitOptions_t;
+typedef struct splitFile {
+    // a single output shard. Lives in the splitter hash table for the whole
+    // run and on the lru list whenever its file is open.
+    char *key;
+    char *path;
+    FILE *fp;
+    bool created; // true once the file has been created and given a header
+    struct splitFile *hashNext;
+    struct splitFile *lruPrev;
+    struct splitFile *lruNext;
+} splitFile_t;
+typedef struct splitter {
+    // routes reported blocks to one of many output files in a single pass
+    splitOptions_t *opts;
+    splitFile_t **table;
+    unsigned tableSize;
+    unsigned numFiles;
+    splitFile_t *lruHead; // most recently used open file
+    splitFile_t *lruTail; // least recently used open file
+    unsigned numOpen;
+    uint64_t *bins;
+    unsigned numBins;
+    mafBlock_t *header;
+    mafNameMatcher_t *names;
+    bool isInclude;
+    bool project;
+    uint64_t numBlocks; // number of blocks written so far
+} splitter_t;
+typedef struct filterWork {
+    // everything a worker thread needs to filter a block, see --threads
+    mafNameMatcher_t *names;
+    bool isInclude;
+    bool project;
+    int64_t excludeBlockDegreeGT;
+    int64_t excludeBlockDegreeLT;
+    filterProgram_t *prog;
+    splitter_t *sp;
+} filterWork_t;
+typedef struct filterParser {
+    const char *expr;
+    const char *p;
+    unsigned depth;
+    filterProgram_t *prog;
+} filterParser_t;
 
 void version(void);
 void usage(void);
-void parseOptions(int argc, char **argv, char *filename, char *nameList,
-                  bool *isInclude, int64_t *blockDegLT, int64_t *blockDegGT);
+void parseOptions(int argc, char **argv, char *filename, char **nameList,
+                  bool *isInclude, int64_t *blockDegLT, int64_t *blockDegGT,
+                  char **expr, splitOptions_t *so, unsigned *numThreads, bool *project);
 void checkRegion(unsigned lineno, char *fullname, uint64_t pos, uint64_t start,
                  uint64_t length, uint64_t sourceLength, char strand);
-bool nameOnList(char *name, char **namelist, unsigned n);
-void reportBlock(mafBlock_t *mb, char **names, unsigned n, bool isInclude);
-void checkBlock(mafBlock_t *mb, char **names, unsigned n, bool isInclude,
-                int64_t excludeBlockDegreeGT, int64_t excludeBlockDegreeLT);
-void filterInput(mafFileApi_t *mfa, char **names, unsigned n,
-                 bool isInclude, int64_t excludeBlockDegreeGT,
-                 int64_t excludeBlockDegreeLT);
+bool nameOnList(char *name, mafNameMatcher_t *names);
+filterProgram_t* compileFilterExpression(const char *expr);
+void destroyFilterProgram(filterProgram_t *prog);
+bool evaluateFilterProgram(filterProgram_t *prog, mafBlock_t *mb);
+void filterParser_fail(filterParser_t *fp, const char *msg);
+void filterParser_emit(filterParser_t *fp, filterInstruction_t instr, int depthChange);
+void filterParser_skipSpace(filterParser_t *fp);
+unsigned filterParser_parseSet(filterParser_t *fp);
+void filterParser_parseComparison(filterParser_t *fp, filterField_t field, unsigned set);
+void filterParser_parsePrimary(filterParser_t *fp);
+void filterParser_parseUnary(filterParser_t *fp);
+void filterParser_parseAnd(filterParser_t *fp);
+void filterParser_parseOr(filterParser_t *fp);
+bool rowIsReported(char *name, mafNameMatcher_t *names, bool isInclude);
+char* copyLineName(char *line);
+uint64_t compactColumns(char *s, uint64_t n, const uint8_t *keep);
+void reportProjectedBlock(mafBlock_t *mb, mafNameMatcher_t *names, bool isInclude, FILE *ofp);
+void reportBlock(mafBlock_t *mb, mafNameMatcher_t *names, bool isInclude, bool project, FILE *ofp);
+bool checkBlock(mafBlock_t *mb, mafNameMatcher_t *names, bool isInclude,
+                int64_t excludeBlockDegreeGT, int64_t excludeBlockDegreeLT,
+                filterProgram_t *prog);
+void parseDegreeBins(splitter_t *sp, const char *s);
+splitter_t* newSplitter(splitOptions_t *opts, mafNameMatcher_t *names, bool isInclude, bool project);
+void destroySplitter(splitter_t *sp);
+char* splitter_speciesKey(mafBlock_t *mb);
+char* splitter_key(splitter_t *sp, mafBlock_t *mb);
+FILE* splitter_getFile(splitter_t *sp, const char *key);
+void splitter_write(splitter_t *sp, mafBlock_t *mb);
+bool filterBlock(mafBlock_t *mb, FILE *ofp, void *arg);
+void emitSplitBlock(mafBlock_t *mb, const char *buf, size_t n, void *arg);
+void filterInput(mafFileApi_t *mfa, mafNameMatcher_t *names, bool isInclude, bool project,
+                 int64_t excludeBlockDegreeGT, int64_t excludeBlockDegreeLT,
+                 filterProgram_t *prog, splitter_t *sp, unsigned numThreads);
 unsigned countNames(char *s);
 char** extractNames(char *nameList, unsigned n);
 void destroyNameList(char **names, unsigned n);
@@ -72,7 +188,23 @@ void usage(void) {
             "command line. For example one can filter out all\n"
             "sequence lines that start with 'hg18' using --excludeSeq\n"
             "or filter for sequence lines starting with only 'hg19',\n"
-            "'mm9' and 'rn4' using --includeSeq.\n\n");
+            "'mm9' and 'rn4' using --includeSeq.\n\n"
+            "Several block criteria can be combined in a single pass\n"
+            "with --expr, e.g.\n"
+            "  --expr 'any(hg19,mm9) && degree >= 3 && gapFraction < 0.5'\n"
+            "Fields: degree, width, score, length (sum of the sequence\n"
+            "size fields), gapFraction and count(names) (the number of\n"
+            "sequence lines matching a name on the list). Comparisons:\n"
+            "< <= > >= == !=. Name predicates: any(names) (some line\n"
+            "matches), all(names) (every name is matched by some line),\n"
+            "only(names) (every line matches). Combine with &&, ||, !\n"
+            "and parentheses. Names are prefix matched as with\n"
+            "--includeSeq.\n\n"
+            "Instead of writing to stdout, reported blocks can be\n"
+            "partitioned into many files in a single pass with\n"
+            "--splitBy [chrom|degree|species|chunk] and --splitPrefix.\n\n"
+            "With --threads blocks are filtered on a pool of worker\n"
+            "threads, output order is unchanged.\n\n");
     fprintf(stderr, "Options: \n");
     usageMessage('h', "help", "show this help message and exit.");
     usageMessage('m', "maf", "path to maf file.");
@@ -80,14 +212,34 @@ void usage(void) {
     usageMessage('e', "excludeSeq", "comma separated list of sequence names to exclude.");
     usageMessage('g', "noDegreeGT", "filter out all blocks with degree greater than this value.");
     usageMessage('l', "noDegreeLT", "filter out all blocks with degree less than this value.");
+    usageMessage('x', "expr", "only report blocks for which this expression is true. "
+                 "May be combined with --includeSeq or --excludeSeq.");
+    usageMessage('p', "project", "after removing sequences with --includeSeq or --excludeSeq, also "
+                 "remove alignment columns that are gaps in every remaining sequence. Blocks "
+                 "left without columns are dropped.");
+    usageMessage('t', "threads", "number of worker threads used to filter blocks. default 1.");
+    usageMessage('\0', "splitBy", "write reported blocks to one file per shard instead of stdout. "
+                 "One of chrom (name of the reference sequence, see --splitRef), degree (block "
+                 "degree, see --splitDegreeBins), species (the set of species in the block) or chunk "
+                 "(consecutive runs of --splitChunkSize blocks).");
+    usageMessage('\0', "splitPrefix", "path prefix for split files, which are named [prefix][shard].maf. "
+                 "Required by --splitBy.");
+    usageMessage('\0', "splitRef", "in chrom mode, route on the first sequence whose name starts with "
+                 "this value. default is the first sequence of the block.");
+    usageMessage('\0', "splitDegreeBins", "in degree mode, comma separated list of increasing bucket "
+                 "lower bounds, e.g. 2,4,8. default is one file per degree.");
+    usageMessage('\0', "splitChunkSize", "in chunk mode, number of blocks per file. default 1000.");
+    usageMessage('\0', "splitMaxOpen", "maximum number of split files held open at once. default 64.");
     usageMessage('v', "verbose", "turns on verbose output.");
     exit(EXIT_FAILURE);
 }
-void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *isInclude, int64_t *blockDegGt, int64_t *blockDegLt) {
+void parseOptions(int argc, char **argv, char *filename, char **nameList, bool *isInclude, int64_t *blockDegGt, int64_t *blockDegLt,
+                  char **expr, splitOptions_t *so, unsigned *numThreads, bool *project) {
     extern int g_debug_flag;
     extern int g_verbose_flag;
     int c;
-    bool setMafName = false, setNames = false, setBlockLimits = false;
+    bool setMafName = false, setNames = false, setBlockLimits = false, setExpr = false;
+    int64_t value = 0;
     while (1) {
         static struct option longOptions[] = {
             {"debug", no_argument, &g_debug_flag, 1},
@@ -99,10 +251,19 @@ void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *i
             {"excludeSeq",  required_argument, 0, 'e'},
             {"noDegreeGT", required_argument, 0, 'g'},
             {"noDegreeLT", required_argument, 0, 'l'},
+            {"expr", required_argument, 0, 'x'},
+            {"threads", required_argument, 0, 't'},
+            {"project", no_argument, 0, 'p'},
+            {"splitBy", required_argument, 0, 0},
+            {"splitPrefix", required_argument, 0, 0},
+            {"splitRef", required_argument, 0, 0},
+            {"splitDegreeBins", required_argument, 0, 0},
+            {"splitChunkSize", required_argument, 0, 0},
+            {"splitMaxOpen", required_argument, 0, 0},
             {0, 0, 0, 0}
         };
         int longIndex = 0;
-        c = getopt_long(argc, argv, "m:i:e:g:l:v:h",
+        c = getopt_long(argc, argv, "m:i:e:g:l:x:t:pv:h",
                         longOptions, &longIndex);
         if (c == -1) {
             break;
@@ -112,6 +273,43 @@ void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *i
             if (strcmp("version", longOptions[longIndex].name) == 0) {
                 version();
                 exit(EXIT_SUCCESS);
+            } else if (strcmp("splitBy", longOptions[longIndex].name) == 0) {
+                if (strcmp(optarg, "chrom") == 0) {
+                    so->mode = kSplitChrom;
+                } else if (strcmp(optarg, "degree") == 0) {
+                    so->mode = kSplitDegree;
+                } else if (strcmp(optarg, "species") == 0) {
+                    so->mode = kSplitSpecies;
+                } else if (strcmp(optarg, "chunk") == 0) {
+                    so->mode = kSplitChunk;
+                } else {
+                    fprintf(stderr, "Error, --splitBy must be one of chrom, degree, species or chunk, not %s\n",
+                            optarg);
+                    usage();
+                }
+            } else if (strcmp("splitPrefix", longOptions[longIndex].name) == 0) {
+                free(so->prefix);
+                so->prefix = de_strdup(optarg);
+            } else if (strcmp("splitRef", longOptions[longIndex].name) == 0) {
+                free(so->reference);
+                so->reference = de_strdup(optarg);
+            } else if (strcmp("splitDegreeBins", longOptions[longIndex].name) == 0) {
+                free(so->degreeBins);
+                so->degreeBins = de_strdup(optarg);
+            } else if (strcmp("splitChunkSize", longOptions[longIndex].name) == 0) {
+                value = strtoll(optarg, NULL, 10);
+                if (value < 1) {
+                    fprintf(stderr, "Error, --splitChunkSize %" PRIi64 " must be positive.\n", value);
+                    usage();
+                }
+                so->chunkSize = value;
+            } else if (strcmp("splitMaxOpen", longOptions[longIndex].name) == 0) {
+                value = strtoll(optarg, NULL, 10);
+                if (value < 1) {
+                    fprintf(stderr, "Error, --splitMaxOpen %" PRIi64 " must be positive.\n", value);
+                    usage();
+                }
+                so->maxOpen = value;
             }
             break;
         case 'm':
@@ -121,12 +319,14 @@ void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *i
         case 'i':
             setNames = true;
             *isInclude = true;
-            sscanf(optarg, "%s", nameList);
+            free(*nameList);
+            *nameList = de_strdup(optarg);
             break;
         case 'e':
             setNames = true;
             *isInclude = false;
-            sscanf(optarg, "%s", nameList);
+            free(*nameList);
+            *nameList = de_strdup(optarg);
             break;
         case 'g':
             setNames = true;
@@ -136,6 +336,22 @@ void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *i
             setNames = true;
             sscanf(optarg, "%" PRIi64, blockDegLt);
             break;
+        case 'x':
+            setExpr = true;
+            free(*expr);
+            *expr = de_strdup(optarg);
+            break;
+        case 'p':
+            *project = true;
+            break;
+        case 't':
+            value = strtoll(optarg, NULL, 10);
+            if (value < 1) {
+                fprintf(stderr, "Error, --threads %" PRIi64 " must be positive.\n", value);
+                usage();
+            }
+            *numThreads = value;
+            break;
         case 'v':
             g_verbose_flag++;
             break;
@@ -151,8 +367,14 @@ void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *i
         fprintf(stderr, "specify --maf\n");
         usage();
     }
-    if ((setNames && setBlockLimits) || !(setNames || setBlockLimits)) {
-        fprintf(stderr, "specify *one* from [--includeSeq or --excludeSeq] or [--noDegreeGT or --noDegreeLT]\n");
+    if ((setNames && setBlockLimits) || !(setNames || setBlockLimits || setExpr || so->mode != kSplitNone ||
+                                                 *project)) {
+        fprintf(stderr, "specify *one* from [--includeSeq or --excludeSeq] or [--noDegreeGT or --noDegreeLT], "
+                "and / or --expr, --splitBy, --project\n");
+        usage();
+    }
+    if (so->mode != kSplitNone && so->prefix == NULL) {
+        fprintf(stderr, "specify --splitPrefix with --splitBy\n");
         usage();
     }
     // Check there's nothing left over on the command line
@@ -166,66 +388,536 @@ void parseOptions(int argc, char **argv, char *filename, char *nameList, bool *i
         usage();
     }
 }
-bool nameOnList(char *name, char **namelist, unsigned n) {
-    for (unsigned i = 0; i < n; ++i) {
-        if ((strncmp(name, namelist[i], strlen(namelist[i])) == 0)) {
-            return true;
+bool nameOnList(char *name, mafNameMatcher_t *names) {
+    return maf_nameMatcher_mark(names, name, NULL, NULL);
+}
+void filterParser_fail(filterParser_t *fp, const char *msg) {
+    fprintf(stderr, "Error, unable to parse --expr at position %ld: %s\n  %s\n  %*s\n",
+            (long) (fp->p - fp->expr), msg, fp->expr, (int) (fp->p - fp->expr) + 1, "^");
+    exit(EXIT_FAILURE);
+}
+void filterParser_emit(filterParser_t *fp, filterInstruction_t instr, int depthChange) {
+    // append an instruction to the program, keeping track of the stack depth
+    filterProgram_t *prog = fp->prog;
+    if (prog->numCode == prog->maxCode) {
+        prog->maxCode *= 2;
+        prog->code = (filterInstruction_t*) realloc(prog->code, sizeof(*(prog->code)) * prog->maxCode);
+        if (prog->code == NULL) {
+            fprintf(stderr, "Error, realloc failed in filterParser_emit()\n");
+            exit(EXIT_FAILURE);
         }
     }
+    prog->code[prog->numCode++] = instr;
+    fp->depth += depthChange;
+    if (fp->depth > prog->maxDepth) {
+        prog->maxDepth = fp->depth;
+    }
+}
+void filterParser_skipSpace(filterParser_t *fp) {
+    while (isspace(*(fp->p))) {
+        ++(fp->p);
+    }
+}
+unsigned filterParser_parseSet(filterParser_t *fp) {
+    // parse a parenthesized, comma separated list of names into a new species set
+    filterParser_skipSpace(fp);
+    if (*(fp->p) != '(') {
+        filterParser_fail(fp, "expected `(' to open a list of names");
+    }
+    ++(fp->p);
+    unsigned n = 0, max = 8;
+    char **names = (char**) de_malloc(sizeof(char*) * max);
+    while (1) {
+        filterParser_skipSpace(fp);
+        const char *start = fp->p;
+        while (*(fp->p) != '\0' && *(fp->p) != ',' && *(fp->p) != ')' && !isspace(*(fp->p))) {
+            ++(fp->p);
+        }
+        if (fp->p == start) {
+            filterParser_fail(fp, "expected a sequence name");
+        }
+        if (n == max) {
+            max *= 2;
+            names = (char**) realloc(names, sizeof(char*) * max);
+            if (names == NULL) {
+                fprintf(stderr, "Error, realloc failed in filterParser_parseSet()\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        names[n++] = de_strndup(start, fp->p - start);
+        filterParser_skipSpace(fp);
+        if (*(fp->p) == ',') {
+            ++(fp->p);
+            continue;
+        }
+        if (*(fp->p) == ')') {
+            ++(fp->p);
+            break;
+        }
+        filterParser_fail(fp, "expected `,' or `)' in list of names");
+    }
+    filterProgram_t *prog = fp->prog;
+    if (prog->numSets == prog->maxSets) {
+        prog->maxSets *= 2;
+        prog->sets = (mafNameMatcher_t**) realloc(prog->sets, sizeof(*(prog->sets)) * prog->maxSets);
+        if (prog->sets == NULL) {
+            fprintf(stderr, "Error, realloc failed in filterParser_parseSet()\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    prog->sets[prog->numSets] = maf_newNameMatcher(names, n, true);
+    destroyNameList(names, n);
+    return prog->numSets++;
+}
+void filterParser_parseComparison(filterParser_t *fp, filterField_t field, unsigned set) {
+    filterInstruction_t instr;
+    instr.op = kOpCompare;
+    instr.field = field;
+    instr.set = set;
+    filterParser_skipSpace(fp);
+    const char *p = fp->p;
+    if (p[0] == '<' && p[1] == '=') {
+        instr.cmp = kCmpLE;
+        fp->p += 2;
+    } else if (p[0] == '>' && p[1] == '=') {
+        instr.cmp = kCmpGE;
+        fp->p += 2;
+    } else if (p[0] == '=' && p[1] == '=') {
+        instr.cmp = kCmpEQ;
+        fp->p += 2;
+    } else if (p[0] == '!' && p[1] == '=') {
+        instr.cmp = kCmpNE;
+        fp->p += 2;
+    } else if (p[0] == '<') {
+        instr.cmp = kCmpLT;
+        ++(fp->p);
+    } else if (p[0] == '>') {
+        instr.cmp = kCmpGT;
+        ++(fp->p);
+    } else if (p[0] == '=') {
+        instr.cmp = kCmpEQ;
+        ++(fp->p);
+    } else {
+        filterParser_fail(fp, "expected a comparison operator");
+    }
+    filterParser_skipSpace(fp);
+    char *end = NULL;
+    instr.value = strtod(fp->p, &end);
+    if (end == fp->p) {
+        filterParser_fail(fp, "expected a number");
+    }
+    fp->p = end;
+    filterParser_emit(fp, instr, 1);
+}
+void filterParser_parsePrimary(filterParser_t *fp) {
+    filterParser_skipSpace(fp);
+    if (*(fp->p) == '(') {
+        ++(fp->p);
+        filterParser_parseOr(fp);
+        filterParser_skipSpace(fp);
+        if (*(fp->p) != ')') {
+            filterParser_fail(fp, "expected `)'");
+        }
+        ++(fp->p);
+        return;
+    }
+    const char *start = fp->p;
+    while (isalpha(*(fp->p))) {
+        ++(fp->p);
+    }
+    size_t len = fp->p - start;
+    filterInstruction_t instr;
+    instr.field = kFieldDegree;
+    instr.cmp = kCmpEQ;
+    instr.value = 0.0;
+    instr.set = 0;
+    if (len == 3 && strncmp(start, "any", len) == 0) {
+        instr.op = kOpAny;
+    } else if (len == 3 && strncmp(start, "all", len) == 0) {
+        instr.op = kOpAll;
+    } else if (len == 4 && strncmp(start, "only", len) == 0) {
+        instr.op = kOpOnly;
+    } else if (len == 5 && strncmp(start, "count", len) == 0) {
+        filterParser_parseComparison(fp, kFieldCount, filterParser_parseSet(fp));
+        return;
+    } else if (len == 6 && strncmp(start, "degree", len) == 0) {
+        filterParser_parseComparison(fp, kFieldDegree, 0);
+        return;
+    } else if (len == 5 && strncmp(start, "width", len) == 0) {
+        filterParser_parseComparison(fp, kFieldWidth, 0);
+        return;
+    } else if (len == 5 && strncmp(start, "score", len) == 0) {
+        filterParser_parseComparison(fp, kFieldScore, 0);
+        return;
+    } else if (len == 6 && strncmp(start, "length", len) == 0) {
+        filterParser_parseComparison(fp, kFieldLength, 0);
+        return;
+    } else if (len == 11 && strncmp(start, "gapFraction", len) == 0) {
+        fp->prog->needsGaps = true;
+        filterParser_parseComparison(fp, kFieldGapFraction, 0);
+        return;
+    } else {
+        fp->p = start;
+        filterParser_fail(fp, "expected a field, a name predicate or `('");
+    }
+    instr.set = filterParser_parseSet(fp);
+    filterParser_emit(fp, instr, 1);
+}
+void filterParser_parseUnary(filterParser_t *fp) {
+    filterParser_skipSpace(fp);
+    if (*(fp->p) == '!' && *(fp->p + 1) != '=') {
+        ++(fp->p);
+        filterParser_parseUnary(fp);
+        filterInstruction_t instr;
+        instr.op = kOpNot;
+        filterParser_emit(fp, instr, 0);
+        return;
+    }
+    filterParser_parsePrimary(fp);
+}
+void filterParser_parseAnd(filterParser_t *fp) {
+    filterParser_parseUnary(fp);
+    while (1) {
+        filterParser_skipSpace(fp);
+        if (fp->p[0] != '&' || fp->p[1] != '&') {
+            return;
+        }
+        fp->p += 2;
+        filterParser_parseUnary(fp);
+        filterInstruction_t instr;
+        instr.op = kOpAnd;
+        filterParser_emit(fp, instr, -1);
+    }
+}
+void filterParser_parseOr(filterParser_t *fp) {
+    filterParser_parseAnd(fp);
+    while (1) {
+        filterParser_skipSpace(fp);
+        if (fp->p[0] != '|' || fp->p[1] != '|') {
+            return;
+        }
+        fp->p += 2;
+        filterParser_parseAnd(fp);
+        filterInstruction_t instr;
+        instr.op = kOpOr;
+        filterParser_emit(fp, instr, -1);
+    }
+}
+filterProgram_t* compileFilterExpression(const char *expr) {
+    // compile a --expr expression into a filterProgram_t. Exits on a malformed expression.
+    if (expr == NULL) {
+        return NULL;
+    }
+    filterProgram_t *prog = (filterProgram_t*) de_malloc(sizeof(*prog));
+    prog->maxCode = 16;
+    prog->numCode = 0;
+    prog->code = (filterInstruction_t*) de_malloc(sizeof(*(prog->code)) * prog->maxCode);
+    prog->maxSets = 4;
+    prog->numSets = 0;
+    prog->sets = (mafNameMatcher_t**) de_malloc(sizeof(*(prog->sets)) * prog->maxSets);
+    prog->maxDepth = 0;
+    prog->needsGaps = false;
+    filterParser_t fp;
+    fp.expr = expr;
+    fp.p = expr;
+    fp.depth = 0;
+    fp.prog = prog;
+    filterParser_parseOr(&fp);
+    filterParser_skipSpace(&fp);
+    if (*(fp.p) != '\0') {
+        filterParser_fail(&fp, "unexpected trailing characters");
+    }
+    return prog;
+}
+void destroyFilterProgram(filterProgram_t *prog) {
+    if (prog == NULL) {
+        return;
+    }
+    for (unsigned i = 0; i < prog->numSets; ++i) {
+        maf_destroyNameMatcher(prog->sets[i]);
+    }
+    free(prog->sets);
+    free(prog->code);
+    free(prog);
+}
+static bool compareValues(double a, filterCmp_t cmp, double b) {
+    switch (cmp) {
+    case kCmpLT:
+        return a < b;
+    case kCmpLE:
+        return a <= b;
+    case kCmpGT:
+        return a > b;
+    case kCmpGE:
+        return a >= b;
+    case kCmpEQ:
+        return a == b;
+    case kCmpNE:
+        return a != b;
+    }
     return false;
 }
-void reportBlock(mafBlock_t *mb, char **names, unsigned n, bool isInclude) {
+bool evaluateFilterProgram(filterProgram_t *prog, mafBlock_t *mb) {
+    // gather everything the program may ask about in a single walk over the
+    // block, then run the program.
+    double fields[kFieldCount];
+    fields[kFieldDegree] = (double) maf_mafBlock_getNumberOfSequences(mb);
+    fields[kFieldWidth] = (double) maf_mafBlock_getSequenceFieldLength(mb);
+    fields[kFieldScore] = 0.0;
+    fields[kFieldLength] = 0.0;
+    fields[kFieldGapFraction] = 0.0;
+    unsigned *numSeen = NULL, *numRows = NULL;
+    bool **seen = NULL;
+    if (prog->numSets > 0) {
+        numSeen = (unsigned*) de_malloc(sizeof(*numSeen) * prog->numSets);
+        numRows = (unsigned*) de_malloc(sizeof(*numRows) * prog->numSets);
+        seen = (bool**) de_malloc(sizeof(*seen) * prog->numSets);
+        for (unsigned i = 0; i < prog->numSets; ++i) {
+            numSeen[i] = 0;
+            numRows[i] = 0;
+            seen[i] = (bool*) de_malloc(sizeof(bool) * (maf_nameMatcher_getNumPatterns(prog->sets[i]) + 1));
+            memset(seen[i], 0, sizeof(bool) * (maf_nameMatcher_getNumPatterns(prog->sets[i]) + 1));
+        }
+    }
+    uint64_t gaps = 0;
+    mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
+    while (ml != NULL) {
+        if (maf_mafLine_getType(ml) == 'a') {
+            char *score = strstr(maf_mafLine_getLine(ml), "score=");
+            if (score != NULL) {
+                fields[kFieldScore] = strtod(score + 6, NULL);
+            }
+        } else if (maf_mafLine_getType(ml) == 's') {
+            fields[kFieldLength] += (double) maf_mafLine_getLength(ml);
+            if (prog->needsGaps) {
+                char *seq = maf_mafLine_getSequence(ml);
+                uint64_t sfl = maf_mafLine_getSequenceFieldLength(ml);
+                for (uint64_t i = 0; i < sfl; ++i) {
+                    if (seq[i] == '-') {
+                        ++gaps;
+                    }
+                }
+            }
+            for (unsigned i = 0; i < prog->numSets; ++i) {
+                if (maf_nameMatcher_mark(prog->sets[i], maf_mafLine_getSpecies(ml), seen[i], &(numSeen[i]))) {
+                    ++(numRows[i]);
+                }
+            }
+        }
+        ml = maf_mafLine_getNext(ml);
+    }
+    if (fields[kFieldDegree] > 0 && fields[kFieldWidth] > 0) {
+        fields[kFieldGapFraction] = gaps / (fields[kFieldDegree] * fields[kFieldWidth]);
+    }
+    bool *stack = (bool*) de_malloc(sizeof(bool) * (prog->maxDepth + 1));
+    unsigned top = 0;
+    for (unsigned i = 0; i < prog->numCode; ++i) {
+        filterInstruction_t *instr = &(prog->code[i]);
+        switch (instr->op) {
+        case kOpCompare:
+            if (instr->field == kFieldCount) {
+                stack[top++] = compareValues(numRows[instr->set], instr->cmp, instr->value);
+            } else {
+                stack[top++] = compareValues(fields[instr->field], instr->cmp, instr->value);
+            }
+            break;
+        case kOpAny:
+            stack[top++] = (numRows[instr->set] > 0);
+            break;
+        case kOpAll:
+            stack[top++] = (numSeen[instr->set] == maf_nameMatcher_getNumPatterns(prog->sets[instr->set]));
+            break;
+        case kOpOnly:
+            stack[top++] = (numRows[instr->set] > 0 &&
+                            numRows[instr->set] == maf_mafBlock_getNumberOfSequences(mb));
+            break;
+        case kOpAnd:
+            --top;
+            stack[top - 1] = stack[top - 1] && stack[top];
+            break;
+        case kOpOr:
+            --top;
+            stack[top - 1] = stack[top - 1] || stack[top];
+            break;
+        case kOpNot:
+            stack[top - 1] = !stack[top - 1];
+            break;
+        }
+    }
+    assert(top == 1);
+    bool result = stack[0];
+    free(stack);
+    for (unsigned i = 0; i < prog->numSets; ++i) {
+        free(seen[i]);
+    }
+    free(seen);
+    free(numSeen);
+    free(numRows);
+    return result;
+}
+bool rowIsReported(char *name, mafNameMatcher_t *names, bool isInclude) {
+    if (names == NULL) {
+        return true;
+    }
+    return nameOnList(name, names) == isInclude;
+}
+char* copyLineName(char *line) {
+    // return a copy of the second whitespace delimited field of a line, i.e.
+    // the sequence name of an s, i, e or q line.
+    char *p = line + 1;
+    while (*p != '\0' && isspace(*p)) {
+        ++p;
+    }
+    char *start = p;
+    while (*p != '\0' && !isspace(*p)) {
+        ++p;
+    }
+    return de_strndup(start, p - start);
+}
+uint64_t compactColumns(char *s, uint64_t n, const uint8_t *keep) {
+    // in place, remove every column i of s for which keep[i] is 0
+    uint64_t j = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        s[j] = s[i];
+        j += keep[i];
+    }
+    s[j] = '\0';
+    return j;
+}
+void reportProjectedBlock(mafBlock_t *mb, mafNameMatcher_t *names, bool isInclude, FILE *ofp) {
+    // report the block after removing sequences (as in reportBlock) and then
+    // removing every column that is a gap in all of the remaining sequences.
+    // Sequence lines that change are re-imputed. Blocks left without any
+    // sequences or columns are not reported.
+    uint64_t width = maf_mafBlock_getSequenceFieldLength(mb);
+    uint8_t *keep = (uint8_t*) de_malloc(width + 1);
+    memset(keep, 0, width + 1);
+    unsigned numRows = 0;
+    mafLine_t *ml;
+    for (ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+        if (maf_mafLine_getType(ml) != 's' || !rowIsReported(maf_mafLine_getSpecies(ml), names, isInclude)) {
+            continue;
+        }
+        if (maf_mafLine_getSequenceFieldLength(ml) != width) {
+            fprintf(stderr, "Error, sequence field of %s on line %" PRIu64 " is %" PRIu64 " columns, "
+                    "expected %" PRIu64 ".\n", maf_mafLine_getSpecies(ml), maf_mafLine_getLineNumber(ml),
+                    maf_mafLine_getSequenceFieldLength(ml), width);
+            exit(EXIT_FAILURE);
+        }
+        // branch free so that the compiler can vectorize the column mask
+        const char *seq = maf_mafLine_getSequence(ml);
+        for (uint64_t i = 0; i < width; ++i) {
+            keep[i] |= (uint8_t) (seq[i] != '-');
+        }
+        ++numRows;
+    }
+    uint64_t newWidth = 0;
+    for (uint64_t i = 0; i < width; ++i) {
+        newWidth += keep[i];
+    }
+    if (numRows == 0 || newWidth == 0) {
+        free(keep);
+        return;
+    }
+    for (ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+        char type = maf_mafLine_getType(ml);
+        if (type == 's') {
+            if (!rowIsReported(maf_mafLine_getSpecies(ml), names, isInclude)) {
+                continue;
+            }
+            if (newWidth < width) {
+                compactColumns(maf_mafLine_getSequence(ml), width, keep);
+                maf_mafLine_setSequence(ml, maf_mafLine_getSequence(ml));
+                free(maf_mafLine_getLine(ml));
+                maf_mafLine_setLine(ml, maf_mafLine_imputeLine(ml));
+            }
+        } else if (type == 'i' || type == 'e' || type == 'q') {
+            char *name = copyLineName(maf_mafLine_getLine(ml));
+            bool reported = rowIsReported(name, names, isInclude);
+            free(name);
+            if (!reported) {
+                continue;
+            }
+            if (type == 'q' && newWidth < width) {
+                char *line = maf_mafLine_getLine(ml);
+                char *qual = strrchr(line, ' ');
+                char *tab = strrchr(line, '\t');
+                qual = (tab > qual) ? tab : qual;
+                if (qual != NULL && strlen(qual + 1) == width) {
+                    compactColumns(qual + 1, width, keep);
+                }
+            }
+        }
+        fprintf(ofp, "%s\n", maf_mafLine_getLine(ml));
+    }
+    fprintf(ofp, "\n");
+    maf_mafBlock_setSequenceFieldLength(mb, newWidth);
+    free(keep);
+}
+void reportBlock(mafBlock_t *mb, mafNameMatcher_t *names, bool isInclude, bool project, FILE *ofp) {
     // report the block being mindful of only including or excluding.
+    if (project) {
+        reportProjectedBlock(mb, names, isInclude, ofp);
+        return;
+    }
     mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
     while (ml != NULL) {
         if (maf_mafLine_getType(ml) != 's') {
             // report all sequence lines
-            printf("%s\n", maf_mafLine_getLine(ml));
+            fprintf(ofp, "%s\n", maf_mafLine_getLine(ml));
             ml = maf_mafLine_getNext(ml);
             continue;
         }
-        if (n > 0) {
+        if (names != NULL) {
             if (isInclude) {
-                if (nameOnList(maf_mafLine_getSpecies(ml), names, n)) {
-                    printf("%s\n", maf_mafLine_getLine(ml));
+                if (nameOnList(maf_mafLine_getSpecies(ml), names)) {
+                    fprintf(ofp, "%s\n", maf_mafLine_getLine(ml));
                     ml = maf_mafLine_getNext(ml);
                     continue;
                 }
             } else {
-                if (!nameOnList(maf_mafLine_getSpecies(ml), names, n)) {
-                    printf("%s\n", maf_mafLine_getLine(ml));
+                if (!nameOnList(maf_mafLine_getSpecies(ml), names)) {
+                    fprintf(ofp, "%s\n", maf_mafLine_getLine(ml));
                     ml = maf_mafLine_getNext(ml);
                     continue;
                 }
             }
         } else {
             // report entire block, this came from one of the blockDegree options
-            printf("%s\n", maf_mafLine_getLine(ml));
+            fprintf(ofp, "%s\n", maf_mafLine_getLine(ml));
         }
         ml = maf_mafLine_getNext(ml);
     }
-    printf("\n");
+    fprintf(ofp, "\n");
 }
-void checkBlock(mafBlock_t *mb, char **names, unsigned n, bool isInclude,
-                int64_t excludeBlockDegreeGT, int64_t excludeBlockDegreeLT) {
+bool checkBlock(mafBlock_t *mb, mafNameMatcher_t *names, bool isInclude,
+                int64_t excludeBlockDegreeGT, int64_t excludeBlockDegreeLT,
+                filterProgram_t *prog) {
     // walk through the maf lines and see if this block should be reported
+    if (prog != NULL) {
+        if (!evaluateFilterProgram(prog, mb)) {
+            return false;
+        }
+        if (names == NULL && excludeBlockDegreeGT == -1 && excludeBlockDegreeLT == -1) {
+            // the expression is the only criterion
+            return true;
+        }
+    }
     mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
     while (ml != NULL) {
         if (maf_mafLine_getType(ml) != 's') {
             ml = maf_mafLine_getNext(ml);
             continue;
         }
-        if (n > 0) {
+        if (names != NULL) {
             // filtering on names
             if (isInclude) {
-                if (nameOnList(maf_mafLine_getSpecies(ml), names, n)) {
-                    reportBlock(mb, names, n, isInclude);
-                    return;
+                if (nameOnList(maf_mafLine_getSpecies(ml), names)) {
+                    return true;
                 }
             } else {
-                if (!nameOnList(maf_mafLine_getSpecies(ml), names, n)) {
-                    reportBlock(mb, names, n, isInclude);
-                    return;
+                if (!nameOnList(maf_mafLine_getSpecies(ml), names)) {
+                    return true;
                 }
             }
         } else {
@@ -233,39 +925,327 @@ void checkBlock(mafBlock_t *mb, char **names, unsigned n, bool isInclude,
             int64_t m = maf_mafBlock_getNumberOfSequences(mb);
             if (excludeBlockDegreeGT != -1 && excludeBlockDegreeLT != -1) {
                 if (m >= excludeBlockDegreeLT && m <= excludeBlockDegreeGT) {
-                    reportBlock(mb, names, n, isInclude);
-                    return;
+                    return true;
                 }
             } else if (excludeBlockDegreeGT != -1) {
                 if (m <= excludeBlockDegreeGT) {
-                    reportBlock(mb, names, n, isInclude);
-                    return;
+                    return true;
                 }
             } else {
                 if (m >= excludeBlockDegreeLT) {
-                    reportBlock(mb, names, n, isInclude);
-                    return;
+                    return true;
                 }
             }
         }
         ml = maf_mafLine_getNext(ml);
     }
+    return false;
+}
+void parseDegreeBins(splitter_t *sp, const char *s) {
+    // --splitDegreeBins is a comma separated list of bucket lower bounds, e.g. 2,4,8
+    sp->numBins = 0;
+    sp->bins = NULL;
+    if (s == NULL) {
+        return;
+    }
+    unsigned n = countNames((char*) s);
+    char **fields = extractNames((char*) s, n);
+    sp->bins = (uint64_t*) de_malloc(sizeof(uint64_t) * (n + 1));
+    for (unsigned i = 0; i < n; ++i) {
+        char *end = NULL;
+        sp->bins[i] = strtoull(fields[i], &end, 10);
+        if (end == fields[i] || *end != '\0' || (i > 0 && sp->bins[i] <= sp->bins[i - 1])) {
+            fprintf(stderr, "Error, --splitDegreeBins must be an increasing comma separated "
+                    "list of integers: %s\n", s);
+            exit(EXIT_FAILURE);
+        }
+    }
+    sp->numBins = n;
+    destroyNameList(fields, n);
+}
+splitter_t* newSplitter(splitOptions_t *opts, mafNameMatcher_t *names, bool isInclude, bool project) {
+    splitter_t *sp = (splitter_t*) de_malloc(sizeof(*sp));
+    sp->opts = opts;
+    sp->tableSize = 256;
+    sp->table = (splitFile_t**) de_malloc(sizeof(*(sp->table)) * sp->tableSize);
+    memset(sp->table, 0, sizeof(*(sp->table)) * sp->tableSize);
+    sp->numFiles = 0;
+    sp->lruHead = NULL;
+    sp->lruTail = NULL;
+    sp->numOpen = 0;
+    sp->header = NULL;
+    sp->names = names;
+    sp->isInclude = isInclude;
+    sp->project = project;
+    sp->numBlocks = 0;
+    parseDegreeBins(sp, opts->degreeBins);
+    return sp;
+}
+void destroySplitter(splitter_t *sp) {
+    if (sp == NULL) {
+        return;
+    }
+    for (unsigned i = 0; i < sp->tableSize; ++i) {
+        splitFile_t *sf = sp->table[i];
+        while (sf != NULL) {
+            splitFile_t *next = sf->hashNext;
+            if (sf->fp != NULL) {
+                fclose(sf->fp);
+            }
+            free(sf->key);
+            free(sf->path);
+            free(sf);
+            sf = next;
+        }
+    }
+    free(sp->table);
+    free(sp->bins);
+    maf_destroyMafBlockList(sp->header);
+    free(sp);
+}
+static uint64_t hashString(const char *s) {
+    // 64 bit FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (; *s != '\0'; ++s) {
+        h ^= (unsigned char) *s;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+static int cmpStringPtrs(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
 }
-void filterInput(mafFileApi_t *mfa, char **names, unsigned n,
-                 bool isInclude, int64_t excludeBlockDegreeGT,
-                 int64_t excludeBlockDegreeLT) {
+char* splitter_speciesKey(mafBlock_t *mb) {
+    // the sorted, unique list of species present in the block joined by `_'.
+    // Very long keys are replaced with a hash to keep file names sane.
+    uint64_t n = maf_mafBlock_getNumberOfSequences(mb);
+    if (n == 0) {
+        return de_strdup("none");
+    }
+    char **species = (char**) de_malloc(sizeof(char*) * n);
+    unsigned m = 0;
+    size_t len = 0;
+    for (mafLine_t *ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+        if (maf_mafLine_getType(ml) == 's') {
+            species[m] = copySpeciesName(maf_mafLine_getSpecies(ml));
+            len += strlen(species[m++]) + 1;
+        }
+    }
+    qsort(species, m, sizeof(char*), cmpStringPtrs);
+    char *key = (char*) de_malloc(len + 1);
+    key[0] = '\0';
+    for (unsigned i = 0; i < m; ++i) {
+        if (i > 0 && strcmp(species[i], species[i - 1]) == 0) {
+            continue;
+        }
+        if (key[0] != '\0') {
+            strcat(key, "_");
+        }
+        strcat(key, species[i]);
+    }
+    destroyNameList(species, m);
+    if (strlen(key) > kMaxSplitKeyLength) {
+        char *hashed = (char*) de_malloc(32);
+        sprintf(hashed, "species_%016" PRIx64, hashString(key));
+        free(key);
+        key = hashed;
+    }
+    return key;
+}
+char* splitter_key(splitter_t *sp, mafBlock_t *mb) {
+    // compute the name of the output shard for this block
+    char *key = NULL;
+    uint64_t degree = maf_mafBlock_getNumberOfSequences(mb);
+    switch (sp->opts->mode) {
+    case kSplitChrom:
+        for (mafLine_t *ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+            if (maf_mafLine_getType(ml) != 's') {
+                continue;
+            }
+            if (sp->opts->reference == NULL ||
+                strncmp(maf_mafLine_getSpecies(ml), sp->opts->reference, strlen(sp->opts->reference)) == 0) {
+                key = de_strdup(maf_mafLine_getSpecies(ml));
+                break;
+            }
+        }
+        if (key == NULL) {
+            key = de_strdup("unassigned");
+        }
+        break;
+    case kSplitDegree:
+        key = (char*) de_malloc(64);
+        if (sp->numBins == 0) {
+            sprintf(key, "degree%" PRIu64, degree);
+        } else {
+            unsigned i;
+            for (i = 0; i < sp->numBins && degree >= sp->bins[i]; ++i);
+            uint64_t lo = (i == 0) ? 0 : sp->bins[i - 1];
+            if (i == sp->numBins) {
+                sprintf(key, "degree%" PRIu64 "+", lo);
+            } else {
+                sprintf(key, "degree%" PRIu64 "-%" PRIu64, lo, sp->bins[i] - 1);
+            }
+        }
+        break;
+    case kSplitSpecies:
+        key = splitter_speciesKey(mb);
+        break;
+    case kSplitChunk:
+        key = (char*) de_malloc(64);
+        sprintf(key, "chunk%06" PRIu64, sp->numBlocks / sp->opts->chunkSize);
+        break;
+    case kSplitNone:
+        assert(false);
+    }
+    for (char *c = key; *c != '\0'; ++c) {
+        if (!(isalnum(*c) || *c == '.' || *c == '_' || *c == '-' || *c == '+')) {
+            *c = '_';
+        }
+    }
+    return key;
+}
+static void splitter_lruRemove(splitter_t *sp, splitFile_t *sf) {
+    if (sf->lruPrev != NULL) {
+        sf->lruPrev->lruNext = sf->lruNext;
+    } else {
+        sp->lruHead = sf->lruNext;
+    }
+    if (sf->lruNext != NULL) {
+        sf->lruNext->lruPrev = sf->lruPrev;
+    } else {
+        sp->lruTail = sf->lruPrev;
+    }
+    sf->lruPrev = NULL;
+    sf->lruNext = NULL;
+}
+static void splitter_lruPushFront(splitter_t *sp, splitFile_t *sf) {
+    sf->lruPrev = NULL;
+    sf->lruNext = sp->lruHead;
+    if (sp->lruHead != NULL) {
+        sp->lruHead->lruPrev = sf;
+    }
+    sp->lruHead = sf;
+    if (sp->lruTail == NULL) {
+        sp->lruTail = sf;
+    }
+}
+FILE* splitter_getFile(splitter_t *sp, const char *key) {
+    // return an open, buffered FILE for this key. Files are created (and given
+    // the maf header) on first use. When more than --splitMaxOpen files are
+    // open the least recently used one is closed, to be reopened for append.
+    uint64_t h = hashString(key) % sp->tableSize;
+    splitFile_t *sf = sp->table[h];
+    while (sf != NULL && strcmp(sf->key, key) != 0) {
+        sf = sf->hashNext;
+    }
+    if (sf == NULL) {
+        sf = (splitFile_t*) de_malloc(sizeof(*sf));
+        sf->key = de_strdup(key);
+        sf->path = (char*) de_malloc(strlen(sp->opts->prefix) + strlen(key) + 5);
+        sprintf(sf->path, "%s%s.maf", sp->opts->prefix, key);
+        sf->fp = NULL;
+        sf->created = false;
+        sf->lruPrev = NULL;
+        sf->lruNext = NULL;
+        sf->hashNext = sp->table[h];
+        sp->table[h] = sf;
+        ++(sp->numFiles);
+    }
+    if (sf->fp != NULL) {
+        if (sp->lruHead != sf) {
+            splitter_lruRemove(sp, sf);
+            splitter_lruPushFront(sp, sf);
+        }
+        return sf->fp;
+    }
+    if (sp->numOpen >= sp->opts->maxOpen) {
+        splitFile_t *victim = sp->lruTail;
+        splitter_lruRemove(sp, victim);
+        fclose(victim->fp);
+        victim->fp = NULL;
+        --(sp->numOpen);
+    }
+    sf->fp = de_fopen(sf->path, sf->created ? "a" : "w");
+    setvbuf(sf->fp, NULL, _IOFBF, kSplitBufferSize);
+    if (!sf->created) {
+        de_verbose("creating split file %s\n", sf->path);
+        reportBlock(sp->header, sp->names, sp->isInclude, false, sf->fp);
+        sf->created = true;
+    }
+    ++(sp->numOpen);
+    splitter_lruPushFront(sp, sf);
+    return sf->fp;
+}
+void splitter_write(splitter_t *sp, mafBlock_t *mb) {
+    char *key = splitter_key(sp, mb);
+    reportBlock(mb, sp->names, sp->isInclude, sp->project, splitter_getFile(sp, key));
+    ++(sp->numBlocks);
+    free(key);
+}
+bool filterBlock(mafBlock_t *mb, FILE *ofp, void *arg) {
+    // worker thread half of --threads, writes the block to ofp if it is reported
+    filterWork_t *fw = (filterWork_t *) arg;
+    if (checkBlock(mb, fw->names, fw->isInclude, fw->excludeBlockDegreeGT, fw->excludeBlockDegreeLT, fw->prog)) {
+        reportBlock(mb, fw->names, fw->isInclude, fw->project, ofp);
+    }
+    return true;
+}
+void emitSplitBlock(mafBlock_t *mb, const char *buf, size_t n, void *arg) {
+    // writer thread half of --threads with --splitBy, routes a filtered block to its file
+    filterWork_t *fw = (filterWork_t *) arg;
+    if (n == 0) {
+        return;
+    }
+    char *key = splitter_key(fw->sp, mb);
+    fwrite(buf, sizeof(char), n, splitter_getFile(fw->sp, key));
+    ++(fw->sp->numBlocks);
+    free(key);
+}
+void filterInput(mafFileApi_t *mfa, mafNameMatcher_t *names, bool isInclude, bool project,
+                 int64_t excludeBlockDegreeGT, int64_t excludeBlockDegreeLT,
+                 filterProgram_t *prog, splitter_t *sp, unsigned numThreads) {
     mafBlock_t *thisBlock = NULL;
     bool headBlock = true;
+    filterWork_t fw;
+    fw.names = names;
+    fw.isInclude = isInclude;
+    fw.project = project;
+    fw.excludeBlockDegreeGT = excludeBlockDegreeGT;
+    fw.excludeBlockDegreeLT = excludeBlockDegreeLT;
+    fw.prog = prog;
+    fw.sp = sp;
+    mafBlockPipeline_t *bp = NULL;
     while ((thisBlock = maf_readBlock(mfa)) != NULL) {
         if (headBlock) {
-            reportBlock(thisBlock, names, n, isInclude);
             headBlock = false;
+            if (sp != NULL) {
+                // the header is written out at the top of each split file
+                sp->header = thisBlock;
+                continue;
+            }
+            reportBlock(thisBlock, names, isInclude, false, stdout);
             maf_destroyMafBlockList(thisBlock);
             continue;
         }
-        checkBlock(thisBlock, names, n, isInclude, excludeBlockDegreeGT, excludeBlockDegreeLT);
+        if (numThreads > 1) {
+            if (bp == NULL) {
+                bp = maf_newBlockPipeline(numThreads, filterBlock, (sp != NULL) ? emitSplitBlock : NULL,
+                                          &fw, stdout);
+            }
+            // the pipeline takes ownership of the block
+            maf_blockPipeline_submit(bp, thisBlock);
+            continue;
+        }
+        if (checkBlock(thisBlock, names, isInclude, excludeBlockDegreeGT, excludeBlockDegreeLT, prog)) {
+            if (sp != NULL) {
+                splitter_write(sp, thisBlock);
+            } else {
+                reportBlock(thisBlock, names, isInclude, project, stdout);
+            }
+        }
         maf_destroyMafBlockList(thisBlock);
     }
+    maf_destroyBlockPipeline(bp);
 }
 unsigned countNames(char *s) {
     unsigned i, n;
@@ -312,20 +1292,47 @@ void reportNames(char **names, unsigned n) {
 int main(int argc, char **argv) {
     (void) (reportNames);
     char filename[kMaxStringLength];
-    char nameList[kMaxStringLength];
-    nameList[0] = '\0';
+    char *nameList = de_strdup("");
     int64_t excludeBlockDegreeGT = -1;
     int64_t excludeBlockDegreeLT = -1;
     bool isInclude = true; // if 0 then we are in exclude mode. 1 is include mode.
-    parseOptions(argc, argv,  filename, nameList, &isInclude, &excludeBlockDegreeGT, &excludeBlockDegreeLT);
+    char *expr = NULL;
+    splitOptions_t so;
+    so.mode = kSplitNone;
+    so.prefix = NULL;
+    so.reference = NULL;
+    so.degreeBins = NULL;
+    so.chunkSize = 1000;
+    so.maxOpen = 64;
+    unsigned numThreads = 1;
+    bool project = false;
+    parseOptions(argc, argv,  filename, &nameList, &isInclude, &excludeBlockDegreeGT, &excludeBlockDegreeLT,
+                 &expr, &so, &numThreads, &project);
     unsigned n = countNames(nameList);
     char **names = extractNames(nameList, n);
+    mafNameMatcher_t *nameMatcher = NULL;
+    if (n > 0) {
+        nameMatcher = maf_newNameMatcher(names, n, true);
+    }
+    filterProgram_t *prog = compileFilterExpression(expr);
+    splitter_t *sp = NULL;
+    if (so.mode != kSplitNone) {
+        sp = newSplitter(&so, nameMatcher, isInclude, project);
+    }
     mafFileApi_t *mfa = maf_newMfa(filename, "r");
 
-    filterInput(mfa, names, n, isInclude, excludeBlockDegreeGT, excludeBlockDegreeLT);
+    filterInput(mfa, nameMatcher, isInclude, project, excludeBlockDegreeGT, excludeBlockDegreeLT, prog, sp, numThreads);
 
     maf_destroyMfa(mfa);
+    destroySplitter(sp);
+    free(so.prefix);
+    free(so.reference);
+    free(so.degreeBins);
+    destroyFilterProgram(prog);
+    maf_destroyNameMatcher(nameMatcher);
     destroyNameList(names, n);
+    free(nameList);
+    free(expr);
 
     return EXIT_SUCCESS;
 }
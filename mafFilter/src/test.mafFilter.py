@@ -391,6 +391,232 @@ s name5 50 10 + 100 ATGTATGCCG
 
 '''),]
 
+# these are triples of expressions, input and expected output for --expr.
+g_knownExpressions = [('any(target0,target1) && degree >= 3',
+                       '''a score=0
+# test0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+a score=0
+# test0
+s target1.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=0
+# test0
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+s mm4.chr6     53310102 13 + 151104725 ACAGCTGAAAATA
+
+''',
+                       '''a score=0
+# test0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+'''),
+                      ('(score > 5 || gapFraction >= 0.25) && !only(name)',
+                       '''a score=10.5
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=1
+s name.chr1           0 10 +       100 ATGT---ATGCCG
+s target0.chr0       50 10 +       100 ATGT---ATGCCG
+
+a score=1
+s name.chr1           0 10 +       100 ATGT---ATGCCG
+s name2.chr1         50 10 +       100 ATGT---ATGCCG
+
+a score=2
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+''',
+                       '''a score=10.5
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+'''),
+                      ('all(target0,panTro1) && count(baboon,mm4) < 2 && width == 13 && length > 30',
+                       '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+s mm4.chr6     53310102 13 + 151104725 ACAGCTGAAAATA
+
+a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+''',
+                       '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+'''),
+                      ]
+
+# these are triples of --splitBy arguments, input and a dict of expected output files.
+g_knownSplits = [(['--splitBy', 'chrom', '--splitMaxOpen', '1'],
+                  '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=2
+s target0.chr0        13 13 + 158545518 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+''',
+                  {'target0.chr0': '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=2
+s target0.chr0        13 13 + 158545518 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+''',
+                   'target0.chr1': '''a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+''',
+                   }),
+                 (['--splitBy', 'degree', '--splitDegreeBins', '3'],
+                  '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+''',
+                  {'degree0-2': '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+''',
+                   'degree3+': '''a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+
+''',
+                   }),
+                 (['--splitBy', 'species', '--excludeSeq', 'baboon'],
+                  '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+s baboon         249182 13 +   4622798 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+''',
+                  {'panTro1_target0': '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+''',
+                   'baboon_panTro1_target0': '''a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+s panTro1.chr6 28869787 13 + 161576975 gcagctgaaaaca
+
+''',
+                   }),
+                 (['--splitBy', 'chunk', '--splitChunkSize', '2', '--expr', 'score < 3'],
+                  '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+
+a score=5
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+
+a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+
+a score=2
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+
+''',
+                  {'chunk000000': '''a score=0
+s target0.chr0         0 13 + 158545518 gcagctgaaaaca
+
+a score=1
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+
+''',
+                   'chunk000001': '''a score=2
+s target0.chr1         0 13 + 158545518 gcagctgaaaaca
+
+''',
+                   }),
+                 ]
+
+# these are triples of arguments, input and expected output for --project.
+g_knownProjections = [(['--excludeSeq', 'mm4'],
+                       '''a score=0
+s target0.chr0         0 10 + 158545518 gca--gct-gaaaca
+s mm4.chr6     53310102  5 + 151104725 ---ag--taga----
+s baboon         249182 10 +   4622798 gca---gaaaaa--a
+q baboon                               999---999999--9
+i baboon C 0 C 0
+
+a score=0
+s target0.chr0        62  6 + 158545518 ATG---CCG
+s baboon         249182  6 +   4622798 ATG---CCG
+
+''',
+                       '''a score=0
+s target0.chr0             0         10 +  158545518 gcagct-gaaaca
+s baboon              249182         10 +    4622798 gca-gaaaaa--a
+q baboon                               999-999999--9
+i baboon C 0 C 0
+
+a score=0
+s target0.chr0            62          6 +  158545518 ATGCCG
+s baboon              249182          6 +    4622798 ATGCCG
+
+'''),
+                      (['--includeSeq', 'mm4'],
+                       '''a score=0
+s target0.chr0         0 10 + 158545518 gca--gct-gaaaca
+s mm4.chr6     53310102  5 + 151104725 ---ag--taga----
+
+a score=0
+s target0.chr0        62  6 + 158545518 ATG---CCG
+s mm4.chr6     53310102  6 + 151104725 ATG---CCG
+
+a score=0
+s target0.chr0        62  6 + 158545518 ATG---CCG
+s mm4.chr6     53310102  0 + 151104725 ---------
+
+''',
+                       '''a score=0
+s mm4.chr6          53310102          5 +  151104725 agtaga
+
+a score=0
+s mm4.chr6          53310102          6 +  151104725 ATGCCG
+
+'''),
+                      ]
+
 def mafIsFiltered(filename, expected, header):
     f = open(filename)
     lastLine = mtt.processHeader(f)
@@ -433,6 +659,27 @@ class FilterTest(unittest.TestCase):
             self.assertTrue(filtered)
             if filtered:
                 mtt.removeDir(tmpDir)
+    def testFilterLongIncludes(self):
+        """ mafFilter should handle --includeSeq lists of hundreds of names.
+        """
+        global g_header
+        mtt.makeTempDirParent()
+        longList = ','.join(['decoy%d.chr%d' % (j, j % 23) for j in xrange(0, 600)] + [g_sequenceList])
+        for i in xrange(0, len(g_knownIncludes)):
+            tmpDir = os.path.abspath(mtt.makeTempDir('filterLongIncludes'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 g_knownIncludes[i][0], g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = []
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafFilter')))
+            cmd += ['--maf', testMafPath, '--includeSeq', longList]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'filtered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            filtered = mafIsFiltered(os.path.join(tmpDir, 'filtered.maf'), g_knownIncludes[i][1], g_header)
+            self.assertTrue(filtered)
+            if filtered:
+                mtt.removeDir(tmpDir)
     def testFilterExcludes(self):
         """ mafFilter should report blocks that match the filter settings for --excludeSeq.
         """
@@ -493,6 +740,94 @@ class FilterTest(unittest.TestCase):
             self.assertTrue(filtered)
             if filtered:
                 mtt.removeDir(tmpDir)
+    def testFilterExpression(self):
+        """ mafFilter should report blocks for which the --expr expression is true.
+        """
+        global g_header
+        mtt.makeTempDirParent()
+        for i in xrange(0, len(g_knownExpressions)):
+            tmpDir = os.path.abspath(mtt.makeTempDir('filterExpression'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 g_knownExpressions[i][1], g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = []
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafFilter')))
+            cmd += ['--maf', testMafPath, '--expr', g_knownExpressions[i][0]]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'filtered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            filtered = mafIsFiltered(os.path.join(tmpDir, 'filtered.maf'), g_knownExpressions[i][2], g_header)
+            self.assertTrue(filtered)
+            if filtered:
+                mtt.removeDir(tmpDir)
+    def testFilterThreads(self):
+        """ mafFilter should report the same blocks, in the same order, when using --threads.
+        """
+        global g_header
+        mtt.makeTempDirParent()
+        cases = ([(['--includeSeq', g_sequenceList], c[0], c[1]) for c in g_knownIncludes] +
+                 [(['--excludeSeq', g_sequenceList], c[0], c[1]) for c in g_knownExcludes] +
+                 [(['--expr', c[0]], c[1], c[2]) for c in g_knownExpressions])
+        for args, maf, expected in cases:
+            tmpDir = os.path.abspath(mtt.makeTempDir('filterThreads'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 maf, g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = []
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafFilter')))
+            cmd += ['--maf', testMafPath, '--threads', '3'] + args
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'filtered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            filtered = mafIsFiltered(os.path.join(tmpDir, 'filtered.maf'), expected, g_header)
+            self.assertTrue(filtered)
+            if filtered:
+                mtt.removeDir(tmpDir)
+    def testProject(self):
+        """ mafFilter --project should remove columns that are all gaps after row filtering.
+        """
+        global g_header
+        mtt.makeTempDirParent()
+        for i in xrange(0, len(g_knownProjections)):
+            tmpDir = os.path.abspath(mtt.makeTempDir('project'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 g_knownProjections[i][1], g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = []
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafFilter')))
+            cmd += ['--maf', testMafPath, '--project'] + g_knownProjections[i][0]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'filtered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            filtered = mafIsFiltered(os.path.join(tmpDir, 'filtered.maf'), g_knownProjections[i][2], g_header)
+            self.assertTrue(filtered)
+            if filtered:
+                mtt.removeDir(tmpDir)
+    def testSplit(self):
+        """ mafFilter should route blocks to the correct files for --splitBy.
+        """
+        global g_header
+        mtt.makeTempDirParent()
+        for i in xrange(0, len(g_knownSplits)):
+            tmpDir = os.path.abspath(mtt.makeTempDir('split'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 g_knownSplits[i][1], g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = []
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafFilter')))
+            cmd += ['--maf', testMafPath, '--splitPrefix', os.path.join(tmpDir, 'split.')]
+            cmd += g_knownSplits[i][0]
+            mtt.recordCommands([cmd], tmpDir)
+            mtt.runCommandsS([cmd], tmpDir)
+            produced = sorted([f for f in os.listdir(tmpDir) if f.startswith('split.')])
+            self.assertEqual(produced, sorted(['split.%s.maf' % k for k in g_knownSplits[i][2]]))
+            filtered = True
+            for key, expected in g_knownSplits[i][2].items():
+                filtered = filtered and mafIsFiltered(os.path.join(tmpDir, 'split.%s.maf' % key),
+                                                      expected, g_header)
+            self.assertTrue(filtered)
+            if filtered:
+                mtt.removeDir(tmpDir)
     def testMemory1(self):
         """ If valgrind is installed on the system, check for memory related errors (1).
         """
@@ -579,5 +914,26 @@ class FilterTest(unittest.TestCase):
             mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
             self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
             mtt.removeDir(tmpDir)
+    def testMemory5(self):
+        """ If valgrind is installed on the system, check for memory related errors (5).
+        """
+        mtt.makeTempDirParent()
+        valgrind = mtt.which('valgrind')
+        if valgrind is None:
+            return
+        global g_header
+        for i in xrange(0, len(g_knownExpressions)):
+            tmpDir = os.path.abspath(mtt.makeTempDir('memory5'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 g_knownExpressions[i][1], g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = mtt.genericValgrind(tmpDir)
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafFilter')))
+            cmd += ['--maf', testMafPath, '--expr', g_knownExpressions[i][0]]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'filtered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
+            mtt.removeDir(tmpDir)
 if __name__ == '__main__':
     unittest.main()
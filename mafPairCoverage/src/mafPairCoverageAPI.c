@@ -153,9 +153,7 @@ void binContainer_setBinValue(BinContainer *bc, int64_t i, int64_t v) {
 }
 bool is_wild(const char *s) {
   // return true if char array ends in *, false otherwise
-  if (s[strlen(s) - 1] == '*')
-    return true;
-  return false;
+  return maf_nameMatcher_isWild(s);
 }
 bool searchMatched(mafLine_t *ml, const char *seq) {
   // report false if search did not match, true if it did
@@ -164,17 +162,7 @@ bool searchMatched(mafLine_t *ml, const char *seq) {
   return searchMatched_(maf_mafLine_getSpecies(ml), seq);
 }
 bool searchMatched_(const char *target, const char *seq) {
-  if (is_wild(seq)) {
-    // only compare up to the wildcard character
-    if (!(strncmp(target, seq, strlen(seq) - 1) == 0)) {
-      return false;
-    }
-  } else {
-    if (!(strcmp(target, seq) == 0)) {
-      return false;
-    }
-  }
-  return true;
+  return maf_nameMatcher_matchOne(seq, target);
 }
 static void quickSetup(mafLine_t *ml1, mafLine_t *ml2, uint64_t *pos1,
                        uint64_t *pos2, int *strand1, int *strand2) {
@@ -225,24 +213,27 @@ void compareLines(mafLine_t *ml1, mafLine_t *ml2, stHash *seq1Hash,
   }
   if (stHash_size(intervalsHash) == 0) {
     // no intervals: yay, life is simple! :D
+    // the columns are taken 64 at a time as bitmasks of the residues of
+    // sequence 1 and of the aligned columns.
     uint64_t offset = 0;  // accounts for gaps in sequence 1
-    for (uint64_t i = 0; i < n; ++i) {
-      if ((s1[i] != '-') && (s2[i] != '-')) {
-        ++(*alignedPositions);
-        ++(mcct1->count);
-        ++(mcct2->count);
+    bool binning = (bin_container != NULL) &&
+      (binContainer_getBins(bin_container) != NULL);
+    for (uint64_t i = 0; i < n; i += 64) {
+      int64_t w = (n - i < 64) ? (int64_t)(n - i) : 64;
+      uint64_t residues1 = de_residueMask(s1 + i, w);
+      uint64_t aligned = residues1 & de_residueMask(s2 + i, w);
+      uint64_t numAligned = de_popcount64(aligned);
+      *alignedPositions += numAligned;
+      mcct1->count += numAligned;
+      mcct2->count += numAligned;
+      for (uint64_t m = aligned; binning && (m != 0); m &= m - 1) {
+        // the offset of a column is the number of residues of 1 before it
+        uint64_t before = residues1 & ((m & -m) - 1);
+        uint64_t columnOffset = offset + de_popcount64(before);
         binContainer_incrementPosition(bin_container,
-                                       s1_start + offset * strand);
-      }
-      if (s1[i] != '-') {
-        /* printf("\noffset: %" PRIu64"\n", offset); */
-        /* for (int k=0; k < i; ++k) */
-        /*   printf(" "); */
-        /* printf("*\n"); */
-        /* printf("1: %s\n", maf_mafLine_getSequence(ml1)); */
-        /* printf("2: %s\n", maf_mafLine_getSequence(ml2)); */
-        ++offset;
+                                       s1_start + columnOffset * strand);
       }
+      offset += de_popcount64(residues1);
     }
   } else {
     // intervals: boo, this shit is complicated! >:(
@@ -289,7 +280,7 @@ void compareLines(mafLine_t *ml1, mafLine_t *ml2, stHash *seq1Hash,
 void wrapDestroyMafLine(void *p) {
   maf_destroyMafLineList((mafLine_t *) p);
 }
-void checkBlock(mafBlock_t *b, const char *seq1, const char *seq2,
+void checkBlock(mafBlock_t *b, mafNameMatcher_t *seqs,
                 stHash *seq1Hash, stHash *seq2Hash, uint64_t *alignedPositions,
                 stHash *intervalsHash, BinContainer *bin_container) {
   // read through each line of a mafBlock and if the sequence matches the
@@ -304,7 +295,13 @@ void checkBlock(mafBlock_t *b, const char *seq1, const char *seq2,
   stList *seq2List = stList_construct3(0, wrapDestroyMafLine);
   mafCoverageCount_t *mcct1 = NULL, *mcct2 = NULL;
   while (ml1 != NULL) {
-    if (searchMatched(ml1, seq1)) {
+    // seqs holds seq1 as pattern 0 and seq2 as pattern 1
+    bool matched[2] = {false, false};
+    unsigned numMatched = 0;
+    if (maf_mafLine_getType(ml1) == 's') {
+      maf_nameMatcher_mark(seqs, maf_mafLine_getSpecies(ml1), matched, &numMatched);
+    }
+    if (matched[0]) {
       has1 = true;
       stList_append(seq1List, maf_copyMafLine(ml1));
       // create an item in the hash for this sequence
@@ -323,7 +320,7 @@ void checkBlock(mafBlock_t *b, const char *seq1, const char *seq2,
         mcct1->observedLength += maf_mafLine_getLength(ml1);
       }
     }
-    if (searchMatched(ml1, seq2)) {
+    if (matched[1]) {
       has2 = true;
       stList_append(seq2List, maf_copyMafLine(ml1));
       // create an item in the hash for this sequence
@@ -374,12 +371,15 @@ void processBody(mafFileApi_t *mfa, char *seq1, char *seq2, stHash *seq1Hash,
                  uint64_t *alignedPositions, stHash *intervalsHash,
                  BinContainer *bin_container) {
   mafBlock_t *thisBlock = NULL;
+  char *seqs[2] = {seq1, seq2};
+  mafNameMatcher_t *seqMatcher = maf_newNameMatcher(seqs, 2, false);
   *alignedPositions = 0;
   while ((thisBlock = maf_readBlock(mfa)) != NULL) {
-    checkBlock(thisBlock, seq1, seq2, seq1Hash, seq2Hash,
+    checkBlock(thisBlock, seqMatcher, seq1Hash, seq2Hash,
                alignedPositions, intervalsHash, bin_container);
     maf_destroyMafBlockList(thisBlock);
   }
+  maf_destroyNameMatcher(seqMatcher);
 }
 
 
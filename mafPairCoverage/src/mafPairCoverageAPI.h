@@ -30,6 +30,7 @@
 #include <inttypes.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "nameMatcher.h"
 #include "sonLib.h"
 #include "mafPairCoverage.h"
 
@@ -66,7 +67,7 @@ void compareLines(mafLine_t *ml1, mafLine_t *ml2, stHash *seq1Hash,
                   stHash *seq2Hash, uint64_t *alignedPositions,
                   stHash *intervalsHash, BinContainer *bc);
 void wrapDestroyMafLine(void *p);
-void checkBlock(mafBlock_t *b, const char *seq1, const char *seq2,
+void checkBlock(mafBlock_t *b, mafNameMatcher_t *seqs,
                 stHash *seq1Hash, stHash *seq2Hash, uint64_t *alignedPositions,
                 stHash *intervalsHash, BinContainer *bc);
 void processBody(mafFileApi_t *mfa, char *seq1, char *seq2, stHash *seq1Hash,
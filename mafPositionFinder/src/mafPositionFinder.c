@@ -22,9 +22,11 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#define _POSIX_C_SOURCE 200809L // fdopen(), sockets for --server
 
 #include <assert.h>
 #include <errno.h> // file existence via ENOENT
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -35,22 +37,74 @@
 #include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "mafIndex.h"
 #include "buildVersion.h"
 
 const char *g_version = "version 0.2 May 2013";
+uint64_t g_vignetteWidth = 5; // bases shown on either side of a hit
+static const uint64_t kGapRankSample = 256; // columns between gapRank_t samples
+
+typedef struct gapRank {
+    // bases counted every kGapRankSample columns along a maf line, for finding the
+    // column of the n'th base of the line quickly
+    const char *seq;
+    uint64_t length; // sequence field length
+    uint64_t numBases;
+    uint64_t *samples; // samples[j] is the number of bases in seq[0, j * kGapRankSample)
+    uint64_t numSamples;
+} gapRank_t;
+typedef struct positionQuery {
+    char *seq;
+    char *id;
+    uint64_t pos;
+    uint64_t order; // position in the query file, used to keep the sort stable
+} positionQuery_t;
+typedef struct querySeq {
+    // all of the queries on one sequence, sorted by position
+    char *name; // owned by the first query of the group
+    positionQuery_t *queries;
+    uint64_t numQueries;
+    uint64_t cursor; // index of the first query at or after the last line start looked up
+} querySeq_t;
+typedef struct queryBatch {
+    querySeq_t *seqs; // sorted by name
+    uint64_t numSeqs;
+    positionQuery_t *queries; // sorted by name, then position, then order
+    uint64_t numQueries;
+} queryBatch_t;
 
 void version(void);
 void usage(void);
-void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t *position);
+void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t *position,
+                  char **queryFilename, bool *server, char **indexFilename, char **socketFilename);
 void checkRegion(unsigned lineno, char *fullname, uint64_t pos, uint64_t start,
                  uint64_t length, uint64_t sourceLength, char strand);
 void getAbsStartEnd(mafLine_t *ml, uint64_t *absStart, uint64_t *absEnd);
 bool insideLine(mafLine_t *ml, uint64_t pos);
-char* extractVignette(mafLine_t *ml, uint64_t targetPos);
-void checkBlock(mafBlock_t *mb, char *fullname, uint64_t pos);
+gapRank_t* newGapRank(mafLine_t *ml);
+void destroyGapRank(gapRank_t *gr);
+uint64_t gapRank_select(const gapRank_t *gr, uint64_t r);
+char* extractVignette(mafLine_t *ml, const gapRank_t *gr, uint64_t targetPos, uint64_t width);
+void checkBlock(mafBlock_t *mb, char *fullname, uint64_t pos, FILE *ofp);
 void searchInput(mafFileApi_t *mfa, char *fullname, unsigned long pos);
+queryBatch_t* readQueryBatch(const char *filename);
+void destroyQueryBatch(queryBatch_t *qb);
+querySeq_t* queryBatch_getSeq(queryBatch_t *qb, const char *name);
+uint64_t querySeq_seek(querySeq_t *qs, uint64_t pos);
+void printHit(mafBlock_t *mb, mafLine_t *ml, const gapRank_t *gr, uint64_t pos, FILE *ofp);
+void checkBlockBatch(mafBlock_t *mb, queryBatch_t *qb);
+void searchInputBatch(mafFileApi_t *mfa, queryBatch_t *qb);
+mafIndex_t* loadIndex(const char *mafFilename, const char *indexFilename);
+void answerPosition(mafIndex_t *mi, int fd, const char *name, uint64_t pos, FILE *ofp);
+void answerRegion(mafIndex_t *mi, int fd, const char *name, uint64_t start, uint64_t stop, FILE *ofp);
+void serveQueries(mafIndex_t *mi, int fd, FILE *ifp, FILE *ofp);
+void serveSocket(mafIndex_t *mi, int fd, const char *socketFilename);
 
 void version(void) {
     fprintf(stderr, "mafBlockDuplicateFilter, %s\nbuild: %s, %s, %s\n\n", g_version, g_build_date,
@@ -60,7 +114,9 @@ void usage(void) {
     version();
     fprintf(stderr, "Usage: mafPositionFinder --maf [path to maf] "
             "--seq [sequence name (and possibly chr)] "
-            "--pos [position to search for, zero based coords] [options]\n\n"
+            "--pos [position to search for, zero based coords] [options]\n"
+            "       mafPositionFinder --maf [path to maf] --queries [path to query file] [options]\n"
+            "       mafPositionFinder --maf [path to maf] --server [options]\n\n"
             "mafPositionFinder is a program that will look through a maf file for a\n"
             "particular sequence name and location. If a match is found the line\n"
             "number and first few fields are returned. If no match is found\n"
@@ -71,10 +127,26 @@ void usage(void) {
     usageMessage('s', "seq", "sequence name, e.g. `hg18.chr2'.");
     usageMessage('p', "pos", "position along the chromosome you are searching for. "
                  "Must be a positive number.");
+    usageMessage('\0', "context", "number of bases shown on either side of the position in the "
+                 "picture at the end of each reported line. default 5.");
+    usageMessage('\0', "queries", "path to a file of queries, one per line, each a sequence name, "
+                 "a zero based position and an optional query id (default `name_pos'). All queries "
+                 "are answered in a single pass through the maf and each reported line is prefixed "
+                 "with the id of the query it answers and a tab. Cannot be used with --seq or --pos.");
+    usageMessage('\0', "server", "load the block index of the maf once and answer queries as they arrive, "
+                 "one per line, on stdin or on --socket until the input ends. `pos name position' "
+                 "reports the same lines as --seq --pos, `region name start stop' prints the blocks "
+                 "overlapping [start, stop] (zero based, inclusive). Every answer ends with a line "
+                 "`#end'. Cannot be used with --seq, --pos or --queries.");
+    usageMessage('\0', "index", "path to the block index used by --server. default is the maf path "
+                 "with .mafidx appended. The index is built if it is missing or out of date.");
+    usageMessage('\0', "socket", "with --server, listen on a unix domain socket at this path instead "
+                 "of reading stdin. Connections are served one at a time.");
     usageMessage('v', "help", "turns on verbose output.");
     exit(EXIT_FAILURE);
 }
-void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t *position) {
+void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t *position,
+                  char **queryFilename, bool *server, char **indexFilename, char **socketFilename) {
     extern int g_debug_flag;
     extern int g_verbose_flag;
     int c;
@@ -91,6 +163,11 @@ void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t
             {"sequence",  required_argument, 0, 's'},
             {"pos",  required_argument, 0, 'p'},
             {"position",  required_argument, 0, 'p'},
+            {"queries",  required_argument, 0, 0},
+            {"context",  required_argument, 0, 0},
+            {"server",  no_argument, 0, 0},
+            {"index",  required_argument, 0, 0},
+            {"socket",  required_argument, 0, 0},
             {0, 0, 0, 0}
         };
         int option_index = 0;
@@ -105,6 +182,29 @@ void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t
                 version();
                 exit(EXIT_SUCCESS);
             }
+            if (strcmp("queries", long_options[option_index].name) == 0) {
+                free(*queryFilename);
+                *queryFilename = de_strdup(optarg);
+            }
+            if (strcmp("context", long_options[option_index].name) == 0) {
+                tempPos = strtoll(optarg, NULL, 10);
+                if (tempPos < 0 || tempPos > 1000) {
+                    fprintf(stderr, "Error, --context %" PRIi64 " must be between 0 and 1000.\n", tempPos);
+                    usage();
+                }
+                g_vignetteWidth = tempPos;
+            }
+            if (strcmp("server", long_options[option_index].name) == 0) {
+                *server = true;
+            }
+            if (strcmp("index", long_options[option_index].name) == 0) {
+                free(*indexFilename);
+                *indexFilename = de_strdup(optarg);
+            }
+            if (strcmp("socket", long_options[option_index].name) == 0) {
+                free(*socketFilename);
+                *socketFilename = de_strdup(optarg);
+            }
             break;
         case 'm':
             setMName = 1;
@@ -134,7 +234,21 @@ void parseOptions(int argc, char **argv, char *filename, char *seqName, uint64_t
             abort();
         }
     }
-    if (!(setMName && setSName && setPos)) {
+    if ((*indexFilename != NULL || *socketFilename != NULL) && !*server) {
+        fprintf(stderr, "--index and --socket are only used with --server\n");
+        usage();
+    }
+    if (*server) {
+        if (!setMName || setSName || setPos || *queryFilename != NULL) {
+            fprintf(stderr, "specify --maf --server, without --seq, --position or --queries\n");
+            usage();
+        }
+    } else if (*queryFilename != NULL) {
+        if (!setMName || setSName || setPos) {
+            fprintf(stderr, "specify --maf --queries, without --seq or --position\n");
+            usage();
+        }
+    } else if (!(setMName && setSName && setPos)) {
         fprintf(stderr, "specify --maf --seq --position\n");
         usage();
     }
@@ -166,77 +280,116 @@ bool insideLine(mafLine_t *ml, uint64_t pos) {
         return true;
     return false;
 }
-char* extractVignette(mafLine_t *ml, uint64_t targetPos) {
-    // produce a pretty picture of the targetPos in question and surrounding sequence region, a la
-    // ...ACGTT --> A <-- GGCCA...
-    char *vig = NULL;
-    char *seq = maf_mafLine_getSequence(ml);
-    char *left = de_malloc(6);
-    char *right = de_malloc(6);
-    char *base = de_malloc(2);
-    memset(left, '\0', 6);
-    memset(right, '\0', 6);
-    memset(base, '\0', 2);
-    unsigned leftIndex = 0, rightIndex = 0;
-    uint64_t absStart, absEnd;
-    uint64_t start, end, pos;
-    getAbsStartEnd(ml, &absStart, &absEnd);
-    int strand = 0;
-    if (maf_mafLine_getStrand(ml) == '+') {
-        strand = 1;
-        start = absStart;
-        end = absEnd;
-    } else {
-        strand = -1;
-        start = absEnd;
-        end = absStart;
-    }
-    pos = start - strand;
-    for (unsigned i = 0; i < strlen(seq); ++i) {
-        if (seq[i] != '-') {
-            pos += strand;
-            if (pos == targetPos)
-                base[0] = seq[i];
-            if (strand == 1) {
-                if (pos >= targetPos - 5 && pos < targetPos) {
-                    left[leftIndex++] = seq[i];
-                }
-                if (pos <= targetPos + 5 && pos > targetPos) {
-                    right[rightIndex++] = seq[i];
-                }
-            } else {
-                // negative strand,
-                if (pos <= targetPos + 5 && pos > targetPos) {
-                    left[leftIndex++] = seq[i];
-                }
-                if (pos >= targetPos - 5 && pos < targetPos) {
-                    right[rightIndex++] = seq[i];
-                }
+static uint64_t countGaps(const char *seq, uint64_t n) {
+    // number of `-' in seq[0, n), eight bytes at a time. A byte of x is zero exactly
+    // where seq has a gap, and the usual zero byte test sets the high bit of those bytes.
+    const uint64_t gaps = 0x2d2d2d2d2d2d2d2dULL, low7 = 0x7f7f7f7f7f7f7f7fULL;
+    uint64_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x;
+        memcpy(&x, seq + i, 8);
+        x ^= gaps;
+        uint64_t y = ~(((x & low7) + low7) | x | low7);
+        count += ((y >> 7) * 0x0101010101010101ULL) >> 56;
+    }
+    for (; i < n; ++i) {
+        count += (seq[i] == '-');
+    }
+    return count;
+}
+gapRank_t* newGapRank(mafLine_t *ml) {
+    // sample the number of bases before every kGapRankSample'th column of the line so
+    // that the column holding any given base can be found without walking the line
+    gapRank_t *gr = (gapRank_t*) de_malloc(sizeof(*gr));
+    gr->seq = maf_mafLine_getSequence(ml);
+    gr->length = maf_mafLine_getSequenceFieldLength(ml);
+    gr->numSamples = gr->length / kGapRankSample + 1;
+    gr->samples = (uint64_t*) de_malloc(sizeof(uint64_t) * gr->numSamples);
+    uint64_t bases = 0;
+    for (uint64_t j = 0; j < gr->numSamples; ++j) {
+        gr->samples[j] = bases;
+        uint64_t n = gr->length - j * kGapRankSample;
+        if (n > kGapRankSample) {
+            n = kGapRankSample;
+        }
+        bases += n - countGaps(gr->seq + j * kGapRankSample, n);
+    }
+    gr->numBases = bases;
+    return gr;
+}
+void destroyGapRank(gapRank_t *gr) {
+    if (gr == NULL) {
+        return;
+    }
+    free(gr->samples);
+    free(gr);
+}
+uint64_t gapRank_select(const gapRank_t *gr, uint64_t r) {
+    // column of base r (zero based, in alignment order), r must be less than numBases
+    uint64_t lo = 0, hi = gr->numSamples;
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (gr->samples[mid] <= r) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    uint64_t bases = gr->samples[lo];
+    uint64_t i = lo * kGapRankSample;
+    for (; i < gr->length; ++i) {
+        if (gr->seq[i] != '-') {
+            if (bases == r) {
+                break;
             }
+            ++bases;
         }
-
     }
-    vig = (char*) de_malloc(kMaxStringLength);
-    vig[0] = '\0';
-    if ((strand == 1 && start + 6 < targetPos) || (strand == -1 && start - 6 > targetPos)) {
-        strcat(vig, "...");
-    }
-    strcat(vig, left);
-    strcat(vig, " ->");
-    strcat(vig, base);
-    strcat(vig, "<- ");
-    strcat(vig, right);
-    if ((strand == 1 && end - 6 > targetPos) || (strand == -1 && end + 6 < targetPos)) {
-        strcat(vig, "...");
-    }
-    free(left);
-    free(right);
-    free(base);
+    return i;
+}
+char* extractVignette(mafLine_t *ml, const gapRank_t *gr, uint64_t targetPos, uint64_t width) {
+    // produce a pretty picture of the targetPos in question and up to width bases on
+    // either side of it, in alignment order, a la
+    // ...ACGTT ->A<- GGCCA...
+    // Only the bases shown are looked up, the rest of the line is not read.
+    uint64_t absStart, absEnd;
+    getAbsStartEnd(ml, &absStart, &absEnd);
+    // rank of the target among the bases of the line
+    uint64_t r = (maf_mafLine_getStrand(ml) == '+') ? targetPos - absStart : absEnd - targetPos;
+    char *vig = (char*) de_malloc(2 * width + 16);
+    char *v = vig;
+    if (r >= gr->numBases) {
+        strcpy(vig, " -><- ");
+        return vig;
+    }
+    uint64_t left = (r < width) ? r : width;
+    uint64_t right = (gr->numBases - 1 - r < width) ? gr->numBases - 1 - r : width;
+    if (r > width) {
+        v += sprintf(v, "...");
+    }
+    for (uint64_t i = r - left; i < r; ++i) {
+        *v++ = gr->seq[gapRank_select(gr, i)];
+    }
+    v += sprintf(v, " ->%c<- ", gr->seq[gapRank_select(gr, r)]);
+    for (uint64_t i = r + 1; i <= r + right; ++i) {
+        *v++ = gr->seq[gapRank_select(gr, i)];
+    }
+    if (gr->numBases - 1 - r > width) {
+        v += sprintf(v, "...");
+    }
+    *v = '\0';
     return vig;
 }
-void checkBlock(mafBlock_t *mb, char *fullname, uint64_t pos) {
+void printHit(mafBlock_t *mb, mafLine_t *ml, const gapRank_t *gr, uint64_t pos, FILE *ofp) {
+    char *vignette = extractVignette(ml, gr, pos, g_vignetteWidth);
+    fprintf(ofp, "block %" PRIu64 ", line %" PRIu64 ": s %s %" PRIu64 " %" PRIu64 " %c %" PRIu64
+           " %s\n", maf_mafBlock_getLineNumber(mb), maf_mafLine_getLineNumber(ml),
+           maf_mafLine_getSpecies(ml), maf_mafLine_getStart(ml), maf_mafLine_getLength(ml),
+           maf_mafLine_getStrand(ml), maf_mafLine_getSourceLength(ml), vignette);
+    free(vignette);
+}
+void checkBlock(mafBlock_t *mb, char *fullname, uint64_t pos, FILE *ofp) {
     mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
-    char *vignette = NULL;
     while (ml != NULL) {
         if (maf_mafLine_getType(ml) != 's') {
             ml = maf_mafLine_getNext(ml);
@@ -247,12 +400,9 @@ void checkBlock(mafBlock_t *mb, char *fullname, uint64_t pos) {
             continue;
         }
         if (insideLine(ml, pos)) {
-            vignette = extractVignette(ml, pos);
-            printf("block %" PRIu64 ", line %" PRIu64 ": s %s %" PRIu64 " %" PRIu64 " %c %" PRIu64
-                   " %s\n", maf_mafBlock_getLineNumber(mb), maf_mafLine_getLineNumber(ml), fullname,
-                   maf_mafLine_getStart(ml), maf_mafLine_getLength(ml), maf_mafLine_getStrand(ml),
-                   maf_mafLine_getSourceLength(ml), vignette);
-            free(vignette);
+            gapRank_t *gr = newGapRank(ml);
+            printHit(mb, ml, gr, pos, ofp);
+            destroyGapRank(gr);
         }
         ml = maf_mafLine_getNext(ml);
     }
@@ -260,19 +410,379 @@ void checkBlock(mafBlock_t *mb, char *fullname, uint64_t pos) {
 void searchInput(mafFileApi_t *mfa, char *fullname, unsigned long pos) {
     mafBlock_t *thisBlock = NULL;
     while ((thisBlock = maf_readBlock(mfa)) != NULL) {
-        checkBlock(thisBlock, fullname, pos);
+        checkBlock(thisBlock, fullname, pos, stdout);
+        maf_destroyMafBlockList(thisBlock);
+    }
+}
+static int cmpQuery(const void *a, const void *b) {
+    const positionQuery_t *qa = (const positionQuery_t *) a, *qb = (const positionQuery_t *) b;
+    int c = strcmp(qa->seq, qb->seq);
+    if (c != 0) {
+        return c;
+    }
+    if (qa->pos != qb->pos) {
+        return (qa->pos < qb->pos) ? -1 : 1;
+    }
+    return (qa->order < qb->order) ? -1 : (qa->order > qb->order);
+}
+static int cmpQuerySeq(const void *a, const void *b) {
+    return strcmp(((const querySeq_t *) a)->name, ((const querySeq_t *) b)->name);
+}
+queryBatch_t* readQueryBatch(const char *filename) {
+    // read a query file (sequence name, zero based position and an optional id), sort
+    // the queries by sequence and position and group them by sequence. Blank and comment
+    // lines are skipped.
+    FILE *ifp = de_fopen(filename, "r");
+    uint64_t n = 0, max = 1024;
+    positionQuery_t *queries = (positionQuery_t*) de_malloc(sizeof(*queries) * max);
+    int64_t nBytes = kMaxStringLength;
+    char *line = (char*) de_malloc(nBytes + 1);
+    uint64_t lineno = 0;
+    while (!feof(ifp)) {
+        de_getline(&line, &nBytes, ifp);
+        ++lineno;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            ++p;
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        char seq[kMaxSeqName], id[kMaxSeqName];
+        int64_t pos;
+        id[0] = '\0';
+        int fields = sscanf(p, "%511s %" SCNi64 " %511s", seq, &pos, id);
+        if (fields < 2 || pos < 0) {
+            fprintf(stderr, "Error, unable to parse query line %" PRIu64 " of %s: %s\n", lineno, filename, line);
+            exit(EXIT_FAILURE);
+        }
+        if (n == max) {
+            max *= 2;
+            queries = (positionQuery_t*) realloc(queries, sizeof(*queries) * max);
+            if (queries == NULL) {
+                fprintf(stderr, "Error, realloc failed in readQueryBatch()\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (fields == 3) {
+            queries[n].id = de_strdup(id);
+        } else {
+            char tmp[kMaxStringLength];
+            snprintf(tmp, kMaxStringLength, "%s_%" PRIi64, seq, pos);
+            queries[n].id = de_strdup(tmp);
+        }
+        queries[n].pos = pos;
+        queries[n].order = n;
+        queries[n].seq = de_strdup(seq);
+        ++n;
+    }
+    free(line);
+    fclose(ifp);
+    qsort(queries, n, sizeof(*queries), cmpQuery);
+    queryBatch_t *qb = (queryBatch_t*) de_malloc(sizeof(*qb));
+    qb->queries = queries;
+    qb->numQueries = n;
+    qb->seqs = (querySeq_t*) de_malloc(sizeof(*(qb->seqs)) * (n + 1));
+    qb->numSeqs = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        if (i == 0 || strcmp(queries[i].seq, queries[i - 1].seq) != 0) {
+            querySeq_t *qs = qb->seqs + qb->numSeqs++;
+            qs->name = queries[i].seq;
+            qs->queries = queries + i;
+            qs->numQueries = 0;
+            qs->cursor = 0;
+        }
+        ++(qb->seqs[qb->numSeqs - 1].numQueries);
+    }
+    return qb;
+}
+void destroyQueryBatch(queryBatch_t *qb) {
+    if (qb == NULL) {
+        return;
+    }
+    for (uint64_t i = 0; i < qb->numQueries; ++i) {
+        free(qb->queries[i].seq);
+        free(qb->queries[i].id);
+    }
+    free(qb->queries);
+    free(qb->seqs);
+    free(qb);
+}
+querySeq_t* queryBatch_getSeq(queryBatch_t *qb, const char *name) {
+    if (qb->numSeqs == 0) {
+        return NULL;
+    }
+    querySeq_t key;
+    key.name = (char*) name;
+    return (querySeq_t*) bsearch(&key, qb->seqs, qb->numSeqs, sizeof(*(qb->seqs)), cmpQuerySeq);
+}
+uint64_t querySeq_seek(querySeq_t *qs, uint64_t pos) {
+    // return the index of the first query at or after pos. The cursor is left where the
+    // previous lookup on this sequence ended, so when the maf is sorted along the sequence
+    // each lookup only gallops forward over the queries that were passed over, and the
+    // whole pass touches each query a constant number of times. Lookups that move
+    // backwards fall back to a binary search of the queries before the cursor.
+    positionQuery_t *q = qs->queries;
+    uint64_t lo, hi;
+    if (qs->cursor > 0 && q[qs->cursor - 1].pos >= pos) {
+        lo = 0;
+        hi = qs->cursor - 1;
+    } else {
+        lo = qs->cursor;
+        hi = lo;
+        uint64_t step = 1;
+        while (hi < qs->numQueries && q[hi].pos < pos) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi > qs->numQueries) {
+            hi = qs->numQueries;
+        }
+    }
+    // invariant: every query before lo is before pos, and the query at hi (if any) is not
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (q[mid].pos < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    qs->cursor = lo;
+    return lo;
+}
+void checkBlockBatch(mafBlock_t *mb, queryBatch_t *qb) {
+    mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
+    uint64_t absStart, absEnd;
+    while (ml != NULL) {
+        if (maf_mafLine_getType(ml) != 's') {
+            ml = maf_mafLine_getNext(ml);
+            continue;
+        }
+        querySeq_t *qs = queryBatch_getSeq(qb, maf_mafLine_getSpecies(ml));
+        if (qs == NULL) {
+            ml = maf_mafLine_getNext(ml);
+            continue;
+        }
+        getAbsStartEnd(ml, &absStart, &absEnd);
+        gapRank_t *gr = NULL; // shared by all of the queries that fall in this line
+        for (uint64_t i = querySeq_seek(qs, absStart);
+             i < qs->numQueries && qs->queries[i].pos <= absEnd; ++i) {
+            if (gr == NULL) {
+                gr = newGapRank(ml);
+            }
+            printf("%s\t", qs->queries[i].id);
+            printHit(mb, ml, gr, qs->queries[i].pos, stdout);
+        }
+        destroyGapRank(gr);
+        ml = maf_mafLine_getNext(ml);
+    }
+}
+void searchInputBatch(mafFileApi_t *mfa, queryBatch_t *qb) {
+    mafBlock_t *thisBlock = NULL;
+    while ((thisBlock = maf_readBlock(mfa)) != NULL) {
+        checkBlockBatch(thisBlock, qb);
         maf_destroyMafBlockList(thisBlock);
     }
 }
+mafIndex_t* loadIndex(const char *mafFilename, const char *indexFilename) {
+    // open the index of the maf, building it first if it is missing or out of date,
+    // and read all of it into memory
+    char *filename = (indexFilename != NULL) ? de_strdup(indexFilename) : maf_index_defaultFilename(mafFilename);
+    mafIndex_t *mi = maf_openIndex(filename);
+    if (mi != NULL && !maf_index_isCurrent(mi, mafFilename)) {
+        de_verbose("index %s is out of date with %s\n", filename, mafFilename);
+        maf_destroyIndex(mi);
+        mi = NULL;
+    }
+    if (mi == NULL) {
+        de_verbose("building index %s\n", filename);
+        maf_buildIndex(mafFilename, filename);
+        mi = maf_openIndex(filename);
+    }
+    maf_index_load(mi);
+    free(filename);
+    return mi;
+}
+void answerPosition(mafIndex_t *mi, int fd, const char *name, uint64_t pos, FILE *ofp) {
+    // report the lines checkBlock() would for every block the index places pos in.
+    // Each block costs one pread() of the maf.
+    uint64_t *blocks = NULL, numBlocks = 0, maxBlocks = 0;
+    maf_index_queryBlocks(mi, name, pos, pos, &blocks, &numBlocks, &maxBlocks);
+    numBlocks = maf_index_uniqueBlocks(blocks, numBlocks);
+    for (uint64_t i = 0; i < numBlocks; ++i) {
+        uint64_t length, lineNumber;
+        mafIndexBlock_t b;
+        char *text = maf_index_preadBlock(mi, fd, blocks[i], &length, &lineNumber);
+        mafBlock_t *mb = maf_newMafBlockFromString(text, lineNumber);
+        // number the block as a streaming read does
+        maf_index_getBlock(mi, blocks[i], &b);
+        maf_mafBlock_setLineNumber(mb, b.lineNumber);
+        checkBlock(mb, (char*) name, pos, ofp);
+        maf_destroyMafBlockList(mb);
+        free(text);
+    }
+    free(blocks);
+}
+void answerRegion(mafIndex_t *mi, int fd, const char *name, uint64_t start, uint64_t stop, FILE *ofp) {
+    // print, in maf order, every block with a non empty row on name that overlaps
+    // [start, stop]. Blocks are copied out of the maf as they are, without parsing.
+    uint64_t *blocks = NULL, numBlocks = 0, maxBlocks = 0;
+    uint64_t maxRows = 0;
+    mafIndexRow_t *rows = NULL;
+    int64_t nameId = maf_index_findName(mi, name);
+    maf_index_queryBlocks(mi, name, start, stop, &blocks, &numBlocks, &maxBlocks);
+    numBlocks = maf_index_uniqueBlocks(blocks, numBlocks);
+    for (uint64_t i = 0; i < numBlocks; ++i) {
+        mafIndexBlock_t b;
+        maf_index_getBlock(mi, blocks[i], &b);
+        if (b.numRows > maxRows) {
+            free(rows);
+            maxRows = b.numRows;
+            rows = (mafIndexRow_t*) de_malloc(sizeof(*rows) * maxRows);
+        }
+        maf_index_getRows(mi, &b, rows);
+        bool overlaps = false;
+        for (uint64_t j = 0; j < b.numRows && !overlaps; ++j) {
+            if ((int64_t) rows[j].nameId != nameId || rows[j].length == 0) {
+                continue;
+            }
+            uint64_t absStart = rows[j].start;
+            if (rows[j].strand == '-') {
+                absStart = rows[j].sourceLength - (rows[j].start + rows[j].length);
+            }
+            overlaps = (absStart <= stop) && (absStart + rows[j].length - 1 >= start);
+        }
+        if (overlaps) {
+            uint64_t length, lineNumber;
+            char *text = maf_index_preadBlock(mi, fd, blocks[i], &length, &lineNumber);
+            fwrite(text, 1, length, ofp);
+            fputc('\n', ofp);
+            free(text);
+        }
+    }
+    free(rows);
+    free(blocks);
+}
+void serveQueries(mafIndex_t *mi, int fd, FILE *ifp, FILE *ofp) {
+    // answer queries from ifp, one per line, until ifp ends or ofp can no longer be
+    // written to. Blank and comment lines are ignored.
+    int64_t nBytes = kMaxStringLength;
+    char *line = (char*) de_malloc(nBytes + 1);
+    int64_t status = 0;
+    while (status != -1 && !ferror(ofp)) {
+        status = de_getline(&line, &nBytes, ifp);
+        char *p = line;
+        while (*p == ' ' || *p == '\t') {
+            ++p;
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        char verb[16], name[kMaxSeqName];
+        int64_t a = -1, b = -1;
+        int fields = sscanf(p, "%15s %511s %" SCNi64 " %" SCNi64, verb, name, &a, &b);
+        if (fields == 3 && strcmp(verb, "pos") == 0 && a >= 0) {
+            answerPosition(mi, fd, name, a, ofp);
+        } else if (fields == 4 && strcmp(verb, "region") == 0 && a >= 0 && b >= a) {
+            answerRegion(mi, fd, name, a, b, ofp);
+        } else {
+            fprintf(ofp, "#error unable to parse query: %s\n", p);
+        }
+        fprintf(ofp, "#end\n");
+        fflush(ofp);
+    }
+    free(line);
+}
+void serveSocket(mafIndex_t *mi, int fd, const char *socketFilename) {
+    // listen on a unix domain socket and serve each connection in turn. Does not return.
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketFilename) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error, socket path %s is too long.\n", socketFilename);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(addr.sun_path, socketFilename);
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) {
+        fprintf(stderr, "Error, unable to create socket: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    // a socket left behind by an earlier server would make bind() fail, but
+    // never remove anything else that happens to live at that path
+    struct stat st;
+    if (lstat(socketFilename, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Error, %s exists and is not a socket.\n", socketFilename);
+            exit(EXIT_FAILURE);
+        }
+        unlink(socketFilename);
+    }
+    if (bind(s, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(s, 16) != 0) {
+        fprintf(stderr, "Error, unable to listen on %s: %s\n", socketFilename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    // a client that hangs up early should end its connection, not the server
+    signal(SIGPIPE, SIG_IGN);
+    de_verbose("listening on %s\n", socketFilename);
+    while (true) {
+        int c = accept(s, NULL, NULL);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            fprintf(stderr, "Error, accept failed on %s: %s\n", socketFilename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        int c2 = dup(c);
+        FILE *ifp = fdopen(c, "r");
+        FILE *ofp = (c2 < 0) ? NULL : fdopen(c2, "w");
+        if (ifp == NULL || ofp == NULL) {
+            fprintf(stderr, "Error, unable to open connection on %s\n", socketFilename);
+            exit(EXIT_FAILURE);
+        }
+        serveQueries(mi, fd, ifp, ofp);
+        fclose(ifp);
+        fclose(ofp);
+    }
+}
 
 int main(int argc, char **argv) {
     char filename[kMaxStringLength];
     char targetName[kMaxStringLength];
+    char *queryFilename = NULL, *indexFilename = NULL, *socketFilename = NULL;
+    bool server = false;
     uint64_t targetPos;
-    parseOptions(argc, argv,  filename, targetName, &targetPos);
+    parseOptions(argc, argv,  filename, targetName, &targetPos, &queryFilename,
+                 &server, &indexFilename, &socketFilename);
+    if (server) {
+        mafIndex_t *mi = loadIndex(filename, indexFilename);
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Error, unable to open %s\n", filename);
+            exit(EXIT_FAILURE);
+        }
+        if (socketFilename != NULL) {
+            serveSocket(mi, fd, socketFilename);
+        }
+        serveQueries(mi, fd, stdin, stdout);
+        close(fd);
+        maf_destroyIndex(mi);
+        free(indexFilename);
+        return EXIT_SUCCESS;
+    }
     mafFileApi_t *mfa = maf_newMfa(filename, "r");
 
-    searchInput(mfa, targetName, targetPos);
+    if (queryFilename != NULL) {
+        queryBatch_t *qb = readQueryBatch(queryFilename);
+        searchInputBatch(mfa, qb);
+        destroyQueryBatch(qb);
+        free(queryFilename);
+    } else {
+        searchInput(mfa, targetName, targetPos);
+    }
     maf_destroyMfa(mfa);
 
     return EXIT_SUCCESS;
@@ -229,5 +229,187 @@ class FindTest(unittest.TestCase):
             self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
             mtt.removeDir(tmpDir)
 
+class ContextTest(unittest.TestCase):
+    def testContext(self):
+        """ mafPositionFinder --context should control how many bases are shown around a hit, in alignment order.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('context'))
+        block = '''a score=0
+s target.chr0  0 12 + 100 AC--GTAC-GT---ACGT
+s other.chr1  88 12 - 100 AC--GTAC-GT---ACGT
+
+'''
+        testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                             block, g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        # (sequence, position, context, expected picture)
+        cases = [('target.chr0', 0, 5, ' ->A<- CGTAC...'),
+                 ('target.chr0', 2, 5, 'AC ->G<- TACGT...'),
+                 ('target.chr0', 6, 2, '...AC ->G<- TA...'),
+                 ('target.chr0', 6, 0, '... ->G<- ...'),
+                 ('target.chr0', 11, 3, '...ACG ->T<- '),
+                 ('other.chr1', 11, 2, ' ->A<- CG...'),
+                 ('other.chr1', 0, 12, 'ACGTACGTACG ->T<- '),
+                 ]
+        for seq, pos, context, picture in cases:
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder'))]
+            cmd += ['--maf', testMafPath, '--seq', seq, '--pos', '%d' % pos, '--context', '%d' % context]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'found.txt'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            f = open(outpipes[0], 'r')
+            lines = f.readlines()
+            f.close()
+            self.assertEqual(len(lines), 1)
+            self.assertTrue(lines[0].endswith(' %s\n' % picture))
+        mtt.removeDir(tmpDir)
+
+class BatchTest(unittest.TestCase):
+    def writeQueries(self, queries, tmpDir):
+        path = os.path.join(tmpDir, 'queries.txt')
+        f = open(path, 'w')
+        f.write('# seq pos id\n')
+        for q in queries:
+            f.write('%s\n' % ' '.join(q))
+        f.close()
+        return path
+    def testBatch(self):
+        """ mafPositionFinder --queries should report the same lines as one run per query, tagged by query id.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('batch'))
+        testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                             ''.join([b[0] for b in g_overlappingBlocks + g_nonOverlappingBlocks]),
+                                             g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        queries = [(g_targetSeq, '%d' % b[1], 'q%d' % i) for i, b in enumerate(g_overlappingBlocks)]
+        queries += [('name2.chr1', '55', 'inside'), ('name5', '49', 'before'),
+                    ('name3.chr9', '59'), (g_targetSeq, '37', 'miss')]
+        random.shuffle(queries)
+        queryPath = self.writeQueries(queries, tmpDir)
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder'))]
+        cmd += ['--maf', testMafPath, '--queries', queryPath]
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'batch.txt'))]
+        mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+        expected = []
+        for q in queries:
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder'))]
+            cmd += ['--maf', testMafPath, '--seq', q[0], '--pos', q[1]]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'single.txt'))]
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            if len(q) > 2:
+                qid = q[2]
+            else:
+                qid = '%s_%s' % (q[0], q[1])
+            f = open(outpipes[0], 'r')
+            expected += ['%s\t%s' % (qid, line) for line in f]
+            f.close()
+        f = open(os.path.join(tmpDir, 'batch.txt'), 'r')
+        observed = f.readlines()
+        f.close()
+        self.assertTrue(len(expected) > len(g_overlappingBlocks))
+        self.assertEqual(sorted(observed), sorted(expected))
+        mtt.removeDir(tmpDir)
+    def testMemory3(self):
+        """ If valgrind is installed on the system, check for memory related errors (3).
+        """
+        mtt.makeTempDirParent()
+        valgrind = mtt.which('valgrind')
+        if valgrind is None:
+            return
+        tmpDir = os.path.abspath(mtt.makeTempDir('memory3'))
+        testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                             ''.join([b[0] for b in g_overlappingBlocks]), g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        queryPath = self.writeQueries([(g_targetSeq, '%d' % b[1]) for b in g_overlappingBlocks], tmpDir)
+        cmd = mtt.genericValgrind(tmpDir)
+        cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder')))
+        cmd += ['--maf', testMafPath, '--queries', queryPath]
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'found.txt'))]
+        mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+        self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
+        mtt.removeDir(tmpDir)
+
+class ServerTest(unittest.TestCase):
+    def writeRequests(self, requests, tmpDir):
+        path = os.path.join(tmpDir, 'requests.txt')
+        f = open(path, 'w')
+        f.write('# requests\n')
+        for r in requests:
+            f.write('%s\n' % r)
+        f.close()
+        return path
+    def testServer(self):
+        """ mafPositionFinder --server should answer pos queries as --seq --pos does and region queries with the overlapping blocks.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('server'))
+        blocks = [b[0] for b in g_overlappingBlocks + g_nonOverlappingBlocks]
+        testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                             ''.join(blocks), g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        positions = [(g_targetSeq, '%d' % b[1]) for b in g_overlappingBlocks]
+        positions += [('name2.chr1', '55'), ('name5', '49'), (g_targetSeq, '37'), ('nosuch', '0')]
+        requests = ['pos %s %s' % p for p in positions]
+        requests += ['region name 5 12', 'region target.chr0 0 50', 'region nosuch 0 100', 'bogus']
+        requestPath = self.writeRequests(requests, tmpDir)
+        cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder'))]
+        cmd += ['--maf', testMafPath, '--server']
+        inpipes = [requestPath]
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'answers.txt'))]
+        mtt.recordCommands([cmd], tmpDir, inPipes=inpipes, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, inPipes=inpipes, outPipes=outpipes)
+        self.assertTrue(os.path.exists(testMafPath + '.mafidx'))
+        f = open(outpipes[0], 'r')
+        answers = f.read().split('#end\n')
+        f.close()
+        self.assertEqual(len(answers), len(requests) + 1)
+        self.assertEqual(answers[-1], '')
+        for i, p in enumerate(positions):
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder'))]
+            cmd += ['--maf', testMafPath, '--seq', p[0], '--pos', p[1]]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'single.txt'))]
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            # a streaming read numbers a block that directly follows the header one
+            # higher than the index does, so leave the block number out
+            f = open(outpipes[0], 'r')
+            self.assertEqual(re.sub(r'(?m)^block \d+, ', '', answers[i]), re.sub(r'(?m)^block \d+, ', '', f.read()))
+            f.close()
+        # name 5..12 touches the third and fourth blocks. target.chr0 0..50 touches the
+        # first, second and eighth but not the third, which holds target.chr0 on the
+        # negative strand at 51..60
+        n = len(positions)
+        self.assertEqual(answers[n], blocks[2] + blocks[3])
+        self.assertEqual(answers[n + 1], blocks[0] + blocks[1] + blocks[7])
+        self.assertEqual(answers[n + 2], '')
+        self.assertTrue(answers[n + 3].startswith('#error'))
+        mtt.removeDir(tmpDir)
+    def testMemory4(self):
+        """ If valgrind is installed on the system, check for memory related errors (4).
+        """
+        mtt.makeTempDirParent()
+        valgrind = mtt.which('valgrind')
+        if valgrind is None:
+            return
+        tmpDir = os.path.abspath(mtt.makeTempDir('memory4'))
+        testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                             ''.join([b[0] for b in g_overlappingBlocks]), g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        requests = ['pos %s %d' % (g_targetSeq, b[1]) for b in g_overlappingBlocks]
+        requests += ['region %s 0 100' % g_targetSeq, 'bogus']
+        requestPath = self.writeRequests(requests, tmpDir)
+        cmd = mtt.genericValgrind(tmpDir)
+        cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafPositionFinder')))
+        cmd += ['--maf', testMafPath, '--server']
+        inpipes = [requestPath]
+        outpipes = [os.path.abspath(os.path.join(tmpDir, 'answers.txt'))]
+        mtt.recordCommands([cmd], tmpDir, inPipes=inpipes, outPipes=outpipes)
+        mtt.runCommandsS([cmd], tmpDir, inPipes=inpipes, outPipes=outpipes)
+        self.assertTrue(mtt.noMemoryErrors(os.path.join(tmpDir, 'valgrind.xml')))
+        mtt.removeDir(tmpDir)
+
 if __name__ == '__main__':
     unittest.main()
@@ -36,18 +36,34 @@
 #include <unistd.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "nameMatcher.h"
 #include "buildVersion.h"
 
 const char *g_version = "version 0.1 October 2012";
 
+typedef struct rowOrder {
+    // the order list and scratch space reused from block to block, see checkBlock
+    mafNameMatcher_t *order;
+    unsigned n; // number of names on the order list
+    uint64_t *counts; // n + 1 bucket offsets
+    mafLine_t **lines; // every line of the current block, in input order
+    mafLine_t **rows; // the rows to report, in output order
+    int32_t *ranks; // order list index of each element of lines, or -1
+    uint64_t capacity; // length of lines, rows and ranks
+    mafBlock_t *shell; // `a ordered=true' block the rows are linked behind for printing
+    bool verbatim; // write rows as they were read rather than pretty printing them
+} rowOrder_t;
+
 void version(void);
 void usage(void);
-void parseOptions(int argc, char **argv, char *filename, char *orderlist);
+void parseOptions(int argc, char **argv, char *filename, char **orderlist, bool *verbatim);
 void checkRegion(unsigned lineno, char *fullname, uint64_t pos, uint64_t start,
                  uint64_t length, uint64_t sourceLength, char strand);
 void printHeader(void);
-void checkBlock(mafBlock_t *mb, char **order, unsigned n);
-void orderInput(mafFileApi_t *mfa, char **order, unsigned n);
+rowOrder_t* newRowOrder(mafNameMatcher_t *order, unsigned n, bool verbatim);
+void destroyRowOrder(rowOrder_t *ro);
+void checkBlock(mafBlock_t *mb, rowOrder_t *ro);
+void orderInput(mafFileApi_t *mfa, rowOrder_t *ro);
 void destroyNameList(char **names, unsigned n);
 
 void version(void) {
@@ -66,10 +82,11 @@ void usage(void) {
     usageMessage('h', "help", "show this help message and exit.");
     usageMessage('m', "maf", "path to maf file.");
     usageMessage('\0', "order", "comma separated list of sequence names.");
+    usageMessage('\0', "verbatim", "write rows exactly as they were read instead of realigning their columns.");
     usageMessage('v', "verbose", "turns on verbose output.");
     exit(EXIT_FAILURE);
 }
-void parseOptions(int argc, char **argv, char *filename, char *orderlist) {
+void parseOptions(int argc, char **argv, char *filename, char **orderlist, bool *verbatim) {
     extern int g_debug_flag;
     extern int g_verbose_flag;
     int c;
@@ -82,6 +99,7 @@ void parseOptions(int argc, char **argv, char *filename, char *orderlist) {
             {"version", no_argument, 0, 0},
             {"maf",  required_argument, 0, 'm'},
             {"order",  required_argument, 0, 0},
+            {"verbatim",  no_argument, 0, 0},
             {0, 0, 0, 0}
         };
         int longIndex = 0;
@@ -98,7 +116,12 @@ void parseOptions(int argc, char **argv, char *filename, char *orderlist) {
             }
             if (strcmp("order", longOptions[longIndex].name) == 0) {
                 setOrder = true;
-                sscanf(optarg, "%s", orderlist);
+                free(*orderlist);
+                *orderlist = de_strdup(optarg);
+                break;
+            }
+            if (strcmp("verbatim", longOptions[longIndex].name) == 0) {
+                *verbatim = true;
                 break;
             }
             break;
@@ -139,70 +162,107 @@ void parseOptions(int argc, char **argv, char *filename, char *orderlist) {
 void printHeader(void) {
     printf("##maf version=1\n\n");
 }
-void checkBlock(mafBlock_t *mb, char **order, unsigned n) {
+rowOrder_t* newRowOrder(mafNameMatcher_t *order, unsigned n, bool verbatim) {
+    rowOrder_t *ro = (rowOrder_t *) de_malloc(sizeof(*ro));
+    ro->order = order;
+    ro->n = n;
+    ro->counts = (uint64_t *) de_malloc(sizeof(uint64_t) * (n + 1));
+    ro->capacity = 0;
+    ro->lines = NULL;
+    ro->rows = NULL;
+    ro->ranks = NULL;
+    ro->shell = maf_newMafBlock();
+    maf_mafBlock_setHeadLine(ro->shell, maf_newMafLineFromString("a ordered=true", 0));
+    ro->verbatim = verbatim;
+    return ro;
+}
+void destroyRowOrder(rowOrder_t *ro) {
+    if (ro == NULL) {
+        return;
+    }
+    maf_mafLine_setNext(maf_mafBlock_getHeadLine(ro->shell), NULL);
+    maf_destroyMafBlockList(ro->shell);
+    free(ro->counts);
+    free(ro->lines);
+    free(ro->rows);
+    free(ro->ranks);
+    free(ro);
+}
+static void rowOrder_reserve(rowOrder_t *ro, uint64_t m) {
+    if (m <= ro->capacity) {
+        return;
+    }
+    while (ro->capacity < m) {
+        ro->capacity = (ro->capacity == 0) ? 64 : 2 * ro->capacity;
+    }
+    free(ro->lines);
+    free(ro->rows);
+    free(ro->ranks);
+    ro->lines = (mafLine_t **) de_malloc(sizeof(mafLine_t *) * ro->capacity);
+    ro->rows = (mafLine_t **) de_malloc(sizeof(mafLine_t *) * ro->capacity);
+    ro->ranks = (int32_t *) de_malloc(sizeof(int32_t) * ro->capacity);
+}
+void checkBlock(mafBlock_t *mb, rowOrder_t *ro) {
     // the plan:
-    // create an array of mafLine_t linked lists, of length n
-    // walk the block, *copying* mafLines into the linked list at the coresponding array element
-    // then attach all existing array elements head to tail to form a single, ordered,
-    // linked list. Report this. Free everything.
-    mafLine_t **lineArrayHeads = (mafLine_t**) de_malloc(sizeof(mafLine_t*) * n);
-    mafLine_t **lineArrayTails = (mafLine_t**) de_malloc(sizeof(mafLine_t*) * n);
+    // look up the rank of every sequence line in the order list and counting sort
+    // pointers to the lines by rank, keeping the input order within a rank. No line
+    // is copied. With --verbatim the line text is written out as is, otherwise the
+    // rows are temporarily linked behind an `a ordered=true' line and pretty printed,
+    // after which the block's own links are restored so that it can be destroyed.
+    uint64_t m = 0, numRows = 0, k;
     unsigned i;
-    for (i = 0; i < n; ++i) {
-        lineArrayHeads[i] = NULL;
-        lineArrayTails[i] = NULL;
-    }
     mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
-    // build array
     while (ml != NULL) {
-        if (maf_mafLine_getType(ml) != 's') {
-            ml = maf_mafLine_getNext(ml);
-            continue;
-        }
-        for (i = 0; i < n; ++i) {
-            if (strncmp(order[i], maf_mafLine_getSpecies(ml), strlen(order[i])) == 0) {
-                if (lineArrayHeads[i] == NULL) {
-                    lineArrayHeads[i] = maf_copyMafLine(ml);
-                    lineArrayTails[i] = lineArrayHeads[i];
-                } else {
-                    maf_mafLine_setNext(lineArrayTails[i], maf_copyMafLine(ml));
-                    lineArrayTails[i] = maf_mafLine_getNext(lineArrayTails[i]);
-                }
-                break;
-            }
-        }
+        ++m;
         ml = maf_mafLine_getNext(ml);
     }
-    // connect array heads / tails
-    mafLine_t *head = NULL;
-    int prev = -1;
-    bool reportBlock = false;
-    for (i = 0; i < n; ++i) {
-        if (lineArrayHeads[i] == NULL) {
-            continue;
+    rowOrder_reserve(ro, m);
+    for (i = 0; i <= ro->n; ++i) {
+        ro->counts[i] = 0;
+    }
+    for (k = 0, ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ++k, ml = maf_mafLine_getNext(ml)) {
+        ro->lines[k] = ml;
+        ro->ranks[k] = -1;
+        if (maf_mafLine_getType(ml) == 's') {
+            // the first name on the order list that is a prefix of the species
+            ro->ranks[k] = maf_nameMatcher_match(ro->order, maf_mafLine_getSpecies(ml));
+        }
+        if (ro->ranks[k] != -1) {
+            ++(ro->counts[ro->ranks[k] + 1]);
+            ++numRows;
         }
-        reportBlock = true;
-        if (head == NULL) {
-            head = lineArrayHeads[i];
+    }
+    if (numRows == 0) {
+        return;
+    }
+    for (i = 1; i <= ro->n; ++i) {
+        ro->counts[i] += ro->counts[i - 1];
+    }
+    for (k = 0; k < m; ++k) {
+        if (ro->ranks[k] != -1) {
+            ro->rows[(ro->counts[ro->ranks[k]])++] = ro->lines[k];
         }
-        if (prev > -1) {
-            maf_mafLine_setNext(lineArrayTails[prev], lineArrayHeads[i]);
+    }
+    if (ro->verbatim) {
+        fputs("a ordered=true\n", stdout);
+        for (k = 0; k < numRows; ++k) {
+            fputs(maf_mafLine_getLine(ro->rows[k]), stdout);
+            fputc('\n', stdout);
         }
-        prev = i;
-    }
-    // put into a dummy block
-    mafBlock_t *orderedBlock = maf_newMafBlock();
-    maf_mafBlock_setHeadLine(orderedBlock, maf_newMafLineFromString("a ordered=true", 0));
-    maf_mafLine_setNext(maf_mafBlock_getHeadLine(orderedBlock), head);
-    // report block
-    if (reportBlock) {
-        maf_mafBlock_print(orderedBlock);
-    }
-    maf_destroyMafBlockList(orderedBlock);
-    free(lineArrayHeads);
-    free(lineArrayTails);
+        fputc('\n', stdout);
+        return;
+    }
+    maf_mafLine_setNext(maf_mafBlock_getHeadLine(ro->shell), ro->rows[0]);
+    for (k = 0; k < numRows; ++k) {
+        maf_mafLine_setNext(ro->rows[k], (k + 1 < numRows) ? ro->rows[k + 1] : NULL);
+    }
+    maf_mafBlock_print(ro->shell);
+    for (k = 0; k < m; ++k) {
+        maf_mafLine_setNext(ro->lines[k], (k + 1 < m) ? ro->lines[k + 1] : NULL);
+    }
+    maf_mafLine_setNext(maf_mafBlock_getHeadLine(ro->shell), NULL);
 }
-void orderInput(mafFileApi_t *mfa, char **order, unsigned n) {
+void orderInput(mafFileApi_t *mfa, rowOrder_t *ro) {
     mafBlock_t *thisBlock = NULL;
     bool headBlock = true;
     printHeader();
@@ -212,7 +272,7 @@ void orderInput(mafFileApi_t *mfa, char **order, unsigned n) {
             maf_destroyMafBlockList(thisBlock);
             continue;
         }
-        checkBlock(thisBlock, order, n);
+        checkBlock(thisBlock, ro);
         maf_destroyMafBlockList(thisBlock);
     }
 }
@@ -224,14 +284,19 @@ void destroyNameList(char **names, unsigned n) {
 }
 int main(int argc, char **argv) {
     char filename[kMaxStringLength];
-    char orderlist[kMaxStringLength];
-    orderlist[0] = '\0';
-    parseOptions(argc, argv,  filename, orderlist);
+    char *orderlist = de_strdup("");
+    bool verbatim = false;
+    parseOptions(argc, argv,  filename, &orderlist, &verbatim);
     unsigned n = 1 + countChar(orderlist, ',');
     char **order = extractSubStrings(orderlist, n, ',');
+    mafNameMatcher_t *orderMatcher = maf_newNameMatcher(order, n, true);
+    rowOrder_t *ro = newRowOrder(orderMatcher, n, verbatim);
     mafFileApi_t *mfa = maf_newMfa(filename, "r");
-    orderInput(mfa, order, n);
+    orderInput(mfa, ro);
     maf_destroyMfa(mfa);
+    destroyRowOrder(ro);
+    maf_destroyNameMatcher(orderMatcher);
     destroyNameList(order, n);
+    free(orderlist);
     return EXIT_SUCCESS;
 }
@@ -230,6 +230,34 @@ class OrderTest(unittest.TestCase):
             self.assertTrue(ordered)
             if ordered:
                 mtt.removeDir(tmpDir)
+    def testVerbatim(self):
+        """ mafRowOrderer --verbatim should order blocks and leave the rows as they were read
+        """
+        global g_header
+        mtt.makeTempDirParent()
+        customOpts = mafval.GenericValidationOptions()
+        for i in xrange(0, len(g_blocks)):
+            tmpDir = os.path.abspath(mtt.makeTempDir('verbatim'))
+            testMafPath, g_header = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                                 g_blocks[i][0], g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = []
+            cmd.append(os.path.abspath(os.path.join(parent, 'test', 'mafRowOrderer')))
+            cmd += ['--maf', testMafPath, '--order', '%s' % g_order, '--verbatim']
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'ordered.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            ordered = mafIsOrdered(os.path.join(tmpDir, 'ordered.maf'), g_blocks[i][1], g_header)
+            self.assertTrue(mafval.validateMaf(os.path.join(tmpDir, 'ordered.maf'), customOpts))
+            self.assertTrue(ordered)
+            inputLines = set(g_blocks[i][0].split('\n'))
+            f = open(os.path.join(tmpDir, 'ordered.maf'))
+            for line in f:
+                if line.startswith('s'):
+                    self.assertTrue(line.rstrip('\n') in inputLines)
+            f.close()
+            if ordered:
+                mtt.removeDir(tmpDir)
     def testMemory1(self):
         """ If valgrind is installed on the system, check for memory related errors (1).
         """
@@ -26,11 +26,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "CuTest.h"
+#include "test.mafStats.h"
 
 CuSuite* mafStats_TestSuite(void);
 
+int mafStats_RunAllTests(void);
+
 int mafStats_RunAllTests(void) {
-    return 0;
+    CuString *output = CuStringNew();
+    CuSuite *suite = CuSuiteNew();
+    CuSuite *mafStats_s = mafStats_TestSuite();
+    CuSuiteAddSuite(suite, mafStats_s);
+    CuSuiteRun(suite);
+    CuSuiteSummary(suite, output);
+    CuSuiteDetails(suite, output);
+    printf("%s\n", output->buffer);
+    CuStringDelete(output);
+    int status = (suite->failCount > 0);
+    free(mafStats_s);
+    CuSuiteDelete(suite);
+    return status;
 }
 int main(void) {
     return mafStats_RunAllTests();
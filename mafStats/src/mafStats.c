@@ -24,14 +24,12 @@
  */
 
 #include <getopt.h>
-#include <math.h>
 #include <stdbool.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
 #include "sonLib.h"
 #include "common.h"
 #include "sharedMaf.h"
+#include "mafIndex.h"
+#include "mafStatsAPI.h"
 #include "mafStats.h"
 #include "buildVersion.h"
 
@@ -48,13 +46,26 @@ void usage(void) {
     fprintf(stderr, "Options: \n");
     usageMessage('h', "help", "show this help message and exit.");
     usageMessage('m', "maf", "path to the maf file.");
+    usageMessage('\0', "json", "report as json, including distributions of block width, block "
+                 "degree, per species aligned length and gap run length, and per species pair "
+                 "column coverage.");
+    usageMessage('\0', "fromIndex", "report only what the block index of --maf records (blocks, "
+                 "s lines, columns, block area, width and degree, and per sequence aligned "
+                 "lengths) without reading the maf. Falls back to reading the maf if there is no "
+                 "up to date index.");
+    usageMessage('\0', "index", "path to the block index of --maf, see mafExtractor --buildIndex. "
+                 "default=[maf].mafidx");
+    usageMessage('t', "threads", "number of worker threads, each reading its own part of the "
+                 "maf. default 1.");
     usageMessage('v', "verbose", "turns on verbose output.");
     exit(EXIT_FAILURE);
 }
-void parseOptions(int argc, char **argv, char **filename) {
+void parseOptions(int argc, char **argv, char **filename, unsigned *numThreads, bool *isJson,
+                  bool *isFromIndex, char **indexFilename) {
     extern int g_verbose_flag;
     extern int g_debug_flag;
     int c;
+    int64_t value = 0;
     bool setMName = false;
     while (1) {
         static struct option long_options[] = {
@@ -63,10 +74,14 @@ void parseOptions(int argc, char **argv, char **filename) {
             {"help", no_argument, 0, 'h'},
             {"version", no_argument, 0, 0},
             {"maf",  required_argument, 0, 'm'},
+            {"threads",  required_argument, 0, 't'},
+            {"json",  no_argument, 0, 0},
+            {"fromIndex",  no_argument, 0, 0},
+            {"index",  required_argument, 0, 0},
             {0, 0, 0, 0}
         };
         int option_index = 0;
-        c = getopt_long(argc, argv, "d:v:h:m:s",
+        c = getopt_long(argc, argv, "d:v:h:m:t:s",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -76,11 +91,32 @@ void parseOptions(int argc, char **argv, char **filename) {
                 version();
                 exit(EXIT_SUCCESS);
             }
+            if (strcmp("json", long_options[option_index].name) == 0) {
+                *isJson = true;
+                break;
+            }
+            if (strcmp("fromIndex", long_options[option_index].name) == 0) {
+                *isFromIndex = true;
+                break;
+            }
+            if (strcmp("index", long_options[option_index].name) == 0) {
+                free(*indexFilename);
+                *indexFilename = stString_copy(optarg);
+                break;
+            }
             break;
         case 'm':
             setMName = true;
             *filename = stString_copy(optarg);
             break;
+        case 't':
+            value = strtoll(optarg, NULL, 10);
+            if (value < 1) {
+                fprintf(stderr, "Error, --threads %" PRIi64 " must be positive.\n", value);
+                usage();
+            }
+            *numThreads = value;
+            break;
         case 'v':
             g_verbose_flag++;
             break;
@@ -112,214 +148,40 @@ void parseOptions(int argc, char **argv, char **filename) {
         usage();
     }
 }
-stats_t* stats_create(char *filename) {
-    stats_t *stats = (stats_t*) st_malloc(sizeof(*stats));
-    stats->filename = filename; // NOT to be free'd in _destroy
-    stats->numLines = 0;
-    stats->numHeaderLines = 1; // the ##maf line
-    stats->numBlocks = 0;
-    stats->numSeqLines = 0;
-    stats->numELines = 0;
-    stats->numILines = 0;
-    stats->numQLines = 0;
-    stats->numCommentLines = 0;
-    stats->numGapCharacters = 0;
-    stats->numSeqCharacters = 0;
-    stats->numColumns = 0;
-    stats->sumSeqField = 0;
-    stats->maxSeqField = 0;
-    stats->sumNumSpeciesInBlock = 0;
-    stats->maxNumSpeciesInBlock = 0;
-    stats->sumBlockArea = 0;
-    stats->maxBlockArea = 0;
-    stats->seqHash = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, free);
-    return stats;
-}
-void stats_destroy(stats_t *stats) {
-    stHash_destruct(stats->seqHash);
-    free(stats);
-    stats = NULL;
-}
-void countCharacters(char *seq, stats_t *stats) {
-    size_t len = strlen(seq);
-    for (size_t i = 0; i < len; ++i) {
-        if (seq[i] == '-') {
-            ++(stats->numGapCharacters);
-        } else {
-            ++(stats->numSeqCharacters);
-        }
-    }
-}
-void processBlock(mafBlock_t *mb, stats_t *stats) {
-    mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
-    char t = '\0';
-    char *name = NULL;
-    uint64_t *v = NULL;
-    uint64_t blockSeqFieldLength = 0;
-    t = maf_mafLine_getType(ml);
-    if (t == '#') {
-        ++(stats->numCommentLines);
-    } else if (t == 'a') {
-        ++(stats->numBlocks);
-    }
-    while ((ml = maf_mafLine_getNext(ml)) != NULL) {
-        t = maf_mafLine_getType(ml);
-        if (t == 's') {
-            ++(stats->numSeqLines);
-            if (blockSeqFieldLength == 0) {
-                blockSeqFieldLength = (uint64_t) maf_mafLine_getSequenceFieldLength(ml);
-                stats->numColumns += blockSeqFieldLength;
-                if (stats->maxSeqField < blockSeqFieldLength) {
-                    stats->maxSeqField = blockSeqFieldLength;
-                }
-            }
-            name = maf_mafLine_getSpecies(ml);
-            stats->sumSeqField += maf_mafLine_getLength(ml);
-            if (stHash_search(stats->seqHash, name) == NULL) {
-                v = (uint64_t *) st_malloc(sizeof(*v));
-                *v = maf_mafLine_getLength(ml);
-                stHash_insert(stats->seqHash, stString_copy(name), v);
-            } else {
-                v = stHash_search(stats->seqHash, name);
-                *v += maf_mafLine_getLength(ml);
-            }
-            countCharacters(maf_mafLine_getSequence(ml), stats);
-        } else if (t == '#') {
-            ++(stats->numCommentLines);
-        } else if (t == 'e') {
-            ++(stats->numELines);
-        } else if (t == 'i') {
-            ++(stats->numILines);
-        } else if (t == 'q') {
-            ++(stats->numQLines);
-        } else if (t == 'h') {
-            ++(stats->numHeaderLines);
+int main(int argc, char **argv) {
+    char *maf = NULL;
+    unsigned numThreads = 1;
+    bool isJson = false, isFromIndex = false;
+    char *indexFilename = NULL;
+    parseOptions(argc, argv, &maf, &numThreads, &isJson, &isFromIndex, &indexFilename);
+    stats_t *stats = stats_create(maf, isJson);
+    mafIndex_t *mi = NULL;
+    if (isFromIndex) {
+        mi = maf_openIndexForMaf(maf, indexFilename);
+        if (mi == NULL) {
+            fprintf(stderr, "Warning, no current index for %s, reading it in full.\n", maf);
         }
     }
-    if (stats->maxBlockArea < maf_mafBlock_getNumberOfSequences(mb) * blockSeqFieldLength) {
-        stats->maxBlockArea = maf_mafBlock_getNumberOfSequences(mb) * blockSeqFieldLength;
-    }
-    stats->sumBlockArea += maf_mafBlock_getNumberOfSequences(mb) * blockSeqFieldLength;
-    if (stats->maxNumSpeciesInBlock < maf_mafBlock_getNumberOfSequences(mb)) {
-        stats->maxNumSpeciesInBlock = maf_mafBlock_getNumberOfSequences(mb);
-    }
-    stats->sumNumSpeciesInBlock += maf_mafBlock_getNumberOfSequences(mb);
-}
-void recordStats(mafFileApi_t *mfa, stats_t *stats) {
-    mafBlock_t *mb = NULL;
-    while ((mb = maf_readBlock(mfa)) != NULL) {
-        processBlock(mb, stats);
-        maf_destroyMafBlockList(mb);
-    }
-    stats->numLines = maf_mafFileApi_getLineNumber(mfa);
-}
-void readFilesize(struct stat *fileStat, char **filesizeString) {
-    char *s = st_malloc(kMaxStringLength);
-    *filesizeString = s;
-    double fs = fileStat->st_size;
-    if (fs > 1024.0) {
-        // KB
-        fs /= 1024.0;
-    } else {
-        sprintf(s, "%d Bytes", (int)fileStat->st_size);
-        return;
-    }
-    if (fs > 1024.0) {
-        // MB
-        fs /= 1024.0;
-    } else {
-        sprintf(s, "%.2f KB", fs);
-        return;
-    }
-    if (fs > 1024.0) {
-        // GB
-        fs /= 1024.0;
+
+    if (mi != NULL) {
+        recordStatsFromIndex(mi, stats);
+        maf_destroyIndex(mi);
+    } else if (numThreads > 1) {
+        recordStatsSharded(stats, numThreads);
     } else {
-        sprintf(s, "%.2f MB", fs);
-        return;
+        mafFileApi_t *mfa = maf_newMfa(maf, "r");
+        recordStats(mfa, stats);
+        maf_destroyMfa(mfa);
     }
-    if (fs > 1024.0) {
-        // TB
-        fs /= 1024.0;
-        sprintf(s, "%.2f TB", fs);
-        return;
+    if (isJson) {
+        reportStatsJson(stats);
     } else {
-        sprintf(s, "%.2f GB", fs);
-        return;
+        reportStats(stats);
     }
-}
-int cmp_seq(const void *a, const void *b) {
-    seq_t **ia = (seq_t **) a;
-    seq_t **ib = (seq_t **) b;
-    return ((*ia)->count < (*ib)->count);
-}
-void reportHash(stHash *hash) {
-    int64_t n = stHash_size(hash);
-    seq_t **order = (seq_t **) st_malloc(sizeof(*order) * n);
-    stHashIterator *hit = stHash_getIterator(hash);
-    char *key = NULL;
-    int64_t i = 0;
-    uint64_t total = 0;
-    while ((key = stHash_getNext(hit)) != NULL) {
-        order[i] = (seq_t*) st_malloc(sizeof(seq_t));
-        order[i]->name = key;
-        order[i]->count = *(uint64_t*)(stHash_search(hash, key));
-        total += order[i++]->count;
-    }
-    qsort(order, n, sizeof(seq_t*), cmp_seq);
-    for (i = 0; i < n; ++i) {
-        printf("%25s: %12" PRIu64 " (%6.2f%%)\n", order[i]->name, order[i]->count, 
-               100.0 * order[i]->count / total);
-    }
-    printf("%25s: %12" PRIu64 " (100.00%%)\n", "total", total);
-}
-void reportStats(stats_t *stats) {
-    struct stat fileStat;
-    stat(stats->filename, &fileStat);
-    printf("%s\n", stats->filename);
-    printf("------------------------------\n");
-    char *filesizeString;
-    readFilesize(&fileStat, &filesizeString);
-    printf("File size:              %10s\n", filesizeString);
-    printf("Lines:                  %10" PRIu64 "\n", stats->numLines);
-    printf("Header lines:           %10" PRIu64 "\n", stats->numHeaderLines);
-    printf("s lines:                %10" PRIu64 "\n", stats->numSeqLines);
-    printf("e lines:                %10" PRIu64 "\n", stats->numELines);
-    printf("i lines:                %10" PRIu64 "\n", stats->numILines);
-    printf("q lines:                %10" PRIu64 "\n", stats->numQLines);
-    printf("Blank lines:            %10" PRIu64 "\n", stats->numLines - stats->numSeqLines - 
-           stats->numELines - stats->numILines - stats->numQLines - 
-           stats->numHeaderLines - stats->numCommentLines);
-    printf("Comment lines:          %10" PRIu64 "\n\n", stats->numCommentLines);
-    printf("Sequence chars:         %10" PRIu64 " (%6.2f%%)\n", stats->numSeqCharacters, 
-           100.0 * (double) stats->numSeqCharacters / (stats->numSeqCharacters + stats->numGapCharacters));
-    printf("Gap chars:              %10" PRIu64 " (%6.2f%%)\n", stats->numGapCharacters,
-           100.0 * (double) stats->numGapCharacters / (stats->numSeqCharacters + stats->numGapCharacters));
-    printf("Columns:                %10" PRIu64 "\n\n", stats->numColumns);
-    printf("Blocks:                 %10" PRIu64 "\n", stats->numBlocks);
-    printf("Ave block area:         %10.2f\n", (double) stats->sumBlockArea / stats->numBlocks);
-    printf("Max block area:         %10" PRIu64 "\n", stats->maxBlockArea);
-    printf("Total block area:       %10" PRIu64 "\n", stats->sumBlockArea);
-    printf("Ave block degree:       %10.2f\n", (double) stats->sumNumSpeciesInBlock / stats->numBlocks);
-    printf("Max block degree:       %10" PRIu64 "\n", stats->maxNumSpeciesInBlock);
-    printf("Ave seq field length:   %10.2f\n", (double) stats->sumSeqField / stats->numSeqLines);
-    printf("Max seq field length:   %10" PRIu64 "\n\n", stats->maxSeqField);
-    printf("%" PRIi64 " unique sequences, ordered by # bases present:\n", stHash_size(stats->seqHash));
-    reportHash(stats->seqHash);
-    printf("\n");
-}
-int main(int argc, char **argv) {
-    char *maf = NULL;
-    parseOptions(argc, argv, &maf);
-    mafFileApi_t *mfa = maf_newMfa(maf, "r");
-    stats_t *stats = stats_create(maf);
-
-    recordStats(mfa, stats);
-    reportStats(stats);
 
     // clean up
     free(maf);
-    maf_destroyMfa(mfa);
+    free(indexFilename);
     stats_destroy(stats);
     return(EXIT_SUCCESS);
 }
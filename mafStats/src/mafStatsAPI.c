@@ -0,0 +1,765 @@
+/* 
+ * Copyright (C) 2013 by 
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's 
+ * lab (BME Dept. UCSC).
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE. 
+ */
+
+#define _POSIX_C_SOURCE 200809L // fseeko(), ftello()
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "sonLib.h"
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafIndex.h"
+#include "mafStatsAPI.h"
+
+stats_t* stats_create(char *filename, bool isDistributions) {
+    stats_t *stats = (stats_t*) st_malloc(sizeof(*stats));
+    stats->filename = filename; // NOT to be free'd in _destroy
+    stats->numLines = 0;
+    stats->numHeaderLines = 1; // the ##maf line
+    stats->numBlocks = 0;
+    stats->numSeqLines = 0;
+    stats->numELines = 0;
+    stats->numILines = 0;
+    stats->numQLines = 0;
+    stats->numCommentLines = 0;
+    stats->numGapCharacters = 0;
+    stats->numSeqCharacters = 0;
+    stats->numColumns = 0;
+    stats->sumSeqField = 0;
+    stats->maxSeqField = 0;
+    stats->sumNumSpeciesInBlock = 0;
+    stats->maxNumSpeciesInBlock = 0;
+    stats->sumBlockArea = 0;
+    stats->maxBlockArea = 0;
+    stats->seqHash = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, free);
+    stats->isFromIndex = false;
+    stats->isDistributions = isDistributions;
+    stats->blockWidth = NULL;
+    stats->blockDegree = NULL;
+    stats->gapRunLength = NULL;
+    stats->speciesHash = NULL;
+    stats->species = NULL;
+    stats->numSpecies = 0;
+    stats->maxSpecies = 0;
+    if (isDistributions) {
+        stats->blockWidth = histogram_create();
+        stats->blockDegree = histogram_create();
+        stats->gapRunLength = histogram_create();
+        // the speciesStats_t are freed through stats->species
+        stats->speciesHash = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+    }
+    return stats;
+}
+void stats_destroy(stats_t *stats) {
+    stHash_destruct(stats->seqHash);
+    histogram_destroy(stats->blockWidth);
+    histogram_destroy(stats->blockDegree);
+    histogram_destroy(stats->gapRunLength);
+    if (stats->speciesHash != NULL) {
+        stHash_destruct(stats->speciesHash);
+    }
+    for (uint64_t i = 0; i < stats->numSpecies; ++i) {
+        free(stats->species[i]->name);
+        histogram_destroy(stats->species[i]->alignedLength);
+        free(stats->species[i]->pairCoverage);
+        free(stats->species[i]);
+    }
+    free(stats->species);
+    free(stats);
+    stats = NULL;
+}
+void stats_merge(stats_t *stats, stats_t *other) {
+    // add the counts of `other' into `stats'. `other' is left unchanged.
+    stats->numLines += other->numLines;
+    stats->numHeaderLines += other->numHeaderLines;
+    stats->numSeqLines += other->numSeqLines;
+    stats->numBlocks += other->numBlocks;
+    stats->numELines += other->numELines;
+    stats->numILines += other->numILines;
+    stats->numQLines += other->numQLines;
+    stats->numCommentLines += other->numCommentLines;
+    stats->numGapCharacters += other->numGapCharacters;
+    stats->numSeqCharacters += other->numSeqCharacters;
+    stats->numColumns += other->numColumns;
+    stats->sumSeqField += other->sumSeqField;
+    if (stats->maxSeqField < other->maxSeqField) {
+        stats->maxSeqField = other->maxSeqField;
+    }
+    stats->sumNumSpeciesInBlock += other->sumNumSpeciesInBlock;
+    if (stats->maxNumSpeciesInBlock < other->maxNumSpeciesInBlock) {
+        stats->maxNumSpeciesInBlock = other->maxNumSpeciesInBlock;
+    }
+    stats->sumBlockArea += other->sumBlockArea;
+    if (stats->maxBlockArea < other->maxBlockArea) {
+        stats->maxBlockArea = other->maxBlockArea;
+    }
+    stHashIterator *hit = stHash_getIterator(other->seqHash);
+    char *key = NULL;
+    uint64_t *v = NULL;
+    while ((key = stHash_getNext(hit)) != NULL) {
+        uint64_t count = *(uint64_t *) stHash_search(other->seqHash, key);
+        if ((v = stHash_search(stats->seqHash, key)) == NULL) {
+            v = (uint64_t *) st_malloc(sizeof(*v));
+            *v = count;
+            stHash_insert(stats->seqHash, stString_copy(key), v);
+        } else {
+            *v += count;
+        }
+    }
+    stHash_destructIterator(hit);
+    if (!(stats->isDistributions && other->isDistributions)) {
+        return;
+    }
+    histogram_merge(stats->blockWidth, other->blockWidth);
+    histogram_merge(stats->blockDegree, other->blockDegree);
+    histogram_merge(stats->gapRunLength, other->gapRunLength);
+    // species ids differ between the two, go through the names
+    speciesStats_t **map = (speciesStats_t **) st_malloc(sizeof(*map) * (other->numSpecies + 1));
+    uint64_t i, j;
+    for (i = 0; i < other->numSpecies; ++i) {
+        map[i] = stats_getSpecies(stats, other->species[i]->name);
+        histogram_merge(map[i]->alignedLength, other->species[i]->alignedLength);
+    }
+    for (i = 0; i < other->numSpecies; ++i) {
+        for (j = 0; j < other->species[i]->numPairs; ++j) {
+            if (other->species[i]->pairCoverage[j] != 0) {
+                speciesStats_addPair(map[i], map[j]->id, other->species[i]->pairCoverage[j]);
+            }
+        }
+    }
+    free(map);
+}
+speciesStats_t* stats_getSpecies(stats_t *stats, const char *name) {
+    // look up the speciesStats_t of species `name', creating it if need be.
+    speciesStats_t *sp = stHash_search(stats->speciesHash, (void *) name);
+    if (sp != NULL) {
+        return sp;
+    }
+    if (stats->numSpecies == stats->maxSpecies) {
+        stats->maxSpecies = (stats->maxSpecies == 0) ? 16 : 2 * stats->maxSpecies;
+        speciesStats_t **species = (speciesStats_t **) st_malloc(sizeof(*species) * stats->maxSpecies);
+        if (stats->numSpecies > 0) {
+            memcpy(species, stats->species, sizeof(*species) * stats->numSpecies);
+        }
+        free(stats->species);
+        stats->species = species;
+    }
+    sp = (speciesStats_t *) st_malloc(sizeof(*sp));
+    sp->name = stString_copy(name);
+    sp->id = stats->numSpecies;
+    sp->alignedLength = histogram_create();
+    sp->pairCoverage = NULL;
+    sp->numPairs = 0;
+    stats->species[stats->numSpecies++] = sp;
+    stHash_insert(stats->speciesHash, sp->name, sp);
+    return sp;
+}
+void speciesStats_addPair(speciesStats_t *sp, uint64_t id, uint64_t n) {
+    // add n to the count of columns shared with the species with this id
+    if (id >= sp->numPairs) {
+        uint64_t numPairs = (sp->numPairs == 0) ? 16 : sp->numPairs;
+        while (numPairs <= id) {
+            numPairs *= 2;
+        }
+        uint64_t *pairCoverage = (uint64_t *) st_malloc(sizeof(uint64_t) * numPairs);
+        memset(pairCoverage, 0, sizeof(uint64_t) * numPairs);
+        if (sp->numPairs > 0) {
+            memcpy(pairCoverage, sp->pairCoverage, sizeof(uint64_t) * sp->numPairs);
+        }
+        free(sp->pairCoverage);
+        sp->pairCoverage = pairCoverage;
+        sp->numPairs = numPairs;
+    }
+    sp->pairCoverage[id] += n;
+}
+void countGapRuns(const char *seq, uint64_t n, histogram_t *h) {
+    // record the length of every maximal run of gaps in a sequence field of length n
+    uint64_t run = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        if (seq[i] == '-') {
+            ++run;
+        } else if (run > 0) {
+            histogram_add(h, run);
+            run = 0;
+        }
+    }
+    if (run > 0) {
+        histogram_add(h, run);
+    }
+}
+void countPairCoverage(stats_t *stats, speciesStats_t **rowSpecies, char **rowSeqs, uint64_t numRows,
+                       uint64_t n) {
+    // for every column of a block, count one column of coverage for each pair of
+    // distinct species that both have a base in it. Several rows of one species
+    // in a column count once.
+    uint64_t *stamp = (uint64_t *) st_malloc(sizeof(uint64_t) * (stats->numSpecies + 1));
+    uint64_t *present = (uint64_t *) st_malloc(sizeof(uint64_t) * (numRows + 1));
+    uint64_t i, r, a, b, numPresent;
+    for (i = 0; i < stats->numSpecies; ++i) {
+        stamp[i] = 0;
+    }
+    for (i = 0; i < n; ++i) {
+        numPresent = 0;
+        for (r = 0; r < numRows; ++r) {
+            if (rowSeqs[r][i] == '-' || stamp[rowSpecies[r]->id] == i + 1) {
+                continue;
+            }
+            stamp[rowSpecies[r]->id] = i + 1;
+            present[numPresent++] = rowSpecies[r]->id;
+        }
+        for (a = 0; a < numPresent; ++a) {
+            for (b = a + 1; b < numPresent; ++b) {
+                speciesStats_addPair(stats->species[present[a]], present[b], 1);
+                speciesStats_addPair(stats->species[present[b]], present[a], 1);
+            }
+        }
+    }
+    free(stamp);
+    free(present);
+}
+void countCharacters(const char *seq, uint64_t n, stats_t *stats) {
+    // count the gaps in a sequence field of known length n, everything else is sequence.
+    // branch free so that the compiler can vectorize it.
+    uint64_t gaps = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        gaps += (seq[i] == '-');
+    }
+    stats->numGapCharacters += gaps;
+    stats->numSeqCharacters += n - gaps;
+}
+void processBlock(mafBlock_t *mb, stats_t *stats) {
+    mafLine_t *ml = maf_mafBlock_getHeadLine(mb);
+    char t = '\0';
+    char *name = NULL;
+    uint64_t *v = NULL;
+    uint64_t blockSeqFieldLength = 0;
+    uint64_t numRows = 0;
+    speciesStats_t **rowSpecies = NULL;
+    char **rowSeqs = NULL;
+    if (stats->isDistributions) {
+        rowSpecies = (speciesStats_t **) st_malloc(sizeof(*rowSpecies) *
+                                                   (maf_mafBlock_getNumberOfSequences(mb) + 1));
+        rowSeqs = (char **) st_malloc(sizeof(*rowSeqs) * (maf_mafBlock_getNumberOfSequences(mb) + 1));
+    }
+    t = maf_mafLine_getType(ml);
+    if (t == '#') {
+        ++(stats->numCommentLines);
+    } else if (t == 'a') {
+        ++(stats->numBlocks);
+    }
+    while ((ml = maf_mafLine_getNext(ml)) != NULL) {
+        t = maf_mafLine_getType(ml);
+        if (t == 's') {
+            ++(stats->numSeqLines);
+            if (blockSeqFieldLength == 0) {
+                blockSeqFieldLength = (uint64_t) maf_mafLine_getSequenceFieldLength(ml);
+                stats->numColumns += blockSeqFieldLength;
+                if (stats->maxSeqField < blockSeqFieldLength) {
+                    stats->maxSeqField = blockSeqFieldLength;
+                }
+            }
+            name = maf_mafLine_getSpecies(ml);
+            stats->sumSeqField += maf_mafLine_getLength(ml);
+            if (stHash_search(stats->seqHash, name) == NULL) {
+                v = (uint64_t *) st_malloc(sizeof(*v));
+                *v = maf_mafLine_getLength(ml);
+                stHash_insert(stats->seqHash, stString_copy(name), v);
+            } else {
+                v = stHash_search(stats->seqHash, name);
+                *v += maf_mafLine_getLength(ml);
+            }
+            countCharacters(maf_mafLine_getSequence(ml), maf_mafLine_getSequenceFieldLength(ml), stats);
+            if (stats->isDistributions) {
+                char *species = copySpeciesName(name);
+                rowSpecies[numRows] = stats_getSpecies(stats, species);
+                rowSeqs[numRows] = maf_mafLine_getSequence(ml);
+                histogram_add(rowSpecies[numRows]->alignedLength, maf_mafLine_getLength(ml));
+                countGapRuns(maf_mafLine_getSequence(ml), maf_mafLine_getSequenceFieldLength(ml),
+                             stats->gapRunLength);
+                ++numRows;
+                free(species);
+            }
+        } else if (t == '#') {
+            ++(stats->numCommentLines);
+        } else if (t == 'e') {
+            ++(stats->numELines);
+        } else if (t == 'i') {
+            ++(stats->numILines);
+        } else if (t == 'q') {
+            ++(stats->numQLines);
+        } else if (t == 'h') {
+            ++(stats->numHeaderLines);
+        }
+    }
+    if (stats->maxBlockArea < maf_mafBlock_getNumberOfSequences(mb) * blockSeqFieldLength) {
+        stats->maxBlockArea = maf_mafBlock_getNumberOfSequences(mb) * blockSeqFieldLength;
+    }
+    stats->sumBlockArea += maf_mafBlock_getNumberOfSequences(mb) * blockSeqFieldLength;
+    if (stats->maxNumSpeciesInBlock < maf_mafBlock_getNumberOfSequences(mb)) {
+        stats->maxNumSpeciesInBlock = maf_mafBlock_getNumberOfSequences(mb);
+    }
+    stats->sumNumSpeciesInBlock += maf_mafBlock_getNumberOfSequences(mb);
+    if (stats->isDistributions) {
+        if (numRows > 0) {
+            histogram_add(stats->blockWidth, blockSeqFieldLength);
+            histogram_add(stats->blockDegree, numRows);
+            countPairCoverage(stats, rowSpecies, rowSeqs, numRows, blockSeqFieldLength);
+        }
+        free(rowSpecies);
+        free(rowSeqs);
+    }
+}
+void recordStats(mafFileApi_t *mfa, stats_t *stats) {
+    mafBlock_t *mb = NULL;
+    while ((mb = maf_readBlock(mfa)) != NULL) {
+        processBlock(mb, stats);
+        maf_destroyMafBlockList(mb);
+    }
+    stats->numLines = maf_mafFileApi_getLineNumber(mfa);
+}
+void recordStatsFromIndex(mafIndex_t *mi, stats_t *stats) {
+    // fill in the counts that can be had from the block and row records of the index,
+    // the maf itself is not read. Mirrors processBlock() for s lines.
+    maf_index_load(mi);
+    mafIndexBlock_t block;
+    uint64_t maxRows = 64;
+    mafIndexRow_t *rows = (mafIndexRow_t *) st_malloc(sizeof(*rows) * maxRows);
+    speciesStats_t **nameSpecies = NULL;
+    uint64_t i, j, *v;
+    if (stats->isDistributions) {
+        // species of each index name, looked up once
+        nameSpecies = (speciesStats_t **) st_malloc(sizeof(*nameSpecies) * (maf_index_getNumNames(mi) + 1));
+        for (i = 0; i < maf_index_getNumNames(mi); ++i) {
+            char *species = copySpeciesName(maf_index_getName(mi, i));
+            nameSpecies[i] = stats_getSpecies(stats, species);
+            free(species);
+        }
+    }
+    // per name aligned lengths, accumulated by id and put in seqHash at the end
+    uint64_t *nameLength = (uint64_t *) st_malloc(sizeof(uint64_t) * (maf_index_getNumNames(mi) + 1));
+    bool *nameSeen = (bool *) st_malloc(sizeof(bool) * (maf_index_getNumNames(mi) + 1));
+    for (i = 0; i < maf_index_getNumNames(mi); ++i) {
+        nameLength[i] = 0;
+        nameSeen[i] = false;
+    }
+    stats->isFromIndex = true;
+    stats->numBlocks = maf_index_getNumBlocks(mi);
+    for (i = 0; i < maf_index_getNumBlocks(mi); ++i) {
+        maf_index_getBlock(mi, i, &block);
+        if (block.numRows > maxRows) {
+            free(rows);
+            while (maxRows < block.numRows) {
+                maxRows *= 2;
+            }
+            rows = (mafIndexRow_t *) st_malloc(sizeof(*rows) * maxRows);
+        }
+        maf_index_getRows(mi, &block, rows);
+        stats->numSeqLines += block.numRows;
+        if (block.numRows > 0) {
+            stats->numColumns += block.width;
+            if (stats->maxSeqField < block.width) {
+                stats->maxSeqField = block.width;
+            }
+        }
+        for (j = 0; j < block.numRows; ++j) {
+            stats->sumSeqField += rows[j].length;
+            nameLength[rows[j].nameId] += rows[j].length;
+            nameSeen[rows[j].nameId] = true;
+            if (stats->isDistributions) {
+                histogram_add(nameSpecies[rows[j].nameId]->alignedLength, rows[j].length);
+            }
+        }
+        if (stats->maxBlockArea < block.numRows * block.width) {
+            stats->maxBlockArea = block.numRows * block.width;
+        }
+        stats->sumBlockArea += block.numRows * block.width;
+        if (stats->maxNumSpeciesInBlock < block.numRows) {
+            stats->maxNumSpeciesInBlock = block.numRows;
+        }
+        stats->sumNumSpeciesInBlock += block.numRows;
+        if (stats->isDistributions && block.numRows > 0) {
+            histogram_add(stats->blockWidth, block.width);
+            histogram_add(stats->blockDegree, block.numRows);
+        }
+    }
+    for (i = 0; i < maf_index_getNumNames(mi); ++i) {
+        if (!nameSeen[i]) {
+            continue;
+        }
+        v = (uint64_t *) st_malloc(sizeof(*v));
+        *v = nameLength[i];
+        stHash_insert(stats->seqHash, stString_copy(maf_index_getName(mi, i)), v);
+    }
+    free(rows);
+    free(nameSpecies);
+    free(nameLength);
+    free(nameSeen);
+}
+static bool isBlank(const char *line) {
+    for (; *line != '\0'; ++line) {
+        if (!isspace((unsigned char) *line)) {
+            return false;
+        }
+    }
+    return true;
+}
+static int64_t blankLineStart(FILE *ifp, int64_t end) {
+    // look back from `end' over the line it is in. Return the start of that line if
+    // everything between its start and `end' is white space, -1 otherwise.
+    // Only white space is stepped over, so this stops early on any real line.
+    for (int64_t i = end; i > 0; --i) {
+        fseeko(ifp, (off_t) (i - 1), SEEK_SET);
+        int c = fgetc(ifp);
+        if (c == '\n') {
+            return i;
+        }
+        if (!isspace(c)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+int64_t findShardStart(FILE *ifp, int64_t offset) {
+    // return the first position at or after `offset' that follows the blank line
+    // ending a block. maf_readBlock() consumes exactly that one blank line, so a
+    // reader that started at the top of the file would be at this same position
+    // and a shard can start reading here without splitting or repeating a block.
+    // Returns the file size if there is no such position.
+    int64_t n = kMaxStringLength;
+    char *line = (char *) st_malloc(n);
+    bool prevBlank = true; // unknown, so a blank first line is not taken as a block end
+    int64_t pos;
+    if (offset > 0) {
+        // back up one byte so that a line starting exactly at offset is not skipped.
+        // the line holding offset - 1 is only read from there on, look back over
+        // the rest of it, and if it is blank, over the line before it.
+        fseeko(ifp, (off_t) (offset - 1), SEEK_SET);
+        if (de_getline(&line, &n, ifp) == -1) {
+            free(line);
+            return (int64_t) ftello(ifp);
+        }
+        pos = (int64_t) ftello(ifp);
+        int64_t start = blankLineStart(ifp, offset - 1);
+        prevBlank = isBlank(line) && start >= 0;
+        if (prevBlank && start > 0 && blankLineStart(ifp, start - 1) < 0) {
+            // the blank line holding offset - 1 ends a block
+            free(line);
+            return pos;
+        }
+        fseeko(ifp, (off_t) pos, SEEK_SET);
+    } else {
+        fseeko(ifp, 0, SEEK_SET);
+    }
+    while (de_getline(&line, &n, ifp) != -1) {
+        bool blank = isBlank(line);
+        if (blank && !prevBlank) {
+            break;
+        }
+        prevBlank = blank;
+    }
+    pos = (int64_t) ftello(ifp);
+    free(line);
+    return pos;
+}
+void* recordShardStats(void *arg) {
+    // worker thread of --threads, read the blocks that begin inside of the shard.
+    shard_t *shard = (shard_t *) arg;
+    mafFileApi_t *mfa = maf_newMfa(shard->stats->filename, "r");
+    mafBlock_t *mb = NULL;
+    uint64_t firstLine = 0, lineNumber;
+    int64_t offset;
+    if (shard->start > 0) {
+        // the line numbers of a later shard are unknown, count them from 1.
+        // the header is only in the first shard.
+        firstLine = 1;
+        maf_mafFileApi_seek(mfa, shard->start, firstLine);
+        shard->stats->numHeaderLines = 0;
+    }
+    maf_mafFileApi_tell(mfa, &offset, &lineNumber);
+    while (offset < shard->end && (mb = maf_readBlock(mfa)) != NULL) {
+        processBlock(mb, shard->stats);
+        maf_destroyMafBlockList(mb);
+        maf_mafFileApi_tell(mfa, &offset, &lineNumber);
+    }
+    shard->stats->numLines = maf_mafFileApi_getLineNumber(mfa) - firstLine;
+    maf_destroyMfa(mfa);
+    return NULL;
+}
+void recordStatsSharded(stats_t *stats, unsigned numThreads) {
+    // split the maf into numThreads byte ranges at block boundaries, gather
+    // stats on each range in its own thread and merge them, in order, into stats.
+    struct stat fileStat;
+    if (stat(stats->filename, &fileStat) != 0) {
+        fprintf(stderr, "Error, unable to stat %s\n", stats->filename);
+        exit(EXIT_FAILURE);
+    }
+    int64_t size = (int64_t) fileStat.st_size;
+    shard_t *shards = (shard_t *) st_malloc(sizeof(*shards) * numThreads);
+    pthread_t *threads = (pthread_t *) st_malloc(sizeof(*threads) * numThreads);
+    FILE *ifp = de_fopen(stats->filename, "r");
+    unsigned i;
+    for (i = 0; i < numThreads; ++i) {
+        shards[i].start = (i == 0) ? 0 : findShardStart(ifp, (int64_t) (size / numThreads) * i);
+        if (i > 0 && shards[i].start < shards[i - 1].start) {
+            shards[i].start = shards[i - 1].start;
+        }
+        shards[i].stats = stats_create(stats->filename, stats->isDistributions);
+    }
+    fclose(ifp);
+    for (i = 0; i < numThreads; ++i) {
+        shards[i].end = (i + 1 < numThreads) ? shards[i + 1].start : INT64_MAX;
+        if (pthread_create(&threads[i], NULL, recordShardStats, &shards[i]) != 0) {
+            fprintf(stderr, "Error, unable to create thread %u\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    // stats starts out counting the ##maf line, which the first shard also counts
+    stats->numHeaderLines = 0;
+    for (i = 0; i < numThreads; ++i) {
+        pthread_join(threads[i], NULL);
+        stats_merge(stats, shards[i].stats);
+        stats_destroy(shards[i].stats);
+    }
+    free(shards);
+    free(threads);
+}
+void readFilesize(struct stat *fileStat, char **filesizeString) {
+    char *s = st_malloc(kMaxStringLength);
+    *filesizeString = s;
+    double fs = fileStat->st_size;
+    if (fs > 1024.0) {
+        // KB
+        fs /= 1024.0;
+    } else {
+        sprintf(s, "%d Bytes", (int)fileStat->st_size);
+        return;
+    }
+    if (fs > 1024.0) {
+        // MB
+        fs /= 1024.0;
+    } else {
+        sprintf(s, "%.2f KB", fs);
+        return;
+    }
+    if (fs > 1024.0) {
+        // GB
+        fs /= 1024.0;
+    } else {
+        sprintf(s, "%.2f MB", fs);
+        return;
+    }
+    if (fs > 1024.0) {
+        // TB
+        fs /= 1024.0;
+        sprintf(s, "%.2f TB", fs);
+        return;
+    } else {
+        sprintf(s, "%.2f GB", fs);
+        return;
+    }
+}
+int cmp_seq(const void *a, const void *b) {
+    // largest count first, ties by name so that the order does not depend on the
+    // hash, which differs between a serial run and merged --threads shards.
+    seq_t **ia = (seq_t **) a;
+    seq_t **ib = (seq_t **) b;
+    if ((*ia)->count != (*ib)->count) {
+        return ((*ia)->count < (*ib)->count) ? 1 : -1;
+    }
+    return strcmp((*ia)->name, (*ib)->name);
+}
+int cmp_string(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+void reportHash(stHash *hash) {
+    int64_t n = stHash_size(hash);
+    seq_t **order = (seq_t **) st_malloc(sizeof(*order) * n);
+    stHashIterator *hit = stHash_getIterator(hash);
+    char *key = NULL;
+    int64_t i = 0;
+    uint64_t total = 0;
+    while ((key = stHash_getNext(hit)) != NULL) {
+        order[i] = (seq_t*) st_malloc(sizeof(seq_t));
+        order[i]->name = key;
+        order[i]->count = *(uint64_t*)(stHash_search(hash, key));
+        total += order[i++]->count;
+    }
+    qsort(order, n, sizeof(seq_t*), cmp_seq);
+    for (i = 0; i < n; ++i) {
+        printf("%25s: %12" PRIu64 " (%6.2f%%)\n", order[i]->name, order[i]->count, 
+               100.0 * order[i]->count / total);
+    }
+    printf("%25s: %12" PRIu64 " (100.00%%)\n", "total", total);
+}
+void reportStats(stats_t *stats) {
+    struct stat fileStat;
+    stat(stats->filename, &fileStat);
+    printf("%s\n", stats->filename);
+    printf("------------------------------\n");
+    char *filesizeString;
+    readFilesize(&fileStat, &filesizeString);
+    printf("File size:              %10s\n", filesizeString);
+    if (stats->isFromIndex) {
+        // only the s lines are recorded in the index
+        printf("s lines:                %10" PRIu64 "\n\n", stats->numSeqLines);
+    } else {
+        printf("Lines:                  %10" PRIu64 "\n", stats->numLines);
+        printf("Header lines:           %10" PRIu64 "\n", stats->numHeaderLines);
+        printf("s lines:                %10" PRIu64 "\n", stats->numSeqLines);
+        printf("e lines:                %10" PRIu64 "\n", stats->numELines);
+        printf("i lines:                %10" PRIu64 "\n", stats->numILines);
+        printf("q lines:                %10" PRIu64 "\n", stats->numQLines);
+        printf("Blank lines:            %10" PRIu64 "\n", stats->numLines - stats->numSeqLines - 
+               stats->numELines - stats->numILines - stats->numQLines - 
+               stats->numHeaderLines - stats->numCommentLines);
+        printf("Comment lines:          %10" PRIu64 "\n\n", stats->numCommentLines);
+        printf("Sequence chars:         %10" PRIu64 " (%6.2f%%)\n", stats->numSeqCharacters, 
+               100.0 * (double) stats->numSeqCharacters / (stats->numSeqCharacters + stats->numGapCharacters));
+        printf("Gap chars:              %10" PRIu64 " (%6.2f%%)\n", stats->numGapCharacters,
+               100.0 * (double) stats->numGapCharacters / (stats->numSeqCharacters + stats->numGapCharacters));
+    }
+    printf("Columns:                %10" PRIu64 "\n\n", stats->numColumns);
+    printf("Blocks:                 %10" PRIu64 "\n", stats->numBlocks);
+    printf("Ave block area:         %10.2f\n", (double) stats->sumBlockArea / stats->numBlocks);
+    printf("Max block area:         %10" PRIu64 "\n", stats->maxBlockArea);
+    printf("Total block area:       %10" PRIu64 "\n", stats->sumBlockArea);
+    printf("Ave block degree:       %10.2f\n", (double) stats->sumNumSpeciesInBlock / stats->numBlocks);
+    printf("Max block degree:       %10" PRIu64 "\n", stats->maxNumSpeciesInBlock);
+    printf("Ave seq field length:   %10.2f\n", (double) stats->sumSeqField / stats->numSeqLines);
+    printf("Max seq field length:   %10" PRIu64 "\n\n", stats->maxSeqField);
+    printf("%" PRIi64 " unique sequences, ordered by # bases present:\n", stHash_size(stats->seqHash));
+    reportHash(stats->seqHash);
+    printf("\n");
+}
+void printJsonString(const char *s, FILE *ofp) {
+    // write s as a quoted json string
+    fputc('"', ofp);
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(ofp, "\\%c", *s);
+        } else if ((unsigned char) *s < 0x20) {
+            fprintf(ofp, "\\u%04x", (unsigned char) *s);
+        } else {
+            fputc(*s, ofp);
+        }
+    }
+    fputc('"', ofp);
+}
+void reportStatsJson(stats_t *stats) {
+    // the contents of reportStats() plus the distributions, as a single json object.
+    // Counts that the block index does not record are left out when read from it.
+    struct stat fileStat;
+    stat(stats->filename, &fileStat);
+    uint64_t i, j;
+    printf("{\n  \"filename\": ");
+    printJsonString(stats->filename, stdout);
+    printf(",\n  \"fileSize\": %" PRIu64 ",\n", (uint64_t) fileStat.st_size);
+    printf("  \"fromIndex\": %s,\n", stats->isFromIndex ? "true" : "false");
+    printf("  \"sLines\": %" PRIu64 ",\n", stats->numSeqLines);
+    if (!stats->isFromIndex) {
+        printf("  \"lines\": %" PRIu64 ",\n", stats->numLines);
+        printf("  \"headerLines\": %" PRIu64 ",\n", stats->numHeaderLines);
+        printf("  \"eLines\": %" PRIu64 ",\n", stats->numELines);
+        printf("  \"iLines\": %" PRIu64 ",\n", stats->numILines);
+        printf("  \"qLines\": %" PRIu64 ",\n", stats->numQLines);
+        printf("  \"blankLines\": %" PRIu64 ",\n", stats->numLines - stats->numSeqLines -
+               stats->numELines - stats->numILines - stats->numQLines -
+               stats->numHeaderLines - stats->numCommentLines);
+        printf("  \"commentLines\": %" PRIu64 ",\n", stats->numCommentLines);
+        printf("  \"sequenceChars\": %" PRIu64 ",\n", stats->numSeqCharacters);
+        printf("  \"gapChars\": %" PRIu64 ",\n", stats->numGapCharacters);
+    }
+    printf("  \"columns\": %" PRIu64 ",\n", stats->numColumns);
+    printf("  \"blocks\": %" PRIu64 ",\n", stats->numBlocks);
+    printf("  \"totalBlockArea\": %" PRIu64 ",\n", stats->sumBlockArea);
+    printf("  \"maxBlockArea\": %" PRIu64 ",\n", stats->maxBlockArea);
+    printf("  \"sumBlockDegree\": %" PRIu64 ",\n", stats->sumNumSpeciesInBlock);
+    printf("  \"maxBlockDegree\": %" PRIu64 ",\n", stats->maxNumSpeciesInBlock);
+    printf("  \"sumSeqField\": %" PRIu64 ",\n", stats->sumSeqField);
+    printf("  \"maxSeqField\": %" PRIu64 ",\n", stats->maxSeqField);
+    printf("  \"sequences\": {");
+    // by name, so that the output does not depend on the order of the hash
+    int64_t n = stHash_size(stats->seqHash);
+    char **keys = (char **) st_malloc(sizeof(*keys) * (n + 1));
+    stHashIterator *hit = stHash_getIterator(stats->seqHash);
+    char *key = NULL;
+    bool first = true;
+    int64_t k = 0;
+    while ((key = stHash_getNext(hit)) != NULL) {
+        keys[k++] = key;
+    }
+    stHash_destructIterator(hit);
+    qsort(keys, n, sizeof(*keys), cmp_string);
+    for (k = 0; k < n; ++k) {
+        printf("%s\n    ", first ? "" : ",");
+        printJsonString(keys[k], stdout);
+        printf(": %" PRIu64, *(uint64_t *) stHash_search(stats->seqHash, keys[k]));
+        first = false;
+    }
+    free(keys);
+    printf("\n  },\n");
+    printf("  \"blockWidth\": ");
+    histogram_printJson(stats->blockWidth, stdout);
+    printf(",\n  \"blockDegree\": ");
+    histogram_printJson(stats->blockDegree, stdout);
+    if (!stats->isFromIndex) {
+        printf(",\n  \"gapRunLength\": ");
+        histogram_printJson(stats->gapRunLength, stdout);
+    }
+    printf(",\n  \"alignedLength\": {");
+    for (i = 0; i < stats->numSpecies; ++i) {
+        printf("%s\n    ", (i == 0) ? "" : ",");
+        printJsonString(stats->species[i]->name, stdout);
+        printf(": ");
+        histogram_printJson(stats->species[i]->alignedLength, stdout);
+    }
+    printf("\n  }");
+    if (stats->isFromIndex) {
+        printf("\n}\n");
+        return;
+    }
+    printf(",\n  \"pairCoverage\": {");
+    for (i = 0; i < stats->numSpecies; ++i) {
+        printf("%s\n    ", (i == 0) ? "" : ",");
+        printJsonString(stats->species[i]->name, stdout);
+        printf(": {");
+        first = true;
+        for (j = 0; j < stats->species[i]->numPairs; ++j) {
+            if (stats->species[i]->pairCoverage[j] == 0) {
+                continue;
+            }
+            printf("%s", first ? "" : ", ");
+            printJsonString(stats->species[j]->name, stdout);
+            printf(": %" PRIu64, stats->species[i]->pairCoverage[j]);
+            first = false;
+        }
+        printf("}");
+    }
+    printf("\n  }\n}\n");
+}
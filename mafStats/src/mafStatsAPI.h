@@ -0,0 +1,108 @@
+/* 
+ * Copyright (C) 2013 by 
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's 
+ * lab (BME Dept. UCSC).
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE. 
+ */
+#ifndef _MAFSTATS_API_H_
+#define _MAFSTATS_API_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "sonLib.h"
+#include "sharedMaf.h"
+#include "mafIndex.h"
+#include "statsHistogram.h"
+
+typedef struct speciesStats {
+    char *name; // hg18.chr1 -> hg18
+    uint64_t id; // index into stats_t species
+    histogram_t *alignedLength; // distribution of the length field of the species' s lines
+    uint64_t *pairCoverage; // columns in which both this species and species[i] have a base
+    uint64_t numPairs; // length of pairCoverage, grown as needed
+} speciesStats_t;
+typedef struct stats {
+    char *filename;
+    uint64_t numLines;
+    uint64_t numHeaderLines;
+    uint64_t numSeqLines;
+    uint64_t numBlocks;
+    uint64_t numELines;
+    uint64_t numILines;
+    uint64_t numQLines;
+    uint64_t numCommentLines;
+    uint64_t numGapCharacters;
+    uint64_t numSeqCharacters;
+    uint64_t numColumns;
+    uint64_t sumSeqField;
+    uint64_t maxSeqField;
+    uint64_t sumNumSpeciesInBlock;
+    uint64_t maxNumSpeciesInBlock;
+    uint64_t sumBlockArea;
+    uint64_t maxBlockArea;
+    stHash *seqHash; // keyed with names, valued with uint64_t count of bases present
+    bool isFromIndex; // read from the block index, line and character counts are not known
+    // distributions, only gathered when isDistributions is set (--json)
+    bool isDistributions;
+    histogram_t *blockWidth; // sequence field length of blocks containing sequences
+    histogram_t *blockDegree; // number of s lines in blocks containing sequences
+    histogram_t *gapRunLength; // length of each run of gaps within an s line
+    stHash *speciesHash; // keyed with species names, valued with speciesStats_t
+    speciesStats_t **species; // by speciesStats_t id
+    uint64_t numSpecies;
+    uint64_t maxSpecies; // allocated length of species
+} stats_t;
+typedef struct shard {
+    // a byte range [start, end) of the maf that begins at a block boundary, see findShardStart
+    int64_t start;
+    int64_t end;
+    stats_t *stats; // the shard's own accumulator, merged into the total when done
+} shard_t;
+typedef struct seq {
+    char *name;
+    uint64_t count;
+} seq_t;
+
+stats_t* stats_create(char *filename, bool isDistributions);
+void stats_destroy(stats_t *stats);
+void stats_merge(stats_t *stats, stats_t *other);
+speciesStats_t* stats_getSpecies(stats_t *stats, const char *name);
+void speciesStats_addPair(speciesStats_t *sp, uint64_t id, uint64_t n);
+void countCharacters(const char *seq, uint64_t n, stats_t *stats);
+void countGapRuns(const char *seq, uint64_t n, histogram_t *h);
+void countPairCoverage(stats_t *stats, speciesStats_t **rowSpecies, char **rowSeqs, uint64_t numRows,
+                       uint64_t n);
+void processBlock(mafBlock_t *mb, stats_t *stats);
+void recordStats(mafFileApi_t *mfa, stats_t *stats);
+int64_t findShardStart(FILE *ifp, int64_t offset);
+void* recordShardStats(void *arg);
+void recordStatsSharded(stats_t *stats, unsigned numThreads);
+void recordStatsFromIndex(mafIndex_t *mi, stats_t *stats);
+void readFilesize(struct stat *fileStat, char **filesizeString);
+int cmp_seq(const void *a, const void *b);
+int cmp_string(const void *a, const void *b);
+void reportHash(stHash *hash);
+void reportStats(stats_t *stats);
+void printJsonString(const char *s, FILE *ofp);
+void reportStatsJson(stats_t *stats);
+
+#endif // _MAFSTATS_API_H_
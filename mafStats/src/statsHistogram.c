@@ -0,0 +1,162 @@
+/* 
+ * Copyright (C) 2013 by 
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's 
+ * lab (BME Dept. UCSC).
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE. 
+ */
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sonLib.h"
+#include "statsHistogram.h"
+
+static const unsigned kHistogramExact = 32; // values below this have a bucket of their own
+static const unsigned kHistogramSubBuckets = 16; // buckets per power of two above that
+#define kHistogramNumBuckets (32 + 59 * 16)
+
+histogram_t* histogram_create(void) {
+    histogram_t *h = (histogram_t *) st_malloc(sizeof(*h));
+    h->count = 0;
+    h->sum = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+    h->buckets = (uint64_t *) st_malloc(sizeof(uint64_t) * kHistogramNumBuckets);
+    memset(h->buckets, 0, sizeof(uint64_t) * kHistogramNumBuckets);
+    return h;
+}
+void histogram_destroy(histogram_t *h) {
+    if (h == NULL) {
+        return;
+    }
+    free(h->buckets);
+    free(h);
+}
+unsigned histogram_bucket(uint64_t value) {
+    // values under kHistogramExact are their own bucket. Otherwise the bucket is
+    // picked by the position of the highest set bit and the four bits below it.
+    if (value < kHistogramExact) {
+        return (unsigned) value;
+    }
+    unsigned e = 0;
+    uint64_t v = value;
+    while (v > 1) {
+        v >>= 1;
+        ++e;
+    }
+    return kHistogramExact + (e - 5) * kHistogramSubBuckets + (unsigned) ((value >> (e - 4)) & 15);
+}
+uint64_t histogram_bucketLower(unsigned i) {
+    // smallest value that falls in bucket i
+    if (i < kHistogramExact) {
+        return i;
+    }
+    unsigned e = (i - kHistogramExact) / kHistogramSubBuckets + 5;
+    uint64_t sub = (i - kHistogramExact) % kHistogramSubBuckets;
+    return (16 + sub) << (e - 4);
+}
+uint64_t histogram_bucketUpper(unsigned i) {
+    // largest value that falls in bucket i
+    if (i < kHistogramExact) {
+        return i;
+    }
+    unsigned e = (i - kHistogramExact) / kHistogramSubBuckets + 5;
+    return histogram_bucketLower(i) + ((uint64_t) 1 << (e - 4)) - 1;
+}
+void histogram_add(histogram_t *h, uint64_t value) {
+    ++(h->count);
+    h->sum += value;
+    if (value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+    ++(h->buckets[histogram_bucket(value)]);
+}
+void histogram_merge(histogram_t *h, const histogram_t *other) {
+    // add the contents of `other' to `h'
+    h->count += other->count;
+    h->sum += other->sum;
+    if (other->min < h->min) {
+        h->min = other->min;
+    }
+    if (other->max > h->max) {
+        h->max = other->max;
+    }
+    for (unsigned i = 0; i < kHistogramNumBuckets; ++i) {
+        h->buckets[i] += other->buckets[i];
+    }
+}
+uint64_t histogram_quantile(const histogram_t *h, double q) {
+    // estimate the value at quantile q, 0 <= q <= 1, as the middle of the bucket
+    // holding that rank, clamped to the observed range.
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (q * h->count);
+    if (rank >= h->count) {
+        rank = h->count - 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < kHistogramNumBuckets; ++i) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t lower = histogram_bucketLower(i);
+            uint64_t v = lower + (histogram_bucketUpper(i) - lower) / 2;
+            if (v < h->min) {
+                v = h->min;
+            }
+            if (v > h->max) {
+                v = h->max;
+            }
+            return v;
+        }
+    }
+    return h->max;
+}
+void histogram_printJson(const histogram_t *h, FILE *ofp) {
+    // write the histogram as a json object. buckets are [lower, upper, count]
+    // triples, empty buckets are left out.
+    static const double quantiles[] = {0.01, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999};
+    unsigned i;
+    bool first = true;
+    fprintf(ofp, "{\"count\": %" PRIu64 ", \"sum\": %" PRIu64 ", \"min\": %" PRIu64
+            ", \"max\": %" PRIu64 ", \"mean\": %.4f, \"quantiles\": {",
+            h->count, h->sum, (h->count == 0) ? 0 : h->min, h->max,
+            (h->count == 0) ? 0.0 : (double) h->sum / h->count);
+    for (i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+        fprintf(ofp, "%s\"%g\": %" PRIu64, (i == 0) ? "" : ", ", quantiles[i],
+                histogram_quantile(h, quantiles[i]));
+    }
+    fprintf(ofp, "}, \"buckets\": [");
+    for (i = 0; i < kHistogramNumBuckets; ++i) {
+        if (h->buckets[i] == 0) {
+            continue;
+        }
+        fprintf(ofp, "%s[%" PRIu64 ", %" PRIu64 ", %" PRIu64 "]", first ? "" : ", ",
+                histogram_bucketLower(i), histogram_bucketUpper(i), h->buckets[i]);
+        first = false;
+    }
+    fprintf(ofp, "]}");
+}
@@ -0,0 +1,55 @@
+/* 
+ * Copyright (C) 2013 by 
+ * Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+ * ... and other members of the Reconstruction Team of David Haussler's 
+ * lab (BME Dept. UCSC).
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE. 
+ */
+#ifndef _STATSHISTOGRAM_H_
+#define _STATSHISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* A histogram_t is a streaming, mergeable summary of a distribution of
+ * non-negative integers. Values below 32 are counted exactly, larger values
+ * go into one of 16 buckets per power of two, so a quantile read back from the
+ * histogram is within 1/16th of the true value. The count, sum, minimum and
+ * maximum are exact. Two histograms are merged by adding their buckets.
+ */
+typedef struct histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t *buckets; // kHistogramNumBuckets counts, see histogram_bucket
+} histogram_t;
+
+histogram_t* histogram_create(void);
+void histogram_destroy(histogram_t *h);
+void histogram_add(histogram_t *h, uint64_t value);
+void histogram_merge(histogram_t *h, const histogram_t *other);
+unsigned histogram_bucket(uint64_t value);
+uint64_t histogram_bucketLower(unsigned i);
+uint64_t histogram_bucketUpper(unsigned i);
+uint64_t histogram_quantile(const histogram_t *h, double q);
+void histogram_printJson(const histogram_t *h, FILE *ofp);
+
+#endif // _STATSHISTOGRAM_H_
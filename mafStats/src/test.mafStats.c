@@ -23,4 +23,323 @@
  * THE SOFTWARE. 
  */
 
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "CuTest.h"
+#include "sonLib.h"
+#include "common.h"
+#include "sharedMaf.h"
+#include "mafIndex.h"
+#include "mafStatsAPI.h"
+#include "test.mafStats.h"
+
+static const char *g_shardHeader = "##maf version=1\n\n";
+static const char *g_shardBlocks[] = {"a score=1\n"
+                                      "s x.c 0 3 + 10 ACG\n"
+                                      "s y.c 0 3 + 10 ACG\n"
+                                      "\n",
+                                      "a score=2\n"
+                                      "s x.c 3 3 + 10 TTT\n"
+                                      "\n",
+                                      "a score=3\n" // no trailing blank line
+                                      "s x.c 6 2 + 10 GG\n"};
+
+static FILE* shardFile(int64_t *starts) {
+    // write the shard test maf to a temporary file, starts[i] is where block i begins
+    FILE *f = tmpfile();
+    assert(f != NULL);
+    fputs(g_shardHeader, f);
+    starts[0] = (int64_t) strlen(g_shardHeader);
+    for (unsigned i = 0; i < 3; ++i) {
+        fputs(g_shardBlocks[i], f);
+        starts[i + 1] = starts[i] + (int64_t) strlen(g_shardBlocks[i]);
+    }
+    return f;
+}
+static void test_findShardStart_0(CuTest *testCase) {
+    // an offset inside of a line moves on to the next block
+    int64_t starts[4];
+    FILE *f = shardFile(starts);
+    CuAssertTrue(testCase, findShardStart(f, 3) == starts[0]);
+    CuAssertTrue(testCase, findShardStart(f, starts[0] + 1) == starts[1]);
+    CuAssertTrue(testCase, findShardStart(f, starts[0] + 15) == starts[1]);
+    CuAssertTrue(testCase, findShardStart(f, starts[1] + 12) == starts[2]);
+    fclose(f);
+}
+static void test_findShardStart_1(CuTest *testCase) {
+    // an offset at the blank line ending a block, or right after it, starts the next block
+    int64_t starts[4];
+    FILE *f = shardFile(starts);
+    CuAssertTrue(testCase, findShardStart(f, starts[1] - 1) == starts[1]);
+    CuAssertTrue(testCase, findShardStart(f, starts[1]) == starts[1]);
+    CuAssertTrue(testCase, findShardStart(f, starts[2] - 1) == starts[2]);
+    CuAssertTrue(testCase, findShardStart(f, starts[2]) == starts[2]);
+    // the blank line after the header ends the header block
+    CuAssertTrue(testCase, findShardStart(f, starts[0] - 1) == starts[0]);
+    CuAssertTrue(testCase, findShardStart(f, starts[0]) == starts[0]);
+    fclose(f);
+}
+static void test_findShardStart_2(CuTest *testCase) {
+    // past the start of a last block with no trailing blank line there is no block left
+    int64_t starts[4];
+    FILE *f = shardFile(starts);
+    CuAssertTrue(testCase, findShardStart(f, starts[2] + 1) == starts[3]);
+    CuAssertTrue(testCase, findShardStart(f, starts[3] - 1) == starts[3]);
+    CuAssertTrue(testCase, findShardStart(f, starts[3]) == starts[3]);
+    fclose(f);
+}
+static void addBlock(stats_t *stats, const char *block) {
+    mafBlock_t *mb = maf_newMafBlockFromString(block, 3);
+    processBlock(mb, stats);
+    maf_destroyMafBlockList(mb);
+}
+static uint64_t pairCoverage(stats_t *stats, const char *a, const char *b) {
+    // columns covered by both species a and b
+    speciesStats_t *sa = stats_getSpecies(stats, a);
+    speciesStats_t *sb = stats_getSpecies(stats, b);
+    return (sb->id < sa->numPairs) ? sa->pairCoverage[sb->id] : 0;
+}
+static void assertHistogramsEqual(CuTest *testCase, histogram_t *a, histogram_t *b) {
+    CuAssertTrue(testCase, a->count == b->count);
+    CuAssertTrue(testCase, a->sum == b->sum);
+    CuAssertTrue(testCase, a->min == b->min);
+    CuAssertTrue(testCase, a->max == b->max);
+    CuAssertTrue(testCase, histogram_quantile(a, 0.5) == histogram_quantile(b, 0.5));
+}
+static void test_stats_merge_0(CuTest *testCase) {
+    // merging the stats of two halves gives the stats of the whole, even though the
+    // halves see their species in a different order
+    const char *first = "a score=1\n"
+        "s hg18.chr1 0 6 + 100 ACG-TAC\n"
+        "s mm9.chr2 10 5 + 100 AC--TAC\n";
+    const char *second = "a score=2\n"
+        "s rn4.chr7 4 4 - 50 GG--GG\n"
+        "s mm9.chr2 20 6 + 100 TTTTTT\n"
+        "s hg18.chr1 6 2 + 100 A----A\n";
+    char filename[] = "none";
+    stats_t *whole = stats_create(filename, true);
+    stats_t *a = stats_create(filename, true);
+    stats_t *b = stats_create(filename, true);
+    addBlock(whole, first);
+    addBlock(whole, second);
+    addBlock(a, first);
+    addBlock(b, second);
+    stats_merge(a, b);
+    CuAssertTrue(testCase, a->numBlocks == 2);
+    CuAssertTrue(testCase, a->numBlocks == whole->numBlocks);
+    CuAssertTrue(testCase, a->numSeqLines == whole->numSeqLines);
+    CuAssertTrue(testCase, a->numColumns == whole->numColumns);
+    CuAssertTrue(testCase, a->numGapCharacters == whole->numGapCharacters);
+    CuAssertTrue(testCase, a->numSeqCharacters == whole->numSeqCharacters);
+    CuAssertTrue(testCase, a->sumSeqField == whole->sumSeqField);
+    CuAssertTrue(testCase, a->maxSeqField == whole->maxSeqField);
+    CuAssertTrue(testCase, a->sumNumSpeciesInBlock == whole->sumNumSpeciesInBlock);
+    CuAssertTrue(testCase, a->maxNumSpeciesInBlock == 3);
+    CuAssertTrue(testCase, a->sumBlockArea == whole->sumBlockArea);
+    CuAssertTrue(testCase, a->maxBlockArea == whole->maxBlockArea);
+    CuAssertTrue(testCase, stHash_size(a->seqHash) == 3);
+    CuAssertTrue(testCase, *(uint64_t *) stHash_search(a->seqHash, "hg18.chr1") == 8);
+    CuAssertTrue(testCase, *(uint64_t *) stHash_search(a->seqHash, "mm9.chr2") == 11);
+    CuAssertTrue(testCase, *(uint64_t *) stHash_search(a->seqHash, "rn4.chr7") == 4);
+    assertHistogramsEqual(testCase, a->blockWidth, whole->blockWidth);
+    assertHistogramsEqual(testCase, a->blockDegree, whole->blockDegree);
+    assertHistogramsEqual(testCase, a->gapRunLength, whole->gapRunLength);
+    CuAssertTrue(testCase, a->numSpecies == 3);
+    const char *names[] = {"hg18", "mm9", "rn4"};
+    for (unsigned i = 0; i < 3; ++i) {
+        assertHistogramsEqual(testCase, stats_getSpecies(a, names[i])->alignedLength,
+                              stats_getSpecies(whole, names[i])->alignedLength);
+        for (unsigned j = 0; j < 3; ++j) {
+            CuAssertTrue(testCase, pairCoverage(a, names[i], names[j]) ==
+                         pairCoverage(whole, names[i], names[j]));
+        }
+    }
+    CuAssertTrue(testCase, pairCoverage(a, "hg18", "mm9") == 7);
+    // b is left as it was
+    CuAssertTrue(testCase, b->numBlocks == 1);
+    stats_destroy(whole);
+    stats_destroy(a);
+    stats_destroy(b);
+}
+static void writeFile(const char *filename, const char *contents) {
+    FILE *f = de_fopen(filename, "w");
+    fputs(contents, f);
+    fclose(f);
+}
+static const char *g_indexMaf = "##maf version=1\n\n"
+    "a score=1\n"
+    "s hg18.chr1 0 6 + 100 ACG-TAC\n"
+    "s mm9.chr2 10 5 + 100 AC--TAC\n"
+    "\n"
+    "a score=2\n"
+    "# a comment line\n"
+    "s rn4.chr7 4 4 - 50 GG--GG\n"
+    "s mm9.chr2 20 6 + 100 TTTTTT\n"
+    "s hg18.chr1 6 2 + 100 A----A\n"
+    "\n";
+static void test_recordStatsFromIndex_0(CuTest *testCase) {
+    // the counts read from the index are those of a full read of the maf
+    char filename[] = "test/fromIndex.maf";
+    const char *indexFilename = "test/fromIndex.maf.mafidx";
+    writeFile(filename, g_indexMaf);
+    maf_buildIndex(filename, indexFilename);
+    mafIndex_t *mi = maf_openIndexForMaf(filename, NULL);
+    CuAssertTrue(testCase, mi != NULL);
+    stats_t *indexed = stats_create(filename, true);
+    recordStatsFromIndex(mi, indexed);
+    maf_destroyIndex(mi);
+    stats_t *whole = stats_create(filename, true);
+    mafFileApi_t *mfa = maf_newMfa(filename, "r");
+    recordStats(mfa, whole);
+    maf_destroyMfa(mfa);
+    CuAssertTrue(testCase, indexed->isFromIndex);
+    CuAssertTrue(testCase, indexed->numBlocks == 2);
+    CuAssertTrue(testCase, indexed->numBlocks == whole->numBlocks);
+    CuAssertTrue(testCase, indexed->numSeqLines == whole->numSeqLines);
+    CuAssertTrue(testCase, indexed->numColumns == whole->numColumns);
+    CuAssertTrue(testCase, indexed->sumSeqField == whole->sumSeqField);
+    CuAssertTrue(testCase, indexed->maxSeqField == whole->maxSeqField);
+    CuAssertTrue(testCase, indexed->sumNumSpeciesInBlock == whole->sumNumSpeciesInBlock);
+    CuAssertTrue(testCase, indexed->maxNumSpeciesInBlock == whole->maxNumSpeciesInBlock);
+    CuAssertTrue(testCase, indexed->sumBlockArea == whole->sumBlockArea);
+    CuAssertTrue(testCase, indexed->maxBlockArea == whole->maxBlockArea);
+    CuAssertTrue(testCase, stHash_size(indexed->seqHash) == 3);
+    CuAssertTrue(testCase, *(uint64_t *) stHash_search(indexed->seqHash, "hg18.chr1") == 8);
+    CuAssertTrue(testCase, *(uint64_t *) stHash_search(indexed->seqHash, "mm9.chr2") == 11);
+    CuAssertTrue(testCase, *(uint64_t *) stHash_search(indexed->seqHash, "rn4.chr7") == 4);
+    assertHistogramsEqual(testCase, indexed->blockWidth, whole->blockWidth);
+    assertHistogramsEqual(testCase, indexed->blockDegree, whole->blockDegree);
+    CuAssertTrue(testCase, indexed->numSpecies == 3);
+    const char *names[] = {"hg18", "mm9", "rn4"};
+    for (unsigned i = 0; i < 3; ++i) {
+        assertHistogramsEqual(testCase, stats_getSpecies(indexed, names[i])->alignedLength,
+                              stats_getSpecies(whole, names[i])->alignedLength);
+    }
+    stats_destroy(indexed);
+    stats_destroy(whole);
+    remove(indexFilename);
+    remove(filename);
+}
+static void test_recordStatsFromIndex_1(CuTest *testCase) {
+    // an index that is missing, or older than its maf, is not used
+    char filename[] = "test/staleIndex.maf";
+    const char *indexFilename = "test/staleIndex.maf.mafidx";
+    writeFile(filename, g_indexMaf);
+    CuAssertTrue(testCase, maf_openIndexForMaf(filename, NULL) == NULL);
+    maf_buildIndex(filename, indexFilename);
+    mafIndex_t *mi = maf_openIndexForMaf(filename, NULL);
+    CuAssertTrue(testCase, mi != NULL);
+    maf_destroyIndex(mi);
+    FILE *f = de_fopen(filename, "a");
+    fputs("a score=3\ns hg18.chr1 8 2 + 100 AC\n\n", f);
+    fclose(f);
+    CuAssertTrue(testCase, maf_openIndexForMaf(filename, NULL) == NULL);
+    remove(indexFilename);
+    remove(filename);
+}
+static void test_histogram_bucket_0(CuTest *testCase) {
+    // small values are exact, the buckets tile all of uint64_t without gaps
+    unsigned last = histogram_bucket(UINT64_MAX);
+    for (uint64_t v = 0; v < 32; ++v) {
+        CuAssertTrue(testCase, histogram_bucket(v) == v);
+    }
+    CuAssertTrue(testCase, histogram_bucketLower(0) == 0);
+    CuAssertTrue(testCase, histogram_bucketUpper(last) == UINT64_MAX);
+    for (unsigned i = 0; i < last; ++i) {
+        CuAssertTrue(testCase, histogram_bucketLower(i) <= histogram_bucketUpper(i));
+        CuAssertTrue(testCase, histogram_bucketUpper(i) + 1 == histogram_bucketLower(i + 1));
+        CuAssertTrue(testCase, histogram_bucket(histogram_bucketLower(i)) == i);
+        CuAssertTrue(testCase, histogram_bucket(histogram_bucketUpper(i)) == i);
+        // a bucket is at most 1/16th as wide as its values
+        uint64_t width = histogram_bucketUpper(i) - histogram_bucketLower(i);
+        CuAssertTrue(testCase, width <= histogram_bucketLower(i) / 16);
+    }
+}
+static void test_histogram_add_0(CuTest *testCase) {
+    histogram_t *h = histogram_create();
+    CuAssertTrue(testCase, histogram_quantile(h, 0.5) == 0);
+    for (uint64_t v = 20; v > 0; --v) {
+        histogram_add(h, v);
+    }
+    CuAssertTrue(testCase, h->count == 20);
+    CuAssertTrue(testCase, h->sum == 210);
+    CuAssertTrue(testCase, h->min == 1);
+    CuAssertTrue(testCase, h->max == 20);
+    // below 32 every value has its own bucket, so quantiles are exact
+    CuAssertTrue(testCase, histogram_quantile(h, 0.0) == 1);
+    CuAssertTrue(testCase, histogram_quantile(h, 0.5) == 11);
+    CuAssertTrue(testCase, histogram_quantile(h, 0.95) == 20);
+    CuAssertTrue(testCase, histogram_quantile(h, 1.0) == 20);
+    histogram_destroy(h);
+}
+static void test_histogram_quantile_0(CuTest *testCase) {
+    // larger values are read back to within 1/16th, and never outside of [min, max]
+    histogram_t *h = histogram_create();
+    uint64_t n = 10000;
+    for (uint64_t i = 0; i < n; ++i) {
+        histogram_add(h, 1000 + 37 * i);
+    }
+    double qs[] = {0.01, 0.1, 0.25, 0.5, 0.9, 0.99};
+    for (unsigned j = 0; j < sizeof(qs) / sizeof(qs[0]); ++j) {
+        uint64_t truth = 1000 + 37 * (uint64_t) (qs[j] * n);
+        uint64_t q = histogram_quantile(h, qs[j]);
+        uint64_t err = (q > truth) ? q - truth : truth - q;
+        CuAssertTrue(testCase, err <= truth / 16);
+    }
+    CuAssertTrue(testCase, histogram_quantile(h, 0.0) >= h->min);
+    CuAssertTrue(testCase, histogram_quantile(h, 1.0) <= h->max);
+    histogram_destroy(h);
+    h = histogram_create();
+    histogram_add(h, 1000003);
+    CuAssertTrue(testCase, histogram_quantile(h, 0.5) == 1000003);
+    histogram_destroy(h);
+}
+static void test_histogram_merge_0(CuTest *testCase) {
+    // merging the histograms of two halves gives the histogram of the whole
+    histogram_t *whole = histogram_create();
+    histogram_t *a = histogram_create();
+    histogram_t *b = histogram_create();
+    histogram_t *empty = histogram_create();
+    uint64_t x = 12345;
+    for (unsigned i = 0; i < 5000; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t v = (x >> 33) % ((i % 2) ? 100 : 1000000);
+        histogram_add(whole, v);
+        histogram_add((i < 1700) ? a : b, v);
+    }
+    histogram_merge(a, b);
+    histogram_merge(a, empty);
+    CuAssertTrue(testCase, a->count == whole->count);
+    CuAssertTrue(testCase, a->sum == whole->sum);
+    CuAssertTrue(testCase, a->min == whole->min);
+    CuAssertTrue(testCase, a->max == whole->max);
+    for (unsigned i = 0; i <= histogram_bucket(UINT64_MAX); ++i) {
+        CuAssertTrue(testCase, a->buckets[i] == whole->buckets[i]);
+    }
+    // into an empty histogram, the minimum comes from the other
+    histogram_merge(empty, b);
+    CuAssertTrue(testCase, empty->min == b->min);
+    CuAssertTrue(testCase, histogram_quantile(empty, 0.5) == histogram_quantile(b, 0.5));
+    histogram_destroy(whole);
+    histogram_destroy(a);
+    histogram_destroy(b);
+    histogram_destroy(empty);
+}
+CuSuite* mafStats_TestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, test_findShardStart_0);
+    SUITE_ADD_TEST(suite, test_findShardStart_1);
+    SUITE_ADD_TEST(suite, test_findShardStart_2);
+    SUITE_ADD_TEST(suite, test_stats_merge_0);
+    SUITE_ADD_TEST(suite, test_recordStatsFromIndex_0);
+    SUITE_ADD_TEST(suite, test_recordStatsFromIndex_1);
+    SUITE_ADD_TEST(suite, test_histogram_bucket_0);
+    SUITE_ADD_TEST(suite, test_histogram_add_0);
+    SUITE_ADD_TEST(suite, test_histogram_quantile_0);
+    SUITE_ADD_TEST(suite, test_histogram_merge_0);
+    return suite;
+}
@@ -0,0 +1,165 @@
+##################################################
+# Copyright (C) 2013 by
+# Dent Earl (dearl@soe.ucsc.edu, dentearl@gmail.com)
+# ... and other members of the Reconstruction Team of David Haussler's
+# lab (BME Dept. UCSC).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+##################################################
+import json
+import os
+import random
+import subprocess
+import sys
+import unittest
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(sys.argv[0]),
+                                             '../../lib/')))
+import mafToolsTest as mtt
+
+g_headers = ['''##maf version=1 scoring=tba.v8
+# tba.v8 (((human chimp) baboon) (mouse rat))
+
+''']
+g_species = ['hg18', 'panTro2', 'baboon', 'mm9', 'rn4']
+
+
+def randomBlock(n):
+  # a block of n columns with some of the species, some of them twice
+  rows = []
+  for i in xrange(0, random.randint(1, 7)):
+    seq = ''.join(random.choice('ACGTN----') for j in xrange(0, n))
+    length = n - seq.count('-')
+    name = '%s.chr%d' % (random.choice(g_species), random.randint(1, 3))
+    rows.append('s %s %d %d %s %d %s' % (name, random.randint(0, 1000), length,
+                                         random.choice('+-'), 10000, seq))
+    if random.random() < 0.1:
+      rows.append('i %s C 0 I 1' % name)
+    if random.random() < 0.1:
+      rows.append('q %s %s' % (name, '9' * n))
+  if random.random() < 0.1:
+    rows.append('e %s.chrUn 0 10 + 200 I' % random.choice(g_species))
+  if random.random() < 0.1:
+    rows.insert(0, '# a comment line')
+  return 'a score=%d\n%s\n' % (random.randint(0, 100), '\n'.join(rows))
+
+
+def randomMaf(numBlocks):
+  return '\n'.join(randomBlock(random.randint(1, 120)) for i in xrange(0, numBlocks))
+
+
+def runMafStats(tmpDir, args):
+  parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+  cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafStats'))] + args
+  mtt.recordCommands([cmd], tmpDir)
+  p = subprocess.Popen(cmd, cwd=tmpDir, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+  out, err = p.communicate()
+  if p.returncode != 0:
+    raise RuntimeError('%s exited with %d: %s' % (' '.join(cmd), p.returncode, err))
+  return out
+
+
+class ThreadsTest(unittest.TestCase):
+  def testThreads(self):
+    """ mafStats --threads should report exactly what a serial run reports.
+    """
+    mtt.makeTempDirParent()
+    for i in xrange(0, 4):
+      tmpDir = os.path.abspath(mtt.makeTempDir('threads'))
+      body = randomMaf(random.randint(1, 300))
+      if i % 2:
+        # with and without a blank line at the end of the last block
+        body += '\n'
+      testMaf = os.path.join(tmpDir, 'test.maf')
+      mtt.testFile(testMaf, body, g_headers)
+      for extra in [[], ['--json']]:
+        serial = runMafStats(tmpDir, ['--maf', testMaf, '--threads', '1'] + extra)
+        for threads in ['2', '3', '7', '16']:
+          self.assertEqual(serial, runMafStats(tmpDir, ['--maf', testMaf, '--threads', threads] + extra))
+      mtt.removeDir(tmpDir)
+  def testThreadsSmall(self):
+    """ mafStats --threads should handle more threads than blocks.
+    """
+    mtt.makeTempDirParent()
+    tmpDir = os.path.abspath(mtt.makeTempDir('threadsSmall'))
+    testMaf = os.path.join(tmpDir, 'test.maf')
+    mtt.testFile(testMaf, randomBlock(10), g_headers)
+    serial = runMafStats(tmpDir, ['--maf', testMaf])
+    for threads in ['2', '16']:
+      self.assertEqual(serial, runMafStats(tmpDir, ['--maf', testMaf, '--threads', threads]))
+    mtt.removeDir(tmpDir)
+
+
+g_jsonMaf = '''a score=1
+s hg18.chr1  0 6 + 100 ACG-TAC
+s mm9.chr2  10 5 + 100 AC--TAC
+
+a score=2
+# a comment line
+s rn4.chr7   4 4 -  50 GG--GG
+s mm9.chr2  20 6 + 100 TTTTTT
+s hg18.chr1  6 2 + 100 A----A
+
+'''
+
+
+class JsonTest(unittest.TestCase):
+  def testJson(self):
+    """ mafStats --json should report the counts and distributions of a known maf.
+    """
+    mtt.makeTempDirParent()
+    tmpDir = os.path.abspath(mtt.makeTempDir('json'))
+    testMaf = os.path.join(tmpDir, 'test.maf')
+    mtt.testFile(testMaf, g_jsonMaf, ['##maf version=1\n\n'])
+    out = runMafStats(tmpDir, ['--maf', testMaf, '--json'])
+    stats = json.loads(out)
+    self.assertEqual(stats['filename'], testMaf)
+    self.assertEqual(stats['fileSize'], os.path.getsize(testMaf))
+    self.assertFalse(stats['fromIndex'])
+    self.assertEqual(stats['lines'], 12)
+    self.assertEqual(stats['headerLines'], 1)
+    self.assertEqual(stats['sLines'], 5)
+    self.assertEqual(stats['commentLines'], 1)
+    self.assertEqual(stats['sequenceChars'], 23)
+    self.assertEqual(stats['gapChars'], 9)
+    self.assertEqual(stats['blocks'], 2)
+    self.assertEqual(stats['columns'], 13)
+    self.assertEqual(stats['maxBlockDegree'], 3)
+    self.assertEqual(stats['sequences'], {'hg18.chr1': 8, 'mm9.chr2': 11, 'rn4.chr7': 4})
+    # the names come out sorted
+    self.assertTrue(out.index('"hg18.chr1"') < out.index('"mm9.chr2"') < out.index('"rn4.chr7"'))
+    width = stats['blockWidth']
+    self.assertEqual((width['count'], width['sum'], width['min'], width['max']), (2, 13, 6, 7))
+    self.assertEqual(width['quantiles']['0.5'], 7)
+    self.assertEqual(width['buckets'], [[6, 6, 1], [7, 7, 1]])
+    degree = stats['blockDegree']
+    self.assertEqual((degree['count'], degree['sum'], degree['min'], degree['max']), (2, 5, 2, 3))
+    gaps = stats['gapRunLength']
+    self.assertEqual((gaps['count'], gaps['sum'], gaps['min'], gaps['max']), (4, 9, 1, 4))
+    self.assertEqual(gaps['buckets'], [[1, 1, 1], [2, 2, 2], [4, 4, 1]])
+    self.assertEqual(sorted(stats['alignedLength'].keys()), ['hg18', 'mm9', 'rn4'])
+    self.assertEqual(stats['alignedLength']['mm9']['sum'], 11)
+    self.assertEqual(stats['alignedLength']['rn4']['buckets'], [[4, 4, 1]])
+    self.assertEqual(stats['pairCoverage'], {'hg18': {'mm9': 7, 'rn4': 2},
+                                             'mm9': {'hg18': 7, 'rn4': 4},
+                                             'rn4': {'hg18': 2, 'mm9': 4}})
+    mtt.removeDir(tmpDir)
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -24,6 +24,7 @@
  */
 #include <ctype.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -31,6 +32,8 @@
 #include <string.h>
 #include "common.h"
 #include "sharedMaf.h"
+#include "nameMatcher.h"
+#include "blockPipeline.h"
 #include "buildVersion.h"
 
 const char *g_version = "version 0.1 October 2012";
@@ -50,13 +53,19 @@ typedef struct duplicate {
     struct duplicate *next;
     uint64_t numSequences; // number of elements in the headScoredMaf ll
 } duplicate_t;
+typedef struct strandWork {
+    // everything a worker thread needs to strand a block, see --threads
+    mafNameMatcher_t *seq;
+    char strand;
+} strandWork_t;
 
-void parseOptions(int argc, char **argv, char *filename, char *seq, char *strand);
+void parseOptions(int argc, char **argv, char *filename, char *seq, char *strand, unsigned *numThreads);
 void usage(void);
 void version(void);
 void printHeader(void);
-void processBody(mafFileApi_t *mfa, char *seq, char strand);
-void checkBlock(mafBlock_t *block, char *seq, char strand);
+void processBody(mafFileApi_t *mfa, char *seq, char strand, unsigned numThreads);
+bool checkBlock(mafBlock_t *block, mafNameMatcher_t *seq, char strand);
+bool strandBlock(mafBlock_t *mb, FILE *ofp, void *arg);
 // void destroyBlock(mafLine_t *m);
 void destroyScoredMafLineList(scoredMafLine_t *sml);
 void destroyDuplicates(duplicate_t *d);
@@ -69,8 +78,9 @@ int cmp_by_score(const void *a, const void *b);
 duplicate_t* newDuplicate(void);
 
 
-void parseOptions(int argc, char **argv, char *filename, char *seq, char *strand) {
+void parseOptions(int argc, char **argv, char *filename, char *seq, char *strand, unsigned *numThreads) {
     int c;
+    int64_t value = 0;
     bool setMaf = false;
     bool setSeq = false;
     while (1) {
@@ -82,10 +92,11 @@ void parseOptions(int argc, char **argv, char *filename, char *seq, char *strand
             {"maf",  required_argument, 0, 'm'},
             {"seq",  required_argument, 0, 0},
             {"strand",  required_argument, 0, 0},
+            {"threads",  required_argument, 0, 't'},
             {0, 0, 0, 0}
         };
         int longIndex = 0;
-        c = getopt_long(argc, argv, "d:m:h:v",
+        c = getopt_long(argc, argv, "d:m:t:h:v",
                         longOptions, &longIndex);
         if (c == -1)
             break;
@@ -113,6 +124,14 @@ void parseOptions(int argc, char **argv, char *filename, char *seq, char *strand
             setMaf = true;
             sscanf(optarg, "%s", filename);
             break;
+        case 't':
+            value = strtoll(optarg, NULL, 10);
+            if (value < 1) {
+                fprintf(stderr, "Error, --threads %" PRIi64 " must be positive.\n", value);
+                usage();
+            }
+            *numThreads = value;
+            break;
         case 'v':
             g_verbose_flag++;
             break;
@@ -160,12 +179,16 @@ void usage(void) {
             "in the flipped orientation (relative to the --strand option) then the block is flipped,\n"
             "i.e. all start coordinates are transformed, and all sequence fields are reverse-complemented.\n"
             "If the block contains the target sequence multiple times and with conflicing strands\n"
-            "(i.e. both + and - strands are observed), then nothing is done.\n");
+            "(i.e. both + and - strands are observed), then nothing is done.\n"
+            "Blocks that are not flipped are written out exactly as they were read.\n"
+            "With --threads blocks are stranded on a pool of worker\n"
+            "threads, output order is unchanged.\n");
     fprintf(stderr, "Options: \n");
     usageMessage('h', "help", "show this help message and exit.");
     usageMessage('m', "maf", "input alignment maf file.");
     usageMessage('\0', "seq", "sequence to base block strandedness upon. (string comparison only done for length of input, i.e. --seq=hg18 will match hg18.chr1, hg18.chr2, etc etc)");
     usageMessage('\0', "strand", "strand to enforce, when possible. may be + or -, defaults to +.");
+    usageMessage('t', "threads", "number of worker threads used to strand blocks. default 1.");
     exit(EXIT_FAILURE);
 }
 scoredMafLine_t* newScoredMafLine(void) {
@@ -188,20 +211,20 @@ duplicate_t* newDuplicate(void) {
 void printHeader(void) {
     printf("##maf version=1\n\n");
 }
-void checkBlock(mafBlock_t *block, char *seq, char strand) {
+bool checkBlock(mafBlock_t *block, mafNameMatcher_t *seq, char strand) {
     // read through each line of a mafBlock and check to see if a block needs to be reverse complemented.
+    // if so the block is flipped in place and true is returned.
     mafLine_t *ml = maf_mafBlock_getHeadLine(block);
     bool flipStrand = false;
     bool obsSeqPos = false;
     bool obsSeqNeg = false;
-    size_t len = strlen(seq);
     while (ml != NULL) {
         if (maf_mafLine_getType(ml) != 's') {
             // skip non-sequence lines
             ml = maf_mafLine_getNext(ml);
             continue;
         }
-        if (strncmp(maf_mafLine_getSpecies(ml), seq, len) == 0) {
+        if (maf_nameMatcher_match(seq, maf_mafLine_getSpecies(ml)) != -1) {
             if (maf_mafLine_getStrand(ml) == '+') {
                 obsSeqPos = true;
             } else {
@@ -215,27 +238,54 @@ void checkBlock(mafBlock_t *block, char *seq, char strand) {
     }
     if (flipStrand && !(obsSeqPos && obsSeqNeg)) {
         maf_mafBlock_flipStrand(block);
+        return true;
+    }
+    return false;
+}
+bool strandBlock(mafBlock_t *mb, FILE *ofp, void *arg) {
+    // check a block and write it to ofp. an unflipped block is passed through
+    // as it was read, only flipped blocks need their lines rebuilt.
+    strandWork_t *sw = (strandWork_t *) arg;
+    if (checkBlock(mb, sw->seq, sw->strand)) {
+        maf_mafBlock_printToFile(mb, ofp);
+    } else {
+        maf_mafBlock_printVerbatimToFile(mb, ofp);
     }
+    return true;
 }
-void processBody(mafFileApi_t *mfa, char *seq, char strand) {
+void processBody(mafFileApi_t *mfa, char *seq, char strand, unsigned numThreads) {
     // walk the body of the maf file and process it, block by block.
     mafBlock_t *thisBlock = NULL;
+    strandWork_t sw;
+    sw.seq = maf_newNameMatcher(&seq, 1, true);
+    sw.strand = strand;
+    mafBlockPipeline_t *bp = NULL;
     thisBlock = maf_readBlock(mfa); // header block, unused
     maf_destroyMafBlockList(thisBlock);
     printHeader();
     while((thisBlock = maf_readBlock(mfa)) != NULL) {
-        checkBlock(thisBlock, seq, strand);
-        maf_mafBlock_print(thisBlock);
+        if (numThreads > 1) {
+            if (bp == NULL) {
+                bp = maf_newBlockPipeline(numThreads, strandBlock, NULL, &sw, stdout);
+            }
+            // the pipeline takes ownership of the block
+            maf_blockPipeline_submit(bp, thisBlock);
+            continue;
+        }
+        strandBlock(thisBlock, stdout, &sw);
         maf_destroyMafBlockList(thisBlock);
     }
+    maf_destroyBlockPipeline(bp);
+    maf_destroyNameMatcher(sw.seq);
 }
 int main(int argc, char **argv) {
     char filename[kMaxStringLength];
     char seq[kMaxStringLength];
     char strand = '+';
-    parseOptions(argc, argv, filename, seq, &strand);
+    unsigned numThreads = 1;
+    parseOptions(argc, argv, filename, seq, &strand, &numThreads);
     mafFileApi_t *mfa = maf_newMfa(filename, "r");
-    processBody(mfa, seq, strand);
+    processBody(mfa, seq, strand, numThreads);
     maf_destroyMfa(mfa);
     return EXIT_SUCCESS;
 }
@@ -253,6 +253,48 @@ class CoercionTest(unittest.TestCase):
             self.assertTrue(mafIsCoerced(os.path.join(tmpDir, 'coerced.maf'), expected))
             self.assertTrue(mafval.validateMaf(os.path.join(tmpDir, 'coerced.maf'), customOpts))
         mtt.removeDir(tmpDir)
+    def testCoercionThreads(self):
+        """ mafStrander should coerce blocks identically when using worker threads
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('coercionThreads'))
+        customOpts = mafval.GenericValidationOptions()
+        for a, expected, strand in g_blocks:
+            testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                   ''.join(a), g_headers)
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafStrander')),
+                   '--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                   '--seq', 'target.chr0', '--strand', strand, '--threads', '3']
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'coerced.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            self.assertTrue(mafIsCoerced(os.path.join(tmpDir, 'coerced.maf'), expected))
+            self.assertTrue(mafval.validateMaf(os.path.join(tmpDir, 'coerced.maf'), customOpts))
+        mtt.removeDir(tmpDir)
+    def testPassThrough(self):
+        """ mafStrander should write blocks that are not flipped exactly as they were read
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('passThrough'))
+        block = ('a score=0\n'
+                 's target.chr0 0 13 +  158545518 gcagctgaaaaca\n'
+                 's name.chr1   0  10 + 100 ATGT---ATGCCG\n'
+                 '\n')
+        testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                               block, g_headers)
+        parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        for threads in ['1', '3']:
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafStrander')),
+                   '--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                   '--seq', 'target.chr0', '--strand', '+', '--threads', threads]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'coerced.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            f = open(os.path.join(tmpDir, 'coerced.maf'))
+            self.assertEqual(f.read(), '##maf version=1\n\n' + block)
+            f.close()
+        mtt.removeDir(tmpDir)
     def testMemory1(self):
         """ If valgrind is installed on the system, check for memory related errors (1).
         """
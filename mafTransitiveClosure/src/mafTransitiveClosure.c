@@ -32,6 +32,7 @@
 #include "common.h"
 #include "CuTest.h"
 #include "sharedMaf.h"
+#include "sequenceSizes.h"
 #include "sonLib.h"
 #include "stPinchGraphs.h"
 #include "mafTransitiveClosure.h"
@@ -41,6 +42,7 @@
 const uint64_t kPinchThreshold = 50000000;
 const char *g_version = "v0.2 May 2013";
 bool g_isSort = false;
+char *g_sizesFilename = NULL;
 
 void version(void);
 void usage(void);
@@ -57,10 +59,11 @@ void parseOptions(int argc, char **argv, char *filename) {
             {"test", no_argument, 0, 't'},
             {"maf",  required_argument, 0, 'm'},
             {"sort", no_argument, 0, 's'},
+            {"sizes", required_argument, 0, 'z'},
             {0, 0, 0, 0}
         };
         int option_index = 0;
-        c = getopt_long(argc, argv, "d:m:s:h:v:t", long_options, &option_index);
+        c = getopt_long(argc, argv, "d:m:s:h:v:tz:", long_options, &option_index);
         if (c == -1)
             break;
         switch (c) {
@@ -77,6 +80,9 @@ void parseOptions(int argc, char **argv, char *filename) {
         case 's':
             g_isSort = true;
             break;
+        case 'z':
+            g_sizesFilename = de_strdup(optarg);
+            break;
         case 'v':
             g_verbose_flag++;
             break;
@@ -129,6 +135,8 @@ void usage(void) {
     fprintf(stderr, "Options: \n");
     usageMessage('h', "help", "show this message and exit.");
     usageMessage('m', "maf", "path to the maf file.");
+    usageMessage('z', "sizes", "path to a .chrom.sizes, .fai or maf index file giving the name and "
+                 "length of every sequence in the maf. The maf is then read once rather than twice.");
     usageMessage('v', "verbose", "turns on verbose output..");
     exit(EXIT_FAILURE);
 }
@@ -209,6 +217,10 @@ void destroyMafTcComparisonOrder(mafTcComparisonOrder_t *co) {
 void addSequenceValuesToMtcSeq(mafLine_t *ml, mafTcSeq_t *mtcs) {
     // add sequence values to maf transitive closure sequence
     int64_t s; // transformed pos coordinate start (zero based)
+    if (mtcs->sequence == NULL) {
+        // sequences read from a sizes file are only given bases once they appear in the maf
+        mtcs->sequence = createNSequence(mtcs->length);
+    }
     if (maf_mafLine_getStrand(ml) == '+') {
         s = maf_mafLine_getStart(ml);
     } else {
@@ -275,6 +287,33 @@ void createSequenceHash(mafFileApi_t *mfa, stHash **hash, stHash **nameHash) {
         maf_destroyMafBlockList(mb);
     }
 }
+void createSequenceHashFromSizes(const char *filename, stHash **hash, stHash **nameHash) {
+    // as createSequenceHash() but the sequences and their lengths come from a sizes file
+    // rather than a pass over the maf. The sequences themselves are filled in by
+    // addAlignmentsAndSequencesToThreadSet().
+    *hash = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, destroyMafTcSeq);
+    *nameHash = stHash_construct3(uint64Return, int64EqualKey, free, free);
+    mafSequenceSizes_t *ss = maf_readSequenceSizes(filename);
+    for (uint64_t i = 0; i < maf_sequenceSizes_getNumSequences(ss); ++i) {
+        const char *name = maf_sequenceSizes_getName(ss, i);
+        if (stHash_search(*hash, (void *) name) != NULL) {
+            continue;
+        }
+        mafTcSeq_t *mtcs = (mafTcSeq_t *) de_malloc(sizeof(*mtcs));
+        mtcs->name = de_strdup(name);
+        mtcs->sequence = NULL;
+        mtcs->length = maf_sequenceSizes_getLength(ss, i);
+        stHash_insert(*hash, de_strdup(name), mtcs);
+        int64_t *key = (int64_t *)st_malloc(sizeof(*key));
+        *key = (int64_t) stHash_stringKey(name);
+        if (stHash_search(*nameHash, key) == NULL) {
+            stHash_insert(*nameHash, key, de_strdup(name));
+        } else {
+            free(key);
+        }
+    }
+    maf_destroySequenceSizes(ss);
+}
 void reportSequenceHash(stHash *hash, stHash *nameHash) {
     stHashIterator *hit = stHash_getIterator(hash);
     char *key = NULL;
@@ -798,12 +837,46 @@ void addAlignmentsToThreadSet(mafFileApi_t *mfa, stPinchThreadSet *threadSet) {
     }
     stPinchThreadSet_joinTrivialBoundaries(threadSet);
 }
+void addAlignmentsAndSequencesToThreadSet(mafFileApi_t *mfa, stPinchThreadSet *threadSet, stHash *hash) {
+    // a single pass version of createSequenceHash() and addAlignmentsToThreadSet() for when
+    // the hash was built by createSequenceHashFromSizes(). The alignments of each block are
+    // added before its sequence since addSequenceValuesToMtcSeq() reverse complements lines.
+    mafBlock_t *mb = NULL;
+    mafLine_t *ml = NULL;
+    mafTcSeq_t *mtcs = NULL;
+    while ((mb = maf_readBlock(mfa)) != NULL) {
+        for (ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+            if (maf_mafLine_getType(ml) != 's') {
+                continue;
+            }
+            mtcs = stHash_search(hash, maf_mafLine_getSpecies(ml));
+            if (mtcs == NULL || mtcs->length != maf_mafLine_getSourceLength(ml)) {
+                fprintf(stderr, "Error, sequence %s on line %" PRIu64 " is missing from, or has a different "
+                        "length in, %s\n", maf_mafLine_getSpecies(ml), maf_mafLine_getLineNumber(ml),
+                        g_sizesFilename);
+                exit(EXIT_FAILURE);
+            }
+        }
+        walkBlockAddingAlignments(mb, threadSet);
+        for (ml = maf_mafBlock_getHeadLine(mb); ml != NULL; ml = maf_mafLine_getNext(ml)) {
+            if (maf_mafLine_getType(ml) == 's') {
+                addSequenceValuesToMtcSeq(ml, stHash_search(hash, maf_mafLine_getSpecies(ml)));
+            }
+        }
+        maf_destroyMafBlockList(mb);
+    }
+    stPinchThreadSet_joinTrivialBoundaries(threadSet);
+}
 uint64_t getMaxNameLength(stHash *hash) {
     // utility function to find out the length of the longest sequence name in the hash.
     stHashIterator *hit = stHash_getIterator(hash);
     char *key = NULL;
     uint64_t max = 0;
     while ((key = stHash_getNext(hit)) != NULL) {
+        if (((mafTcSeq_t *)stHash_search(hash, key))->sequence == NULL) {
+            // listed in the sizes file but absent from the maf
+            continue;
+        }
         if (max < strlen(key) + 2)
             max = strlen(key) + 2;
     }
@@ -926,20 +999,32 @@ int main(int argc, char **argv) {
     char filename[kMaxStringLength];
     stHash *sequenceHash, *nameHash;
     parseOptions(argc, argv, filename);
-    // first pass, build sequence hash
-    mafFileApi_t *mfa = maf_newMfa(filename, "r");
-    createSequenceHash(mfa, &sequenceHash, &nameHash);
-    stPinchThreadSet *threadSet = buildThreadSet(sequenceHash);
-    maf_destroyMfa(mfa);
-    // second pass, build pinch graph
-    mfa = maf_newMfa(filename, "r");
-    addAlignmentsToThreadSet(mfa, threadSet);
-    maf_destroyMfa(mfa);
+    stPinchThreadSet *threadSet = NULL;
+    mafFileApi_t *mfa = NULL;
+    if (g_sizesFilename != NULL) {
+        // the sizes are known, build the sequence hash and the pinch graph in one pass
+        createSequenceHashFromSizes(g_sizesFilename, &sequenceHash, &nameHash);
+        threadSet = buildThreadSet(sequenceHash);
+        mfa = maf_newMfa(filename, "r");
+        addAlignmentsAndSequencesToThreadSet(mfa, threadSet, sequenceHash);
+        maf_destroyMfa(mfa);
+    } else {
+        // first pass, build sequence hash
+        mfa = maf_newMfa(filename, "r");
+        createSequenceHash(mfa, &sequenceHash, &nameHash);
+        threadSet = buildThreadSet(sequenceHash);
+        maf_destroyMfa(mfa);
+        // second pass, build pinch graph
+        mfa = maf_newMfa(filename, "r");
+        addAlignmentsToThreadSet(mfa, threadSet);
+        maf_destroyMfa(mfa);
+    }
     // consolidate and report
     reportTransitiveClosure(threadSet, sequenceHash, nameHash);
     // cleanup
     stHash_destruct(sequenceHash);
     stHash_destruct(nameHash);
     stPinchThreadSet_destruct(threadSet);
+    free(g_sizesFilename);
     return EXIT_SUCCESS;
 }
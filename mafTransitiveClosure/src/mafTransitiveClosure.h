@@ -94,6 +94,8 @@ stPinchThreadSet* buildThreadSet(stHash *hash);
 void walkBlockAddingAlignments(mafBlock_t *mb, stPinchThreadSet *threadSet);
 void addAlignmentsToThreadSet(mafFileApi_t *mfa, stPinchThreadSet *threadSet);
 void createSequenceHash(mafFileApi_t *mfa, stHash **hash, stHash **nameHash);
+void createSequenceHashFromSizes(const char *filename, stHash **hash, stHash **nameHash);
+void addAlignmentsAndSequencesToThreadSet(mafFileApi_t *mfa, stPinchThreadSet *threadSet, stHash *hash);
 mafTcRegion_t* getComparisonOrderFromRow(char **mat, uint64_t row, mafTcComparisonOrder_t **done,
                                          mafTcRegion_t *todo, int containsGaps);
 mafTcComparisonOrder_t *getComparisonOrderFromMatrix(char **mat, uint64_t rowLength, uint64_t colLength,
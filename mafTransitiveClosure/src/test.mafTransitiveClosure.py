@@ -178,6 +178,30 @@ s rn3.chr4       0 10 - 20 CCGGCGGTTG
             passed = mafIsClosed(os.path.join(tmpDir, 'transitiveClosure.maf'), outList)
             self.assertTrue(passed)
         mtt.removeDir(tmpDir)
+    def testKnownInOut_3(self):
+        """ mafTransitiveClosure should compute the transitive closure of a maf built by pairwise alignment to a reference sequence, testing the --sizes option.
+        """
+        mtt.makeTempDirParent()
+        tmpDir = os.path.abspath(mtt.makeTempDir('knownInOut_3'))
+        for inMaf, outList in self.knownResults:
+            testMaf = mtt.testFile(os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                                   inMaf, g_headers)
+            f = open(os.path.join(tmpDir, 'test.chrom.sizes'), 'w')
+            for line in inMaf.split('\n'):
+                data = line.split()
+                if len(data) == 7 and data[0] == 's':
+                    f.write('%s\t%s\n' % (data[1], data[5]))
+            f.close()
+            parent = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+            cmd = [os.path.abspath(os.path.join(parent, 'test', 'mafTransitiveClosure')),
+                   '--maf', os.path.abspath(os.path.join(tmpDir, 'test.maf')),
+                   '--sizes', os.path.abspath(os.path.join(tmpDir, 'test.chrom.sizes'))]
+            outpipes = [os.path.abspath(os.path.join(tmpDir, 'transitiveClosure.maf'))]
+            mtt.recordCommands([cmd], tmpDir, outPipes=outpipes)
+            mtt.runCommandsS([cmd], tmpDir, outPipes=outpipes)
+            passed = mafIsClosed(os.path.join(tmpDir, 'transitiveClosure.maf'), outList)
+            self.assertTrue(passed)
+        mtt.removeDir(tmpDir)
     def testMemory_1(self):
         """ mafTransitiveClosure should be memory clean.
         """